@@ -10,7 +10,9 @@
 #endif
 
 #include "core_lib.h"
+#include "memory_lib.h"
 #include "render_lib.h"
+#include "render_stats.h"
 #include "physics_lib.h"
 #include "input_lib.h"
 #include "frametime.h"
@@ -27,6 +29,9 @@
 #include "scene_manager.h"
 #include "sg_main_scene.h"
 #include "shader.h"
+#include "transform.h"
+#include "job_system.h"
+#include "profiler.h"
 
 #include "SDL.h"
 #include "SDL_OpenGL.h"
@@ -70,8 +75,21 @@ int main(int argc, char *argv[]) {
 	if (core_lib_init() == false) {
 		return 1;
 	}
+
+#if defined(JOB_BENCHMARK)
+	job_system_benchmark(1000000);
+#endif
+
+#if defined(MATH_BENCHMARK)
+	matrix44_benchmark(100000, 100);
+#endif
+
+#if defined(PHYSICS_BENCHMARK)
+	physics_lib_benchmark(64, 64, 60);
+	physics_lib_benchmark(256, 256, 10);
+#endif
 	
-	render_lib_init(width, height);
+	render_lib_init(width, height, RENDER_LIB_GBUFFER_LAYOUT_SLIM);
 	
 	if (input_lib_init() == false) {
 		return 1;
@@ -79,6 +97,12 @@ int main(int argc, char *argv[]) {
 	
 	frametime_init();
 
+	if (physics_lib_init(PHYSICS_LIB_TICK_RATE_DEFAULT, PHYSICS_LIB_TICKS_MAX_DEFAULT, true) == false) {
+		return 1;
+	}
+
+	resource_manager_init();
+
 	render_lib_set_default_shader("deferred_base");
 	
 	
@@ -157,7 +181,10 @@ int main(int argc, char *argv[]) {
 	 * an event loop with a lot of redrawing.
 	 */
 	while( 1 ) {
-		real frametime = frametime_get() / 1000.0f;
+		real frametime = frametime_get_seconds();
+
+		// Everything handed out from the frame arena last iteration is dead now
+		memory_frame_reset();
 		
 		
 		{
@@ -168,8 +195,14 @@ int main(int argc, char *argv[]) {
 			}
 			if (count >= compare) {
 				char buffer[256];
-				sprintf(buffer, "%u] ft: %f\n", frametime_get_count(), frametime);
+				frametime_stats const* stats = frametime_get_stats();
+				sprintf(buffer, "%u] ft: %f  min %.2f ms  avg %.2f ms  max %.2f ms  %lu hitches\n", frametime_get_count(), frametime,
+					stats->m_frame_ms_min, stats->m_frame_ms_avg, stats->m_frame_ms_max, stats->m_hitches);
 				OutputDebugStringA(buffer);
+				render_stats_print();
+				physics_lib_print_stats();
+				profiler_print_stats();
+				memory_print_stats();
 				count = 0;
 			}
 			count++;
@@ -178,17 +211,44 @@ int main(int argc, char *argv[]) {
 		/* Process incoming events. */
 		//process_events( );
 		
-		input_lib_process(frametime);
+		{
+			PROFILE_SCOPE("input");
+			input_lib_process(frametime);
+		}
+		
+		{
+			PROFILE_SCOPE("scene");
+			g_main_scene.process(frametime);
+		}
 		
-		g_main_scene.process(frametime);
+		// Simulate away, cloth ticks on its own thread and is only blended into the render data here
+		{
+			PROFILE_SCOPE("physics");
+			physics_lib_simulate(frametime);
+		}
 		
-		// Simulate away
-		physics_lib_simulate(frametime);
+		// World matrices for everything moved above
+		{
+			PROFILE_SCOPE("transforms");
+			transform_system_update();
+		}
+
+		// GL work jobs handed back to the main thread
+		{
+			PROFILE_SCOPE("main thread jobs");
+			job_system_process_main_thread();
+		}
 		
 		// Render away
 		//render_lib_set_camera(g_camera_pos, g_camera_orient);
-		render_lib_render();
+		{
+			PROFILE_SCOPE("render");
+			render_lib_render();
+		}
 		
+		// Every thread's markers so far go into this frame's stats
+		profiler_frame();
+
 		frametime_process();
 	}
 	
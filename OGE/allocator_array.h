@@ -15,9 +15,11 @@ public:
 	void destroy(T* p_ptr);
 
 	uint32 get_allocated_count();
+	// One past the highest slot ever handed out
+	uint32 get_index_max();
+	// NULL if the slot is free
 	T * get_from_index(uint32 p_index);
-
-	T* element_find(T const* p_obj_data, bool (*p_find_func)(T const *p_obj_data_a, T const *p_obj_data_b));
+	uint32 get_index(T const* p_ptr);
 
 private:
 	class array_element
@@ -30,6 +32,7 @@ private:
 	array_element* m_array_data;
 	uint32 m_elements_max;
 	uint32 m_allocated_count;
+	uint32 m_index_max;
 };
 
 #include "allocator_array.inl"
@@ -1,12 +1,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <new.h>
+#include <string.h>
+
+#include "assert.h"
 
 template <class T>
 void allocator_array<T>::init(uint32 p_max_elements)
 {
 	m_elements_max = p_max_elements;
 	m_allocated_count = 0;
+	m_index_max = 0;
 	m_array_data = (array_element *)malloc(sizeof(array_element) * p_max_elements);
 	memset(m_array_data, 0, sizeof(array_element) * p_max_elements);
 }
@@ -24,6 +28,8 @@ void allocator_array<T>::shutdown()
 	free(m_array_data);
 	m_array_data = NULL;
 	m_elements_max = 0;
+	m_allocated_count = 0;
+	m_index_max = 0;
 }
 
 template <class T>
@@ -37,6 +43,9 @@ T* allocator_array<T>::allocate()
 				
 				m_array_data[i].m_used = true;
 				m_allocated_count++;
+				if (i >= m_index_max) {
+					m_index_max = i + 1;
+				}
 				return &m_array_data[i].m_data;
 		}
 	}
@@ -56,29 +65,31 @@ void allocator_array<T>::destroy(T* p_ptr)
 }
 
 template <class T>
-T* allocator_array<T>::element_find(T const* p_obj_data, bool (*p_find_func)(T const *p_obj_data_a, T const *p_obj_data_b))
+uint32 allocator_array<T>::get_allocated_count()
 {
-	for (uint32 i = 0; i < m_elements_max; ++i) {
-		if (p_find_func(p_obj_data, &m_array_data[i].m_data) == true) {
-			return &m_array_data[i].m_data;
-		}
-	}
-
-	return NULL;
+	return m_allocated_count;
 }
 
 template <class T>
-uint32 allocator_array<T>::get_allocated_count()
+uint32 allocator_array<T>::get_index_max()
 {
-	return m_allocated_count;
+	return m_index_max;
 }
 
 template <class T>
 T * allocator_array<T>::get_from_index(uint32 p_index)
 {
-	if (p_index >= m_elements_max) {
+	if (p_index >= m_elements_max || m_array_data[p_index].m_used == false) {
 		return NULL;
 	}
 
 	return &m_array_data[p_index].m_data;
+}
+
+template <class T>
+uint32 allocator_array<T>::get_index(T const* p_ptr)
+{
+	uint32 index = (uint32)((array_element const*)p_ptr - m_array_data);
+	assert(index < m_elements_max);
+	return index;
 }
\ No newline at end of file
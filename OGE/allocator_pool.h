@@ -0,0 +1,72 @@
+#ifndef __ALLOCATOR_POOL_H_
+#define __ALLOCATOR_POOL_H_
+
+#include "core_types.h"
+
+// Slot index in the low 16 bits, the slot's generation in the high 16
+typedef uint32 allocator_pool_handle;
+
+#define ALLOCATOR_POOL_HANDLE_INVALID (0xffffffff)
+#define ALLOCATOR_POOL_HANDLE_INDEX_BITS (16)
+#define ALLOCATOR_POOL_HANDLE_INDEX_MASK ((1 << ALLOCATOR_POOL_HANDLE_INDEX_BITS) - 1)
+
+#define ALLOCATOR_POOL_CACHE_LINE (64)
+
+// Freed slots get filled with this so stale pointers read garbage rather than old data
+#if defined(_DEBUG) && !defined(ALLOCATOR_POOL_POISON)
+#define ALLOCATOR_POOL_POISON
+#endif
+#define ALLOCATOR_POOL_POISON_BYTE (0xdd)
+
+// Fixed size pool with O(1) allocate/destroy through a free list threaded through the unused slots.
+// Live slots are also tracked in a dense list for iteration. Slots are padded out to T_ALIGNMENT,
+// use ALLOCATOR_POOL_CACHE_LINE to keep elements touched from different threads apart.
+// Has the interface ref_counted expects from its T_ALLOCATOR.
+template<class T, uint32 T_ALIGNMENT = 16>
+class allocator_pool
+{
+public:
+	allocator_pool();
+
+	void init(uint32 p_max_elements);
+	void shutdown();
+
+	T* allocate();
+	void destroy(T* p_ptr);
+
+	uint32 get_allocated_count();
+	// One past the highest slot ever handed out
+	uint32 get_index_max();
+	// NULL if the slot is free
+	T * get_from_index(uint32 p_index);
+	uint32 get_index(T const* p_ptr);
+
+	allocator_pool_handle get_handle(T const* p_ptr);
+	// NULL once the slot has been freed, even if it has been handed out again since
+	T * get_from_handle(allocator_pool_handle p_handle);
+
+	// Live elements packed together, order changes as elements are destroyed
+	uint32 get_dense_count();
+	T * get_dense(uint32 p_dense_index);
+
+private:
+	T *get_slot(uint32 p_index);
+
+	uint8 *m_memory;
+	uint8 *m_slots;
+	uint32 m_slot_size;
+	uint32 m_elements_max;
+
+	uint32 m_free_head;
+	uint32 m_allocated_count;
+	uint32 m_index_max;
+
+	uint32 *m_generations;
+	// Per slot position in m_dense, ALLOCATOR_POOL_FREE when unused
+	uint32 *m_dense_positions;
+	uint32 *m_dense;
+};
+
+#include "allocator_pool.inl"
+
+#endif /* __ALLOCATOR_POOL_H_ */
\ No newline at end of file
@@ -0,0 +1,212 @@
+#include <stdlib.h>
+#include <string.h>
+#include <new.h>
+
+#include "assert.h"
+
+#define ALLOCATOR_POOL_FREE (0xffffffff)
+
+template <class T, uint32 T_ALIGNMENT>
+allocator_pool<T, T_ALIGNMENT>::allocator_pool()
+{
+	m_memory = NULL;
+	m_slots = NULL;
+	m_slot_size = 0;
+	m_elements_max = 0;
+	m_free_head = ALLOCATOR_POOL_FREE;
+	m_allocated_count = 0;
+	m_index_max = 0;
+	m_generations = NULL;
+	m_dense_positions = NULL;
+	m_dense = NULL;
+}
+
+template <class T, uint32 T_ALIGNMENT>
+void allocator_pool<T, T_ALIGNMENT>::init(uint32 p_max_elements)
+{
+	assert((T_ALIGNMENT & (T_ALIGNMENT - 1)) == 0);
+	assert(p_max_elements <= ALLOCATOR_POOL_HANDLE_INDEX_MASK);
+
+	// Free slots hold the index of the next free one
+	uint32 size = (sizeof(T) > sizeof(uint32)) ? sizeof(T) : sizeof(uint32);
+	m_slot_size = (size + T_ALIGNMENT - 1) & ~(T_ALIGNMENT - 1);
+	m_elements_max = p_max_elements;
+
+	m_memory = (uint8 *)malloc(m_slot_size * p_max_elements + T_ALIGNMENT);
+	assert(m_memory != NULL);
+	m_slots = (uint8 *)(((size_t)m_memory + T_ALIGNMENT - 1) & ~((size_t)T_ALIGNMENT - 1));
+
+	m_generations = (uint32 *)calloc(p_max_elements, sizeof(uint32));
+	m_dense_positions = (uint32 *)malloc(sizeof(uint32) * p_max_elements);
+	m_dense = (uint32 *)malloc(sizeof(uint32) * p_max_elements);
+	assert(m_generations != NULL && m_dense_positions != NULL && m_dense != NULL);
+
+#if defined(ALLOCATOR_POOL_POISON)
+	memset(m_slots, ALLOCATOR_POOL_POISON_BYTE, m_slot_size * p_max_elements);
+#endif
+
+	// Chain every slot in order so the first allocations come out at the front
+	for (uint32 i = 0; i < p_max_elements; ++i) {
+		*(uint32 *)(m_slots + (i * m_slot_size)) = (i + 1 < p_max_elements) ? i + 1 : ALLOCATOR_POOL_FREE;
+		m_dense_positions[i] = ALLOCATOR_POOL_FREE;
+	}
+
+	m_free_head = (p_max_elements > 0) ? 0 : ALLOCATOR_POOL_FREE;
+	m_allocated_count = 0;
+	m_index_max = 0;
+}
+
+template <class T, uint32 T_ALIGNMENT>
+void allocator_pool<T, T_ALIGNMENT>::shutdown()
+{
+	for (uint32 i = 0; i < m_allocated_count; ++i) {
+		get_slot(m_dense[i])->T::~T();
+	}
+
+	free(m_memory);
+	free(m_generations);
+	free(m_dense_positions);
+	free(m_dense);
+
+	m_memory = NULL;
+	m_slots = NULL;
+	m_generations = NULL;
+	m_dense_positions = NULL;
+	m_dense = NULL;
+	m_elements_max = 0;
+	m_allocated_count = 0;
+	m_index_max = 0;
+	m_free_head = ALLOCATOR_POOL_FREE;
+}
+
+template <class T, uint32 T_ALIGNMENT>
+T *allocator_pool<T, T_ALIGNMENT>::get_slot(uint32 p_index)
+{
+	return (T *)(m_slots + (p_index * m_slot_size));
+}
+
+template <class T, uint32 T_ALIGNMENT>
+T* allocator_pool<T, T_ALIGNMENT>::allocate()
+{
+	if (m_free_head == ALLOCATOR_POOL_FREE) {
+		return NULL;
+	}
+
+	uint32 index = m_free_head;
+	uint8 *slot = m_slots + (index * m_slot_size);
+	m_free_head = *(uint32 *)slot;
+
+#if defined(ALLOCATOR_POOL_POISON)
+	// Anything other than the free list link written since the slot was freed is a use after free
+	for (uint32 i = sizeof(uint32); i < m_slot_size; ++i) {
+		assert(slot[i] == ALLOCATOR_POOL_POISON_BYTE);
+	}
+#endif
+
+	m_dense_positions[index] = m_allocated_count;
+	m_dense[m_allocated_count++] = index;
+	if (index >= m_index_max) {
+		m_index_max = index + 1;
+	}
+
+	return new(slot) T();
+}
+
+template <class T, uint32 T_ALIGNMENT>
+void allocator_pool<T, T_ALIGNMENT>::destroy(T* p_ptr)
+{
+	uint32 index = get_index(p_ptr);
+	if (m_dense_positions[index] == ALLOCATOR_POOL_FREE) {
+		return;
+	}
+
+	p_ptr->T::~T();
+
+	// Move the last live slot into the hole
+	uint32 position = m_dense_positions[index];
+	uint32 last = m_dense[--m_allocated_count];
+	m_dense[position] = last;
+	m_dense_positions[last] = position;
+	m_dense_positions[index] = ALLOCATOR_POOL_FREE;
+
+	m_generations[index]++;
+
+	uint8 *slot = (uint8 *)p_ptr;
+#if defined(ALLOCATOR_POOL_POISON)
+	memset(slot, ALLOCATOR_POOL_POISON_BYTE, m_slot_size);
+#endif
+	*(uint32 *)slot = m_free_head;
+	m_free_head = index;
+}
+
+template <class T, uint32 T_ALIGNMENT>
+uint32 allocator_pool<T, T_ALIGNMENT>::get_allocated_count()
+{
+	return m_allocated_count;
+}
+
+template <class T, uint32 T_ALIGNMENT>
+uint32 allocator_pool<T, T_ALIGNMENT>::get_index_max()
+{
+	return m_index_max;
+}
+
+template <class T, uint32 T_ALIGNMENT>
+T * allocator_pool<T, T_ALIGNMENT>::get_from_index(uint32 p_index)
+{
+	if (p_index >= m_elements_max || m_dense_positions[p_index] == ALLOCATOR_POOL_FREE) {
+		return NULL;
+	}
+
+	return get_slot(p_index);
+}
+
+template <class T, uint32 T_ALIGNMENT>
+uint32 allocator_pool<T, T_ALIGNMENT>::get_index(T const* p_ptr)
+{
+	size_t offset = (size_t)((uint8 const*)p_ptr - m_slots);
+	assert(offset % m_slot_size == 0);
+
+	uint32 index = (uint32)(offset / m_slot_size);
+	assert(index < m_elements_max);
+	return index;
+}
+
+template <class T, uint32 T_ALIGNMENT>
+allocator_pool_handle allocator_pool<T, T_ALIGNMENT>::get_handle(T const* p_ptr)
+{
+	if (p_ptr == NULL) {
+		return ALLOCATOR_POOL_HANDLE_INVALID;
+	}
+
+	uint32 index = get_index(p_ptr);
+	return ((m_generations[index] << ALLOCATOR_POOL_HANDLE_INDEX_BITS) | index) & 0xffffffff;
+}
+
+template <class T, uint32 T_ALIGNMENT>
+T * allocator_pool<T, T_ALIGNMENT>::get_from_handle(allocator_pool_handle p_handle)
+{
+	if (p_handle == ALLOCATOR_POOL_HANDLE_INVALID) {
+		return NULL;
+	}
+
+	uint32 index = p_handle & ALLOCATOR_POOL_HANDLE_INDEX_MASK;
+	if (index >= m_elements_max || ((m_generations[index] << ALLOCATOR_POOL_HANDLE_INDEX_BITS) & 0xffffffff) != (p_handle & ~ALLOCATOR_POOL_HANDLE_INDEX_MASK)) {
+		return NULL;
+	}
+
+	return get_from_index(index);
+}
+
+template <class T, uint32 T_ALIGNMENT>
+uint32 allocator_pool<T, T_ALIGNMENT>::get_dense_count()
+{
+	return m_allocated_count;
+}
+
+template <class T, uint32 T_ALIGNMENT>
+T * allocator_pool<T, T_ALIGNMENT>::get_dense(uint32 p_dense_index)
+{
+	assert(p_dense_index < m_allocated_count);
+	return get_slot(m_dense[p_dense_index]);
+}
\ No newline at end of file
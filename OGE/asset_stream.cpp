@@ -0,0 +1,231 @@
+#include "asset_stream.h"
+
+#include "assert.h"
+#include "job_system.h"
+#include "memory_lib.h"
+#include "profiler.h"
+
+#include "SDL.h"
+#include "SDL_thread.h"
+
+class asset_stream_request_node
+{
+public:
+	asset_stream_load_function m_load;
+	asset_stream_upload_function m_upload;
+	asset_stream_cancel_function m_cancel;
+	void *m_data;
+	asset_stream_request_node *m_next;
+};
+
+// Singly linked FIFO, pushed at the tail and popped at the head
+class asset_stream_queue
+{
+public:
+	asset_stream_request_node *m_head;
+	asset_stream_request_node *m_tail;
+};
+
+static SDL_Thread *g_stream_threads[ASSET_STREAM_THREADS_MAX];
+static uint32 g_stream_thread_count = 0;
+
+// Counts requests waiting in the load queue, workers sleep on it
+static SDL_sem *g_stream_pending = NULL;
+static SDL_mutex *g_stream_lock = NULL;
+static volatile bool g_stream_quit = false;
+
+static asset_stream_queue g_load_queue;
+static asset_stream_queue g_upload_queue;
+static uint32 g_stream_request_count = 0;
+
+static void queue_push(asset_stream_queue *p_queue, asset_stream_request_node *p_node)
+{
+	p_node->m_next = NULL;
+	if (p_queue->m_tail) {
+		p_queue->m_tail->m_next = p_node;
+	} else {
+		p_queue->m_head = p_node;
+	}
+	p_queue->m_tail = p_node;
+}
+
+static asset_stream_request_node *queue_pop(asset_stream_queue *p_queue)
+{
+	asset_stream_request_node *node = p_queue->m_head;
+	if (node) {
+		p_queue->m_head = node->m_next;
+		if (p_queue->m_head == NULL) {
+			p_queue->m_tail = NULL;
+		}
+	}
+
+	return node;
+}
+
+static void cancel_queue(asset_stream_queue *p_queue)
+{
+	asset_stream_request_node *node;
+	while ((node = queue_pop(p_queue)) != NULL) {
+		if (node->m_cancel) {
+			node->m_cancel(node->m_data);
+		}
+
+		MEMORY_FREE(node);
+	}
+}
+
+static int asset_stream_worker(void *p_data)
+{
+	PROFILE_THREAD_NAME("asset stream");
+
+	for (;;) {
+		SDL_SemWait(g_stream_pending);
+		if (g_stream_quit) {
+			break;
+		}
+
+		SDL_mutexP(g_stream_lock);
+		asset_stream_request_node *node = queue_pop(&g_load_queue);
+		SDL_mutexV(g_stream_lock);
+
+		if (node == NULL) {
+			continue;
+		}
+
+		if (node->m_load) {
+			node->m_load(node->m_data);
+		}
+
+		SDL_mutexP(g_stream_lock);
+		queue_push(&g_upload_queue, node);
+		SDL_mutexV(g_stream_lock);
+	}
+
+	return 0;
+}
+
+bool asset_stream_system_init(uint32 p_thread_count)
+{
+	if (p_thread_count == 0) {
+		p_thread_count = (job_system_get_thread_count() + 1) / 2;
+		if (p_thread_count == 0) {
+			p_thread_count = 1;
+		}
+	}
+
+	if (p_thread_count > ASSET_STREAM_THREADS_MAX) {
+		p_thread_count = ASSET_STREAM_THREADS_MAX;
+	}
+
+	g_stream_pending = SDL_CreateSemaphore(0);
+	g_stream_lock = SDL_CreateMutex();
+	if (g_stream_pending == NULL || g_stream_lock == NULL) {
+		return false;
+	}
+
+	g_load_queue.m_head = g_load_queue.m_tail = NULL;
+	g_upload_queue.m_head = g_upload_queue.m_tail = NULL;
+	g_stream_request_count = 0;
+
+	g_stream_quit = false;
+	g_stream_thread_count = 0;
+	for (uint32 i = 0; i < p_thread_count; ++i) {
+		g_stream_threads[i] = SDL_CreateThread(asset_stream_worker, NULL);
+		if (g_stream_threads[i] == NULL) {
+			break;
+		}
+
+		g_stream_thread_count++;
+	}
+
+	return g_stream_thread_count > 0;
+}
+
+void asset_stream_system_shutdown()
+{
+	// Loads still in flight finish, anything queued behind them or waiting to upload is cancelled
+	g_stream_quit = true;
+	for (uint32 i = 0; i < g_stream_thread_count; ++i) {
+		SDL_SemPost(g_stream_pending);
+	}
+
+	for (uint32 i = 0; i < g_stream_thread_count; ++i) {
+		SDL_WaitThread(g_stream_threads[i], NULL);
+	}
+
+	g_stream_thread_count = 0;
+
+	cancel_queue(&g_load_queue);
+	cancel_queue(&g_upload_queue);
+	g_stream_request_count = 0;
+
+	if (g_stream_pending) {
+		SDL_DestroySemaphore(g_stream_pending);
+		g_stream_pending = NULL;
+	}
+
+	if (g_stream_lock) {
+		SDL_DestroyMutex(g_stream_lock);
+		g_stream_lock = NULL;
+	}
+}
+
+void asset_stream_request(asset_stream_load_function p_load, asset_stream_upload_function p_upload,
+	asset_stream_cancel_function p_cancel, void *p_data)
+{
+	assert(g_stream_thread_count > 0);
+
+	asset_stream_request_node *node = (asset_stream_request_node *)MEMORY_ALLOC(sizeof(asset_stream_request_node), MEMORY_TAG_GENERAL);
+	node->m_load = p_load;
+	node->m_upload = p_upload;
+	node->m_cancel = p_cancel;
+	node->m_data = p_data;
+
+	SDL_mutexP(g_stream_lock);
+	queue_push(&g_load_queue, node);
+	g_stream_request_count++;
+	SDL_mutexV(g_stream_lock);
+
+	SDL_SemPost(g_stream_pending);
+}
+
+void asset_stream_process(uint32 p_budget)
+{
+	PROFILE_SCOPE("asset_stream_process");
+
+	assert(job_system_is_main_thread());
+
+	bool first = true;
+	while (first || p_budget > 0) {
+		first = false;
+
+		// Pushes only ever touch the tail, so the head can be used outside the lock
+		SDL_mutexP(g_stream_lock);
+		asset_stream_request_node *node = g_upload_queue.m_head;
+		SDL_mutexV(g_stream_lock);
+
+		if (node == NULL) {
+			break;
+		}
+
+		if (node->m_upload && node->m_upload(node->m_data, &p_budget) == false) {
+			break;
+		}
+
+		SDL_mutexP(g_stream_lock);
+		queue_pop(&g_upload_queue);
+		g_stream_request_count--;
+		SDL_mutexV(g_stream_lock);
+
+		MEMORY_FREE(node);
+	}
+}
+
+uint32 asset_stream_get_pending_count()
+{
+	SDL_mutexP(g_stream_lock);
+	uint32 count = g_stream_request_count;
+	SDL_mutexV(g_stream_lock);
+
+	return count;
+}
\ No newline at end of file
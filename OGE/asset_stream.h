@@ -0,0 +1,35 @@
+#ifndef __ASSET_STREAM_H_
+#define __ASSET_STREAM_H_
+
+#include "core_types.h"
+
+#define ASSET_STREAM_THREADS_MAX (4)
+
+// Bytes handed to GL per frame, the first upload of a frame always goes through so large assets still finish
+#define ASSET_STREAM_UPLOAD_BUDGET_DEFAULT (2 * 1024 * 1024)
+
+// Runs on a streaming thread: file I/O, decoding, parsing. Must not touch GL.
+typedef void (*asset_stream_load_function)(void *p_data);
+
+// Runs on the main thread once the load is done. Always makes some progress, then keeps going while p_budget
+// lasts, subtracting what it uploaded. Returns true when finished, false to be called again next frame.
+typedef bool (*asset_stream_upload_function)(void *p_data, uint32 *p_budget);
+
+// Runs at shutdown for a request that never finished uploading and frees p_data. GL may already be gone.
+typedef void (*asset_stream_cancel_function)(void *p_data);
+
+// Zero threads picks half the cores, at least one
+bool asset_stream_system_init(uint32 p_thread_count);
+void asset_stream_system_shutdown();
+
+// Thread safe. Loads start in request order, uploads go in the order loads finish.
+void asset_stream_request(asset_stream_load_function p_load, asset_stream_upload_function p_upload,
+	asset_stream_cancel_function p_cancel, void *p_data);
+
+// Main thread, once a frame
+void asset_stream_process(uint32 p_budget);
+
+// Requests made but not yet fully uploaded
+uint32 asset_stream_get_pending_count();
+
+#endif /* __ASSET_STREAM_H_ */
\ No newline at end of file
@@ -3,38 +3,70 @@
 
 #include "cloth_sim.h"
 #include "mesh_instance_dynamic.h"
+#include "mesh.h"
+#include "memory_lib.h"
 
 class cape : public cloth_sim
 {
 public:
 
-	static unsigned long const MESH_WIDTH = 16;
-	static unsigned long const MESH_HEIGHT = 16;
-	static unsigned long const MESH_SIZE = (MESH_WIDTH * MESH_HEIGHT);
-	static unsigned long const CONSTRAINTS_NUM = ((MESH_WIDTH - 1) + ((MESH_HEIGHT - 1) * ((MESH_WIDTH - 1) + (MESH_WIDTH) + ((MESH_WIDTH - 1) * 2))) + (2));
+	static unsigned long const MESH_WIDTH_DEFAULT = 16;
+	static unsigned long const MESH_HEIGHT_DEFAULT = 16;
+	unsigned long MESH_WIDTH;
+	unsigned long MESH_HEIGHT;
+	unsigned long MESH_SIZE;
+	unsigned long CONSTRAINTS_NUM;
 	float MESH_SPACING;
 	
-	cape() {
+	cape(unsigned long p_width = MESH_WIDTH_DEFAULT, unsigned long p_height = MESH_HEIGHT_DEFAULT) {
+		MESH_WIDTH = p_width;
+		MESH_HEIGHT = p_height;
+		MESH_SIZE = MESH_WIDTH * MESH_HEIGHT;
+		CONSTRAINTS_NUM = ((MESH_WIDTH - 1) + ((MESH_HEIGHT - 1) * ((MESH_WIDTH - 1) + (MESH_WIDTH) + ((MESH_WIDTH - 1) * 2))) + (2));
 		MESH_SPACING = 1.6f / MESH_WIDTH;
+		m_vert_data = NULL;
+		m_constraints = NULL;
+		m_mesh_instance = NULL;
+	}
+
+	virtual ~cape()
+	{
+		if (m_mesh_instance) {
+			mesh *mesh_ptr = (mesh *)m_mesh_instance->m_mesh;
+			render_block *render_block_ptr = &mesh_ptr->m_render_blocks[0];
+			render_block_ptr->release();
+			MEMORY_FREE(render_block_ptr->m_pos);
+			MEMORY_FREE(render_block_ptr->m_uv);
+			MEMORY_FREE(render_block_ptr->m_index_buffer);
+			MEMORY_FREE(mesh_ptr->m_render_blocks);
+			MEMORY_DELETE(mesh_ptr);
+			MEMORY_FREE(m_mesh_instance->m_dynamic_pos);
+			MEMORY_DELETE(m_mesh_instance);
+		}
+
+		MEMORY_FREE(m_constraints);
+		MEMORY_FREE(m_vert_data);
 	}
 
 	virtual void init()
 	{
 		// Generate mesh and uv's
-		m_vert_data = (Vector3 *)malloc(sizeof(Vector3) * MESH_SIZE);
-		m_constraints = (constraint *)malloc(sizeof(constraint) * CONSTRAINTS_NUM);
-		m_mesh_instance = new mesh_instance_dynamic;
-		mesh *mesh_ptr = new mesh;
+		m_vert_data = (Vector3 *)MEMORY_ALLOC(sizeof(Vector3) * MESH_SIZE, MEMORY_TAG_PHYSICS);
+		m_constraints = (constraint *)MEMORY_ALLOC(sizeof(constraint) * CONSTRAINTS_NUM, MEMORY_TAG_PHYSICS);
+		m_mesh_instance = MEMORY_NEW(mesh_instance_dynamic, MEMORY_TAG_SCENE);
+		mesh *mesh_ptr = MEMORY_NEW(mesh, MEMORY_TAG_GEOMETRY);
 		m_mesh_instance->m_mesh = mesh_ptr;
 
 		mesh_ptr->m_render_block_count = 1;
-		mesh_ptr->m_render_blocks = (render_block *)malloc(sizeof(render_block));
+		mesh_ptr->m_render_blocks = (render_block *)MEMORY_ALLOC(sizeof(render_block), MEMORY_TAG_GEOMETRY);
 		render_block *render_block_ptr = &mesh_ptr->m_render_blocks[0];
 
-		render_block_ptr->m_pos = (Vector3 *)malloc(sizeof(Vector3) * MESH_SIZE);
-		render_block_ptr->m_uv = (uv_coord *)malloc(sizeof(uv_coord) * MESH_SIZE);
-		m_mesh_instance->m_dynamic_pos = (Vector3 *)malloc(sizeof(Vector3) * MESH_SIZE);
+		render_block_ptr->m_pos = (Vector3 *)MEMORY_ALLOC(sizeof(Vector3) * MESH_SIZE, MEMORY_TAG_GEOMETRY);
+		render_block_ptr->m_uv = (uv_coord *)MEMORY_ALLOC(sizeof(uv_coord) * MESH_SIZE, MEMORY_TAG_GEOMETRY);
+		m_mesh_instance->m_dynamic_pos = (Vector3 *)MEMORY_ALLOC(sizeof(Vector3) * MESH_SIZE, MEMORY_TAG_PHYSICS);
 		render_block_ptr->m_vertex_count = MESH_SIZE;
+		render_block_ptr->m_prepared = false;
+		render_block_ptr->m_cpu_data_mapped = false;
 		
 
 		for (int x = 0; x < MESH_WIDTH; x++) {
@@ -48,11 +80,13 @@ public:
 			}
 		}
 
+		render_block_ptr->compute_bounds();
+
 		// Generate index buffer
 		// 2 indeces for each row, + 2 indices for each (start + 2 degenerate)
 		// For each column in the row except the last one add two indices
 		render_block_ptr->m_index_count = ((MESH_HEIGHT - 1) * 4) + ((MESH_HEIGHT - 1) * (MESH_WIDTH - 1) * 2);
-		render_block_ptr->m_index_buffer = (unsigned long *)malloc(sizeof(unsigned long) * render_block_ptr->m_index_count);
+		render_block_ptr->m_index_buffer = (unsigned long *)MEMORY_ALLOC(sizeof(unsigned long) * render_block_ptr->m_index_count, MEMORY_TAG_GEOMETRY);
 
 		unsigned long index_count = 0;
 		// Go through each row but the last one
@@ -145,16 +179,6 @@ public:
 		memcpy(m_mesh_instance->m_dynamic_pos, render_block_ptr->m_pos, render_block_ptr->m_vertex_count);
 	}
 
-	void add_force(Vector3 const& p_force) 
-	{
-		m_particle_system.add_force(p_force);
-	}
-
-	void reset_force() 
-	{
-		m_particle_system.reset_force();
-	}
-
 	virtual void simulate_post()
 	{
 	}
@@ -1,17 +1,129 @@
 #include "cloth_sim.h"
 
 #include "mesh.h"
+#include "memory_lib.h"
+#include "assert.h"
 
 #include "SDL_OpenGL.h"
 
 
+cloth_sim::cloth_sim()
+{
+	m_constraints = NULL;
+	m_constraint_count = 0;
+	m_vert_data = NULL;
+	m_state_memory = NULL;
+	m_state_previous = m_state_current = m_state_next = NULL;
+	m_state_published = 0;
+	m_state_lock = SDL_CreateMutex();
+	assert(m_state_lock != NULL);
+}
+
+cloth_sim::~cloth_sim()
+{
+	if (m_state_memory) {
+		MEMORY_FREE(m_state_memory);
+		m_state_memory = NULL;
+	}
+
+	if (m_state_lock) {
+		SDL_DestroyMutex(m_state_lock);
+		m_state_lock = NULL;
+	}
+}
+
+// The particle system is only ever touched by whoever is stepping it, the inputs are copied over first
+void cloth_sim::read_inputs(Vector3 *p_adjust)
+{
+	SDL_mutexP(m_state_lock);
+	*p_adjust = m_adjust;
+	Vector3 force = m_force;
+	SDL_mutexV(m_state_lock);
+
+	m_particle_system.reset_force();
+	m_particle_system.add_force(force);
+}
 
 void cloth_sim::simulate(real p_frametime)
 {
-	Vector3 adjust(0.0f, 0.0f, 0.0f);
+	Vector3 adjust;
+	read_inputs(&adjust);
+
 	m_particle_system.simulate(p_frametime, 1.0f, adjust, m_vert_data);
 
 	// We need to push vert data to the mesh
 	simulate_post();
 
+}
+
+void cloth_sim::tick(real p_timestep)
+{
+	uint32 count = get_particle_count();
+	if (m_state_memory == NULL) {
+		m_state_memory = (Vector3 *)MEMORY_ALLOC(sizeof(Vector3) * count * 3, MEMORY_TAG_PHYSICS);
+		assert(m_state_memory != NULL);
+		m_state_previous = m_state_memory;
+		m_state_current = m_state_memory + count;
+		m_state_next = m_state_memory + (count * 2);
+	}
+
+	Vector3 adjust;
+	read_inputs(&adjust);
+
+	// Nothing reads m_state_next, so the step runs without the lock
+	if (m_particle_system.simulate(p_timestep, 1.0f, adjust, m_state_next) == 0) {
+		return;
+	}
+
+	SDL_mutexP(m_state_lock);
+	Vector3 *oldest = m_state_previous;
+	m_state_previous = m_state_current;
+	m_state_current = m_state_next;
+	m_state_next = oldest;
+	m_state_published++;
+	SDL_mutexV(m_state_lock);
+}
+
+void cloth_sim::interpolate(real p_alpha)
+{
+	uint32 count = get_particle_count();
+
+	// Held throughout so the physics thread can't start writing into the previous state mid blend
+	SDL_mutexP(m_state_lock);
+	if (m_state_published == 0) {
+		SDL_mutexV(m_state_lock);
+		return;
+	}
+
+	if (m_state_published == 1) {
+		memcpy(m_vert_data, m_state_current, sizeof(Vector3) * count);
+	} else {
+		for (uint32 i = 0; i < count; ++i) {
+			m_vert_data[i] = m_state_previous[i] + ((m_state_current[i] - m_state_previous[i]) * p_alpha);
+		}
+	}
+	SDL_mutexV(m_state_lock);
+
+	simulate_post();
+}
+
+void cloth_sim::add_force(Vector3 const& p_force)
+{
+	SDL_mutexP(m_state_lock);
+	m_force += p_force;
+	SDL_mutexV(m_state_lock);
+}
+
+void cloth_sim::reset_force()
+{
+	SDL_mutexP(m_state_lock);
+	m_force = Vector3(0.0f, 0.0f, 0.0f);
+	SDL_mutexV(m_state_lock);
+}
+
+void cloth_sim::move(Vector3 const& p_adjust)
+{
+	SDL_mutexP(m_state_lock);
+	m_adjust += p_adjust;
+	SDL_mutexV(m_state_lock);
 }
\ No newline at end of file
@@ -5,17 +5,41 @@
 
 #include "core_types.h"
 
+#include "SDL_thread.h"
+
 class mesh_dynamic;
 
 class cloth_sim
 {
 public:
-	cloth_sim() {}
+	cloth_sim();
+	virtual ~cloth_sim();
 
 	virtual void init() = 0;
 	
+	// Safe to call for different cloth sims at the same time. Steps straight into m_vert_data, for sims
+	// that aren't run by physics_lib.
 	void simulate(real p_frametime);
 
+	// Physics thread side. Simulates p_timestep and, if that took a step, publishes the result as the
+	// newest state.
+	void tick(real p_timestep);
+
+	// Render side, main thread. Blends the last two published states by p_alpha into m_vert_data and
+	// hands that to simulate_post.
+	void interpolate(real p_alpha);
+
+	// Picked up by the next step
+	void add_force(Vector3 const& p_force);
+	void reset_force();
+	void move(Vector3 const& p_adjust);
+
+	void set_parallel(bool p_parallel) { m_particle_system.set_parallel(p_parallel); }
+	uint32 get_particle_count() const { return m_particle_system.get_particle_count(); }
+
+	// Simulated positions as of the last step
+	Vector3 const* get_positions() const { return m_vert_data; }
+
 protected:
 	particle_system m_particle_system;
 	constraint *m_constraints;
@@ -23,6 +47,21 @@ protected:
 	Vector3 *m_vert_data;
 
 	virtual void simulate_post() = 0;
+
+private:
+	Vector3 m_force;
+	Vector3 m_adjust;
+
+	// Three position buffers: the previous and the current published state, which the render side reads,
+	// and the one the physics thread steps into. Publishing rotates them under m_state_lock.
+	Vector3 *m_state_memory;
+	Vector3 *m_state_previous;
+	Vector3 *m_state_current;
+	Vector3 *m_state_next;
+	uint32 m_state_published;
+	SDL_mutex *m_state_lock;
+
+	void read_inputs(Vector3 *p_adjust);
 };
 
-#endif // __CLOTH_SIM_H_
+#endif // __CLOTH_SIM_H_
\ No newline at end of file
@@ -0,0 +1,366 @@
+#include "collision.h"
+
+#include "assert.h"
+#include "memory_lib.h"
+
+#include <math.h>
+#include <string.h>
+
+// Never fewer buckets than this, and at least two per entry otherwise
+#define COLLISION_GRID_BUCKETS_MIN (64)
+
+collision_primitive collision_primitive_sphere(Vector3 const& p_center, real p_radius)
+{
+	collision_primitive primitive;
+	primitive.m_shape = COLLISION_SHAPE_SPHERE;
+	primitive.m_position = p_center;
+	primitive.m_radius = p_radius;
+	return primitive;
+}
+
+collision_primitive collision_primitive_capsule(Vector3 const& p_start, Vector3 const& p_end, real p_radius)
+{
+	collision_primitive primitive;
+	primitive.m_shape = COLLISION_SHAPE_CAPSULE;
+	primitive.m_position = p_start;
+	primitive.m_end = p_end;
+	primitive.m_radius = p_radius;
+	return primitive;
+}
+
+collision_primitive collision_primitive_plane(Vector3 const& p_point, Vector3 const& p_normal)
+{
+	collision_primitive primitive;
+	primitive.m_shape = COLLISION_SHAPE_PLANE;
+	primitive.m_position = p_point;
+	primitive.m_normal = p_normal / p_normal.len();
+	primitive.m_radius = 0.0f;
+	return primitive;
+}
+
+collision_primitive collision_primitive_box(Vector3 const& p_center, Vector3 const p_axes[3], Vector3 const& p_half_extents)
+{
+	collision_primitive primitive;
+	primitive.m_shape = COLLISION_SHAPE_BOX;
+	primitive.m_position = p_center;
+	for (uint32 i = 0; i < 3; ++i) {
+		primitive.m_axes[i] = p_axes[i] / p_axes[i].len();
+	}
+	primitive.m_half_extents = p_half_extents;
+	primitive.m_radius = 0.0f;
+	return primitive;
+}
+
+bool collision_primitive_get_bounds(collision_primitive const* p_primitive, real p_margin, Vector3 *p_min, Vector3 *p_max)
+{
+	switch (p_primitive->m_shape) {
+		case COLLISION_SHAPE_SPHERE:
+		{
+			real radius = p_primitive->m_radius + p_margin;
+			Vector3 extent(radius, radius, radius);
+			*p_min = p_primitive->m_position - extent;
+			*p_max = p_primitive->m_position + extent;
+			return true;
+		}
+		case COLLISION_SHAPE_CAPSULE:
+		{
+			real radius = p_primitive->m_radius + p_margin;
+			Vector3 extent(radius, radius, radius);
+			*p_min = vmin(p_primitive->m_position, p_primitive->m_end) - extent;
+			*p_max = vmax(p_primitive->m_position, p_primitive->m_end) + extent;
+			return true;
+		}
+		case COLLISION_SHAPE_BOX:
+		{
+			// Each axis reaches as far as the sum of the absolute projections of the three half axes
+			Vector3 extent(p_margin, p_margin, p_margin);
+			for (uint32 i = 0; i < 3; ++i) {
+				for (uint32 j = 0; j < 3; ++j) {
+					extent.m_data[j] += fabsf(p_primitive->m_axes[i].m_data[j]) * p_primitive->m_half_extents.m_data[i];
+				}
+			}
+			*p_min = p_primitive->m_position - extent;
+			*p_max = p_primitive->m_position + extent;
+			return true;
+		}
+		default:
+			return false;
+	}
+}
+
+static bool push_out_of_sphere(Vector3 const& p_center, real p_radius, real *p_x, real *p_y, real *p_z)
+{
+	real delta_x = *p_x - p_center.m_data[0];
+	real delta_y = *p_y - p_center.m_data[1];
+	real delta_z = *p_z - p_center.m_data[2];
+	real len_sq = (delta_x * delta_x) + (delta_y * delta_y) + (delta_z * delta_z);
+
+	// Exactly on the center there's no way out to prefer, so leave it
+	if (len_sq >= p_radius * p_radius || len_sq == 0.0f) {
+		return false;
+	}
+
+	real scale = p_radius / sqrtf(len_sq);
+	*p_x = p_center.m_data[0] + (delta_x * scale);
+	*p_y = p_center.m_data[1] + (delta_y * scale);
+	*p_z = p_center.m_data[2] + (delta_z * scale);
+	return true;
+}
+
+bool collision_primitive_push_out(collision_primitive const* p_primitive, real p_margin, real *p_x, real *p_y, real *p_z)
+{
+	switch (p_primitive->m_shape) {
+		case COLLISION_SHAPE_SPHERE:
+			return push_out_of_sphere(p_primitive->m_position, p_primitive->m_radius + p_margin, p_x, p_y, p_z);
+
+		case COLLISION_SHAPE_CAPSULE:
+		{
+			// Out of the sphere around the closest point on the segment
+			Vector3 point(*p_x, *p_y, *p_z);
+			Vector3 axis = p_primitive->m_end - p_primitive->m_position;
+			real axis_len_sq = axis * axis;
+			real t = (axis_len_sq > 0.0f) ? ((point - p_primitive->m_position) * axis) / axis_len_sq : 0.0f;
+			t = (t < 0.0f) ? 0.0f : ((t > 1.0f) ? 1.0f : t);
+
+			return push_out_of_sphere(p_primitive->m_position + (axis * t), p_primitive->m_radius + p_margin, p_x, p_y, p_z);
+		}
+
+		case COLLISION_SHAPE_PLANE:
+		{
+			Vector3 point(*p_x, *p_y, *p_z);
+			real distance = ((point - p_primitive->m_position) * p_primitive->m_normal) - p_margin;
+			if (distance >= 0.0f) {
+				return false;
+			}
+
+			*p_x -= p_primitive->m_normal.m_data[0] * distance;
+			*p_y -= p_primitive->m_normal.m_data[1] * distance;
+			*p_z -= p_primitive->m_normal.m_data[2] * distance;
+			return true;
+		}
+
+		case COLLISION_SHAPE_BOX:
+		{
+			// Into box space, then out through whichever face is closest
+			Vector3 offset = Vector3(*p_x, *p_y, *p_z) - p_primitive->m_position;
+			real local[3];
+			uint32 exit_axis = 0;
+			real exit_depth = 0.0f;
+			for (uint32 i = 0; i < 3; ++i) {
+				local[i] = offset * p_primitive->m_axes[i];
+
+				real depth = p_primitive->m_half_extents.m_data[i] + p_margin - fabsf(local[i]);
+				if (depth <= 0.0f) {
+					return false;
+				}
+
+				if (i == 0 || depth < exit_depth) {
+					exit_axis = i;
+					exit_depth = depth;
+				}
+			}
+
+			real push = (local[exit_axis] < 0.0f) ? -exit_depth : exit_depth;
+			*p_x += p_primitive->m_axes[exit_axis].m_data[0] * push;
+			*p_y += p_primitive->m_axes[exit_axis].m_data[1] * push;
+			*p_z += p_primitive->m_axes[exit_axis].m_data[2] * push;
+			return true;
+		}
+
+		default:
+			return false;
+	}
+}
+
+collision_grid::collision_grid()
+{
+	m_cell_size = 1.0f;
+	m_inverse_cell_size = 1.0f;
+	m_bucket_mask = 0;
+	m_buckets_max = 0;
+	m_bucket_start = NULL;
+	m_entries = NULL;
+	m_entry_items = NULL;
+	m_entry_buckets = NULL;
+	m_entry_count = 0;
+	m_entries_max = 0;
+	m_unbinned = NULL;
+	m_unbinned_count = 0;
+	m_unbinned_max = 0;
+}
+
+collision_grid::~collision_grid()
+{
+	MEMORY_FREE(m_bucket_start);
+	MEMORY_FREE(m_entries);
+	MEMORY_FREE(m_entry_items);
+	MEMORY_FREE(m_entry_buckets);
+	MEMORY_FREE(m_unbinned);
+}
+
+void collision_grid::reset(uint32 p_entry_count, real p_cell_size)
+{
+	assert(p_cell_size > 0.0f);
+
+	m_cell_size = p_cell_size;
+	m_inverse_cell_size = 1.0f / p_cell_size;
+
+	uint32 bucket_count = COLLISION_GRID_BUCKETS_MIN;
+	while (bucket_count < p_entry_count * 2) {
+		bucket_count *= 2;
+	}
+
+	if (bucket_count > m_buckets_max) {
+		m_buckets_max = bucket_count;
+		m_bucket_start = (uint32 *)MEMORY_REALLOC(m_bucket_start, sizeof(uint32) * (m_buckets_max + 1), MEMORY_TAG_PHYSICS);
+		assert(m_bucket_start != NULL);
+	}
+	m_bucket_mask = bucket_count - 1;
+
+	if (p_entry_count > m_entries_max) {
+		m_entries_max = p_entry_count;
+		m_entries = (uint32 *)MEMORY_REALLOC(m_entries, sizeof(uint32) * m_entries_max, MEMORY_TAG_PHYSICS);
+		m_entry_items = (uint32 *)MEMORY_REALLOC(m_entry_items, sizeof(uint32) * m_entries_max, MEMORY_TAG_PHYSICS);
+		m_entry_buckets = (uint32 *)MEMORY_REALLOC(m_entry_buckets, sizeof(uint32) * m_entries_max, MEMORY_TAG_PHYSICS);
+		assert(m_entries != NULL && m_entry_items != NULL && m_entry_buckets != NULL);
+	}
+
+	m_entry_count = 0;
+	m_unbinned_count = 0;
+}
+
+void collision_grid::add(uint32 p_bucket, uint32 p_item)
+{
+	assert(m_entry_count < m_entries_max);
+
+	m_entry_items[m_entry_count] = p_item;
+	m_entry_buckets[m_entry_count] = p_bucket;
+	m_entry_count++;
+}
+
+// Count, prefix sum, scatter. Stable, so each bucket lists its entries in the order they were added.
+void collision_grid::sort()
+{
+	uint32 bucket_count = m_bucket_mask + 1;
+	memset(m_bucket_start, 0, sizeof(uint32) * (bucket_count + 1));
+
+	for (uint32 i = 0; i < m_entry_count; ++i) {
+		m_bucket_start[m_entry_buckets[i] + 1]++;
+	}
+
+	for (uint32 b = 0; b < bucket_count; ++b) {
+		m_bucket_start[b + 1] += m_bucket_start[b];
+	}
+
+	// The bucket starts double as write positions, which leaves each holding the next start until shifted back
+	for (uint32 i = 0; i < m_entry_count; ++i) {
+		m_entries[m_bucket_start[m_entry_buckets[i]]++] = m_entry_items[i];
+	}
+
+	for (uint32 b = bucket_count; b > 0; --b) {
+		m_bucket_start[b] = m_bucket_start[b - 1];
+	}
+	m_bucket_start[0] = 0;
+}
+
+int32 collision_grid::get_cell(real p_value) const
+{
+	return (int32)floorf(p_value * m_inverse_cell_size);
+}
+
+uint32 collision_grid::get_bucket(int32 p_cell_x, int32 p_cell_y, int32 p_cell_z) const
+{
+	return (((uint32)p_cell_x * 73856093) ^ ((uint32)p_cell_y * 19349663) ^ ((uint32)p_cell_z * 83492791)) & m_bucket_mask;
+}
+
+uint32 collision_grid::get_bucket(real p_x, real p_y, real p_z) const
+{
+	return get_bucket(get_cell(p_x), get_cell(p_y), get_cell(p_z));
+}
+
+void collision_grid::build_points(real const* p_x, real const* p_y, real const* p_z, uint32 p_count, real p_cell_size)
+{
+	reset(p_count, p_cell_size);
+
+	for (uint32 i = 0; i < p_count; ++i) {
+		add(get_bucket(p_x[i], p_y[i], p_z[i]), i);
+	}
+
+	sort();
+}
+
+void collision_grid::build_primitives(collision_primitive const* p_primitives, uint32 p_count, real p_margin, real p_cell_size)
+{
+	m_cell_size = p_cell_size;
+	m_inverse_cell_size = 1.0f / p_cell_size;
+
+	if (p_count > m_unbinned_max) {
+		m_unbinned_max = p_count;
+		m_unbinned = (uint32 *)MEMORY_REALLOC(m_unbinned, sizeof(uint32) * m_unbinned_max, MEMORY_TAG_PHYSICS);
+		assert(m_unbinned != NULL);
+	}
+
+	// Count first so the tables are sized once
+	uint32 entry_count = 0;
+	for (uint32 i = 0; i < p_count; ++i) {
+		Vector3 bounds_min;
+		Vector3 bounds_max;
+		if (collision_primitive_get_bounds(&p_primitives[i], p_margin, &bounds_min, &bounds_max)) {
+			real cells = 1.0f;
+			for (uint32 j = 0; j < 3; ++j) {
+				cells *= (real)(get_cell(bounds_max.m_data[j]) - get_cell(bounds_min.m_data[j]) + 1);
+			}
+
+			if (cells <= (real)COLLISION_GRID_PRIMITIVE_CELLS_MAX) {
+				entry_count += (uint32)cells;
+			}
+		}
+	}
+
+	reset(entry_count, p_cell_size);
+
+	for (uint32 i = 0; i < p_count; ++i) {
+		Vector3 bounds_min;
+		Vector3 bounds_max;
+		if (collision_primitive_get_bounds(&p_primitives[i], p_margin, &bounds_min, &bounds_max) == false) {
+			m_unbinned[m_unbinned_count++] = i;
+			continue;
+		}
+
+		int32 cell_min[3];
+		int32 cell_max[3];
+		real cells = 1.0f;
+		for (uint32 j = 0; j < 3; ++j) {
+			cell_min[j] = get_cell(bounds_min.m_data[j]);
+			cell_max[j] = get_cell(bounds_max.m_data[j]);
+			cells *= (real)(cell_max[j] - cell_min[j] + 1);
+		}
+
+		if (cells > (real)COLLISION_GRID_PRIMITIVE_CELLS_MAX) {
+			m_unbinned[m_unbinned_count++] = i;
+			continue;
+		}
+
+		for (int32 z = cell_min[2]; z <= cell_max[2]; ++z) {
+			for (int32 y = cell_min[1]; y <= cell_max[1]; ++y) {
+				for (int32 x = cell_min[0]; x <= cell_max[0]; ++x) {
+					add(get_bucket(x, y, z), i);
+				}
+			}
+		}
+	}
+
+	sort();
+}
+
+uint32 const* collision_grid::get_entries(uint32 p_bucket, uint32 *p_count) const
+{
+	*p_count = m_bucket_start[p_bucket + 1] - m_bucket_start[p_bucket];
+	return &m_entries[m_bucket_start[p_bucket]];
+}
+
+uint32 const* collision_grid::get_unbinned(uint32 *p_count) const
+{
+	*p_count = m_unbinned_count;
+	return m_unbinned;
+}
\ No newline at end of file
@@ -0,0 +1,99 @@
+#ifndef __COLLISION_H_
+#define __COLLISION_H_
+
+#include "vector3.h"
+
+#include "core_types.h"
+
+typedef uint32 collision_shape;
+const collision_shape COLLISION_SHAPE_SPHERE = 0;
+const collision_shape COLLISION_SHAPE_CAPSULE = 1;
+const collision_shape COLLISION_SHAPE_PLANE = 2;
+const collision_shape COLLISION_SHAPE_BOX = 3;
+
+// A primitive covering more cells than this isn't binned, every particle is tested against it instead
+#define COLLISION_GRID_PRIMITIVE_CELLS_MAX (4096)
+
+// World space, built with the collision_primitive_* functions below
+class collision_primitive
+{
+public:
+	collision_shape m_shape;
+
+	// Sphere and box center, capsule start, any point on the plane
+	Vector3 m_position;
+
+	// Capsule end
+	Vector3 m_end;
+
+	// Plane normal, unit length. Particles are kept on the side it points to.
+	Vector3 m_normal;
+
+	// Box axes, unit length and at right angles, and the half size along each
+	Vector3 m_axes[3];
+	Vector3 m_half_extents;
+
+	// Sphere and capsule
+	real m_radius;
+};
+
+collision_primitive collision_primitive_sphere(Vector3 const& p_center, real p_radius);
+collision_primitive collision_primitive_capsule(Vector3 const& p_start, Vector3 const& p_end, real p_radius);
+collision_primitive collision_primitive_plane(Vector3 const& p_point, Vector3 const& p_normal);
+collision_primitive collision_primitive_box(Vector3 const& p_center, Vector3 const p_axes[3], Vector3 const& p_half_extents);
+
+// World space bounds grown by p_margin, false for planes which have none
+bool collision_primitive_get_bounds(collision_primitive const* p_primitive, real p_margin, Vector3 *p_min, Vector3 *p_max);
+
+// Moves the point to the nearest spot at least p_margin outside the primitive, returns true if it moved
+bool collision_primitive_push_out(collision_primitive const* p_primitive, real p_margin, real *p_x, real *p_y, real *p_z);
+
+// Uniform grid hashed into a power of two table and stored as a counting sort, so building it and finding
+// everything near a point are both linear. Different cells can share a bucket, the exact tests sort that out.
+class collision_grid
+{
+public:
+	collision_grid();
+	~collision_grid();
+
+	// Bin particle i into the cell its position falls in
+	void build_points(real const* p_x, real const* p_y, real const* p_z, uint32 p_count, real p_cell_size);
+
+	// Bin each primitive into every cell its bounds, grown by p_margin, touch. Planes and primitives over
+	// COLLISION_GRID_PRIMITIVE_CELLS_MAX cells go in the unbinned list instead.
+	void build_primitives(collision_primitive const* p_primitives, uint32 p_count, real p_margin, real p_cell_size);
+
+	uint32 get_bucket(real p_x, real p_y, real p_z) const;
+	uint32 get_bucket(int32 p_cell_x, int32 p_cell_y, int32 p_cell_z) const;
+	int32 get_cell(real p_value) const;
+
+	// Everything binned into the bucket, in build order
+	uint32 const* get_entries(uint32 p_bucket, uint32 *p_count) const;
+	uint32 const* get_unbinned(uint32 *p_count) const;
+
+private:
+	real m_cell_size;
+	real m_inverse_cell_size;
+	uint32 m_bucket_mask;
+	uint32 m_buckets_max;
+
+	// Bucket b holds m_entries[m_bucket_start[b]] up to m_entries[m_bucket_start[b + 1]]
+	uint32 *m_bucket_start;
+	uint32 *m_entries;
+	uint32 m_entry_count;
+	uint32 m_entries_max;
+
+	// Entries in the order they were added, and the bucket of each, until sort() scatters them
+	uint32 *m_entry_items;
+	uint32 *m_entry_buckets;
+
+	uint32 *m_unbinned;
+	uint32 m_unbinned_count;
+	uint32 m_unbinned_max;
+
+	void reset(uint32 p_entry_count, real p_cell_size);
+	void add(uint32 p_bucket, uint32 p_item);
+	void sort();
+};
+
+#endif /* __COLLISION_H_ */
\ No newline at end of file
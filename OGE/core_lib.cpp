@@ -10,6 +10,11 @@
 #include "SDL.h"
 
 #include "core_lib.h"
+#include "job_system.h"
+#include "memory_lib.h"
+#include "asset_stream.h"
+#include "transform.h"
+#include "profiler.h"
 
 bool core_lib_init()
 {
@@ -20,6 +25,45 @@ bool core_lib_init()
 		SDL_Quit( );
 		return false;
 	}
+
+	if (memory_lib_init(MEMORY_FRAME_ARENA_SIZE_DEFAULT) == false) {
+		fprintf( stderr, "Memory initialization failed\n" );
+		return false;
+	}
+
+	// Before any threads start, so they can all record markers
+	if (profiler_init() == false) {
+		fprintf( stderr, "Profiler initialization failed\n" );
+		return false;
+	}
+
+	if (job_system_init(0) == false) {
+		fprintf( stderr, "Job system initialization failed: %s\n",
+					SDL_GetError( ) );
+		return false;
+	}
+
+	if (transform_system_init(TRANSFORM_CAPACITY_DEFAULT) == false) {
+		fprintf( stderr, "Transform system initialization failed\n" );
+		return false;
+	}
+
+	if (asset_stream_system_init(0) == false) {
+		fprintf( stderr, "Asset streaming initialization failed: %s\n",
+					SDL_GetError( ) );
+		return false;
+	}
 	
 	return true;
 }
+
+void core_lib_shutdown()
+{
+	asset_stream_system_shutdown();
+	transform_system_shutdown();
+	job_system_shutdown();
+	profiler_shutdown();
+
+	// Last so the leak report sees everything the other systems released
+	memory_lib_shutdown();
+}
\ No newline at end of file
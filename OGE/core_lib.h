@@ -2,6 +2,7 @@
 #define __CORE_LIB_H_
 
 bool core_lib_init();
+void core_lib_shutdown();
 
 #endif /* __CORE_LIB_H_ */
 
@@ -14,6 +14,21 @@ typedef signed char int8;
 // Do not assume that this is a 32 bit float, could be double
 typedef float real;
 
+// The math library's SSE2 kernels assume real is a 32 bit float. Define MATH_SCALAR for the plain
+// C++ versions, which is also required before switching real to double.
+#if !defined(MATH_SCALAR) && (defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__))
+#define MATH_SSE
+#endif
+
+// Widens the batch transforms to eight points at a time, only for compilers and targets with AVX
+//#define MATH_AVX
+
+#if defined(_MSC_VER)
+#define MATH_ALIGN(n) __declspec(align(n))
+#else
+#define MATH_ALIGN(n) __attribute__((aligned(n)))
+#endif
+
 // Use these when precision must be 32 or 64 bit
 typedef float real32;
 typedef double real64;
@@ -1,5 +1,6 @@
 #include "framebuffer_object.h"
 
+#include "render_stats.h"
 #include "glew/glew.h"
 
 // Assumes that GLuint is same size as uint32.. This may need to change
@@ -8,6 +9,8 @@ framebuffer_object::framebuffer_object()
 {
 	m_width = 0;
 	m_height = 0;
+	m_frame_buffer_index = 0;
+	m_depth_buffer_index = 0;
 }
 
 framebuffer_object::~framebuffer_object()
@@ -47,7 +50,14 @@ void framebuffer_object::init(uint32 p_width, uint32 p_height, framebuffer_forma
 		glFramebufferRenderbufferEXT(GL_FRAMEBUFFER_EXT, GL_DEPTH_ATTACHMENT_EXT, GL_RENDERBUFFER_EXT, m_depth_buffer_index);
 	}
 #else
-	if (depth) {
+	if (p_format & FRAMEBUFFER_FORMAT_DEPTH24_STENCIL8) {
+		glGenTextures(1, (GLuint *)&m_depth_buffer_index);
+		glBindTexture(GL_TEXTURE_2D, m_depth_buffer_index);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8_EXT, p_width, p_height, 0, GL_DEPTH_STENCIL_EXT, GL_UNSIGNED_INT_24_8_EXT, 0);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		set_depth_stencil_texture(m_depth_buffer_index);
+	} else if (depth) {
 		glGenTextures(1, (GLuint *)&m_depth_buffer_index);
 		glBindTexture(GL_TEXTURE_2D, m_depth_buffer_index);
 		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, p_width, p_height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_BYTE, 0);
@@ -77,10 +87,19 @@ void framebuffer_object::set_target_texture(uint32 p_texture_handle, uint8 p_col
 	}
 }
 
+void framebuffer_object::set_depth_stencil_texture(uint32 p_texture_handle)
+{
+	if (m_frame_buffer_index) {
+		glFramebufferTexture2DEXT(GL_FRAMEBUFFER_EXT, GL_DEPTH_ATTACHMENT_EXT, GL_TEXTURE_2D, p_texture_handle, 0);
+		glFramebufferTexture2DEXT(GL_FRAMEBUFFER_EXT, GL_STENCIL_ATTACHMENT_EXT, GL_TEXTURE_2D, p_texture_handle, 0);
+	}
+}
+
 void framebuffer_object::bind() const
 {
 	if (m_frame_buffer_index) {
 		glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, m_frame_buffer_index);
+		render_stats_count(RENDER_COUNTER_FRAMEBUFFER_BINDS, 1);
 	}
 }
 
@@ -88,6 +107,7 @@ void framebuffer_object::unbind() const
 {
 	if (m_frame_buffer_index) {
 		glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+		render_stats_count(RENDER_COUNTER_FRAMEBUFFER_BINDS, 1);
 	}
 }
 
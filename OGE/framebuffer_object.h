@@ -10,6 +10,7 @@ public:
 	static framebuffer_format const FRAMEBUFFER_FORMAT_DEPTH16 = 1;
 	static framebuffer_format const FRAMEBUFFER_FORMAT_DEPTH24 = 2;
 	static framebuffer_format const FRAMEBUFFER_FORMAT_DEPTH32 = 4;
+	static framebuffer_format const FRAMEBUFFER_FORMAT_DEPTH24_STENCIL8 = 8;
 
 	framebuffer_object();
 	~framebuffer_object();
@@ -17,6 +18,9 @@ public:
 	void init(uint32 p_width, uint32 p_height, framebuffer_format p_format);
 	bool is_status_ready() const;
 	void set_target_texture(uint32 p_texture_handle, uint8 p_color_buffer);
+
+	// Share another framebuffer's packed depth stencil texture, must be bound first
+	void set_depth_stencil_texture(uint32 p_texture_handle);
 	void bind() const;
 	void unbind() const;
 
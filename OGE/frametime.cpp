@@ -1,27 +1,94 @@
 #include "frametime.h"
 
-#include "SDL.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif
 
 #define START_FRAMETIME_MS (33)
 
-static uint32 g_frametime_last_ms;
 static uint32 g_frametime_ms;
+static real g_frametime_seconds;
+static double g_frametime_last;
 
 static uint32 g_framecount = 0;
 
+// Ring of the last FRAMETIME_STATS_FRAMES frame times in milliseconds
+static real g_frame_history[FRAMETIME_STATS_FRAMES];
+static uint32 g_frame_history_count = 0;
+static frametime_stats g_frametime_stats;
+
+#ifdef _WIN32
+static LARGE_INTEGER g_clock_start;
+static double g_clock_period;
+#else
+static struct timeval g_clock_start;
+#endif
+
+static void clock_init()
+{
+#ifdef _WIN32
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	g_clock_period = 1.0 / (double)frequency.QuadPart;
+	QueryPerformanceCounter(&g_clock_start);
+#else
+	gettimeofday(&g_clock_start, NULL);
+#endif
+}
+
+static void update_stats()
+{
+	uint32 count = (g_frame_history_count < FRAMETIME_STATS_FRAMES) ? g_frame_history_count : FRAMETIME_STATS_FRAMES;
+
+	real total = 0.0f;
+	real frame_min = g_frame_history[0];
+	real frame_max = g_frame_history[0];
+	for (uint32 i = 0; i < count; ++i) {
+		total += g_frame_history[i];
+		frame_min = (g_frame_history[i] < frame_min) ? g_frame_history[i] : frame_min;
+		frame_max = (g_frame_history[i] > frame_max) ? g_frame_history[i] : frame_max;
+	}
+
+	real average = total / count;
+	uint32 hitches = 0;
+	for (uint32 i = 0; i < count; ++i) {
+		if (g_frame_history[i] > average * 2.0f) {
+			hitches++;
+		}
+	}
+
+	g_frametime_stats.m_frame_ms_min = frame_min;
+	g_frametime_stats.m_frame_ms_avg = average;
+	g_frametime_stats.m_frame_ms_max = frame_max;
+	g_frametime_stats.m_hitches = hitches;
+}
 
 void frametime_init()
 {
+	clock_init();
+
 	g_frametime_ms = START_FRAMETIME_MS;
-	g_frametime_last_ms = SDL_GetTicks();
+	g_frametime_seconds = START_FRAMETIME_MS / 1000.0f;
+	g_frametime_last = frametime_get_clock();
 	g_framecount = 0;
+
+	g_frame_history[0] = (real)START_FRAMETIME_MS;
+	g_frame_history_count = 1;
+	update_stats();
 }
 
 void frametime_process()
 {
-	uint32 tmp_ticks = SDL_GetTicks();
-	g_frametime_ms = tmp_ticks - g_frametime_last_ms;
-	g_frametime_last_ms = tmp_ticks;
+	double now = frametime_get_clock();
+	g_frametime_seconds = (real)(now - g_frametime_last);
+	g_frametime_ms = (uint32)(g_frametime_seconds * 1000.0f + 0.5f);
+	g_frametime_last = now;
+
+	g_frame_history[g_frame_history_count % FRAMETIME_STATS_FRAMES] = g_frametime_seconds * 1000.0f;
+	g_frame_history_count++;
+	update_stats();
 
 	g_framecount++;
 }
@@ -31,7 +98,30 @@ unsigned long frametime_get()
 	return g_frametime_ms;
 }
 
+real frametime_get_seconds()
+{
+	return g_frametime_seconds;
+}
+
 uint32 frametime_get_count()
 {
 	return g_framecount;
+}
+
+double frametime_get_clock()
+{
+#ifdef _WIN32
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	return (double)(now.QuadPart - g_clock_start.QuadPart) * g_clock_period;
+#else
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	return (double)(now.tv_sec - g_clock_start.tv_sec) + (double)(now.tv_usec - g_clock_start.tv_usec) * 0.000001;
+#endif
+}
+
+frametime_stats const* frametime_get_stats()
+{
+	return &g_frametime_stats;
 }
\ No newline at end of file
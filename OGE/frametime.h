@@ -3,12 +3,34 @@
 
 #include "core_types.h"
 
+// Frames the pacing stats are taken over
+#define FRAMETIME_STATS_FRAMES (120)
+
+class frametime_stats
+{
+public:
+	real m_frame_ms_min;
+	real m_frame_ms_avg;
+	real m_frame_ms_max;
+	// Frames in the window that took more than twice the average
+	uint32 m_hitches;
+};
+
 void frametime_init();
 
 void frametime_process();
 
 uint32 frametime_get();
 
+// Last frame in seconds, to the resolution of frametime_get_clock
+real frametime_get_seconds();
+
 uint32 frametime_get_count();
 
+// Seconds since frametime_init from the best clock the platform has, safe from any thread
+double frametime_get_clock();
+
+// Over the last FRAMETIME_STATS_FRAMES frames
+frametime_stats const* frametime_get_stats();
+
 #endif // __FRAMETIME_H_
\ No newline at end of file
@@ -0,0 +1,90 @@
+#include "frustum.h"
+
+#include <math.h>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE__)
+#define FRUSTUM_SSE
+#include <xmmintrin.h>
+#endif
+
+void frustum::set_from_matrix(matrix44 const* p_view_proj)
+{
+	// Column major, so row i is every fourth element starting at i
+	real const* m = p_view_proj->m_data;
+
+	for (uint32 i = 0; i < 3; ++i) {
+		real *lower = m_planes[i * 2 + 0];
+		real *upper = m_planes[i * 2 + 1];
+
+		for (uint32 j = 0; j < 4; ++j) {
+			lower[j] = m[j * 4 + 3] + m[j * 4 + i];
+			upper[j] = m[j * 4 + 3] - m[j * 4 + i];
+		}
+	}
+
+	for (uint32 i = 0; i < FRUSTUM_PLANE_COUNT; ++i) {
+		real *plane = m_planes[i];
+		real len = sqrtf(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+		if (len > 0.0f) {
+			real inv_len = 1.0f / len;
+			plane[0] *= inv_len;
+			plane[1] *= inv_len;
+			plane[2] *= inv_len;
+			plane[3] *= inv_len;
+		}
+	}
+}
+
+bool frustum::test_sphere(Vector3 const& p_center, real p_radius) const
+{
+	for (uint32 i = 0; i < FRUSTUM_PLANE_COUNT; ++i) {
+		real const* plane = m_planes[i];
+		real dist = plane[0] * p_center.m_data[0] + plane[1] * p_center.m_data[1] + plane[2] * p_center.m_data[2] + plane[3];
+		if (dist < -p_radius) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void frustum_cull_spheres(frustum const* p_frustum, real const* p_x, real const* p_y, real const* p_z, real const* p_radius, uint32 p_count, uint8 *p_visible)
+{
+	uint32 i = 0;
+
+#if defined(FRUSTUM_SSE)
+	__m128 planes[FRUSTUM_PLANE_COUNT][4];
+	for (uint32 p = 0; p < FRUSTUM_PLANE_COUNT; ++p) {
+		for (uint32 j = 0; j < 4; ++j) {
+			planes[p][j] = _mm_set1_ps(p_frustum->m_planes[p][j]);
+		}
+	}
+
+	for (; i + 4 <= p_count; i += 4) {
+		__m128 x = _mm_loadu_ps(&p_x[i]);
+		__m128 y = _mm_loadu_ps(&p_y[i]);
+		__m128 z = _mm_loadu_ps(&p_z[i]);
+		__m128 neg_radius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&p_radius[i]));
+
+		// Lanes stay set while the sphere is in front of (or straddling) every plane
+		__m128 inside = _mm_cmpeq_ps(x, x);
+		for (uint32 p = 0; p < FRUSTUM_PLANE_COUNT; ++p) {
+			__m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, planes[p][0]), _mm_mul_ps(y, planes[p][1])),
+									_mm_add_ps(_mm_mul_ps(z, planes[p][2]), planes[p][3]));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(dist, neg_radius));
+		}
+
+		int mask = _mm_movemask_ps(inside);
+		p_visible[i + 0] = (uint8)((mask >> 0) & 1);
+		p_visible[i + 1] = (uint8)((mask >> 1) & 1);
+		p_visible[i + 2] = (uint8)((mask >> 2) & 1);
+		p_visible[i + 3] = (uint8)((mask >> 3) & 1);
+	}
+#endif
+
+	for (; i < p_count; ++i) {
+		Vector3 center;
+		center.set(p_x[i], p_y[i], p_z[i]);
+		p_visible[i] = p_frustum->test_sphere(center, p_radius[i]) ? 1 : 0;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,25 @@
+#ifndef __FRUSTUM_H_
+#define __FRUSTUM_H_
+
+#include "core_types.h"
+#include "matrix.h"
+
+#define FRUSTUM_PLANE_COUNT (6)
+
+// Six inward facing planes, stored as (a, b, c, d) with a unit normal
+class frustum
+{
+public:
+	// Pull the planes out of a combined projection * view matrix, culled objects are then in world space
+	void set_from_matrix(matrix44 const* p_view_proj);
+
+	bool test_sphere(Vector3 const& p_center, real p_radius) const;
+
+	real m_planes[FRUSTUM_PLANE_COUNT][4];
+};
+
+// Test p_count spheres laid out as separate x, y, z and radius arrays, p_visible gets 1 for every sphere touching the frustum.
+// Four spheres at a time where SSE is available.
+void frustum_cull_spheres(frustum const* p_frustum, real const* p_x, real const* p_y, real const* p_z, real const* p_radius, uint32 p_count, uint8 *p_visible);
+
+#endif /* __FRUSTUM_H_ */
\ No newline at end of file
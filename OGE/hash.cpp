@@ -0,0 +1,43 @@
+#include "hash.h"
+
+static uint32 g_crc_table[256];
+
+// Filled in before main so worker threads never race on it
+class crc_table_builder
+{
+public:
+	crc_table_builder()
+	{
+		for (uint32 i = 0; i < 256; ++i) {
+			uint32 c = i;
+			for (uint32 j = 0; j < 8; ++j) {
+				c = (c & 1) ? (0xedb88320 ^ (c >> 1)) : (c >> 1);
+			}
+			g_crc_table[i] = c;
+		}
+	}
+};
+
+static crc_table_builder g_crc_table_builder;
+
+uint32 hash_crc32(uint32 p_crc, void const* p_data, uint32 p_size)
+{
+	uint8 const* data = (uint8 const*)p_data;
+
+	p_crc = ~p_crc & 0xffffffff;
+	for (uint32 i = 0; i < p_size; ++i) {
+		p_crc = g_crc_table[(p_crc ^ data[i]) & 0xff] ^ (p_crc >> 8);
+	}
+
+	return ~p_crc & 0xffffffff;
+}
+
+uint32 hash_string(char const* p_string, uint32 p_max_length)
+{
+	uint32 crc = 0xffffffff;
+	for (uint32 i = 0; i < p_max_length && p_string[i] != '\0'; ++i) {
+		crc = g_crc_table[(crc ^ (uint8)p_string[i]) & 0xff] ^ (crc >> 8);
+	}
+
+	return ~crc & 0xffffffff;
+}
\ No newline at end of file
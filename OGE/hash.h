@@ -0,0 +1,12 @@
+#ifndef __HASH_H_
+#define __HASH_H_
+
+#include "core_types.h"
+
+// Standard CRC-32, feed the previous result back in to continue a running CRC (start with 0)
+uint32 hash_crc32(uint32 p_crc, void const* p_data, uint32 p_size);
+
+// CRC-32 of a name, stops at the terminator or p_max_length characters
+uint32 hash_string(char const* p_string, uint32 p_max_length);
+
+#endif /* __HASH_H_ */
\ No newline at end of file
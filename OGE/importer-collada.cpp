@@ -7,6 +7,8 @@
 #include "material.h"
 #include "mesh_meta_data.h"
 #include "render_lib.h"
+#include "memory_lib.h"
+#include "profiler.h"
 
 // FCollada
 #include "FCollada.h"
@@ -311,12 +313,13 @@ void load_mesh(mesh *p_mesh_ptr, unsigned long &p_render_block_index, FCDGeometr
 			render_block &render_block_ptr = p_mesh_ptr->m_render_blocks[p_render_block_index];
 
 			render_block_ptr.m_prepared = false;
+			render_block_ptr.m_cpu_data_mapped = false;
 			render_block_ptr.m_format = RENDER_LIB_MESH_FORMAT_VA_TRIANGLES;
 			render_block_ptr.m_vertex_count = 0;
 			render_block_ptr.m_index_count = 0;
 
 			render_block_ptr.m_index_count = (unsigned long)position_index_count;
-			render_block_ptr.m_index_buffer = (unsigned long *)malloc(sizeof(unsigned long) * render_block_ptr.m_index_count);
+			render_block_ptr.m_index_buffer = (unsigned long *)MEMORY_ALLOC(sizeof(unsigned long) * render_block_ptr.m_index_count, MEMORY_TAG_FCOLLADA);
 			memcpy(render_block_ptr.m_index_buffer, positionIndices, position_index_count * sizeof(unsigned long));
 
 			float *data = positionSource->GetData();
@@ -324,23 +327,19 @@ void load_mesh(mesh *p_mesh_ptr, unsigned long &p_render_block_index, FCDGeometr
 
 			render_block_ptr.m_vertex_count = (unsigned long)len2 / 3;
 
-			render_block_ptr.m_pos = (Vector3 *)malloc(sizeof(Vector3) * render_block_ptr.m_vertex_count);
+			render_block_ptr.m_pos = (Vector3 *)MEMORY_ALLOC(sizeof(Vector3) * render_block_ptr.m_vertex_count, MEMORY_TAG_FCOLLADA);
 			memcpy(render_block_ptr.m_pos, data, sizeof(Vector3) * render_block_ptr.m_vertex_count);
 
 			// Transform all read in verts
 			matrix44 transform_matrix;
 			memcpy(transform_matrix.m_data, p_matrix->m, sizeof(p_matrix->m));
+			matrix44_transform_points(&transform_matrix, render_block_ptr.m_pos, render_block_ptr.m_pos, render_block_ptr.m_vertex_count);
 
-
-			
-			for (unsigned long i = 0; i < render_block_ptr.m_vertex_count; i++) {
-				Vector3 out = transform_matrix * render_block_ptr.m_pos[i];
-				render_block_ptr.m_pos[i].set(out.m_data[0], out.m_data[1], out.m_data[2]);
-			}
+			render_block_ptr.compute_bounds();
 				
 			data = texcoordSource->GetData();
 			len2 = texcoordSource->GetDataCount();
-			render_block_ptr.m_uv = (uv_coord *)malloc(sizeof(uv_coord) * render_block_ptr.m_vertex_count);
+			render_block_ptr.m_uv = (uv_coord *)MEMORY_ALLOC(sizeof(uv_coord) * render_block_ptr.m_vertex_count, MEMORY_TAG_FCOLLADA);
 			
 			// Test for whether this is a two or three coordinate texture
 			if (texcoordSource->GetStride() == 3) {
@@ -354,7 +353,7 @@ void load_mesh(mesh *p_mesh_ptr, unsigned long &p_render_block_index, FCDGeometr
 
 			data = normalSource->GetData();
 			len2 = normalSource->GetDataCount();
-			render_block_ptr.m_normal = (Vector3 *)malloc(sizeof(Vector3) * render_block_ptr.m_vertex_count);
+			render_block_ptr.m_normal = (Vector3 *)MEMORY_ALLOC(sizeof(Vector3) * render_block_ptr.m_vertex_count, MEMORY_TAG_FCOLLADA);
 			memcpy(render_block_ptr.m_normal, data, sizeof(Vector3) * render_block_ptr.m_vertex_count);
 
 			// Find material for this polygon
@@ -428,6 +427,8 @@ void load_geometries(mesh *p_mesh_ptr, FCDocument *p_document)
 
 mesh *importer_collada_load(char const* p_mesh_name)
 {	
+	PROFILE_SCOPE("importer_collada_load");
+
 // open dae file
 	FCDocument *document = FCollada::NewTopDocument();
 	bool z_is_up = true;
@@ -447,9 +448,9 @@ mesh *importer_collada_load(char const* p_mesh_name)
 
 	unsigned long num_geometries = count_geometries(document);
 
-	mesh *mesh_ptr = new mesh;
+	mesh *mesh_ptr = MEMORY_NEW(mesh, MEMORY_TAG_FCOLLADA);
 	mesh_ptr->m_render_block_count = num_geometries;
-	mesh_ptr->m_render_blocks = (render_block *)malloc(sizeof(render_block) * num_geometries);
+	mesh_ptr->m_render_blocks = (render_block *)MEMORY_ALLOC(sizeof(render_block) * num_geometries, MEMORY_TAG_FCOLLADA);
 
 
 	// Traverse visual scene and load data
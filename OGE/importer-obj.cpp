@@ -0,0 +1,628 @@
+#include "importer-obj.h"
+
+#include "mesh.h"
+#include "material.h"
+#include "render_lib.h"
+#include "assert.h"
+#include "mapped_file.h"
+#include "job_system.h"
+#include "memory_lib.h"
+#include "profiler.h"
+
+#include "SDL.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+// Files smaller than this per thread are parsed in one go
+#define IMPORTER_OBJ_CHUNK_SIZE_MIN (256 * 1024)
+#define IMPORTER_OBJ_CHUNKS_MAX (JOB_THREADS_MAX + 1)
+
+// Face corners store their v/vt/vn indices as:
+// >= 0 absolute, 0 based
+// < 0 negative file indices, the chunk local index minus OBJ_INDEX_RELATIVE, rebased once every chunk's counts are known
+#define OBJ_INDEX_NONE ((int32)0x7fffffff)
+#define OBJ_INDEX_RELATIVE ((int32)0x40000000)
+
+// Everything one chunk of lines produced, in file order
+class obj_chunk
+{
+public:
+	char const* m_begin;
+	char const* m_end;
+
+	real *m_positions;
+	uint32 m_position_count;
+	uint32 m_positions_max;
+
+	real *m_uvs;
+	uint32 m_uv_count;
+	uint32 m_uvs_max;
+
+	real *m_normals;
+	uint32 m_normal_count;
+	uint32 m_normals_max;
+
+	// Three indices per corner
+	int32 *m_corners;
+	uint32 m_corner_count;
+	uint32 m_corners_max;
+
+	uint32 *m_face_sizes;
+	uint32 m_face_count;
+	uint32 m_faces_max;
+};
+
+// Deduplicated, triangulated output ready to go into a render block
+class obj_geometry
+{
+public:
+	Vector3 *m_pos;
+	Vector3 *m_normal;
+	uv_coord *m_uv;
+	uint32 m_vertex_count;
+
+	unsigned long *m_indices;
+	uint32 m_index_count;
+};
+
+static void *grow_array(void *p_array, uint32 *p_max, uint32 p_needed, uint32 p_element_size)
+{
+	if (p_needed <= *p_max) {
+		return p_array;
+	}
+
+	uint32 new_max = (*p_max == 0) ? 1024 : *p_max * 2;
+	while (new_max < p_needed) {
+		new_max *= 2;
+	}
+
+	p_array = MEMORY_REALLOC(p_array, new_max * p_element_size, MEMORY_TAG_GEOMETRY);
+	assert(p_array != NULL);
+	*p_max = new_max;
+
+	return p_array;
+}
+
+static bool is_space(char p_c)
+{
+	return p_c == ' ' || p_c == '\t' || p_c == '\r';
+}
+
+static char const* skip_space(char const* p, char const* p_end)
+{
+	while (p < p_end && is_space(*p)) {
+		++p;
+	}
+
+	return p;
+}
+
+static char const* skip_line(char const* p, char const* p_end)
+{
+	while (p < p_end && *p != '\n') {
+		++p;
+	}
+
+	return (p < p_end) ? p + 1 : p_end;
+}
+
+static char const* scan_real(char const* p, char const* p_end, real *p_value)
+{
+	static real const powers[] = { 1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f };
+
+	p = skip_space(p, p_end);
+
+	bool negative = false;
+	if (p < p_end && (*p == '-' || *p == '+')) {
+		negative = (*p == '-');
+		++p;
+	}
+
+	// Accumulate in a double, the digit count of real world files stays well inside its precision
+	double value = 0.0;
+	while (p < p_end && *p >= '0' && *p <= '9') {
+		value = value * 10.0 + (*p - '0');
+		++p;
+	}
+
+	if (p < p_end && *p == '.') {
+		++p;
+
+		double scale = 1.0;
+		while (p < p_end && *p >= '0' && *p <= '9') {
+			value = value * 10.0 + (*p - '0');
+			scale *= 10.0;
+			++p;
+		}
+		value /= scale;
+	}
+
+	if (p < p_end && (*p == 'e' || *p == 'E')) {
+		++p;
+
+		bool exp_negative = false;
+		if (p < p_end && (*p == '-' || *p == '+')) {
+			exp_negative = (*p == '-');
+			++p;
+		}
+
+		int exponent = 0;
+		while (p < p_end && *p >= '0' && *p <= '9') {
+			exponent = exponent * 10 + (*p - '0');
+			++p;
+		}
+
+		while (exponent > 0) {
+			int step = (exponent > 10) ? 10 : exponent;
+			value = exp_negative ? value / powers[step] : value * powers[step];
+			exponent -= step;
+		}
+	}
+
+	// MSVC writes nan and inf as 1.#QNAN0, 1.#INF00, take them as zero so the bounds stay finite
+	if (p < p_end && *p == '#') {
+		value = 0.0;
+		while (p < p_end && is_space(*p) == false && *p != '\n') {
+			++p;
+		}
+	}
+
+	*p_value = (real)(negative ? -value : value);
+	return p;
+}
+
+static char const* scan_int(char const* p, char const* p_end, int32 *p_value, bool *p_found)
+{
+	bool negative = false;
+	if (p < p_end && (*p == '-' || *p == '+')) {
+		negative = (*p == '-');
+		++p;
+	}
+
+	int32 value = 0;
+	*p_found = false;
+	while (p < p_end && *p >= '0' && *p <= '9') {
+		value = value * 10 + (*p - '0');
+		*p_found = true;
+		++p;
+	}
+
+	*p_value = negative ? -value : value;
+	return p;
+}
+
+static int32 encode_index(int32 p_index, uint32 p_local_count)
+{
+	if (p_index > 0) {
+		return p_index - 1;
+	}
+
+	// Negative indices count back from the last element seen so far, which may be in an earlier chunk
+	if (p_index < 0) {
+		return (int32)p_local_count + p_index - OBJ_INDEX_RELATIVE;
+	}
+
+	return OBJ_INDEX_NONE;
+}
+
+static void parse_face(obj_chunk *p_chunk, char const* p, char const* p_end)
+{
+	uint32 size = 0;
+
+	for (;;) {
+		p = skip_space(p, p_end);
+		if (p >= p_end || *p == '\n' || *p == '#') {
+			break;
+		}
+
+		// v, v/vt, v//vn or v/vt/vn
+		int32 value[3] = { 0, 0, 0 };
+		bool found = false;
+		p = scan_int(p, p_end, &value[0], &found);
+		if (found == false) {
+			break;
+		}
+
+		for (uint32 i = 1; i < 3 && p < p_end && *p == '/'; ++i) {
+			p = scan_int(p + 1, p_end, &value[i], &found);
+		}
+
+		p_chunk->m_corners = (int32 *)grow_array(p_chunk->m_corners, &p_chunk->m_corners_max, (p_chunk->m_corner_count + 1) * 3, sizeof(int32));
+		int32 *corner = &p_chunk->m_corners[p_chunk->m_corner_count * 3];
+		corner[0] = encode_index(value[0], p_chunk->m_position_count);
+		corner[1] = encode_index(value[1], p_chunk->m_uv_count);
+		corner[2] = encode_index(value[2], p_chunk->m_normal_count);
+		p_chunk->m_corner_count++;
+		size++;
+	}
+
+	p_chunk->m_face_sizes = (uint32 *)grow_array(p_chunk->m_face_sizes, &p_chunk->m_faces_max, p_chunk->m_face_count + 1, sizeof(uint32));
+	p_chunk->m_face_sizes[p_chunk->m_face_count++] = size;
+}
+
+static void parse_chunk(obj_chunk *p_chunk)
+{
+	char const* p = p_chunk->m_begin;
+	char const* end = p_chunk->m_end;
+
+	while (p < end) {
+		p = skip_space(p, end);
+		if (p + 1 >= end) {
+			break;
+		}
+
+		if (p[0] == 'v' && is_space(p[1])) {
+			p_chunk->m_positions = (real *)grow_array(p_chunk->m_positions, &p_chunk->m_positions_max, (p_chunk->m_position_count + 1) * 3, sizeof(real));
+			real *v = &p_chunk->m_positions[p_chunk->m_position_count++ * 3];
+			p = scan_real(p + 2, end, &v[0]);
+			p = scan_real(p, end, &v[1]);
+			p = scan_real(p, end, &v[2]);
+		} else if (p[0] == 'v' && p[1] == 't') {
+			p_chunk->m_uvs = (real *)grow_array(p_chunk->m_uvs, &p_chunk->m_uvs_max, (p_chunk->m_uv_count + 1) * 2, sizeof(real));
+			real *vt = &p_chunk->m_uvs[p_chunk->m_uv_count++ * 2];
+			p = scan_real(p + 2, end, &vt[0]);
+			p = scan_real(p, end, &vt[1]);
+		} else if (p[0] == 'v' && p[1] == 'n') {
+			p_chunk->m_normals = (real *)grow_array(p_chunk->m_normals, &p_chunk->m_normals_max, (p_chunk->m_normal_count + 1) * 3, sizeof(real));
+			real *vn = &p_chunk->m_normals[p_chunk->m_normal_count++ * 3];
+			p = scan_real(p + 2, end, &vn[0]);
+			p = scan_real(p, end, &vn[1]);
+			p = scan_real(p, end, &vn[2]);
+		} else if (p[0] == 'f' && is_space(p[1])) {
+			parse_face(p_chunk, p + 2, end);
+		}
+
+		// Comments, groups, materials and anything left over on the line
+		p = skip_line(p, end);
+	}
+}
+
+static void parse_chunk_job(void *p_data, uint32 p_begin, uint32 p_end)
+{
+	obj_chunk *chunks = (obj_chunk *)p_data;
+	for (uint32 i = p_begin; i < p_end; ++i) {
+		parse_chunk(&chunks[i]);
+	}
+}
+
+static void free_chunk(obj_chunk *p_chunk)
+{
+	MEMORY_FREE(p_chunk->m_positions);
+	MEMORY_FREE(p_chunk->m_uvs);
+	MEMORY_FREE(p_chunk->m_normals);
+	MEMORY_FREE(p_chunk->m_corners);
+	MEMORY_FREE(p_chunk->m_face_sizes);
+}
+
+static int32 resolve_index(int32 p_index, uint32 p_base, uint32 p_count)
+{
+	if (p_index == OBJ_INDEX_NONE) {
+		return -1;
+	}
+
+	int32 index = (p_index >= 0) ? p_index : (int32)p_base + p_index + OBJ_INDEX_RELATIVE;
+	return (index >= 0 && (uint32)index < p_count) ? index : -2;
+}
+
+static uint32 hash_corner(int32 const* p_corner)
+{
+	uint32 h = (uint32)p_corner[0] * 73856093;
+	h ^= (uint32)p_corner[1] * 19349663;
+	h ^= (uint32)p_corner[2] * 83492791;
+	return h & 0xffffffff;
+}
+
+// Rebase every chunk's corners, share identical v/vt/vn triples and fan triangulate the faces
+static void merge_chunks(obj_chunk *p_chunks, uint32 p_chunk_count, obj_geometry *p_geometry)
+{
+	uint32 position_count = 0;
+	uint32 uv_count = 0;
+	uint32 normal_count = 0;
+	uint32 corner_count = 0;
+	uint32 triangle_count = 0;
+	for (uint32 c = 0; c < p_chunk_count; ++c) {
+		obj_chunk const& chunk = p_chunks[c];
+		position_count += chunk.m_position_count;
+		uv_count += chunk.m_uv_count;
+		normal_count += chunk.m_normal_count;
+		corner_count += chunk.m_corner_count;
+		for (uint32 f = 0; f < chunk.m_face_count; ++f) {
+			if (chunk.m_face_sizes[f] >= 3) {
+				triangle_count += chunk.m_face_sizes[f] - 2;
+			}
+		}
+	}
+
+	real *positions = (real *)MEMORY_ALLOC(sizeof(real) * 3 * (position_count + 1), MEMORY_TAG_GEOMETRY);
+	real *uvs = (real *)MEMORY_ALLOC(sizeof(real) * 2 * (uv_count + 1), MEMORY_TAG_GEOMETRY);
+	real *normals = (real *)MEMORY_ALLOC(sizeof(real) * 3 * (normal_count + 1), MEMORY_TAG_GEOMETRY);
+
+	uint32 hash_size = 1024;
+	while (hash_size < corner_count * 2) {
+		hash_size *= 2;
+	}
+	uint32 *hash_table = (uint32 *)MEMORY_CALLOC(sizeof(uint32) * hash_size, MEMORY_TAG_GEOMETRY);
+
+	// Resolved v/vt/vn per output vertex, -1 where the corner had none
+	int32 *vertex_keys = (int32 *)MEMORY_ALLOC(sizeof(int32) * 3 * (corner_count + 1), MEMORY_TAG_GEOMETRY);
+	unsigned long *indices = (unsigned long *)MEMORY_ALLOC(sizeof(unsigned long) * 3 * (triangle_count + 1), MEMORY_TAG_GEOMETRY);
+	uint32 *face_vertices = NULL;
+	uint32 face_vertices_max = 0;
+	assert(positions != NULL && uvs != NULL && normals != NULL && hash_table != NULL && vertex_keys != NULL && indices != NULL);
+
+	uint32 vertex_count = 0;
+	uint32 index_count = 0;
+	uint32 position_base = 0;
+	uint32 uv_base = 0;
+	uint32 normal_base = 0;
+
+	for (uint32 c = 0; c < p_chunk_count; ++c) {
+		obj_chunk const& chunk = p_chunks[c];
+		memcpy(&positions[position_base * 3], chunk.m_positions, sizeof(real) * 3 * chunk.m_position_count);
+		memcpy(&uvs[uv_base * 2], chunk.m_uvs, sizeof(real) * 2 * chunk.m_uv_count);
+		memcpy(&normals[normal_base * 3], chunk.m_normals, sizeof(real) * 3 * chunk.m_normal_count);
+
+		int32 const* corners = chunk.m_corners;
+		for (uint32 f = 0; f < chunk.m_face_count; ++f) {
+			uint32 size = chunk.m_face_sizes[f];
+			int32 const* face = corners;
+			corners += size * 3;
+
+			if (size < 3) {
+				continue;
+			}
+
+			face_vertices = (uint32 *)grow_array(face_vertices, &face_vertices_max, size, sizeof(uint32));
+
+			bool valid = true;
+			for (uint32 i = 0; i < size && valid; ++i) {
+				int32 key[3];
+				key[0] = resolve_index(face[i * 3 + 0], position_base, position_count);
+				key[1] = resolve_index(face[i * 3 + 1], uv_base, uv_count);
+				key[2] = resolve_index(face[i * 3 + 2], normal_base, normal_count);
+				if (key[0] < 0 || key[1] == -2 || key[2] == -2) {
+					valid = false;
+					break;
+				}
+
+				uint32 slot = hash_corner(key) & (hash_size - 1);
+				for (;;) {
+					uint32 entry = hash_table[slot];
+					if (entry == 0) {
+						memcpy(&vertex_keys[vertex_count * 3], key, sizeof(key));
+						hash_table[slot] = ++vertex_count;
+						face_vertices[i] = vertex_count - 1;
+						break;
+					}
+
+					if (memcmp(&vertex_keys[(entry - 1) * 3], key, sizeof(key)) == 0) {
+						face_vertices[i] = entry - 1;
+						break;
+					}
+
+					slot = (slot + 1) & (hash_size - 1);
+				}
+			}
+
+			if (valid == false) {
+				continue;
+			}
+
+			for (uint32 i = 1; i + 1 < size; ++i) {
+				indices[index_count++] = face_vertices[0];
+				indices[index_count++] = face_vertices[i];
+				indices[index_count++] = face_vertices[i + 1];
+			}
+		}
+
+		position_base += chunk.m_position_count;
+		uv_base += chunk.m_uv_count;
+		normal_base += chunk.m_normal_count;
+	}
+
+	// Area weighted normals per position, so vertices split by a uv seam still smooth across it
+	Vector3 *smooth = (Vector3 *)MEMORY_CALLOC(sizeof(Vector3) * (position_count + 1), MEMORY_TAG_GEOMETRY);
+	assert(smooth != NULL);
+	for (uint32 i = 0; i < index_count; i += 3) {
+		int32 a = vertex_keys[indices[i + 0] * 3];
+		int32 b = vertex_keys[indices[i + 1] * 3];
+		int32 c = vertex_keys[indices[i + 2] * 3];
+
+		Vector3 x(positions[b * 3 + 0] - positions[a * 3 + 0], positions[b * 3 + 1] - positions[a * 3 + 1], positions[b * 3 + 2] - positions[a * 3 + 2]);
+		Vector3 y(positions[c * 3 + 0] - positions[a * 3 + 0], positions[c * 3 + 1] - positions[a * 3 + 1], positions[c * 3 + 2] - positions[a * 3 + 2]);
+
+		// Unnormalised cross product is twice the triangle's area
+		Vector3 n = x.cross(y);
+		smooth[a] += n;
+		smooth[b] += n;
+		smooth[c] += n;
+	}
+
+	p_geometry->m_vertex_count = vertex_count;
+	p_geometry->m_index_count = index_count;
+	p_geometry->m_indices = indices;
+	p_geometry->m_pos = (Vector3 *)MEMORY_ALLOC(sizeof(Vector3) * (vertex_count + 1), MEMORY_TAG_GEOMETRY);
+	p_geometry->m_normal = (Vector3 *)MEMORY_ALLOC(sizeof(Vector3) * (vertex_count + 1), MEMORY_TAG_GEOMETRY);
+	p_geometry->m_uv = (uv_coord *)MEMORY_ALLOC(sizeof(uv_coord) * (vertex_count + 1), MEMORY_TAG_GEOMETRY);
+	assert(p_geometry->m_pos != NULL && p_geometry->m_normal != NULL && p_geometry->m_uv != NULL);
+
+	for (uint32 i = 0; i < vertex_count; ++i) {
+		int32 const* key = &vertex_keys[i * 3];
+		p_geometry->m_pos[i].set(positions[key[0] * 3 + 0], positions[key[0] * 3 + 1], positions[key[0] * 3 + 2]);
+
+		if (key[1] >= 0) {
+			p_geometry->m_uv[i].m_data[0] = uvs[key[1] * 2 + 0];
+			p_geometry->m_uv[i].m_data[1] = uvs[key[1] * 2 + 1];
+		} else {
+			p_geometry->m_uv[i].m_data[0] = 0.0f;
+			p_geometry->m_uv[i].m_data[1] = 0.0f;
+		}
+
+		Vector3 n;
+		if (key[2] >= 0) {
+			n.set(normals[key[2] * 3 + 0], normals[key[2] * 3 + 1], normals[key[2] * 3 + 2]);
+		} else {
+			n = smooth[key[0]];
+		}
+
+		real len = n.len();
+		if (len > 0.0f) {
+			n *= 1.0f / len;
+		}
+		p_geometry->m_normal[i] = n;
+	}
+
+	MEMORY_FREE(smooth);
+	MEMORY_FREE(face_vertices);
+	MEMORY_FREE(vertex_keys);
+	MEMORY_FREE(hash_table);
+	MEMORY_FREE(normals);
+	MEMORY_FREE(uvs);
+	MEMORY_FREE(positions);
+}
+
+static void parse(char const* p_data, uint32 p_size, obj_geometry *p_geometry)
+{
+	uint32 chunk_count = p_size / IMPORTER_OBJ_CHUNK_SIZE_MIN;
+	uint32 threads = job_system_get_thread_count() + 1;
+	if (chunk_count > threads) {
+		chunk_count = threads;
+	}
+	if (chunk_count > IMPORTER_OBJ_CHUNKS_MAX) {
+		chunk_count = IMPORTER_OBJ_CHUNKS_MAX;
+	}
+	if (chunk_count == 0) {
+		chunk_count = 1;
+	}
+
+	obj_chunk chunks[IMPORTER_OBJ_CHUNKS_MAX];
+	memset(chunks, 0, sizeof(chunks));
+
+	// Even splits pushed forward to the next line start
+	char const* end = p_data + p_size;
+	char const* begin = p_data;
+	for (uint32 i = 0; i < chunk_count; ++i) {
+		char const* split = (i + 1 == chunk_count) ? end : p_data + (uint32)(((uint64)p_size * (i + 1)) / chunk_count);
+		if (split < begin) {
+			split = begin;
+		}
+		split = (split < end) ? skip_line(split, end) : end;
+
+		chunks[i].m_begin = begin;
+		chunks[i].m_end = split;
+		begin = split;
+	}
+
+	job_parallel_for(chunk_count, 1, parse_chunk_job, chunks);
+
+	merge_chunks(chunks, chunk_count, p_geometry);
+
+	for (uint32 i = 0; i < chunk_count; ++i) {
+		free_chunk(&chunks[i]);
+	}
+}
+
+mesh *importer_obj_load(char const* p_mesh_name)
+{
+	PROFILE_SCOPE("importer_obj_load");
+
+	uint32 size = 0;
+	uint8 *data = mapped_file_open(p_mesh_name, false, &size);
+	if (data == NULL) {
+		return NULL;
+	}
+
+	obj_geometry geometry;
+	parse((char const*)data, size, &geometry);
+
+	mapped_file_close(data, size);
+
+	mesh *mesh_ptr = MEMORY_NEW(mesh, MEMORY_TAG_GEOMETRY);
+	mesh_ptr->m_render_block_count = 1;
+	mesh_ptr->m_render_blocks = (render_block *)MEMORY_ALLOC(sizeof(render_block), MEMORY_TAG_GEOMETRY);
+	render_block *render_block_ptr = &mesh_ptr->m_render_blocks[0];
+
+	render_block_ptr->m_format = RENDER_LIB_MESH_FORMAT_VA_TRIANGLES;
+	render_block_ptr->m_prepared = false;
+	render_block_ptr->m_cpu_data_mapped = false;
+	render_block_ptr->m_transform.set_identity();
+
+	render_block_ptr->m_vertex_count = geometry.m_vertex_count;
+	render_block_ptr->m_pos = geometry.m_pos;
+	render_block_ptr->m_normal = geometry.m_normal;
+	render_block_ptr->m_uv = geometry.m_uv;
+	render_block_ptr->m_index_count = geometry.m_index_count;
+	render_block_ptr->m_index_buffer = geometry.m_indices;
+
+	material *render_mat = material_create("fake_material");
+	render_block_ptr->m_material = render_mat;
+
+	if (render_block_ptr->m_material->m_texture == NULL) {
+		render_mat->m_color_ambient[0] = 0.5f;
+		render_mat->m_color_ambient[1] = 0.5f;
+		render_mat->m_color_ambient[2] = 0.5f;
+		render_mat->m_color_ambient[3] = 0.5f;
+		
+		render_mat->m_color_diffuse[0] = 0.5f;
+		render_mat->m_color_diffuse[1] = 0.5f;
+		render_mat->m_color_diffuse[2] = 0.5f;
+		render_mat->m_color_diffuse[3] = 0.5f;
+
+		render_mat->m_color_spec[0] = 0.5f;
+		render_mat->m_color_spec[1] = 0.5f;
+		render_mat->m_color_spec[2] = 0.5f;
+		render_mat->m_color_spec[3] = 0.5f;
+
+		material_load(render_mat, "invalid.png");
+		render_mat->m_shader = render_lib_get_default_shader();
+	}
+
+	render_block_ptr->compute_bounds();
+
+	return mesh_ptr;
+}
+
+void importer_obj_benchmark(char const* p_mesh_name, uint32 p_iterations)
+{
+	uint32 size = 0;
+	uint8 *data = mapped_file_open(p_mesh_name, false, &size);
+	if (data == NULL) {
+		return;
+	}
+
+	uint32 vertex_count = 0;
+	uint32 index_count = 0;
+	uint32 start = SDL_GetTicks();
+
+	for (uint32 i = 0; i < p_iterations; ++i) {
+		obj_geometry geometry;
+		parse((char const*)data, size, &geometry);
+
+		vertex_count = geometry.m_vertex_count;
+		index_count = geometry.m_index_count;
+
+		MEMORY_FREE(geometry.m_pos);
+		MEMORY_FREE(geometry.m_normal);
+		MEMORY_FREE(geometry.m_uv);
+		MEMORY_FREE(geometry.m_indices);
+	}
+
+	uint32 ms = SDL_GetTicks() - start;
+	mapped_file_close(data, size);
+
+	real megabytes = ((real)size * p_iterations) / (1024.0f * 1024.0f);
+	char buffer[256];
+	sprintf(buffer, "obj: %s  verts: %u  tri's: %u  %.2f MB in %u ms  %.1f MB/s\n",
+		p_mesh_name, vertex_count, index_count / 3, megabytes, ms, (ms > 0) ? megabytes * 1000.0f / ms : 0.0f);
+#ifdef _WIN32
+	OutputDebugStringA(buffer);
+#else
+	fputs(buffer, stdout);
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,16 @@
+#ifndef __IMPORTER_OBJ_H_
+#define __IMPORTER_OBJ_H_
+
+#include "core_types.h"
+
+class mesh;
+
+// Print parse throughput for a few meshes while loading
+//#define IMPORTER_OBJ_BENCHMARK
+
+mesh *importer_obj_load(char const* p_mesh_name);
+
+// Parse p_mesh_name p_iterations times and print the throughput in MB/s
+void importer_obj_benchmark(char const* p_mesh_name, uint32 p_iterations);
+
+#endif // __IMPORTER_OBJ_H_
\ No newline at end of file
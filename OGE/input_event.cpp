@@ -31,6 +31,9 @@ static bool convert_sdl_keydown_event(SDL_Event const * p_sdl_event, input_event
 		case SDLK_d:
 			p_event->m_event_keyboard.m_key = KEY_D;
 			break;
+		case SDLK_p:
+			p_event->m_event_keyboard.m_key = KEY_P;
+			break;
 		default:
 			event_processed = false;
 			break;
@@ -64,6 +67,9 @@ static bool convert_sdl_keyup_event(SDL_Event const * p_sdl_event, input_event *
 		case SDLK_d:
 			p_event->m_event_keyboard.m_key = KEY_D;
 			break;
+		case SDLK_p:
+			p_event->m_event_keyboard.m_key = KEY_P;
+			break;
 		default:
 			event_processed = false;
 			break;
@@ -0,0 +1,543 @@
+#include "job_system.h"
+
+#include "assert.h"
+#include "memory_lib.h"
+#include "profiler.h"
+
+#include "SDL.h"
+#include "SDL_thread.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <sched.h>
+#endif
+
+#ifdef _WIN32
+#define JOB_THREAD_LOCAL __declspec(thread)
+#define job_atomic_increment(ptr) InterlockedIncrement(ptr)
+#define job_atomic_decrement(ptr) InterlockedDecrement(ptr)
+#define job_atomic_compare_exchange(ptr, value, comparand) InterlockedCompareExchange((ptr), (value), (comparand))
+#define job_memory_barrier() MemoryBarrier()
+#define job_yield() SwitchToThread()
+#else
+#define JOB_THREAD_LOCAL __thread
+#define job_atomic_increment(ptr) __sync_add_and_fetch((ptr), 1)
+#define job_atomic_decrement(ptr) __sync_sub_and_fetch((ptr), 1)
+#define job_atomic_compare_exchange(ptr, value, comparand) __sync_val_compare_and_swap((ptr), (comparand), (value))
+#define job_memory_barrier() __sync_synchronize()
+#define job_yield() sched_yield()
+#endif
+
+// Looks for work an idle pool thread makes before it goes to sleep
+#define JOB_SPIN_COUNT (64)
+
+class job
+{
+public:
+	job_function m_function;
+	void *m_data;
+	job_counter *m_counter;
+};
+
+// Chase-Lev work stealing deque of a fixed size. The owning thread pushes and pops at the bottom, everyone
+// else steals from the top.
+class job_queue
+{
+public:
+	job m_jobs[JOB_QUEUE_SIZE];
+	volatile long m_top;
+	volatile long m_bottom;
+};
+
+// FIFO under a lock, for jobs from threads outside the pool and jobs for the main thread
+class job_list
+{
+public:
+	job *m_jobs;
+	volatile uint32 m_head;
+	volatile uint32 m_count;
+	uint32 m_max;
+	SDL_mutex *m_lock;
+};
+
+class job_parallel_for_state
+{
+public:
+	job_parallel_for_function m_function;
+	void *m_data;
+	uint32 m_count;
+	uint32 m_batch_size;
+	uint32 m_batch_count;
+	volatile long m_next_batch;
+};
+
+static SDL_Thread *g_job_threads[JOB_THREADS_MAX];
+static uint32 g_job_thread_count = 0;
+static Uint32 g_job_main_thread = 0;
+
+// The main thread's queue first, then one per worker
+static job_queue *g_job_queues = NULL;
+static uint32 g_job_queue_count = 0;
+
+static job_list g_job_shared;
+static job_list g_job_main;
+
+// Workers that found nothing to do wait on g_job_wake, g_job_sleeping counts the ones not yet woken
+static SDL_sem *g_job_wake = NULL;
+static volatile long g_job_sleeping = 0;
+static volatile bool g_job_quit = false;
+
+// One more than the index of the thread's queue, zero outside the pool
+static JOB_THREAD_LOCAL uint32 g_job_slot = 0;
+
+static bool queue_push(job_queue *p_queue, job const* p_job)
+{
+	long bottom = p_queue->m_bottom;
+	long top = p_queue->m_top;
+	if (bottom - top >= JOB_QUEUE_SIZE) {
+		return false;
+	}
+
+	p_queue->m_jobs[bottom & (JOB_QUEUE_SIZE - 1)] = *p_job;
+
+	// The job has to be visible before the slot is
+	job_memory_barrier();
+	p_queue->m_bottom = bottom + 1;
+	return true;
+}
+
+static bool queue_pop(job_queue *p_queue, job *p_job)
+{
+	long bottom = p_queue->m_bottom - 1;
+	p_queue->m_bottom = bottom;
+
+	// Claim the bottom slot before looking at the top, a thief then either sees the claim or we see the steal
+	job_memory_barrier();
+	long top = p_queue->m_top;
+	if (top > bottom) {
+		p_queue->m_bottom = top;
+		return false;
+	}
+
+	*p_job = p_queue->m_jobs[bottom & (JOB_QUEUE_SIZE - 1)];
+	if (top != bottom) {
+		return true;
+	}
+
+	// Last job in the queue, race the thieves for it
+	bool taken = job_atomic_compare_exchange(&p_queue->m_top, top + 1, top) == top;
+	p_queue->m_bottom = top + 1;
+	return taken;
+}
+
+static bool queue_steal(job_queue *p_queue, job *p_job)
+{
+	long top = p_queue->m_top;
+	job_memory_barrier();
+	long bottom = p_queue->m_bottom;
+	if (top >= bottom) {
+		return false;
+	}
+
+	// The owner can only reuse the slot once the top has moved, and then the exchange fails
+	*p_job = p_queue->m_jobs[top & (JOB_QUEUE_SIZE - 1)];
+	return job_atomic_compare_exchange(&p_queue->m_top, top + 1, top) == top;
+}
+
+static bool list_init(job_list *p_list)
+{
+	p_list->m_jobs = NULL;
+	p_list->m_head = 0;
+	p_list->m_count = 0;
+	p_list->m_max = 0;
+	p_list->m_lock = SDL_CreateMutex();
+	return p_list->m_lock != NULL;
+}
+
+static void list_release(job_list *p_list)
+{
+	MEMORY_FREE(p_list->m_jobs);
+	p_list->m_jobs = NULL;
+
+	if (p_list->m_lock) {
+		SDL_DestroyMutex(p_list->m_lock);
+		p_list->m_lock = NULL;
+	}
+}
+
+static void list_push(job_list *p_list, job const* p_job)
+{
+	SDL_mutexP(p_list->m_lock);
+	if (p_list->m_count == p_list->m_max) {
+		// Slide the live jobs down first, only grow if that doesn't free up enough
+		uint32 live = p_list->m_count - p_list->m_head;
+		memmove(p_list->m_jobs, p_list->m_jobs + p_list->m_head, sizeof(job) * live);
+		p_list->m_head = 0;
+		p_list->m_count = live;
+
+		if (live * 2 >= p_list->m_max) {
+			p_list->m_max = (p_list->m_max == 0) ? 64 : p_list->m_max * 2;
+			p_list->m_jobs = (job *)MEMORY_REALLOC(p_list->m_jobs, sizeof(job) * p_list->m_max, MEMORY_TAG_GENERAL);
+			assert(p_list->m_jobs != NULL);
+		}
+	}
+
+	p_list->m_jobs[p_list->m_count++] = *p_job;
+	SDL_mutexV(p_list->m_lock);
+}
+
+static bool list_pop(job_list *p_list, job *p_job)
+{
+	// Unlocked peek, an idle thread shouldn't take the lock every time it looks
+	if (p_list->m_head == p_list->m_count) {
+		return false;
+	}
+
+	SDL_mutexP(p_list->m_lock);
+	bool popped = p_list->m_head < p_list->m_count;
+	if (popped) {
+		*p_job = p_list->m_jobs[p_list->m_head++];
+		if (p_list->m_head == p_list->m_count) {
+			p_list->m_head = p_list->m_count = 0;
+		}
+	}
+	SDL_mutexV(p_list->m_lock);
+
+	return popped;
+}
+
+static uint32 get_core_count()
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return (uint32)info.dwNumberOfProcessors;
+#else
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return (count > 0) ? (uint32)count : 1;
+#endif
+}
+
+static void run_job(job const* p_job)
+{
+	p_job->m_function(p_job->m_data);
+	if (p_job->m_counter) {
+		job_atomic_decrement(&p_job->m_counter->m_count);
+	}
+}
+
+// Own queue newest first, then main thread jobs if this is the main thread, then the shared queue, then
+// stealing the oldest job of every other queue in turn, starting with the next one along
+static bool find_job(job *p_job)
+{
+	uint32 slot = g_job_slot;
+	if (slot != 0 && queue_pop(&g_job_queues[slot - 1], p_job)) {
+		return true;
+	}
+
+	if (slot == 1 && list_pop(&g_job_main, p_job)) {
+		return true;
+	}
+
+	if (list_pop(&g_job_shared, p_job)) {
+		return true;
+	}
+
+	for (uint32 i = 0; i < g_job_queue_count; ++i) {
+		uint32 victim = (slot + i) % g_job_queue_count;
+		if (victim + 1 != slot && queue_steal(&g_job_queues[victim], p_job)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void wake_worker()
+{
+	// The job is pushed, it must be before we look for sleepers
+	job_memory_barrier();
+
+	long sleeping = g_job_sleeping;
+	if (sleeping > 0 && job_atomic_compare_exchange(&g_job_sleeping, sleeping - 1, sleeping) == sleeping) {
+		SDL_SemPost(g_job_wake);
+	}
+}
+
+static int job_worker(void *p_data)
+{
+	g_job_slot = (uint32)(size_t)p_data;
+	PROFILE_THREAD_NAME("job worker");
+
+	uint32 idle = 0;
+	while (g_job_quit == false) {
+		job next;
+		if (find_job(&next)) {
+			run_job(&next);
+			idle = 0;
+			continue;
+		}
+
+		if (++idle < JOB_SPIN_COUNT) {
+			job_yield();
+			continue;
+		}
+
+		// Counted as asleep before the last look, so a submit either sees us asleep or we see its job
+		job_atomic_increment(&g_job_sleeping);
+		if (find_job(&next)) {
+			// Unless a submit already took us off the count, in which case a wake up is on its way
+			long sleeping;
+			while ((sleeping = g_job_sleeping) > 0 && job_atomic_compare_exchange(&g_job_sleeping, sleeping - 1, sleeping) != sleeping) {
+			}
+
+			run_job(&next);
+		} else {
+			SDL_SemWait(g_job_wake);
+		}
+
+		idle = 0;
+	}
+
+	return 0;
+}
+
+bool job_system_init(uint32 p_thread_count)
+{
+	if (p_thread_count == 0) {
+		uint32 cores = get_core_count();
+		p_thread_count = (cores > 1) ? cores - 1 : 0;
+	}
+
+	g_job_main_thread = SDL_ThreadID();
+	g_job_slot = 1;
+
+	if (p_thread_count > JOB_THREADS_MAX) {
+		p_thread_count = JOB_THREADS_MAX;
+	}
+
+	g_job_queue_count = p_thread_count + 1;
+	g_job_queues = (job_queue *)MEMORY_CALLOC(sizeof(job_queue) * g_job_queue_count, MEMORY_TAG_GENERAL);
+	g_job_wake = SDL_CreateSemaphore(0);
+	if (g_job_queues == NULL || g_job_wake == NULL || list_init(&g_job_shared) == false || list_init(&g_job_main) == false) {
+		return false;
+	}
+
+	g_job_sleeping = 0;
+	g_job_quit = false;
+	g_job_thread_count = 0;
+	for (uint32 i = 0; i < p_thread_count; ++i) {
+		g_job_threads[i] = SDL_CreateThread(job_worker, (void *)(size_t)(i + 2));
+		if (g_job_threads[i] == NULL) {
+			break;
+		}
+
+		g_job_thread_count++;
+	}
+
+	return true;
+}
+
+void job_system_shutdown()
+{
+	g_job_quit = true;
+	for (uint32 i = 0; i < g_job_thread_count; ++i) {
+		SDL_SemPost(g_job_wake);
+	}
+
+	for (uint32 i = 0; i < g_job_thread_count; ++i) {
+		SDL_WaitThread(g_job_threads[i], NULL);
+	}
+
+	g_job_thread_count = 0;
+
+	list_release(&g_job_shared);
+	list_release(&g_job_main);
+
+	MEMORY_FREE(g_job_queues);
+	g_job_queues = NULL;
+	g_job_queue_count = 0;
+
+	if (g_job_wake) {
+		SDL_DestroySemaphore(g_job_wake);
+		g_job_wake = NULL;
+	}
+}
+
+uint32 job_system_get_thread_count()
+{
+	return g_job_thread_count;
+}
+
+bool job_system_is_main_thread()
+{
+	return SDL_ThreadID() == g_job_main_thread;
+}
+
+void job_submit(job_function p_function, void *p_data, job_counter *p_counter)
+{
+	job submitted;
+	submitted.m_function = p_function;
+	submitted.m_data = p_data;
+	submitted.m_counter = p_counter;
+
+	if (p_counter) {
+		job_atomic_increment(&p_counter->m_count);
+	}
+
+	if (g_job_thread_count == 0) {
+		run_job(&submitted);
+		return;
+	}
+
+	uint32 slot = g_job_slot;
+	if (slot != 0) {
+		// A full queue means there's plenty for the pool to be getting on with already
+		if (queue_push(&g_job_queues[slot - 1], &submitted) == false) {
+			run_job(&submitted);
+			return;
+		}
+	} else {
+		list_push(&g_job_shared, &submitted);
+	}
+
+	wake_worker();
+}
+
+void job_submit_main_thread(job_function p_function, void *p_data, job_counter *p_counter)
+{
+	job submitted;
+	submitted.m_function = p_function;
+	submitted.m_data = p_data;
+	submitted.m_counter = p_counter;
+
+	if (p_counter) {
+		job_atomic_increment(&p_counter->m_count);
+	}
+
+	list_push(&g_job_main, &submitted);
+}
+
+void job_wait(job_counter *p_counter)
+{
+	while (p_counter->m_count > 0) {
+		job next;
+		if (find_job(&next)) {
+			run_job(&next);
+		} else {
+			job_yield();
+		}
+	}
+
+	// Everything the jobs wrote is visible from here on
+	job_memory_barrier();
+}
+
+void job_system_process_main_thread()
+{
+	assert(job_system_is_main_thread());
+
+	// Only the jobs already queued, one that submits another main thread job doesn't keep us here
+	SDL_mutexP(g_job_main.m_lock);
+	uint32 count = g_job_main.m_count - g_job_main.m_head;
+	SDL_mutexV(g_job_main.m_lock);
+
+	job next;
+	for (uint32 i = 0; i < count && list_pop(&g_job_main, &next); ++i) {
+		run_job(&next);
+	}
+}
+
+static void parallel_for_job(void *p_data)
+{
+	job_parallel_for_state *state = (job_parallel_for_state *)p_data;
+	for (;;) {
+		uint32 batch = (uint32)(job_atomic_increment(&state->m_next_batch) - 1);
+		if (batch >= state->m_batch_count) {
+			break;
+		}
+
+		uint32 begin = batch * state->m_batch_size;
+		uint32 end = (begin + state->m_batch_size < state->m_count) ? begin + state->m_batch_size : state->m_count;
+		state->m_function(state->m_data, begin, end);
+	}
+}
+
+void job_parallel_for(uint32 p_count, uint32 p_batch_size, job_parallel_for_function p_function, void *p_data)
+{
+	if (p_count == 0) {
+		return;
+	}
+
+	assert(p_batch_size > 0);
+
+	// Not worth waking anyone for a single batch
+	uint32 batch_count = (p_count + p_batch_size - 1) / p_batch_size;
+	if (g_job_thread_count == 0 || batch_count == 1) {
+		p_function(p_data, 0, p_count);
+		return;
+	}
+
+	job_parallel_for_state state;
+	state.m_function = p_function;
+	state.m_data = p_data;
+	state.m_count = p_count;
+	state.m_batch_size = p_batch_size;
+	state.m_batch_count = batch_count;
+	state.m_next_batch = 0;
+
+	// Helpers take batches until there are none left, any that start late just return
+	job_counter counter;
+	uint32 helpers = (batch_count - 1 < g_job_thread_count) ? batch_count - 1 : g_job_thread_count;
+	for (uint32 i = 0; i < helpers; ++i) {
+		job_submit(parallel_for_job, &state, &counter);
+	}
+
+	parallel_for_job(&state);
+	job_wait(&counter);
+}
+
+static void empty_job(void * /*p_data*/)
+{
+}
+
+static void empty_parallel_for(void * /*p_data*/, uint32 /*p_begin*/, uint32 /*p_end*/)
+{
+}
+
+void job_system_benchmark(uint32 p_job_count)
+{
+	// Submitted in rounds so the queue never fills up and starts running jobs inline
+	uint32 start = SDL_GetTicks();
+	uint32 submitted = 0;
+	while (submitted < p_job_count) {
+		uint32 round = (p_job_count - submitted < JOB_QUEUE_SIZE / 2) ? p_job_count - submitted : JOB_QUEUE_SIZE / 2;
+
+		job_counter counter;
+		for (uint32 i = 0; i < round; ++i) {
+			job_submit(empty_job, NULL, &counter);
+		}
+		job_wait(&counter);
+
+		submitted += round;
+	}
+	uint32 submit_ms = SDL_GetTicks() - start;
+
+	start = SDL_GetTicks();
+	job_parallel_for(p_job_count, 1, empty_parallel_for, NULL);
+	uint32 parallel_for_ms = SDL_GetTicks() - start;
+
+	char buffer[256];
+	sprintf(buffer, "jobs: %lu empty jobs  submit and wait %.1f ns per job  parallel for %.1f ns per batch  %lu threads\n",
+		p_job_count, submit_ms * 1000000.0 / p_job_count, parallel_for_ms * 1000000.0 / p_job_count, g_job_thread_count + 1);
+#ifdef _WIN32
+	OutputDebugStringA(buffer);
+#else
+	fputs(buffer, stdout);
+#endif
+}
\ No newline at end of file
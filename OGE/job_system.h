@@ -0,0 +1,58 @@
+#ifndef __JOB_SYSTEM_H_
+#define __JOB_SYSTEM_H_
+
+#include "core_types.h"
+
+// Print job scheduling overhead at startup
+//#define JOB_BENCHMARK
+
+#define JOB_THREADS_MAX (16)
+
+// Jobs each pool thread can have queued before submitting runs them inline instead, a power of two
+#define JOB_QUEUE_SIZE (1024)
+
+typedef void (*job_function)(void *p_data);
+typedef void (*job_parallel_for_function)(void *p_data, uint32 p_begin, uint32 p_end);
+
+// Counts the jobs submitted against it that haven't finished yet
+class job_counter
+{
+public:
+	job_counter() : m_count(0) {}
+
+	volatile long m_count;
+};
+
+// Zero threads picks one less than the number of cores, the calling thread makes up the rest and becomes
+// the main thread
+bool job_system_init(uint32 p_thread_count);
+void job_system_shutdown();
+
+uint32 job_system_get_thread_count();
+
+// True on the thread that called job_system_init, the only one that owns the GL context
+bool job_system_is_main_thread();
+
+// Any thread. Pool threads push to their own queue and the rest of the pool steals from it, other threads
+// go through a shared queue. p_counter may be NULL.
+void job_submit(job_function p_function, void *p_data, job_counter *p_counter);
+
+// Any thread. The job only ever runs on the main thread, from job_system_process_main_thread or while the
+// main thread waits.
+void job_submit_main_thread(job_function p_function, void *p_data, job_counter *p_counter);
+
+// Runs other jobs until every job submitted against p_counter is done. Jobs depend on others by waiting on
+// their counter, from inside a job too.
+void job_wait(job_counter *p_counter);
+
+// Main thread, once a frame
+void job_system_process_main_thread();
+
+// Split [0, p_count) into batches of p_batch_size run by the pool and the calling thread, returns once
+// every batch is done. Any thread, nested in a job too.
+void job_parallel_for(uint32 p_count, uint32 p_batch_size, job_parallel_for_function p_function, void *p_data);
+
+// Cost of p_job_count empty jobs, submitted one at a time and as a parallel for
+void job_system_benchmark(uint32 p_job_count);
+
+#endif /* __JOB_SYSTEM_H_ */
\ No newline at end of file
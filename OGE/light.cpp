@@ -1,17 +1,21 @@
 #include "light.h"
 
-#include "allocator_array.h"
+#include "allocator_pool.h"
 #include "ref_counted.h"
 
-#define LIGHT_MAX_NUMBER (512)
+#include <math.h>
 
-static ref_counted<light, LIGHT_MAX_NUMBER, allocator_array<ref_count_store<light, LIGHT_MAX_NUMBER>>> g_allocator_light;
+static ref_counted<light, LIGHT_MAX_NUMBER, allocator_pool<ref_count_store<light, LIGHT_MAX_NUMBER>>> g_allocator_light;
 
 light::light()
 {
 	m_type = LIGHT_TYPE_NONE;
 	m_shadow_casting = false;
 
+	m_constant_attenuation = 1.0f;
+	m_linear_attenuation = 0.0f;
+	m_quadratic_attenuation = 0.0f;
+
 	m_spot_direction.set(0.0f, 0.0f, 0.0f);
 	m_spot_exponent = 1.0f;
 	m_spot_cos_cutoff = 1.0f;
@@ -42,12 +46,44 @@ void light_release(light *p_light)
 	g_allocator_light.release(p_light);
 }
 
-uint8 light_get_count()
+uint32 light_get_count()
+{
+	return g_allocator_light.get_allocated_count();
+}
+
+uint32 light_get_index_max()
 {
-	return (uint8)g_allocator_light.get_allocated_count();
+	return g_allocator_light.get_index_max();
 }
 
-light * light_get_from_index(uint8 p_index)
+light * light_get_from_index(uint32 p_index)
 {
 	return g_allocator_light.get_from_index(p_index);
+}
+
+light * light_get_from_dense(uint32 p_dense_index)
+{
+	return g_allocator_light.get_from_dense(p_dense_index);
+}
+
+real light_get_attenuation_radius(light const* p_light, real p_cutoff)
+{
+	// Solve 1 / (c + l*d + q*d^2) = cutoff for d
+	real c = p_light->m_constant_attenuation - (1.0f / p_cutoff);
+	real l = p_light->m_linear_attenuation;
+	real q = p_light->m_quadratic_attenuation;
+
+	if (c >= 0.0f) {
+		return 0.0f;
+	}
+
+	if (q > 0.0f) {
+		return (-l + sqrtf((l * l) - (4.0f * q * c))) / (2.0f * q);
+	}
+
+	if (l > 0.0f) {
+		return -c / l;
+	}
+
+	return -1.0f;
 }
\ No newline at end of file
@@ -4,6 +4,11 @@
 #include "core_types.h"
 #include "transform.h"
 
+#define LIGHT_MAX_NUMBER (512)
+
+// Attenuation below this is treated as no light at all
+#define LIGHT_ATTENUATION_CUTOFF_DEFAULT (1.0f / 256.0f)
+
 class light
 {
 public:
@@ -46,7 +51,15 @@ void light_system_shutdown();
 light * light_create(char *p_name);
 void light_release(light *p_light);
 
-uint8 light_get_count();
-light * light_get_from_index(uint8 p_index);
+uint32 light_get_count();
+// Upper bound for light_get_from_index, empty slots come back NULL
+uint32 light_get_index_max();
+// Adds a reference, release it when done
+light * light_get_from_index(uint32 p_index);
+// Below light_get_count every index is a live light. Adds a reference, release it when done.
+light * light_get_from_dense(uint32 p_dense_index);
+
+// Distance at which the light's attenuation falls to p_cutoff, -1 if it never does
+real light_get_attenuation_radius(light const* p_light, real p_cutoff);
 
 #endif /* __LIGHT_H_ */
\ No newline at end of file
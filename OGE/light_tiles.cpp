@@ -0,0 +1,363 @@
+#include "light_tiles.h"
+
+#include "light.h"
+#include "assert.h"
+#include "render_state.h"
+#include "memory_lib.h"
+#include "glew/glew.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+light_tile_grid::light_tile_grid()
+{
+	m_width = 0;
+	m_height = 0;
+	m_tile_size = 0;
+	m_tiles_x = 0;
+	m_tiles_y = 0;
+
+	m_light_data = NULL;
+	m_light_bounds = NULL;
+	m_light_count = 0;
+
+	m_tile_data = NULL;
+
+	m_indices = NULL;
+	m_index_count = 0;
+	m_indices_max = 0;
+	m_index_texture_height = 0;
+
+	m_light_data_texture = 0;
+	m_tile_texture = 0;
+	m_index_texture = 0;
+}
+
+light_tile_grid::~light_tile_grid()
+{
+	shutdown();
+}
+
+static void create_float_texture(uint32 *p_texture_id, GLint p_internal_format, GLenum p_format, uint32 p_width, uint32 p_height)
+{
+	if (*p_texture_id == 0) {
+		glGenTextures(1, (GLuint *)p_texture_id);
+	}
+
+	render_state_bind_texture(0, GL_TEXTURE_2D, *p_texture_id);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+	glTexImage2D(GL_TEXTURE_2D, 0, p_internal_format, p_width, p_height, 0, p_format, GL_FLOAT, NULL);
+	render_state_bind_texture(0, GL_TEXTURE_2D, 0);
+}
+
+void light_tile_grid::init(uint32 p_width, uint32 p_height, uint32 p_tile_size)
+{
+	m_width = p_width;
+	m_height = p_height;
+	m_tile_size = p_tile_size;
+	m_tiles_x = (p_width + p_tile_size - 1) / p_tile_size;
+	m_tiles_y = (p_height + p_tile_size - 1) / p_tile_size;
+
+	m_light_data = (float *)MEMORY_ALLOC(sizeof(float) * 4 * LIGHT_TILE_DATA_TEXELS * LIGHT_MAX_NUMBER, MEMORY_TAG_GENERAL);
+	m_light_bounds = (uint32 *)MEMORY_ALLOC(sizeof(uint32) * 4 * LIGHT_MAX_NUMBER, MEMORY_TAG_GENERAL);
+	m_tile_data = (float *)MEMORY_ALLOC(sizeof(float) * 2 * m_tiles_x * m_tiles_y, MEMORY_TAG_GENERAL);
+
+	// Room for every light in a quarter of the tiles before having to grow
+	m_index_texture_height = ((m_tiles_x * m_tiles_y * 16) + LIGHT_TILE_INDEX_TEXTURE_WIDTH - 1) / LIGHT_TILE_INDEX_TEXTURE_WIDTH;
+	m_indices_max = m_index_texture_height * LIGHT_TILE_INDEX_TEXTURE_WIDTH;
+	m_indices = (float *)MEMORY_ALLOC(sizeof(float) * m_indices_max, MEMORY_TAG_GENERAL);
+
+	assert(m_light_data != NULL && m_light_bounds != NULL && m_tile_data != NULL && m_indices != NULL);
+
+	create_float_texture(&m_light_data_texture, GL_RGBA32F_ARB, GL_RGBA, LIGHT_TILE_DATA_TEXELS, LIGHT_MAX_NUMBER);
+	create_float_texture(&m_tile_texture, GL_LUMINANCE_ALPHA32F_ARB, GL_LUMINANCE_ALPHA, m_tiles_x, m_tiles_y);
+	create_float_texture(&m_index_texture, GL_LUMINANCE32F_ARB, GL_LUMINANCE, LIGHT_TILE_INDEX_TEXTURE_WIDTH, m_index_texture_height);
+}
+
+void light_tile_grid::shutdown()
+{
+	MEMORY_FREE(m_light_data);
+	MEMORY_FREE(m_light_bounds);
+	MEMORY_FREE(m_tile_data);
+	MEMORY_FREE(m_indices);
+	m_light_data = NULL;
+	m_light_bounds = NULL;
+	m_tile_data = NULL;
+	m_indices = NULL;
+
+	if (m_light_data_texture) {
+		glDeleteTextures(1, (GLuint *)&m_light_data_texture);
+		glDeleteTextures(1, (GLuint *)&m_tile_texture);
+		glDeleteTextures(1, (GLuint *)&m_index_texture);
+		m_light_data_texture = 0;
+		m_tile_texture = 0;
+		m_index_texture = 0;
+	}
+}
+
+bool light_tile_grid::get_tile_bounds(light const* p_light, Vector3 const& p_view_pos, Vector3 const& p_view_dir, real p_near, real p_cutoff, uint32 p_bounds[4]) const
+{
+	p_bounds[0] = 0;
+	p_bounds[1] = 0;
+	p_bounds[2] = m_tiles_x - 1;
+	p_bounds[3] = m_tiles_y - 1;
+
+	if (p_light->m_type == light::LIGHT_TYPE_DIRECTION) {
+		return true;
+	}
+
+	real radius = light_get_attenuation_radius(p_light, p_cutoff);
+	if (radius == 0.0f) {
+		return false;
+	}
+
+	// Never attenuates out, touches everything
+	if (radius < 0.0f) {
+		return true;
+	}
+
+	Vector3 center = p_view_pos;
+
+	// Shrink to the sphere around the cone. The lighting shader measures the cone
+	// against the pixel to light vector, so it opens away from the spot direction.
+	real dir_len = p_view_dir.len();
+	if (p_light->m_type == light::LIGHT_TYPE_SPOT && dir_len > 0.0f) {
+		Vector3 axis = p_view_dir / -dir_len;
+		real cos_angle = p_light->m_spot_cos_cutoff;
+
+		if (cos_angle > 0.7071f) {
+			real cone_radius = radius / (2.0f * cos_angle);
+			center = p_view_pos + (axis * cone_radius);
+			radius = cone_radius;
+		} else if (cos_angle > 0.0f) {
+			center = p_view_pos + (axis * (radius * cos_angle));
+			radius = radius * sqrtf(1.0f - (cos_angle * cos_angle));
+		}
+	}
+
+	real z = center.m_data[2];
+
+	// Entirely behind the near plane
+	if (z - radius >= -p_near) {
+		return false;
+	}
+
+	// Straddles the near plane, projection of the box would be meaningless
+	if (z + radius > -p_near) {
+		return true;
+	}
+
+	// Project the corners of the view space box around the sphere
+	real const* m = m_proj_mat.m_data;
+	real min_x = 1.0f, min_y = 1.0f, max_x = -1.0f, max_y = -1.0f;
+	for (uint32 i = 0; i < 8; ++i) {
+		real x = center.m_data[0] + ((i & 1) ? radius : -radius);
+		real y = center.m_data[1] + ((i & 2) ? radius : -radius);
+		real cz = center.m_data[2] + ((i & 4) ? radius : -radius);
+
+		real clip_x = (m[0] * x) + (m[4] * y) + (m[8] * cz) + m[12];
+		real clip_y = (m[1] * x) + (m[5] * y) + (m[9] * cz) + m[13];
+		real clip_w = (m[3] * x) + (m[7] * y) + (m[11] * cz) + m[15];
+
+		real ndc_x = clip_x / clip_w;
+		real ndc_y = clip_y / clip_w;
+
+		if (i == 0) {
+			min_x = max_x = ndc_x;
+			min_y = max_y = ndc_y;
+		} else {
+			min_x = (ndc_x < min_x) ? ndc_x : min_x;
+			max_x = (ndc_x > max_x) ? ndc_x : max_x;
+			min_y = (ndc_y < min_y) ? ndc_y : min_y;
+			max_y = (ndc_y > max_y) ? ndc_y : max_y;
+		}
+	}
+
+	if (max_x < -1.0f || min_x > 1.0f || max_y < -1.0f || min_y > 1.0f) {
+		return false;
+	}
+
+	// Pixels with the origin bottom left, same as gl_FragCoord
+	real pixel_min_x = ((min_x * 0.5f) + 0.5f) * m_width;
+	real pixel_max_x = ((max_x * 0.5f) + 0.5f) * m_width;
+	real pixel_min_y = ((min_y * 0.5f) + 0.5f) * m_height;
+	real pixel_max_y = ((max_y * 0.5f) + 0.5f) * m_height;
+
+	p_bounds[0] = (pixel_min_x <= 0.0f) ? 0 : (uint32)pixel_min_x / m_tile_size;
+	p_bounds[1] = (pixel_min_y <= 0.0f) ? 0 : (uint32)pixel_min_y / m_tile_size;
+	p_bounds[2] = (pixel_max_x >= m_width) ? m_tiles_x - 1 : (uint32)pixel_max_x / m_tile_size;
+	p_bounds[3] = (pixel_max_y >= m_height) ? m_tiles_y - 1 : (uint32)pixel_max_y / m_tile_size;
+
+	return true;
+}
+
+void light_tile_grid::add_light(light const* p_light, Vector3 const& p_view_pos, Vector3 const& p_view_dir)
+{
+	float *data = &m_light_data[m_light_count * LIGHT_TILE_DATA_TEXELS * 4];
+
+	data[0] = p_view_pos.m_data[0];
+	data[1] = p_view_pos.m_data[1];
+	data[2] = p_view_pos.m_data[2];
+	data[3] = (p_light->m_type == light::LIGHT_TYPE_DIRECTION) ? 0.0f : 1.0f;
+
+	for (uint32 i = 0; i < 4; ++i) {
+		data[4 + i] = p_light->m_diffuse[i];
+		data[8 + i] = p_light->m_specular[i];
+		data[12 + i] = p_light->m_ambient[i];
+	}
+
+	data[16] = p_light->m_constant_attenuation;
+	data[17] = p_light->m_linear_attenuation;
+	data[18] = p_light->m_quadratic_attenuation;
+	data[19] = p_light->m_spot_cos_cutoff;
+
+	data[20] = p_view_dir.m_data[0];
+	data[21] = p_view_dir.m_data[1];
+	data[22] = p_view_dir.m_data[2];
+	data[23] = p_light->m_spot_exponent;
+
+	m_light_count++;
+}
+
+void light_tile_grid::build(matrix44 const* p_view_mat, matrix44 const* p_proj_mat, real p_cutoff)
+{
+	m_proj_mat = *p_proj_mat;
+	m_light_count = 0;
+	m_ambient[0] = m_ambient[1] = m_ambient[2] = m_ambient[3] = 0.0f;
+
+	// Recover the near plane from the perspective projection
+	real near_plane = p_proj_mat->m_data[14] / (p_proj_mat->m_data[10] - 1.0f);
+
+	uint32 tile_count = m_tiles_x * m_tiles_y;
+	memset(m_tile_data, 0, sizeof(float) * 2 * tile_count);
+
+	Vector3 view_origin = *p_view_mat * Vector3(0.0f, 0.0f, 0.0f);
+
+	// Find the tile rectangle of every light and count how many land in each tile
+	uint32 light_total = light_get_count();
+	for (uint32 i = 0; i < light_total && m_light_count < LIGHT_MAX_NUMBER; ++i) {
+		light *light_ptr = light_get_from_dense(i);
+
+		if (light_ptr->m_type != light::LIGHT_TYPE_NONE) {
+			for (uint32 j = 0; j < 4; ++j) {
+				m_ambient[j] += light_ptr->m_ambient[j];
+			}
+
+			Vector3 view_pos = *p_view_mat * light_ptr->m_transform.get_world_position();
+			Vector3 view_dir = (*p_view_mat * light_ptr->m_spot_direction) - view_origin;
+
+			uint32 *bounds = &m_light_bounds[m_light_count * 4];
+			if (get_tile_bounds(light_ptr, view_pos, view_dir, near_plane, p_cutoff, bounds)) {
+				for (uint32 y = bounds[1]; y <= bounds[3]; ++y) {
+					for (uint32 x = bounds[0]; x <= bounds[2]; ++x) {
+						m_tile_data[((y * m_tiles_x) + x) * 2 + 1] += 1.0f;
+					}
+				}
+
+				add_light(light_ptr, view_pos, view_dir);
+			}
+		}
+
+		light_release(light_ptr);
+	}
+
+	// Turn the counts into offsets into one flat index list
+	uint32 offset = 0;
+	for (uint32 i = 0; i < tile_count; ++i) {
+		uint32 count = (uint32)m_tile_data[(i * 2) + 1];
+		m_tile_data[i * 2] = (float)offset;
+		m_tile_data[(i * 2) + 1] = 0.0f;
+		offset += count;
+	}
+
+	m_index_count = offset;
+	if (m_index_count > m_indices_max) {
+		while (m_indices_max < m_index_count) {
+			m_indices_max *= 2;
+		}
+		m_indices = (float *)MEMORY_REALLOC(m_indices, sizeof(float) * m_indices_max, MEMORY_TAG_GENERAL);
+		assert(m_indices != NULL);
+	}
+
+	// Fill the lists, counts are rebuilt as the write cursor
+	for (uint32 l = 0; l < m_light_count; ++l) {
+		uint32 const* bounds = &m_light_bounds[l * 4];
+		for (uint32 y = bounds[1]; y <= bounds[3]; ++y) {
+			for (uint32 x = bounds[0]; x <= bounds[2]; ++x) {
+				float *tile = &m_tile_data[((y * m_tiles_x) + x) * 2];
+				m_indices[(uint32)tile[0] + (uint32)tile[1]] = (float)l;
+				tile[1] += 1.0f;
+			}
+		}
+	}
+}
+
+void light_tile_grid::upload()
+{
+	if (m_light_count > 0) {
+		render_state_bind_texture(0, GL_TEXTURE_2D, m_light_data_texture);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, LIGHT_TILE_DATA_TEXELS, m_light_count, GL_RGBA, GL_FLOAT, m_light_data);
+	}
+
+	render_state_bind_texture(0, GL_TEXTURE_2D, m_tile_texture);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_tiles_x, m_tiles_y, GL_LUMINANCE_ALPHA, GL_FLOAT, m_tile_data);
+
+	uint32 rows = (m_index_count + LIGHT_TILE_INDEX_TEXTURE_WIDTH - 1) / LIGHT_TILE_INDEX_TEXTURE_WIDTH;
+	if (rows > m_index_texture_height) {
+		m_index_texture_height = m_indices_max / LIGHT_TILE_INDEX_TEXTURE_WIDTH;
+		create_float_texture(&m_index_texture, GL_LUMINANCE32F_ARB, GL_LUMINANCE, LIGHT_TILE_INDEX_TEXTURE_WIDTH, m_index_texture_height);
+	}
+
+	if (rows > 0) {
+		render_state_bind_texture(0, GL_TEXTURE_2D, m_index_texture);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, LIGHT_TILE_INDEX_TEXTURE_WIDTH, rows, GL_LUMINANCE, GL_FLOAT, m_indices);
+	}
+
+	render_state_bind_texture(0, GL_TEXTURE_2D, 0);
+}
+
+void light_tile_grid::bind(uint32 p_light_data_unit, uint32 p_tile_unit, uint32 p_index_unit) const
+{
+	render_state_bind_texture(p_light_data_unit, GL_TEXTURE_2D, m_light_data_texture);
+	render_state_bind_texture(p_tile_unit, GL_TEXTURE_2D, m_tile_texture);
+	render_state_bind_texture(p_index_unit, GL_TEXTURE_2D, m_index_texture);
+}
+
+uint32 light_tile_grid::get_tile_size() const
+{
+	return m_tile_size;
+}
+
+uint32 light_tile_grid::get_tiles_x() const
+{
+	return m_tiles_x;
+}
+
+uint32 light_tile_grid::get_tiles_y() const
+{
+	return m_tiles_y;
+}
+
+uint32 light_tile_grid::get_light_count() const
+{
+	return m_light_count;
+}
+
+uint32 light_tile_grid::get_index_count() const
+{
+	return m_index_count;
+}
+
+uint32 light_tile_grid::get_index_texture_height() const
+{
+	return m_index_texture_height;
+}
+
+real const* light_tile_grid::get_ambient() const
+{
+	return m_ambient;
+}
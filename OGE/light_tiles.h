@@ -0,0 +1,75 @@
+#ifndef __LIGHT_TILES_H_
+#define __LIGHT_TILES_H_
+
+#include "core_types.h"
+#include "matrix.h"
+
+class light;
+
+#define LIGHT_TILE_SIZE_DEFAULT (16)
+
+// Texels of light data per light: position, diffuse, specular, ambient, attenuation + spot cutoff, spot direction + exponent
+#define LIGHT_TILE_DATA_TEXELS (6)
+
+// Width of the texture holding the flattened per tile light lists
+#define LIGHT_TILE_INDEX_TEXTURE_WIDTH (1024)
+
+// Splits the screen into tiles and builds the list of lights touching each one on the CPU.
+// The lists go up as float textures so a single lighting pass can walk them per pixel.
+class light_tile_grid
+{
+public:
+	light_tile_grid();
+	~light_tile_grid();
+
+	void init(uint32 p_width, uint32 p_height, uint32 p_tile_size);
+	void shutdown();
+
+	// Bin every active light against the tiles, matrices are the camera's view and projection
+	void build(matrix44 const* p_view_mat, matrix44 const* p_proj_mat, real p_cutoff);
+	void upload();
+
+	void bind(uint32 p_light_data_unit, uint32 p_tile_unit, uint32 p_index_unit) const;
+
+	uint32 get_tile_size() const;
+	uint32 get_tiles_x() const;
+	uint32 get_tiles_y() const;
+	uint32 get_light_count() const;
+	uint32 get_index_count() const;
+	uint32 get_index_texture_height() const;
+	real const* get_ambient() const;
+
+private:
+	bool get_tile_bounds(light const* p_light, Vector3 const& p_view_pos, Vector3 const& p_view_dir, real p_near, real p_cutoff, uint32 p_bounds[4]) const;
+	void add_light(light const* p_light, Vector3 const& p_view_pos, Vector3 const& p_view_dir);
+
+	uint32 m_width;
+	uint32 m_height;
+	uint32 m_tile_size;
+	uint32 m_tiles_x;
+	uint32 m_tiles_y;
+
+	matrix44 m_proj_mat;
+
+	// Packed LIGHT_TILE_DATA_TEXELS rgba texels per light
+	float *m_light_data;
+	uint32 *m_light_bounds;
+	uint32 m_light_count;
+
+	// Sum of every active light's ambient, culled or not
+	real m_ambient[4];
+
+	// Offset and count into the index list per tile
+	float *m_tile_data;
+
+	float *m_indices;
+	uint32 m_index_count;
+	uint32 m_indices_max;
+	uint32 m_index_texture_height;
+
+	uint32 m_light_data_texture;
+	uint32 m_tile_texture;
+	uint32 m_index_texture;
+};
+
+#endif /* __LIGHT_TILES_H_ */
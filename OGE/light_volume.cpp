@@ -0,0 +1,178 @@
+#include "light_volume.h"
+
+#include "light.h"
+#include "assert.h"
+#include "memory_lib.h"
+#include "render_stats.h"
+#include "glew/glew.h"
+
+#include <stdlib.h>
+#include <math.h>
+
+#define LIGHT_VOLUME_PI (3.14159265f)
+
+// Cones wider than this are bounded by their sphere instead
+#define LIGHT_VOLUME_CONE_COS_MIN (0.3f)
+
+light_volume::light_volume()
+{
+	m_pos = NULL;
+	m_indices = NULL;
+	m_vertex_count = 0;
+	m_index_count = 0;
+}
+
+light_volume::~light_volume()
+{
+	shutdown();
+}
+
+void light_volume::shutdown()
+{
+	MEMORY_FREE(m_pos);
+	MEMORY_FREE(m_indices);
+	m_pos = NULL;
+	m_indices = NULL;
+	m_vertex_count = 0;
+	m_index_count = 0;
+}
+
+void light_volume::init_sphere(uint32 p_rings, uint32 p_segments)
+{
+	// Faces sit inside the sphere, push the vertices out so the mesh covers it
+	real scale = 1.0f / (cosf(LIGHT_VOLUME_PI / p_segments) * cosf(LIGHT_VOLUME_PI / (2 * p_rings)));
+
+	m_vertex_count = (p_rings + 1) * (p_segments + 1);
+	m_index_count = p_rings * p_segments * 6;
+	m_pos = (Vector3 *)MEMORY_ALLOC(sizeof(Vector3) * m_vertex_count, MEMORY_TAG_GEOMETRY);
+	m_indices = (uint16 *)MEMORY_ALLOC(sizeof(uint16) * m_index_count, MEMORY_TAG_GEOMETRY);
+	assert(m_pos != NULL && m_indices != NULL);
+
+	uint32 vertex = 0;
+	for (uint32 ring = 0; ring <= p_rings; ++ring) {
+		real phi = (LIGHT_VOLUME_PI * ring) / p_rings;
+		for (uint32 segment = 0; segment <= p_segments; ++segment) {
+			real theta = (2.0f * LIGHT_VOLUME_PI * segment) / p_segments;
+			m_pos[vertex++].set(sinf(phi) * cosf(theta) * scale, cosf(phi) * scale, sinf(phi) * sinf(theta) * scale);
+		}
+	}
+
+	// Counter clockwise seen from outside
+	uint32 index = 0;
+	for (uint32 ring = 0; ring < p_rings; ++ring) {
+		for (uint32 segment = 0; segment < p_segments; ++segment) {
+			uint16 a = (uint16)((ring * (p_segments + 1)) + segment);
+			uint16 b = (uint16)(a + p_segments + 1);
+			m_indices[index++] = a;
+			m_indices[index++] = a + 1;
+			m_indices[index++] = b;
+			m_indices[index++] = b;
+			m_indices[index++] = a + 1;
+			m_indices[index++] = b + 1;
+		}
+	}
+}
+
+void light_volume::init_cone(uint32 p_segments)
+{
+	real scale = 1.0f / cosf(LIGHT_VOLUME_PI / p_segments);
+
+	// Apex, base centre, then the base ring
+	m_vertex_count = p_segments + 2;
+	m_index_count = p_segments * 6;
+	m_pos = (Vector3 *)MEMORY_ALLOC(sizeof(Vector3) * m_vertex_count, MEMORY_TAG_GEOMETRY);
+	m_indices = (uint16 *)MEMORY_ALLOC(sizeof(uint16) * m_index_count, MEMORY_TAG_GEOMETRY);
+	assert(m_pos != NULL && m_indices != NULL);
+
+	m_pos[0].set(0.0f, 0.0f, 0.0f);
+	m_pos[1].set(0.0f, 0.0f, -1.0f);
+	for (uint32 segment = 0; segment < p_segments; ++segment) {
+		real theta = (2.0f * LIGHT_VOLUME_PI * segment) / p_segments;
+		m_pos[segment + 2].set(cosf(theta) * scale, sinf(theta) * scale, -1.0f);
+	}
+
+	uint32 index = 0;
+	for (uint32 segment = 0; segment < p_segments; ++segment) {
+		uint16 a = (uint16)(segment + 2);
+		uint16 b = (uint16)(((segment + 1) % p_segments) + 2);
+
+		// Side
+		m_indices[index++] = 0;
+		m_indices[index++] = a;
+		m_indices[index++] = b;
+
+		// Base cap
+		m_indices[index++] = 1;
+		m_indices[index++] = b;
+		m_indices[index++] = a;
+	}
+}
+
+void light_volume::draw() const
+{
+	glVertexPointer(3, GL_FLOAT, 0, m_pos);
+	glDrawElements(GL_TRIANGLES, m_index_count, GL_UNSIGNED_SHORT, m_indices);
+
+	render_stats_count_draw(m_index_count / 3);
+}
+
+light_volume_type light_volume_get_transform(light const* p_light, real p_cutoff, matrix44 *p_transform)
+{
+	if (p_light->m_type == light::LIGHT_TYPE_DIRECTION) {
+		return LIGHT_VOLUME_TYPE_FULLSCREEN;
+	}
+
+	real radius = light_get_attenuation_radius(p_light, p_cutoff);
+	if (radius == 0.0f) {
+		return LIGHT_VOLUME_TYPE_NONE;
+	}
+
+	if (radius < 0.0f) {
+		return LIGHT_VOLUME_TYPE_FULLSCREEN;
+	}
+
+	Vector3 pos = p_light->m_transform.get_world_position();
+	p_transform->set_identity();
+
+	Vector3 spot_direction = p_light->m_spot_direction;
+	real spot_len = spot_direction.len();
+	real cos_angle = p_light->m_spot_cos_cutoff;
+
+	if (p_light->m_type != light::LIGHT_TYPE_SPOT || spot_len <= 0.0f || cos_angle < LIGHT_VOLUME_CONE_COS_MIN) {
+		p_transform->_00 = radius;
+		p_transform->_11 = radius;
+		p_transform->_22 = radius;
+		p_transform->set_translation(pos);
+		return LIGHT_VOLUME_TYPE_SPHERE;
+	}
+
+	// The lighting shader opens the cone away from the spot direction
+	Vector3 axis = spot_direction / -spot_len;
+
+	Vector3 up(0.0f, 1.0f, 0.0f);
+	if (fabsf(axis.m_data[1]) > 0.9f) {
+		up.set(1.0f, 0.0f, 0.0f);
+	}
+
+	Vector3 u = up.cross(axis);
+	u = u / u.len();
+	Vector3 v = axis;
+	v = v.cross(u);
+
+	// Cone of height radius covers every point within radius inside the cutoff angle
+	real base_radius = radius * sqrtf(1.0f - (cos_angle * cos_angle)) / cos_angle;
+
+	// Columns v, u, -axis keep the winding counter clockwise
+	p_transform->_00 = v.m_data[0] * base_radius;
+	p_transform->_10 = v.m_data[1] * base_radius;
+	p_transform->_20 = v.m_data[2] * base_radius;
+	p_transform->_01 = u.m_data[0] * base_radius;
+	p_transform->_11 = u.m_data[1] * base_radius;
+	p_transform->_21 = u.m_data[2] * base_radius;
+	p_transform->_02 = -axis.m_data[0] * radius;
+	p_transform->_12 = -axis.m_data[1] * radius;
+	p_transform->_22 = -axis.m_data[2] * radius;
+	p_transform->set_translation(pos);
+
+	return LIGHT_VOLUME_TYPE_CONE;
+}
\ No newline at end of file
@@ -0,0 +1,41 @@
+#ifndef __LIGHT_VOLUME_H_
+#define __LIGHT_VOLUME_H_
+
+#include "core_types.h"
+#include "vector3.h"
+#include "matrix.h"
+
+class light;
+
+typedef uint32 light_volume_type;
+const light_volume_type LIGHT_VOLUME_TYPE_NONE = 0;			// Never reaches the cutoff, nothing to draw
+const light_volume_type LIGHT_VOLUME_TYPE_FULLSCREEN = 1;	// Directional or unattenuated, needs a full screen pass
+const light_volume_type LIGHT_VOLUME_TYPE_SPHERE = 2;
+const light_volume_type LIGHT_VOLUME_TYPE_CONE = 3;
+
+// Closed mesh rasterized to find the pixels a light can touch. The unit sphere is
+// centred on the origin, the unit cone has its apex there and opens down -z.
+class light_volume
+{
+public:
+	light_volume();
+	~light_volume();
+
+	void init_sphere(uint32 p_rings, uint32 p_segments);
+	void init_cone(uint32 p_segments);
+	void shutdown();
+
+	// Drawn from client arrays, no vertex buffer may be bound
+	void draw() const;
+
+private:
+	Vector3 *m_pos;
+	uint16 *m_indices;
+	uint32 m_vertex_count;
+	uint32 m_index_count;
+};
+
+// Pick the volume bounding a light and its world transform, the radius is where attenuation drops to p_cutoff
+light_volume_type light_volume_get_transform(light const* p_light, real p_cutoff, matrix44 *p_transform);
+
+#endif /* __LIGHT_VOLUME_H_ */
\ No newline at end of file
@@ -0,0 +1,76 @@
+#include "mapped_file.h"
+
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+uint8 *mapped_file_open(char const* p_path, bool p_copy_on_write, uint32 *p_size)
+{
+#ifdef _WIN32
+	HANDLE file = CreateFileA(p_path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		return NULL;
+	}
+
+	DWORD size = GetFileSize(file, NULL);
+	if (size == INVALID_FILE_SIZE || size == 0) {
+		CloseHandle(file);
+		return NULL;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, p_copy_on_write ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);
+	if (mapping == NULL) {
+		return NULL;
+	}
+
+	// The view keeps the mapping alive
+	uint8 *data = (uint8 *)MapViewOfFile(mapping, p_copy_on_write ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+
+	*p_size = (uint32)size;
+	return data;
+#else
+	int fd = open(p_path, O_RDONLY);
+	if (fd < 0) {
+		return NULL;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		close(fd);
+		return NULL;
+	}
+
+	int prot = p_copy_on_write ? (PROT_READ | PROT_WRITE) : PROT_READ;
+	void *data = mmap(NULL, (size_t)st.st_size, prot, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		return NULL;
+	}
+
+	*p_size = (uint32)st.st_size;
+	return (uint8 *)data;
+#endif
+}
+
+void mapped_file_close(uint8 *p_data, uint32 p_size)
+{
+	if (p_data == NULL) {
+		return;
+	}
+
+#ifdef _WIN32
+	UnmapViewOfFile(p_data);
+#else
+	munmap(p_data, p_size);
+#endif
+}
\ No newline at end of file
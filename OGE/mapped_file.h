@@ -0,0 +1,10 @@
+#ifndef __MAPPED_FILE_H_
+#define __MAPPED_FILE_H_
+
+#include "core_types.h"
+
+// Map a whole file into memory. Copy on write views can be modified without touching the file.
+uint8 *mapped_file_open(char const* p_path, bool p_copy_on_write, uint32 *p_size);
+void mapped_file_close(uint8 *p_data, uint32 p_size);
+
+#endif /* __MAPPED_FILE_H_ */
\ No newline at end of file
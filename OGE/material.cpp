@@ -1,17 +1,21 @@
 #include "material.h"
 #include "render_lib.h"
 #include "ref_counted.h"
-#include "allocator_array.h"
+#include "allocator_pool.h"
 
 #include "SDL.h"
 #include "SDL_image.h"
+#include "SDL_thread.h"
 
 #include <string.h>
 
 
 #define MATERIAL_MAX_NUMBER (256)
 
-static ref_counted<material, MATERIAL_MAX_NUMBER, allocator_array<ref_count_store<material, MATERIAL_MAX_NUMBER>>> g_allocator_material;
+static ref_counted<material, MATERIAL_MAX_NUMBER, allocator_pool<ref_count_store<material, MATERIAL_MAX_NUMBER>>> g_allocator_material;
+
+// Meshes streaming in create their materials off the main thread
+static SDL_mutex *g_material_lock = NULL;
 
 material::material()
 {
@@ -19,12 +23,13 @@ material::material()
 	memset(m_color_diffuse, 0, 16);
 	m_texture = NULL;
 	m_shader = NULL;
+	m_material_name[0] = '\0';
+	m_texture_name[0] = '\0';
 }
 
 material::~material()
 {
 	if (m_texture) {
-		m_texture->unbind();
 		texture_release(m_texture);
 		m_texture = NULL;
 	}
@@ -38,32 +43,48 @@ material::~material()
 void material_system_init()
 {
 	g_allocator_material.init(MATERIAL_MAX_NUMBER);
+	g_material_lock = SDL_CreateMutex();
 }
 
 void material_system_shutdown()
 {
 	g_allocator_material.shutdown();
+
+	if (g_material_lock) {
+		SDL_DestroyMutex(g_material_lock);
+		g_material_lock = NULL;
+	}
 }
 
 material *material_create(char *p_material_name)
 {
-	return g_allocator_material.create(p_material_name);
+	SDL_mutexP(g_material_lock);
+	material *mat = g_allocator_material.create(p_material_name);
+	if (mat != NULL && mat->m_material_name[0] == '\0') {
+		strncpy(mat->m_material_name, p_material_name, MAX_MATERIAL_NAME_LENGTH - 1);
+		mat->m_material_name[MAX_MATERIAL_NAME_LENGTH - 1] = '\0';
+	}
+	SDL_mutexV(g_material_lock);
+
+	return mat;
 }
 
 bool material_load(material *p_mat, char *p_texture_name)
 {
+	strncpy(p_mat->m_texture_name, p_texture_name, MAX_TEXTURE_NAME_LENGTH - 1);
+	p_mat->m_texture_name[MAX_TEXTURE_NAME_LENGTH - 1] = '\0';
+
+	// Draws with the placeholder until the texture has streamed in
 	p_mat->m_texture = texture_create(p_texture_name);
-	p_mat->m_texture->load(p_texture_name);
+	p_mat->m_texture->load_async(p_texture_name);
 
 	return true;
 }
 
 void material_release(material *p_mat)
 {
+	// The last reference destroys the material, which drops its texture and shader
+	SDL_mutexP(g_material_lock);
 	g_allocator_material.release(p_mat);
-
-	if (p_mat->m_texture != NULL) {
-		p_mat->m_texture->unbind();
-		texture_release(p_mat->m_texture);
-	}
+	SDL_mutexV(g_material_lock);
 }
\ No newline at end of file
@@ -16,7 +16,9 @@ public:
 	material();
 	~material();
 
-	//char m_material_name[MAX_MATERIAL_NAME_LENGTH];
+	// Kept so the material can be written back out with a cooked mesh
+	char m_material_name[MAX_MATERIAL_NAME_LENGTH];
+	char m_texture_name[MAX_TEXTURE_NAME_LENGTH];
 	real32 m_color_ambient[4];
 	real32 m_color_diffuse[4];
 	real32 m_color_spec[4];
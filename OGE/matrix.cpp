@@ -1,9 +1,25 @@
 #include "matrix.h"
 
 #include "assert.h"
+#include "memory_lib.h"
 
+#include "SDL.h"
+
+#include <stdio.h>
 #include <string.h>
 
+#if defined(MATH_SSE)
+#include <xmmintrin.h>
+#endif
+
+#if defined(MATH_SSE) && defined(MATH_AVX)
+#include <immintrin.h>
+#endif
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
 Vector3 matrix44::get_fvec() const
 {
 	Vector3 tmp_vec;
@@ -55,72 +71,52 @@ void matrix44::set_identity()
 	m_data[15] = 1.0f;
 }
 
-Vector3 matrix44::operator*(Vector3 const& val) const
+// Scalar kernels, the only ones with MATH_SCALAR and the baseline for the benchmark
+static void transform_point_scalar(matrix44 const* p_matrix, Vector3 const& val, Vector3 *p_out)
 {
-	Vector3 out;
-
-	//out.m_data[0] = (val.m_data[0] * _00) + (val.m_data[1] * _10) + (val.m_data[2] * _20) + _30;
-	//out.m_data[1] = (val.m_data[0] * _01) + (val.m_data[1] * _11) + (val.m_data[2] * _21) + _31;
-	//out.m_data[2] = (val.m_data[0] * _02) + (val.m_data[1] * _12) + (val.m_data[2] * _22) + _32;
-
-	out.m_data[0] = (val.m_data[0] * _00) + (val.m_data[1] * _01) + (val.m_data[2] * _02) + _03;
-	out.m_data[1] = (val.m_data[0] * _10) + (val.m_data[1] * _11) + (val.m_data[2] * _12) + _13;
-	out.m_data[2] = (val.m_data[0] * _20) + (val.m_data[1] * _21) + (val.m_data[2] * _22) + _23;
-
-	return out;
+	real x = (val.m_data[0] * p_matrix->_00) + (val.m_data[1] * p_matrix->_01) + (val.m_data[2] * p_matrix->_02) + p_matrix->_03;
+	real y = (val.m_data[0] * p_matrix->_10) + (val.m_data[1] * p_matrix->_11) + (val.m_data[2] * p_matrix->_12) + p_matrix->_13;
+	real z = (val.m_data[0] * p_matrix->_20) + (val.m_data[1] * p_matrix->_21) + (val.m_data[2] * p_matrix->_22) + p_matrix->_23;
+	p_out->set(x, y, z);
 }
 
-matrix44 matrix44::operator*(matrix44 const& _m) const
+static void transform_direction_scalar(matrix44 const* p_matrix, Vector3 const& val, Vector3 *p_out)
 {
-	matrix44 result;
+	real x = (val.m_data[0] * p_matrix->_00) + (val.m_data[1] * p_matrix->_01) + (val.m_data[2] * p_matrix->_02);
+	real y = (val.m_data[0] * p_matrix->_10) + (val.m_data[1] * p_matrix->_11) + (val.m_data[2] * p_matrix->_12);
+	real z = (val.m_data[0] * p_matrix->_20) + (val.m_data[1] * p_matrix->_21) + (val.m_data[2] * p_matrix->_22);
+	p_out->set(x, y, z);
+}
 
-#if 1
-	result._00 = (_00 * _m._00) + (_10 * _m._01) + (_20 * _m._02) + (_30 * _m._03);
-	result._01 = (_01 * _m._00) + (_11 * _m._01) + (_21 * _m._02) + (_31 * _m._03);
-	result._02 = (_02 * _m._00) + (_12 * _m._01) + (_22 * _m._02) + (_32 * _m._03);
-	result._03 = (_03 * _m._00) + (_13 * _m._01) + (_23 * _m._02) + (_33 * _m._03);
-	
-	result._10 = (_00 * _m._10) + (_10 * _m._11) + (_20 * _m._12) + (_30 * _m._13);
-	result._11 = (_01 * _m._10) + (_11 * _m._11) + (_21 * _m._12) + (_31 * _m._13);
-	result._12 = (_02 * _m._10) + (_12 * _m._11) + (_22 * _m._12) + (_32 * _m._13);
-	result._13 = (_03 * _m._10) + (_13 * _m._11) + (_23 * _m._12) + (_33 * _m._13);
-	
-	result._20 = (_00 * _m._20) + (_10 * _m._21) + (_20 * _m._22) + (_30 * _m._23);
-	result._21 = (_01 * _m._20) + (_11 * _m._21) + (_21 * _m._22) + (_31 * _m._23);
-	result._22 = (_02 * _m._20) + (_12 * _m._21) + (_22 * _m._22) + (_32 * _m._23);
-	result._23 = (_03 * _m._20) + (_13 * _m._21) + (_23 * _m._22) + (_33 * _m._23);
-	
-	result._30 = (_00 * _m._30) + (_10 * _m._31) + (_20 * _m._32) + (_30 * _m._33);
-	result._31 = (_01 * _m._30) + (_11 * _m._31) + (_21 * _m._32) + (_31 * _m._33);
-	result._32 = (_02 * _m._30) + (_12 * _m._31) + (_22 * _m._32) + (_32 * _m._33);
-	result._33 = (_03 * _m._30) + (_13 * _m._31) + (_23 * _m._32) + (_33 * _m._33);
+// Note the operand order, a * b is b applied after a in column vector terms
+static void multiply_scalar(matrix44 const* p_a, matrix44 const* p_b, matrix44 *p_result)
+{
+	matrix44 const& a = *p_a;
+	matrix44 const& _m = *p_b;
+	matrix44 &result = *p_result;
 
-#else
-	result._00 = (_00 * _m._00) + (_01 * _m._10) + (_02 * _m._20) + (_03 * _m._30);
-	result._01 = (_00 * _m._01) + (_01 * _m._11) + (_02 * _m._21) + (_03 * _m._31);
-	result._02 = (_00 * _m._02) + (_01 * _m._12) + (_02 * _m._22) + (_03 * _m._32);
-	result._03 = (_00 * _m._03) + (_01 * _m._13) + (_02 * _m._23) + (_03 * _m._33);
+	result._00 = (a._00 * _m._00) + (a._10 * _m._01) + (a._20 * _m._02) + (a._30 * _m._03);
+	result._01 = (a._01 * _m._00) + (a._11 * _m._01) + (a._21 * _m._02) + (a._31 * _m._03);
+	result._02 = (a._02 * _m._00) + (a._12 * _m._01) + (a._22 * _m._02) + (a._32 * _m._03);
+	result._03 = (a._03 * _m._00) + (a._13 * _m._01) + (a._23 * _m._02) + (a._33 * _m._03);
 	
-	result._10 = (_10 * _m._00) + (_11 * _m._10) + (_12 * _m._20) + (_13 * _m._30);
-	result._11 = (_10 * _m._01) + (_11 * _m._11) + (_12 * _m._21) + (_13 * _m._31);
-	result._12 = (_10 * _m._02) + (_11 * _m._12) + (_12 * _m._22) + (_13 * _m._32);
-	result._13 = (_10 * _m._03) + (_11 * _m._13) + (_12 * _m._23) + (_13 * _m._33);
+	result._10 = (a._00 * _m._10) + (a._10 * _m._11) + (a._20 * _m._12) + (a._30 * _m._13);
+	result._11 = (a._01 * _m._10) + (a._11 * _m._11) + (a._21 * _m._12) + (a._31 * _m._13);
+	result._12 = (a._02 * _m._10) + (a._12 * _m._11) + (a._22 * _m._12) + (a._32 * _m._13);
+	result._13 = (a._03 * _m._10) + (a._13 * _m._11) + (a._23 * _m._12) + (a._33 * _m._13);
 	
-	result._20 = (_20 * _m._00) + (_21 * _m._10) + (_22 * _m._20) + (_23 * _m._30);
-	result._21 = (_20 * _m._01) + (_21 * _m._11) + (_22 * _m._21) + (_23 * _m._31);
-	result._22 = (_20 * _m._02) + (_21 * _m._12) + (_22 * _m._22) + (_23 * _m._32);
-	result._23 = (_20 * _m._03) + (_21 * _m._13) + (_22 * _m._23) + (_23 * _m._33);
+	result._20 = (a._00 * _m._20) + (a._10 * _m._21) + (a._20 * _m._22) + (a._30 * _m._23);
+	result._21 = (a._01 * _m._20) + (a._11 * _m._21) + (a._21 * _m._22) + (a._31 * _m._23);
+	result._22 = (a._02 * _m._20) + (a._12 * _m._21) + (a._22 * _m._22) + (a._32 * _m._23);
+	result._23 = (a._03 * _m._20) + (a._13 * _m._21) + (a._23 * _m._22) + (a._33 * _m._23);
 	
-	result._30 = (_30 * _m._00) + (_31 * _m._10) + (_32 * _m._20) + (_33 * _m._30);
-	result._31 = (_30 * _m._01) + (_31 * _m._11) + (_32 * _m._21) + (_33 * _m._31);
-	result._32 = (_30 * _m._02) + (_31 * _m._12) + (_32 * _m._22) + (_33 * _m._32);
-	result._33 = (_30 * _m._03) + (_31 * _m._13) + (_32 * _m._23) + (_33 * _m._33);
-#endif
-
-	return result;
+	result._30 = (a._00 * _m._30) + (a._10 * _m._31) + (a._20 * _m._32) + (a._30 * _m._33);
+	result._31 = (a._01 * _m._30) + (a._11 * _m._31) + (a._21 * _m._32) + (a._31 * _m._33);
+	result._32 = (a._02 * _m._30) + (a._12 * _m._31) + (a._22 * _m._32) + (a._32 * _m._33);
+	result._33 = (a._03 * _m._30) + (a._13 * _m._31) + (a._23 * _m._32) + (a._33 * _m._33);
 }
 
-matrix44 matrix44::inverse() const
+static void inverse_scalar(real const* m_data, matrix44 *p_result)
 {
 	real fA0 = m_data[ 0]*m_data[ 5] - m_data[ 1]*m_data[ 4];
 	real fA1 = m_data[ 0]*m_data[ 6] - m_data[ 2]*m_data[ 4];
@@ -140,7 +136,7 @@ matrix44 matrix44::inverse() const
    //     return Matrix4<Real>::ZERO;
    // }
 
-	matrix44 kInv;
+	matrix44 &kInv = *p_result;
 	kInv.m_data[ 0] =	+ m_data[ 5]*fB5 - m_data[ 6]*fB4 + m_data[ 7]*fB3;
 	kInv.m_data[ 4] =	- m_data[ 4]*fB5 + m_data[ 6]*fB2 - m_data[ 7]*fB1;
 	kInv.m_data[ 8] = + m_data[ 4]*fB4 - m_data[ 5]*fB2 + m_data[ 7]*fB0;
@@ -176,6 +172,241 @@ matrix44 matrix44::inverse() const
 	kInv.m_data[14] *= fInvDet;
 	kInv.m_data[15] *= fInvDet;
 
+}
+
+
+#if defined(MATH_SSE)
+// Columns are contiguous, so every kernel works on whole columns. Loads are unaligned since
+// matrices embedded in heap objects only get malloc's alignment.
+static void multiply_sse(matrix44 const* p_a, matrix44 const* p_b, matrix44 *p_result)
+{
+	__m128 b0 = _mm_loadu_ps(&p_b->m_data[0]);
+	__m128 b1 = _mm_loadu_ps(&p_b->m_data[4]);
+	__m128 b2 = _mm_loadu_ps(&p_b->m_data[8]);
+	__m128 b3 = _mm_loadu_ps(&p_b->m_data[12]);
+
+	// Column c of the result is b's columns weighted by column c of a
+	for (uint32 c = 0; c < 4; ++c) {
+		real const* a = &p_a->m_data[c * 4];
+		__m128 col = _mm_mul_ps(b0, _mm_set1_ps(a[0]));
+		col = _mm_add_ps(col, _mm_mul_ps(b1, _mm_set1_ps(a[1])));
+		col = _mm_add_ps(col, _mm_mul_ps(b2, _mm_set1_ps(a[2])));
+		col = _mm_add_ps(col, _mm_mul_ps(b3, _mm_set1_ps(a[3])));
+		_mm_storeu_ps(&p_result->m_data[c * 4], col);
+	}
+}
+
+// Same cofactor expansion as the scalar version, one column of the result per pass
+static void inverse_sse(matrix44 const* p_matrix, matrix44 *p_result)
+{
+	__m128 c0 = _mm_loadu_ps(&p_matrix->m_data[0]);
+	__m128 c1 = _mm_loadu_ps(&p_matrix->m_data[4]);
+	__m128 c2 = _mm_loadu_ps(&p_matrix->m_data[8]);
+	__m128 c3 = _mm_loadu_ps(&p_matrix->m_data[12]);
+
+	// 2x2 determinants of the first two and last two columns, fA0-fA3 | fA4 fA5 and fB likewise
+	__m128 a = _mm_sub_ps(_mm_mul_ps(_mm_shuffle_ps(c0, c0, _MM_SHUFFLE(1, 0, 0, 0)), _mm_shuffle_ps(c1, c1, _MM_SHUFFLE(2, 3, 2, 1))),
+		_mm_mul_ps(_mm_shuffle_ps(c0, c0, _MM_SHUFFLE(2, 3, 2, 1)), _mm_shuffle_ps(c1, c1, _MM_SHUFFLE(1, 0, 0, 0))));
+	__m128 a2 = _mm_sub_ps(_mm_mul_ps(_mm_shuffle_ps(c0, c0, _MM_SHUFFLE(2, 1, 2, 1)), _mm_shuffle_ps(c1, c1, _MM_SHUFFLE(3, 3, 3, 3))),
+		_mm_mul_ps(_mm_shuffle_ps(c0, c0, _MM_SHUFFLE(3, 3, 3, 3)), _mm_shuffle_ps(c1, c1, _MM_SHUFFLE(2, 1, 2, 1))));
+	__m128 b = _mm_sub_ps(_mm_mul_ps(_mm_shuffle_ps(c2, c2, _MM_SHUFFLE(1, 0, 0, 0)), _mm_shuffle_ps(c3, c3, _MM_SHUFFLE(2, 3, 2, 1))),
+		_mm_mul_ps(_mm_shuffle_ps(c2, c2, _MM_SHUFFLE(2, 3, 2, 1)), _mm_shuffle_ps(c3, c3, _MM_SHUFFLE(1, 0, 0, 0))));
+	__m128 b2 = _mm_sub_ps(_mm_mul_ps(_mm_shuffle_ps(c2, c2, _MM_SHUFFLE(2, 1, 2, 1)), _mm_shuffle_ps(c3, c3, _MM_SHUFFLE(3, 3, 3, 3))),
+		_mm_mul_ps(_mm_shuffle_ps(c2, c2, _MM_SHUFFLE(3, 3, 3, 3)), _mm_shuffle_ps(c3, c3, _MM_SHUFFLE(2, 1, 2, 1))));
+
+	// (fBk, fBk, fAk, fAk) for each k
+	__m128 k0 = _mm_shuffle_ps(b, a, _MM_SHUFFLE(0, 0, 0, 0));
+	__m128 k1 = _mm_shuffle_ps(b, a, _MM_SHUFFLE(1, 1, 1, 1));
+	__m128 k2 = _mm_shuffle_ps(b, a, _MM_SHUFFLE(2, 2, 2, 2));
+	__m128 k3 = _mm_shuffle_ps(b, a, _MM_SHUFFLE(3, 3, 3, 3));
+	__m128 k4 = _mm_shuffle_ps(b2, a2, _MM_SHUFFLE(0, 0, 0, 0));
+	__m128 k5 = _mm_shuffle_ps(b2, a2, _MM_SHUFFLE(1, 1, 1, 1));
+
+	// (m4, m0, m12, m8), (m5, m1, m13, m9), (m6, m2, m14, m10), (m7, m3, m15, m11)
+	__m128 lo01 = _mm_unpacklo_ps(c1, c0);
+	__m128 hi01 = _mm_unpackhi_ps(c1, c0);
+	__m128 lo23 = _mm_unpacklo_ps(c3, c2);
+	__m128 hi23 = _mm_unpackhi_ps(c3, c2);
+	__m128 v4 = _mm_movelh_ps(lo01, lo23);
+	__m128 v5 = _mm_movehl_ps(lo23, lo01);
+	__m128 v6 = _mm_movelh_ps(hi01, hi23);
+	__m128 v7 = _mm_movehl_ps(hi23, hi01);
+
+	__m128 r0 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(v5, k5), _mm_mul_ps(v6, k4)), _mm_mul_ps(v7, k3));
+	__m128 r1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(v4, k5), _mm_mul_ps(v6, k2)), _mm_mul_ps(v7, k1));
+	__m128 r2 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(v4, k4), _mm_mul_ps(v5, k2)), _mm_mul_ps(v7, k0));
+	__m128 r3 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(v4, k3), _mm_mul_ps(v5, k1)), _mm_mul_ps(v6, k0));
+
+	real fa[8];
+	real fb[8];
+	_mm_storeu_ps(&fa[0], a);
+	_mm_storeu_ps(&fa[4], a2);
+	_mm_storeu_ps(&fb[0], b);
+	_mm_storeu_ps(&fb[4], b2);
+	real det = fa[0] * fb[5] - fa[1] * fb[4] + fa[2] * fb[3] + fa[3] * fb[2] - fa[4] * fb[1] + fa[5] * fb[0];
+	real inv_det = ((real)1.0) / det;
+
+	// Cofactor signs alternate down each column, starting positive in the even columns
+	__m128 even = _mm_setr_ps(inv_det, -inv_det, inv_det, -inv_det);
+	__m128 odd = _mm_setr_ps(-inv_det, inv_det, -inv_det, inv_det);
+	_mm_storeu_ps(&p_result->m_data[0], _mm_mul_ps(r0, even));
+	_mm_storeu_ps(&p_result->m_data[4], _mm_mul_ps(r1, odd));
+	_mm_storeu_ps(&p_result->m_data[8], _mm_mul_ps(r2, even));
+	_mm_storeu_ps(&p_result->m_data[12], _mm_mul_ps(r3, odd));
+}
+
+// Four packed xyz points in three registers to one register per component, and back again
+static void transpose_points_in(__m128 p_a, __m128 p_b, __m128 p_c, __m128 *p_x, __m128 *p_y, __m128 *p_z)
+{
+	*p_x = _mm_shuffle_ps(p_a, _mm_shuffle_ps(p_b, p_c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 3, 0));
+	*p_y = _mm_shuffle_ps(_mm_shuffle_ps(p_a, p_b, _MM_SHUFFLE(0, 0, 1, 1)), _mm_shuffle_ps(p_b, p_c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+	*p_z = _mm_shuffle_ps(_mm_shuffle_ps(p_a, p_b, _MM_SHUFFLE(1, 1, 2, 2)), _mm_shuffle_ps(p_c, p_c, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+}
+
+static void transpose_points_out(__m128 p_x, __m128 p_y, __m128 p_z, __m128 *p_a, __m128 *p_b, __m128 *p_c)
+{
+	*p_a = _mm_shuffle_ps(_mm_shuffle_ps(p_x, p_y, _MM_SHUFFLE(0, 0, 0, 0)), _mm_shuffle_ps(p_z, p_x, _MM_SHUFFLE(1, 1, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+	*p_b = _mm_shuffle_ps(_mm_shuffle_ps(p_y, p_z, _MM_SHUFFLE(1, 1, 1, 1)), _mm_shuffle_ps(p_x, p_y, _MM_SHUFFLE(2, 2, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0));
+	*p_c = _mm_shuffle_ps(_mm_shuffle_ps(p_z, p_x, _MM_SHUFFLE(3, 3, 2, 2)), _mm_shuffle_ps(p_y, p_z, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+}
+
+// Returns how many points were done, the caller finishes the remainder
+static uint32 transform_batch_sse(matrix44 const* p_matrix, Vector3 const* p_in, Vector3 *p_out, uint32 p_count, bool p_translate)
+{
+	assert(sizeof(Vector3) == sizeof(real) * 3);
+
+	real const* m = p_matrix->m_data;
+	__m128 m00 = _mm_set1_ps(m[0]), m10 = _mm_set1_ps(m[1]), m20 = _mm_set1_ps(m[2]);
+	__m128 m01 = _mm_set1_ps(m[4]), m11 = _mm_set1_ps(m[5]), m21 = _mm_set1_ps(m[6]);
+	__m128 m02 = _mm_set1_ps(m[8]), m12 = _mm_set1_ps(m[9]), m22 = _mm_set1_ps(m[10]);
+	__m128 m03 = _mm_setzero_ps(), m13 = _mm_setzero_ps(), m23 = _mm_setzero_ps();
+	if (p_translate) {
+		m03 = _mm_set1_ps(m[12]);
+		m13 = _mm_set1_ps(m[13]);
+		m23 = _mm_set1_ps(m[14]);
+	}
+
+	uint32 i = 0;
+
+#if defined(MATH_AVX)
+	// Two groups of four per pass, transposed with SSE and combined into one wide register each
+	__m256 w00 = _mm256_set1_ps(m[0]), w10 = _mm256_set1_ps(m[1]), w20 = _mm256_set1_ps(m[2]);
+	__m256 w01 = _mm256_set1_ps(m[4]), w11 = _mm256_set1_ps(m[5]), w21 = _mm256_set1_ps(m[6]);
+	__m256 w02 = _mm256_set1_ps(m[8]), w12 = _mm256_set1_ps(m[9]), w22 = _mm256_set1_ps(m[10]);
+	__m256 w03 = _mm256_insertf128_ps(_mm256_castps128_ps256(m03), m03, 1);
+	__m256 w13 = _mm256_insertf128_ps(_mm256_castps128_ps256(m13), m13, 1);
+	__m256 w23 = _mm256_insertf128_ps(_mm256_castps128_ps256(m23), m23, 1);
+
+	for (; i + 8 <= p_count; i += 8) {
+		real const* src = p_in[i].m_data;
+		__m128 x0, y0, z0, x1, y1, z1;
+		transpose_points_in(_mm_loadu_ps(src), _mm_loadu_ps(src + 4), _mm_loadu_ps(src + 8), &x0, &y0, &z0);
+		transpose_points_in(_mm_loadu_ps(src + 12), _mm_loadu_ps(src + 16), _mm_loadu_ps(src + 20), &x1, &y1, &z1);
+
+		__m256 x = _mm256_insertf128_ps(_mm256_castps128_ps256(x0), x1, 1);
+		__m256 y = _mm256_insertf128_ps(_mm256_castps128_ps256(y0), y1, 1);
+		__m256 z = _mm256_insertf128_ps(_mm256_castps128_ps256(z0), z1, 1);
+
+		__m256 ox = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, w00), _mm256_mul_ps(y, w01)), _mm256_add_ps(_mm256_mul_ps(z, w02), w03));
+		__m256 oy = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, w10), _mm256_mul_ps(y, w11)), _mm256_add_ps(_mm256_mul_ps(z, w12), w13));
+		__m256 oz = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, w20), _mm256_mul_ps(y, w21)), _mm256_add_ps(_mm256_mul_ps(z, w22), w23));
+
+		real *dst = p_out[i].m_data;
+		__m128 a, b, c;
+		transpose_points_out(_mm256_castps256_ps128(ox), _mm256_castps256_ps128(oy), _mm256_castps256_ps128(oz), &a, &b, &c);
+		_mm_storeu_ps(dst, a);
+		_mm_storeu_ps(dst + 4, b);
+		_mm_storeu_ps(dst + 8, c);
+		transpose_points_out(_mm256_extractf128_ps(ox, 1), _mm256_extractf128_ps(oy, 1), _mm256_extractf128_ps(oz, 1), &a, &b, &c);
+		_mm_storeu_ps(dst + 12, a);
+		_mm_storeu_ps(dst + 16, b);
+		_mm_storeu_ps(dst + 20, c);
+	}
+#endif
+
+	for (; i + 4 <= p_count; i += 4) {
+		real const* src = p_in[i].m_data;
+		__m128 x, y, z;
+		transpose_points_in(_mm_loadu_ps(src), _mm_loadu_ps(src + 4), _mm_loadu_ps(src + 8), &x, &y, &z);
+
+		__m128 ox = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m00), _mm_mul_ps(y, m01)), _mm_add_ps(_mm_mul_ps(z, m02), m03));
+		__m128 oy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m10), _mm_mul_ps(y, m11)), _mm_add_ps(_mm_mul_ps(z, m12), m13));
+		__m128 oz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m20), _mm_mul_ps(y, m21)), _mm_add_ps(_mm_mul_ps(z, m22), m23));
+
+		// All twelve inputs are in registers already, so writing over them is fine
+		real *dst = p_out[i].m_data;
+		__m128 a, b, c;
+		transpose_points_out(ox, oy, oz, &a, &b, &c);
+		_mm_storeu_ps(dst, a);
+		_mm_storeu_ps(dst + 4, b);
+		_mm_storeu_ps(dst + 8, c);
+	}
+
+	return i;
+}
+#endif
+
+Vector3 matrix44::operator*(Vector3 const& val) const
+{
+	Vector3 out;
+
+#if defined(MATH_SSE)
+	__m128 col = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&m_data[0]), _mm_set1_ps(val.m_data[0])), _mm_loadu_ps(&m_data[12]));
+	col = _mm_add_ps(col, _mm_mul_ps(_mm_loadu_ps(&m_data[4]), _mm_set1_ps(val.m_data[1])));
+	col = _mm_add_ps(col, _mm_mul_ps(_mm_loadu_ps(&m_data[8]), _mm_set1_ps(val.m_data[2])));
+
+	MATH_ALIGN(16) real result[4];
+	_mm_store_ps(result, col);
+	out.set(result[0], result[1], result[2]);
+#else
+	transform_point_scalar(this, val, &out);
+#endif
+
+	return out;
+}
+
+vector4 matrix44::operator*(vector4 const& val) const
+{
+	vector4 out;
+
+#if defined(MATH_SSE)
+	__m128 col = _mm_mul_ps(_mm_loadu_ps(&m_data[0]), _mm_set1_ps(val.m_data[0]));
+	col = _mm_add_ps(col, _mm_mul_ps(_mm_loadu_ps(&m_data[4]), _mm_set1_ps(val.m_data[1])));
+	col = _mm_add_ps(col, _mm_mul_ps(_mm_loadu_ps(&m_data[8]), _mm_set1_ps(val.m_data[2])));
+	col = _mm_add_ps(col, _mm_mul_ps(_mm_loadu_ps(&m_data[12]), _mm_set1_ps(val.m_data[3])));
+	_mm_storeu_ps(out.m_data, col);
+#else
+	for (uint32 r = 0; r < 4; ++r) {
+		out.m_data[r] = (val.m_data[0] * m_data[r]) + (val.m_data[1] * m_data[4 + r]) + (val.m_data[2] * m_data[8 + r]) + (val.m_data[3] * m_data[12 + r]);
+	}
+#endif
+
+	return out;
+}
+
+matrix44 matrix44::operator*(matrix44 const& _m) const
+{
+	matrix44 result;
+
+#if defined(MATH_SSE)
+	multiply_sse(this, &_m, &result);
+#else
+	multiply_scalar(this, &_m, &result);
+#endif
+
+	return result;
+}
+
+matrix44 matrix44::inverse() const
+{
+	matrix44 kInv;
+
+#if defined(MATH_SSE)
+	inverse_sse(this, &kInv);
+#else
+	inverse_scalar(m_data, &kInv);
+#endif
+
 	return kInv;
 }
 
@@ -184,4 +415,90 @@ void matrix44::set_translation(Vector3 const& p_val)
 	_03 = p_val.m_data[0];
 	_13 = p_val.m_data[1];
 	_23 = p_val.m_data[2];
+}
+
+void matrix44_transform_points(matrix44 const* p_matrix, Vector3 const* p_in, Vector3 *p_out, uint32 p_count)
+{
+	uint32 i = 0;
+
+#if defined(MATH_SSE)
+	i = transform_batch_sse(p_matrix, p_in, p_out, p_count, true);
+#endif
+
+	for (; i < p_count; ++i) {
+		transform_point_scalar(p_matrix, p_in[i], &p_out[i]);
+	}
+}
+
+void matrix44_transform_directions(matrix44 const* p_matrix, Vector3 const* p_in, Vector3 *p_out, uint32 p_count)
+{
+	uint32 i = 0;
+
+#if defined(MATH_SSE)
+	i = transform_batch_sse(p_matrix, p_in, p_out, p_count, false);
+#endif
+
+	for (; i < p_count; ++i) {
+		transform_direction_scalar(p_matrix, p_in[i], &p_out[i]);
+	}
+}
+
+static void print_benchmark(char const* p_name, uint32 p_scalar_ms, uint32 p_simd_ms, uint32 p_operations)
+{
+	char buffer[256];
+	sprintf(buffer, "math: %-10s scalar %5u ms  simd %5u ms  %.1f M/s vs %.1f M/s\n", p_name, p_scalar_ms, p_simd_ms,
+		(p_scalar_ms > 0) ? p_operations / (p_scalar_ms * 1000.0f) : 0.0f, (p_simd_ms > 0) ? p_operations / (p_simd_ms * 1000.0f) : 0.0f);
+#ifdef _WIN32
+	OutputDebugStringA(buffer);
+#else
+	fputs(buffer, stdout);
+#endif
+}
+
+void matrix44_benchmark(uint32 p_count, uint32 p_iterations)
+{
+	Vector3 *points = (Vector3 *)MEMORY_ALLOC(sizeof(Vector3) * p_count, MEMORY_TAG_GENERAL);
+	assert(points != NULL);
+	for (uint32 i = 0; i < p_count; ++i) {
+		points[i].set((real)(i % 97), (real)(i % 89), (real)(i % 83));
+	}
+
+	matrix44 matrix;
+	matrix.set_identity();
+	matrix._01 = 0.5f;
+	matrix._12 = 0.25f;
+	matrix.set_translation(Vector3(1.0f, 2.0f, 3.0f));
+
+	// In place each pass, the same as the importer does
+	uint32 start = SDL_GetTicks();
+	for (uint32 n = 0; n < p_iterations; ++n) {
+		for (uint32 i = 0; i < p_count; ++i) {
+			transform_point_scalar(&matrix, points[i], &points[i]);
+		}
+	}
+	uint32 scalar_ms = SDL_GetTicks() - start;
+
+	start = SDL_GetTicks();
+	for (uint32 n = 0; n < p_iterations; ++n) {
+		matrix44_transform_points(&matrix, points, points, p_count);
+	}
+	print_benchmark("points", scalar_ms, SDL_GetTicks() - start, p_count * p_iterations);
+
+	// Chained so neither loop can be folded away
+	matrix44 result = matrix;
+	start = SDL_GetTicks();
+	for (uint32 n = 0; n < p_count * p_iterations / 16; ++n) {
+		matrix44 tmp;
+		multiply_scalar(&result, &matrix, &tmp);
+		inverse_scalar(tmp.m_data, &result);
+	}
+	scalar_ms = SDL_GetTicks() - start;
+
+	start = SDL_GetTicks();
+	for (uint32 n = 0; n < p_count * p_iterations / 16; ++n) {
+		result = (result * matrix).inverse();
+	}
+	print_benchmark("mul+inv", scalar_ms, SDL_GetTicks() - start, p_count * p_iterations / 16);
+
+	MEMORY_FREE(points);
 }
\ No newline at end of file
@@ -1,9 +1,12 @@
 #ifndef __MATRIX_H_
 #define __MATRIX_H_
 
-#include "vector3.h"
+#include "vector4.h"
 
-class matrix44
+// Print scalar against SIMD throughput for the matrix kernels at startup
+//#define MATH_BENCHMARK
+
+class MATH_ALIGN(16) matrix44
 {
 public:
 	union {
@@ -34,6 +37,7 @@ public:
 	void set_identity();
 	
 	Vector3 operator*(Vector3 const& val) const;
+	vector4 operator*(vector4 const& val) const;
 	matrix44 operator*(matrix44 const& val) const;
 
 	void set_translation(Vector3 const& p_val);
@@ -42,5 +46,13 @@ public:
 	matrix44 inverse() const;
 };
 
+// Batch versions of operator*(Vector3) for whole vertex arrays, p_out may be p_in.
+// Points pick up the translation, directions don't.
+void matrix44_transform_points(matrix44 const* p_matrix, Vector3 const* p_in, Vector3 *p_out, uint32 p_count);
+void matrix44_transform_directions(matrix44 const* p_matrix, Vector3 const* p_in, Vector3 *p_out, uint32 p_count);
+
+// Time p_iterations passes of the scalar and SIMD kernels over p_count points and print both
+void matrix44_benchmark(uint32 p_count, uint32 p_iterations);
+
 #endif // __MATRIX_H_
 
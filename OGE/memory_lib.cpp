@@ -0,0 +1,435 @@
+#include "memory_lib.h"
+
+#include "assert.h"
+
+#include "SDL.h"
+#include "SDL_thread.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <malloc.h>
+#endif
+
+#define MEMORY_HEADER_MAGIC (0x6d656d21)
+#define MEMORY_HEADER_MAGIC_FREED (0x66726565)
+
+#define MEMORY_FRAME_ALIGNMENT (16)
+
+// Tracked blocks are 16 byte aligned too, matrix44 and vector4 arrays live in them. The 64 bit CRTs already
+// give that from malloc, the 32 bit MSVC one only promises 8 so it goes through the aligned heap instead.
+#ifdef _WIN32
+#define memory_block_malloc(size) _aligned_malloc((size), MEMORY_FRAME_ALIGNMENT)
+#define memory_block_realloc(ptr, size) _aligned_realloc((ptr), (size), MEMORY_FRAME_ALIGNMENT)
+#define memory_block_free(ptr) _aligned_free(ptr)
+#else
+#define memory_block_malloc(size) malloc(size)
+#define memory_block_realloc(ptr, size) realloc((ptr), (size))
+#define memory_block_free(ptr) free(ptr)
+#endif
+
+// Distinct sites folded together in the leak report, the rest are summed into one line
+#define MEMORY_LEAK_SITES_MAX (256)
+
+// Sits in front of every tracked block, padded so the user pointer keeps the block's alignment
+class memory_header
+{
+public:
+#ifdef MEMORY_DEBUG
+	memory_header *m_prev;
+	memory_header *m_next;
+	char const* m_file;
+	uint32 m_line;
+#endif
+	size_t m_size;
+	memory_tag m_tag;
+	uint32 m_magic;
+};
+
+#define MEMORY_HEADER_SIZE ((sizeof(memory_header) + 15) & ~15)
+
+static char const* g_memory_tag_names[MEMORY_TAG_COUNT] = {
+	"general",
+	"geometry",
+	"texture",
+	"physics",
+	"scene",
+	"fcollada",
+};
+
+static memory_tag_stats g_memory_tag_stats[MEMORY_TAG_COUNT];
+static SDL_mutex *g_memory_lock = NULL;
+
+#ifdef MEMORY_DEBUG
+static memory_header *g_memory_blocks = NULL;
+#endif
+
+static uint8 *g_frame_arena_memory = NULL;
+static uint8 *g_frame_arena = NULL;
+static void *g_frame_overflow = NULL;
+static memory_frame_stats g_frame_stats;
+
+static void memory_output(char const* p_string)
+{
+#ifdef _WIN32
+	OutputDebugStringA(p_string);
+#else
+	fputs(p_string, stderr);
+#endif
+}
+
+// The lock only exists between init and shutdown, anything outside that is single threaded
+static void memory_lock()
+{
+	if (g_memory_lock) {
+		SDL_mutexP(g_memory_lock);
+	}
+}
+
+static void memory_unlock()
+{
+	if (g_memory_lock) {
+		SDL_mutexV(g_memory_lock);
+	}
+}
+
+static void memory_track(memory_header *p_header)
+{
+	memory_tag_stats &stats = g_memory_tag_stats[p_header->m_tag];
+	stats.m_bytes += p_header->m_size;
+	if (stats.m_bytes > stats.m_bytes_peak) {
+		stats.m_bytes_peak = stats.m_bytes;
+	}
+	stats.m_allocations++;
+	stats.m_allocations_total++;
+
+#ifdef MEMORY_DEBUG
+	p_header->m_prev = NULL;
+	p_header->m_next = g_memory_blocks;
+	if (g_memory_blocks) {
+		g_memory_blocks->m_prev = p_header;
+	}
+	g_memory_blocks = p_header;
+#endif
+}
+
+static void memory_untrack(memory_header *p_header)
+{
+	memory_tag_stats &stats = g_memory_tag_stats[p_header->m_tag];
+	stats.m_bytes -= p_header->m_size;
+	stats.m_allocations--;
+
+#ifdef MEMORY_DEBUG
+	if (p_header->m_prev) {
+		p_header->m_prev->m_next = p_header->m_next;
+	} else {
+		g_memory_blocks = p_header->m_next;
+	}
+
+	if (p_header->m_next) {
+		p_header->m_next->m_prev = p_header->m_prev;
+	}
+#endif
+}
+
+// malloc only promises 8 bytes on some targets
+static uint8 *align_frame_pointer(uint8 *p_ptr)
+{
+	return (uint8 *)(((size_t)p_ptr + MEMORY_FRAME_ALIGNMENT - 1) & ~(size_t)(MEMORY_FRAME_ALIGNMENT - 1));
+}
+
+static memory_header *get_header(void *p_ptr)
+{
+	memory_header *header = (memory_header *)((uint8 *)p_ptr - MEMORY_HEADER_SIZE);
+	assert(header->m_magic == MEMORY_HEADER_MAGIC);
+	return header;
+}
+
+bool memory_lib_init(size_t p_frame_arena_size)
+{
+	g_memory_lock = SDL_CreateMutex();
+	if (g_memory_lock == NULL) {
+		return false;
+	}
+
+	g_frame_arena_memory = (uint8 *)malloc(p_frame_arena_size + MEMORY_FRAME_ALIGNMENT);
+	if (g_frame_arena_memory == NULL) {
+		SDL_DestroyMutex(g_memory_lock);
+		g_memory_lock = NULL;
+		return false;
+	}
+	g_frame_arena = align_frame_pointer(g_frame_arena_memory);
+
+	g_frame_overflow = NULL;
+	memset(&g_frame_stats, 0, sizeof(g_frame_stats));
+	g_frame_stats.m_size = p_frame_arena_size;
+
+	return true;
+}
+
+void memory_lib_shutdown()
+{
+	memory_print_stats();
+
+	memory_frame_reset();
+	free(g_frame_arena_memory);
+	g_frame_arena_memory = NULL;
+	g_frame_arena = NULL;
+	g_frame_stats.m_size = 0;
+
+#ifdef MEMORY_DEBUG
+	// Fold the live blocks by site so a leak in a loop shows up as one line
+	class leak_site
+	{
+	public:
+		char const* m_file;
+		uint32 m_line;
+		memory_tag m_tag;
+		uint32 m_count;
+		size_t m_bytes;
+	};
+
+	static leak_site sites[MEMORY_LEAK_SITES_MAX];
+	uint32 site_count = 0;
+	uint32 other_count = 0;
+	size_t other_bytes = 0;
+
+	memory_lock();
+
+	for (memory_header *header = g_memory_blocks; header != NULL; header = header->m_next) {
+		uint32 i = 0;
+		while (i < site_count && (sites[i].m_line != header->m_line || sites[i].m_tag != header->m_tag || strcmp(sites[i].m_file, header->m_file) != 0)) {
+			++i;
+		}
+
+		if (i == site_count) {
+			if (site_count == MEMORY_LEAK_SITES_MAX) {
+				other_count++;
+				other_bytes += header->m_size;
+				continue;
+			}
+
+			sites[i].m_file = header->m_file;
+			sites[i].m_line = header->m_line;
+			sites[i].m_tag = header->m_tag;
+			sites[i].m_count = 0;
+			sites[i].m_bytes = 0;
+			site_count++;
+		}
+
+		sites[i].m_count++;
+		sites[i].m_bytes += header->m_size;
+	}
+
+	memory_unlock();
+
+	char buffer[512];
+	if (site_count == 0) {
+		memory_output("memory: no leaks\n");
+	}
+
+	for (uint32 i = 0; i < site_count; ++i) {
+		sprintf(buffer, "memory leak: %s(%lu): %lu blocks, %lu bytes [%s]\n",
+			sites[i].m_file, sites[i].m_line, sites[i].m_count, (unsigned long)sites[i].m_bytes, g_memory_tag_names[sites[i].m_tag]);
+		memory_output(buffer);
+	}
+
+	if (other_count) {
+		sprintf(buffer, "memory leak: other sites: %lu blocks, %lu bytes\n", other_count, (unsigned long)other_bytes);
+		memory_output(buffer);
+	}
+#endif
+
+	if (g_memory_lock) {
+		SDL_DestroyMutex(g_memory_lock);
+		g_memory_lock = NULL;
+	}
+}
+
+void *memory_alloc(size_t p_size, memory_tag p_tag, char const* p_file, uint32 p_line)
+{
+	assert(p_tag < MEMORY_TAG_COUNT);
+
+	memory_header *header = (memory_header *)memory_block_malloc(MEMORY_HEADER_SIZE + p_size);
+	assert(header != NULL);
+	if (header == NULL) {
+		return NULL;
+	}
+
+	header->m_size = p_size;
+	header->m_tag = p_tag;
+	header->m_magic = MEMORY_HEADER_MAGIC;
+#ifdef MEMORY_DEBUG
+	header->m_file = p_file;
+	header->m_line = p_line;
+#endif
+
+	memory_lock();
+	memory_track(header);
+	memory_unlock();
+
+	return (uint8 *)header + MEMORY_HEADER_SIZE;
+}
+
+void *memory_calloc(size_t p_size, memory_tag p_tag, char const* p_file, uint32 p_line)
+{
+	void *ptr = memory_alloc(p_size, p_tag, p_file, p_line);
+	if (ptr) {
+		memset(ptr, 0, p_size);
+	}
+
+	return ptr;
+}
+
+void *memory_realloc(void *p_ptr, size_t p_size, memory_tag p_tag, char const* p_file, uint32 p_line)
+{
+	if (p_ptr == NULL) {
+		return memory_alloc(p_size, p_tag, p_file, p_line);
+	}
+
+	memory_header *header = get_header(p_ptr);
+
+	// Unlinked for the duration since realloc can move the block
+	memory_lock();
+	memory_untrack(header);
+	memory_unlock();
+
+	memory_header *moved = (memory_header *)memory_block_realloc(header, MEMORY_HEADER_SIZE + p_size);
+	assert(moved != NULL);
+	if (moved == NULL) {
+		memory_lock();
+		memory_track(header);
+		memory_unlock();
+		return NULL;
+	}
+
+	moved->m_size = p_size;
+	moved->m_tag = p_tag;
+#ifdef MEMORY_DEBUG
+	moved->m_file = p_file;
+	moved->m_line = p_line;
+#endif
+
+	memory_lock();
+	memory_track(moved);
+	memory_unlock();
+
+	return (uint8 *)moved + MEMORY_HEADER_SIZE;
+}
+
+void memory_free(void *p_ptr)
+{
+	if (p_ptr == NULL) {
+		return;
+	}
+
+	memory_header *header = get_header(p_ptr);
+
+	memory_lock();
+	memory_untrack(header);
+	memory_unlock();
+
+	// Catch double frees
+	header->m_magic = MEMORY_HEADER_MAGIC_FREED;
+	memory_block_free(header);
+}
+
+void *memory_frame_alloc(size_t p_size)
+{
+	p_size = (p_size + MEMORY_FRAME_ALIGNMENT - 1) & ~(size_t)(MEMORY_FRAME_ALIGNMENT - 1);
+
+	size_t offset = g_frame_stats.m_used;
+	g_frame_stats.m_used += p_size;
+	if (g_frame_stats.m_used > g_frame_stats.m_used_peak) {
+		g_frame_stats.m_used_peak = g_frame_stats.m_used;
+	}
+
+	if (g_frame_stats.m_used <= g_frame_stats.m_size) {
+		return g_frame_arena + offset;
+	}
+
+	// Out of arena, hand out a heap block for this frame and grow the arena on the next reset
+	g_frame_stats.m_overflows++;
+
+	uint8 *block = (uint8 *)malloc(MEMORY_FRAME_ALIGNMENT * 2 + p_size);
+	assert(block != NULL);
+	if (block == NULL) {
+		return NULL;
+	}
+
+	*(void **)block = g_frame_overflow;
+	g_frame_overflow = block;
+
+	return align_frame_pointer(block + sizeof(void *));
+}
+
+void memory_frame_reset()
+{
+	bool overflowed = (g_frame_overflow != NULL);
+
+	while (g_frame_overflow) {
+		void *next = *(void **)g_frame_overflow;
+		free(g_frame_overflow);
+		g_frame_overflow = next;
+	}
+
+	if (overflowed && g_frame_arena_memory) {
+		size_t size = (g_frame_stats.m_size > 0) ? g_frame_stats.m_size : MEMORY_FRAME_ALIGNMENT;
+		while (size < g_frame_stats.m_used_peak) {
+			size *= 2;
+		}
+
+		uint8 *arena = (uint8 *)malloc(size + MEMORY_FRAME_ALIGNMENT);
+		assert(arena != NULL);
+		if (arena) {
+			free(g_frame_arena_memory);
+			g_frame_arena_memory = arena;
+			g_frame_arena = align_frame_pointer(arena);
+			g_frame_stats.m_size = size;
+		}
+	}
+
+	g_frame_stats.m_used = 0;
+}
+
+memory_tag_stats const* memory_get_tag_stats(memory_tag p_tag)
+{
+	assert(p_tag < MEMORY_TAG_COUNT);
+	return &g_memory_tag_stats[p_tag];
+}
+
+memory_frame_stats const* memory_get_frame_stats()
+{
+	return &g_frame_stats;
+}
+
+char const* memory_get_tag_name(memory_tag p_tag)
+{
+	assert(p_tag < MEMORY_TAG_COUNT);
+	return g_memory_tag_names[p_tag];
+}
+
+void memory_print_stats()
+{
+	char buffer[256];
+
+	memory_lock();
+
+	for (memory_tag tag = 0; tag < MEMORY_TAG_COUNT; ++tag) {
+		memory_tag_stats const& stats = g_memory_tag_stats[tag];
+		sprintf(buffer, "memory %s: %lu KB (peak %lu KB) in %lu blocks, %lu allocations\n",
+			g_memory_tag_names[tag], (unsigned long)(stats.m_bytes / 1024), (unsigned long)(stats.m_bytes_peak / 1024),
+			stats.m_allocations, stats.m_allocations_total);
+		memory_output(buffer);
+	}
+
+	memory_unlock();
+
+	sprintf(buffer, "memory frame: %lu KB (peak %lu KB) of %lu KB, %lu overflows\n",
+		(unsigned long)(g_frame_stats.m_used / 1024), (unsigned long)(g_frame_stats.m_used_peak / 1024),
+		(unsigned long)(g_frame_stats.m_size / 1024), g_frame_stats.m_overflows);
+	memory_output(buffer);
+}
\ No newline at end of file
@@ -0,0 +1,83 @@
+#ifndef __MEMORY_LIB_H_
+#define __MEMORY_LIB_H_
+
+#include "core_types.h"
+
+#include <stddef.h>
+#include <new>
+
+typedef uint32 memory_tag;
+const memory_tag MEMORY_TAG_GENERAL = 0;
+const memory_tag MEMORY_TAG_GEOMETRY = 1;
+const memory_tag MEMORY_TAG_TEXTURE = 2;
+const memory_tag MEMORY_TAG_PHYSICS = 3;
+const memory_tag MEMORY_TAG_SCENE = 4;
+const memory_tag MEMORY_TAG_FCOLLADA = 5;
+const memory_tag MEMORY_TAG_COUNT = 6;
+
+#define MEMORY_FRAME_ARENA_SIZE_DEFAULT (4 * 1024 * 1024)
+
+class memory_tag_stats
+{
+public:
+	size_t m_bytes;
+	size_t m_bytes_peak;
+	uint32 m_allocations;
+	uint32 m_allocations_total;
+};
+
+class memory_frame_stats
+{
+public:
+	size_t m_size;
+	size_t m_used;
+	size_t m_used_peak;
+	uint32 m_overflows;
+};
+
+// Call before any threads are started, shutdown reports every block still allocated
+bool memory_lib_init(size_t p_frame_arena_size);
+void memory_lib_shutdown();
+
+// Thread safe. Blocks are tracked per tag and, with MEMORY_DEBUG, per allocation site.
+void *memory_alloc(size_t p_size, memory_tag p_tag, char const* p_file, uint32 p_line);
+void *memory_calloc(size_t p_size, memory_tag p_tag, char const* p_file, uint32 p_line);
+void *memory_realloc(void *p_ptr, size_t p_size, memory_tag p_tag, char const* p_file, uint32 p_line);
+void memory_free(void *p_ptr);
+
+#define MEMORY_ALLOC(size, tag) memory_alloc((size), (tag), __FILE__, __LINE__)
+#define MEMORY_CALLOC(size, tag) memory_calloc((size), (tag), __FILE__, __LINE__)
+#define MEMORY_REALLOC(ptr, size, tag) memory_realloc((ptr), (size), (tag), __FILE__, __LINE__)
+#define MEMORY_FREE(ptr) memory_free(ptr)
+
+// Replacements for new and delete that go through the tracked heap
+template <class T>
+T *memory_new(memory_tag p_tag, char const* p_file, uint32 p_line)
+{
+	return new(memory_alloc(sizeof(T), p_tag, p_file, p_line)) T;
+}
+
+template <class T>
+void memory_delete(T *p_object)
+{
+	if (p_object != NULL) {
+		p_object->~T();
+		memory_free(p_object);
+	}
+}
+
+#define MEMORY_NEW(type, tag) memory_new<type>((tag), __FILE__, __LINE__)
+#define MEMORY_DELETE(ptr) memory_delete(ptr)
+
+// Linear arena for data that only lives until the end of the frame, main thread only.
+// Allocations are 16 byte aligned and never freed individually.
+void *memory_frame_alloc(size_t p_size);
+void memory_frame_reset();
+
+memory_tag_stats const* memory_get_tag_stats(memory_tag p_tag);
+memory_frame_stats const* memory_get_frame_stats();
+char const* memory_get_tag_name(memory_tag p_tag);
+
+void memory_print_stats();
+
+#endif /* __MEMORY_LIB_H_ */
\ No newline at end of file
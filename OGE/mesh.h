@@ -8,8 +8,17 @@
 class mesh
 {
 public:
+	mesh()
+	{
+		m_render_blocks = NULL;
+		m_render_block_count = 0;
+		m_load_failed = false;
+	}
+
 	render_block *m_render_blocks;
 	unsigned long m_render_block_count;
+	// Set on an async mesh whose load failed, it never gets any blocks
+	bool m_load_failed;
 	// Material..  (or part of instance?)
 
 	mesh_meta_data m_meta_data;
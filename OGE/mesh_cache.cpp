@@ -0,0 +1,373 @@
+#include "mesh_cache.h"
+
+#include "mesh.h"
+#include "material.h"
+#include "render_lib.h"
+#include "assert.h"
+#include "mapped_file.h"
+#include "hash.h"
+#include "memory_lib.h"
+#include "profiler.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#define MESH_CACHE_MAGIC (0x4d45474f) // "OGEM"
+#define MESH_CACHE_ALIGNMENT (16)
+#define MESH_CACHE_PATH_LENGTH (256)
+
+// Everything is written in native layout, these catch a blob cooked by a different build
+class mesh_cache_header
+{
+public:
+	uint32 m_magic;
+	uint32 m_version;
+	uint32 m_index_size;
+	uint32 m_vector_size;
+
+	uint64 m_source_time;
+	uint64 m_cook_time;
+	uint32 m_source_size;
+	uint32 m_source_crc;
+
+	uint32 m_render_block_count;
+	uint32 m_meta_data_count;
+	uint32 m_total_size;
+	uint32 m_pad;
+};
+
+class mesh_cache_material
+{
+public:
+	char m_material_name[MAX_MATERIAL_NAME_LENGTH];
+	char m_texture_name[MAX_TEXTURE_NAME_LENGTH];
+	real32 m_color_ambient[4];
+	real32 m_color_diffuse[4];
+	real32 m_color_spec[4];
+};
+
+// Array offsets are from the start of the blob, zero when the block has no such array
+class mesh_cache_render_block
+{
+public:
+	uint32 m_format;
+	uint32 m_vertex_count;
+	uint32 m_index_count;
+	uint32 m_pos_offset;
+	uint32 m_normal_offset;
+	uint32 m_uv_offset;
+	uint32 m_index_offset;
+	uint32 m_pad;
+
+	real32 m_transform[16];
+	real32 m_bound_min[3];
+	real32 m_bound_max[3];
+	real32 m_bound_center[3];
+	real32 m_bound_radius;
+
+	mesh_cache_material m_material;
+};
+
+class mesh_cache_meta_data
+{
+public:
+	char m_name[MAX_META_NAME_LENGTH];
+	real32 m_position[3];
+	real32 m_pad;
+};
+
+static bool get_file_crc(char const* p_path, uint32 *p_crc)
+{
+	FILE *fp = fopen(p_path, "rb");
+	if (fp == NULL) {
+		return false;
+	}
+
+	uint8 buffer[16384];
+	uint32 crc = 0;
+	size_t read;
+	while ((read = fread(buffer, 1, sizeof(buffer), fp)) > 0) {
+		crc = hash_crc32(crc, buffer, (uint32)read);
+	}
+
+	fclose(fp);
+
+	*p_crc = crc;
+	return true;
+}
+
+static void get_cooked_path(char const* p_source_path, char p_path[MESH_CACHE_PATH_LENGTH])
+{
+	assert(strlen(p_source_path) + strlen(MESH_CACHE_EXTENSION) < MESH_CACHE_PATH_LENGTH);
+	sprintf(p_path, "%s%s", p_source_path, MESH_CACHE_EXTENSION);
+}
+
+static uint32 align_offset(uint32 p_offset)
+{
+	return (p_offset + MESH_CACHE_ALIGNMENT - 1) & ~(MESH_CACHE_ALIGNMENT - 1);
+}
+
+static bool is_array_valid(uint32 p_offset, uint32 p_size, uint32 p_total_size)
+{
+	if (p_offset == 0) {
+		return true;
+	}
+
+	return (p_offset % MESH_CACHE_ALIGNMENT) == 0 && p_offset <= p_total_size && p_size <= p_total_size - p_offset;
+}
+
+// Cheap checks first, the CRC is only read when the timestamp moved without the size changing
+static bool is_header_current(mesh_cache_header const* p_header, char const* p_source_path)
+{
+	if (p_header->m_magic != MESH_CACHE_MAGIC
+		|| p_header->m_version != MESH_CACHE_VERSION
+		|| p_header->m_index_size != sizeof(unsigned long)
+		|| p_header->m_vector_size != sizeof(Vector3)) {
+		return false;
+	}
+
+	// Shipping without the sources is fine, the blob is all there is
+	struct stat st;
+	if (stat(p_source_path, &st) != 0) {
+		return true;
+	}
+
+	if ((uint32)st.st_size != p_header->m_source_size) {
+		return false;
+	}
+
+	// Timestamps only have second resolution, a source saved in the same second it was cooked needs the CRC
+	if ((uint64)st.st_mtime == p_header->m_source_time && p_header->m_source_time < p_header->m_cook_time) {
+		return true;
+	}
+
+	uint32 crc;
+	return get_file_crc(p_source_path, &crc) && crc == p_header->m_source_crc;
+}
+
+static material *load_material(mesh_cache_material const* p_material)
+{
+	material *render_mat = material_create((char *)p_material->m_material_name);
+	assert(render_mat != NULL);
+
+	if (render_mat->m_texture == NULL) {
+		memcpy(render_mat->m_color_ambient, p_material->m_color_ambient, sizeof(render_mat->m_color_ambient));
+		memcpy(render_mat->m_color_diffuse, p_material->m_color_diffuse, sizeof(render_mat->m_color_diffuse));
+		memcpy(render_mat->m_color_spec, p_material->m_color_spec, sizeof(render_mat->m_color_spec));
+		render_mat->m_shader = render_lib_get_default_shader();
+
+		if (p_material->m_texture_name[0] != '\0') {
+			material_load(render_mat, (char *)p_material->m_texture_name);
+		}
+	}
+
+	return render_mat;
+}
+
+mesh *mesh_cache_load(char const* p_source_path)
+{
+	PROFILE_SCOPE("mesh_cache_load");
+
+	char path[MESH_CACHE_PATH_LENGTH];
+	get_cooked_path(p_source_path, path);
+
+	// Copy on write so simulations can still scribble over the positions, stays mapped for the life of the mesh
+	uint32 size = 0;
+	uint8 *data = mapped_file_open(path, true, &size);
+	if (data == NULL) {
+		return NULL;
+	}
+
+	mesh_cache_header const* header = (mesh_cache_header const*)data;
+	uint32 tables_size = sizeof(mesh_cache_header);
+	if (size >= sizeof(mesh_cache_header)) {
+		tables_size += sizeof(mesh_cache_render_block) * header->m_render_block_count + sizeof(mesh_cache_meta_data) * header->m_meta_data_count;
+	}
+
+	if (size < tables_size || header->m_total_size != size || is_header_current(header, p_source_path) == false) {
+		mapped_file_close(data, size);
+		return NULL;
+	}
+
+	mesh_cache_render_block const* blocks = (mesh_cache_render_block const*)(header + 1);
+	for (uint32 i = 0; i < header->m_render_block_count; ++i) {
+		mesh_cache_render_block const& cb = blocks[i];
+		uint32 vector_size = sizeof(Vector3) * cb.m_vertex_count;
+		if (is_array_valid(cb.m_pos_offset, vector_size, size) == false
+			|| is_array_valid(cb.m_normal_offset, vector_size, size) == false
+			|| is_array_valid(cb.m_uv_offset, sizeof(uv_coord) * cb.m_vertex_count, size) == false
+			|| is_array_valid(cb.m_index_offset, sizeof(unsigned long) * cb.m_index_count, size) == false) {
+			mapped_file_close(data, size);
+			return NULL;
+		}
+	}
+
+	mesh *mesh_ptr = MEMORY_NEW(mesh, MEMORY_TAG_GEOMETRY);
+	mesh_ptr->m_render_block_count = header->m_render_block_count;
+	mesh_ptr->m_render_blocks = (render_block *)MEMORY_ALLOC(sizeof(render_block) * header->m_render_block_count, MEMORY_TAG_GEOMETRY);
+
+	for (uint32 i = 0; i < header->m_render_block_count; ++i) {
+		mesh_cache_render_block const& cb = blocks[i];
+		render_block &rb = mesh_ptr->m_render_blocks[i];
+
+		rb.m_format = (mesh_format)cb.m_format;
+		rb.m_prepared = false;
+		rb.m_cpu_data_mapped = true;
+		rb.m_vertex_count = cb.m_vertex_count;
+		rb.m_index_count = cb.m_index_count;
+		rb.m_pos = cb.m_pos_offset ? (Vector3 *)(data + cb.m_pos_offset) : NULL;
+		rb.m_normal = cb.m_normal_offset ? (Vector3 *)(data + cb.m_normal_offset) : NULL;
+		rb.m_uv = cb.m_uv_offset ? (uv_coord *)(data + cb.m_uv_offset) : NULL;
+		rb.m_index_buffer = cb.m_index_offset ? (unsigned long *)(data + cb.m_index_offset) : NULL;
+
+		memcpy(rb.m_transform.m_data, cb.m_transform, sizeof(cb.m_transform));
+		rb.m_bound_min.set(cb.m_bound_min[0], cb.m_bound_min[1], cb.m_bound_min[2]);
+		rb.m_bound_max.set(cb.m_bound_max[0], cb.m_bound_max[1], cb.m_bound_max[2]);
+		rb.m_bound_center.set(cb.m_bound_center[0], cb.m_bound_center[1], cb.m_bound_center[2]);
+		rb.m_bound_radius = cb.m_bound_radius;
+
+		rb.m_material = load_material(&cb.m_material);
+	}
+
+	mesh_cache_meta_data const* meta = (mesh_cache_meta_data const*)(blocks + header->m_render_block_count);
+	for (uint32 i = 0; i < header->m_meta_data_count; ++i) {
+		char name[MAX_META_NAME_LENGTH];
+		memcpy(name, meta[i].m_name, MAX_META_NAME_LENGTH);
+		name[MAX_META_NAME_LENGTH - 1] = '\0';
+
+		Vector3 position(meta[i].m_position[0], meta[i].m_position[1], meta[i].m_position[2]);
+		mesh_ptr->m_meta_data.data_add(name, &position);
+	}
+
+	return mesh_ptr;
+}
+
+static uint32 add_array(uint32 *p_offset, void const* p_array, uint32 p_size)
+{
+	if (p_array == NULL || p_size == 0) {
+		return 0;
+	}
+
+	uint32 offset = align_offset(*p_offset);
+	*p_offset = offset + p_size;
+	return offset;
+}
+
+bool mesh_cache_save(char const* p_source_path, mesh const* p_mesh)
+{
+	struct stat st;
+	uint32 crc;
+	if (stat(p_source_path, &st) != 0 || get_file_crc(p_source_path, &crc) == false) {
+		return false;
+	}
+
+	uint32 block_count = p_mesh->m_render_block_count;
+	uint32 meta_count = p_mesh->m_meta_data.data_count();
+
+	mesh_cache_render_block *blocks = (mesh_cache_render_block *)MEMORY_CALLOC(sizeof(mesh_cache_render_block) * (block_count ? block_count : 1), MEMORY_TAG_GEOMETRY);
+	assert(blocks != NULL);
+
+	// Lay out every array after the tables
+	uint32 offset = sizeof(mesh_cache_header) + sizeof(mesh_cache_render_block) * block_count + sizeof(mesh_cache_meta_data) * meta_count;
+	for (uint32 i = 0; i < block_count; ++i) {
+		render_block const& rb = p_mesh->m_render_blocks[i];
+		mesh_cache_render_block &cb = blocks[i];
+
+		// Cooking after prepare() would lose the geometry
+		assert(rb.m_pos != NULL);
+
+		cb.m_format = (uint32)rb.m_format;
+		cb.m_vertex_count = rb.m_vertex_count;
+		cb.m_index_count = rb.m_index_count;
+		cb.m_pos_offset = add_array(&offset, rb.m_pos, sizeof(Vector3) * rb.m_vertex_count);
+		cb.m_normal_offset = add_array(&offset, rb.m_normal, sizeof(Vector3) * rb.m_vertex_count);
+		cb.m_uv_offset = add_array(&offset, rb.m_uv, sizeof(uv_coord) * rb.m_vertex_count);
+		cb.m_index_offset = add_array(&offset, rb.m_index_buffer, sizeof(unsigned long) * rb.m_index_count);
+
+		memcpy(cb.m_transform, rb.m_transform.m_data, sizeof(cb.m_transform));
+		memcpy(cb.m_bound_min, rb.m_bound_min.m_data, sizeof(cb.m_bound_min));
+		memcpy(cb.m_bound_max, rb.m_bound_max.m_data, sizeof(cb.m_bound_max));
+		memcpy(cb.m_bound_center, rb.m_bound_center.m_data, sizeof(cb.m_bound_center));
+		cb.m_bound_radius = rb.m_bound_radius;
+
+		material const* mat = rb.m_material;
+		if (mat) {
+			memcpy(cb.m_material.m_material_name, mat->m_material_name, MAX_MATERIAL_NAME_LENGTH);
+			memcpy(cb.m_material.m_texture_name, mat->m_texture_name, MAX_TEXTURE_NAME_LENGTH);
+			memcpy(cb.m_material.m_color_ambient, mat->m_color_ambient, sizeof(cb.m_material.m_color_ambient));
+			memcpy(cb.m_material.m_color_diffuse, mat->m_color_diffuse, sizeof(cb.m_material.m_color_diffuse));
+			memcpy(cb.m_material.m_color_spec, mat->m_color_spec, sizeof(cb.m_material.m_color_spec));
+		}
+	}
+
+	uint32 total_size = align_offset(offset);
+	uint8 *data = (uint8 *)MEMORY_CALLOC(total_size, MEMORY_TAG_GEOMETRY);
+	assert(data != NULL);
+
+	mesh_cache_header *header = (mesh_cache_header *)data;
+	header->m_magic = MESH_CACHE_MAGIC;
+	header->m_version = MESH_CACHE_VERSION;
+	header->m_index_size = sizeof(unsigned long);
+	header->m_vector_size = sizeof(Vector3);
+	header->m_source_time = (uint64)st.st_mtime;
+	header->m_cook_time = (uint64)time(NULL);
+	header->m_source_size = (uint32)st.st_size;
+	header->m_source_crc = crc;
+	header->m_render_block_count = block_count;
+	header->m_meta_data_count = meta_count;
+	header->m_total_size = total_size;
+
+	memcpy(header + 1, blocks, sizeof(mesh_cache_render_block) * block_count);
+
+	mesh_cache_meta_data *meta = (mesh_cache_meta_data *)(data + sizeof(mesh_cache_header) + sizeof(mesh_cache_render_block) * block_count);
+	for (mesh_meta_data::const_iterator it = p_mesh->m_meta_data.begin(); it != p_mesh->m_meta_data.end(); ++it, ++meta) {
+		strncpy(meta->m_name, it->first.c_str(), MAX_META_NAME_LENGTH - 1);
+		memcpy(meta->m_position, it->second.m_data, sizeof(meta->m_position));
+	}
+
+	for (uint32 i = 0; i < block_count; ++i) {
+		render_block const& rb = p_mesh->m_render_blocks[i];
+		mesh_cache_render_block const& cb = blocks[i];
+
+		if (cb.m_pos_offset) {
+			memcpy(data + cb.m_pos_offset, rb.m_pos, sizeof(Vector3) * rb.m_vertex_count);
+		}
+
+		if (cb.m_normal_offset) {
+			memcpy(data + cb.m_normal_offset, rb.m_normal, sizeof(Vector3) * rb.m_vertex_count);
+		}
+
+		if (cb.m_uv_offset) {
+			memcpy(data + cb.m_uv_offset, rb.m_uv, sizeof(uv_coord) * rb.m_vertex_count);
+		}
+
+		if (cb.m_index_offset) {
+			memcpy(data + cb.m_index_offset, rb.m_index_buffer, sizeof(unsigned long) * rb.m_index_count);
+		}
+	}
+
+	MEMORY_FREE(blocks);
+
+	char path[MESH_CACHE_PATH_LENGTH];
+	get_cooked_path(p_source_path, path);
+
+	bool ret = false;
+	FILE *fp = fopen(path, "wb");
+	if (fp != NULL) {
+		ret = (fwrite(data, 1, total_size, fp) == total_size);
+		fclose(fp);
+
+		// Never leave a truncated blob behind
+		if (ret == false) {
+			remove(path);
+		}
+	}
+
+	MEMORY_FREE(data);
+
+	return ret;
+}
\ No newline at end of file
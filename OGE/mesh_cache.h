@@ -0,0 +1,20 @@
+#ifndef __MESH_CACHE_H_
+#define __MESH_CACHE_H_
+
+#include "core_types.h"
+
+class mesh;
+
+// Bump whenever the cooked layout changes, older blobs are then recooked
+#define MESH_CACHE_VERSION (2)
+
+#define MESH_CACHE_EXTENSION ".cooked"
+
+// Map the cooked blob sitting next to p_source_path. Render block arrays point straight into the mapping.
+// Returns NULL if there is no blob or it no longer matches the source's size, timestamp and CRC.
+mesh *mesh_cache_load(char const* p_source_path);
+
+// Cook p_mesh for p_source_path, must be called before the render blocks are prepared and their CPU arrays freed
+bool mesh_cache_save(char const* p_source_path, mesh const* p_mesh);
+
+#endif /* __MESH_CACHE_H_ */
\ No newline at end of file
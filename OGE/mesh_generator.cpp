@@ -2,6 +2,7 @@
 
 #include "mesh.h"
 #include "vector3.h"
+#include "memory_lib.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -9,9 +10,9 @@
 // Create a mesh from a list of triangles
 mesh *mesh_generator_from_triangles(Vector3 const p_vectors[][3], unsigned long p_triangle_count)
 {
-	mesh *mesh_ptr = new mesh;
+	mesh *mesh_ptr = MEMORY_NEW(mesh, MEMORY_TAG_GEOMETRY);
 	mesh_ptr->m_render_block_count = 1;
-	mesh_ptr->m_render_blocks = (render_block *)malloc(sizeof(render_block));
+	mesh_ptr->m_render_blocks = (render_block *)MEMORY_ALLOC(sizeof(render_block), MEMORY_TAG_GEOMETRY);
 	render_block *render_block_ptr = &mesh_ptr->m_render_blocks[0];
 
 	render_block_ptr->m_format = RENDER_LIB_MESH_FORMAT_VA_TRIANGLES;
@@ -20,8 +21,10 @@ mesh *mesh_generator_from_triangles(Vector3 const p_vectors[][3], unsigned long
 	render_block_ptr->m_uv = NULL;
 	render_block_ptr->m_normal = NULL;
 	render_block_ptr->m_material = NULL;
-	render_block_ptr->m_pos = (Vector3 *)malloc(sizeof(Vector3) * render_block_ptr->m_vertex_count);
-	render_block_ptr->m_index_buffer = (unsigned long *)malloc(sizeof(unsigned long) * render_block_ptr->m_index_count);
+	render_block_ptr->m_prepared = false;
+	render_block_ptr->m_cpu_data_mapped = false;
+	render_block_ptr->m_pos = (Vector3 *)MEMORY_ALLOC(sizeof(Vector3) * render_block_ptr->m_vertex_count, MEMORY_TAG_GEOMETRY);
+	render_block_ptr->m_index_buffer = (unsigned long *)MEMORY_ALLOC(sizeof(unsigned long) * render_block_ptr->m_index_count, MEMORY_TAG_GEOMETRY);
 
 	unsigned long i;
 	for (i = 0; i < p_triangle_count; ++i) {
@@ -33,5 +36,7 @@ mesh *mesh_generator_from_triangles(Vector3 const p_vectors[][3], unsigned long
 		render_block_ptr->m_index_buffer[(i * 3) + 2] = (i * 3) + 2;
 	}
 
+	render_block_ptr->compute_bounds();
+
 	return mesh_ptr;
 }
\ No newline at end of file
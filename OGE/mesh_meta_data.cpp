@@ -14,4 +14,19 @@ Vector3 const *mesh_meta_data::data_get(char const* p_name)
 	}
 
 	return &(it->second);
+}
+
+uint32 mesh_meta_data::data_count() const
+{
+	return (uint32)m_data.size();
+}
+
+mesh_meta_data::const_iterator mesh_meta_data::begin() const
+{
+	return m_data.begin();
+}
+
+mesh_meta_data::const_iterator mesh_meta_data::end() const
+{
+	return m_data.end();
 }
\ No newline at end of file
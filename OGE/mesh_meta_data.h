@@ -12,10 +12,16 @@
 class mesh_meta_data
 {
 public:
+	typedef std::map<std::string, Vector3>::const_iterator const_iterator;
+
 	void data_add(char const* p_name, Vector3 const *p_position);
 	bool data_exists(char const* p_name);
 	Vector3 const *data_get(char const* p_name);
 
+	uint32 data_count() const;
+	const_iterator begin() const;
+	const_iterator end() const;
+
 private:
 	std::map<std::string, Vector3> m_data;
 };
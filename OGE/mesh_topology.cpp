@@ -0,0 +1,205 @@
+#include "mesh_topology.h"
+
+#include "assert.h"
+#include "memory_lib.h"
+
+#include <string.h>
+
+// One stable counting sort pass of p_order by p_keys
+static void counting_sort(uint32 const* p_keys, uint32 p_value_count, uint32 const* p_order, uint32 p_count, uint32 *p_counts, uint32 *p_sorted)
+{
+	memset(p_counts, 0, sizeof(uint32) * (p_value_count + 1));
+
+	for (uint32 i = 0; i < p_count; ++i) {
+		p_counts[p_keys[p_order[i]] + 1]++;
+	}
+
+	for (uint32 v = 0; v < p_value_count; ++v) {
+		p_counts[v + 1] += p_counts[v];
+	}
+
+	for (uint32 i = 0; i < p_count; ++i) {
+		p_sorted[p_counts[p_keys[p_order[i]]]++] = p_order[i];
+	}
+}
+
+void mesh_topology_sort_pairs(uint32 const* p_first, uint32 const* p_second, uint32 p_count, uint32 p_value_count, uint32 *p_order)
+{
+	uint32 *counts = (uint32 *)MEMORY_ALLOC(sizeof(uint32) * (p_value_count + 1), MEMORY_TAG_GEOMETRY);
+	uint32 *scratch = (uint32 *)MEMORY_ALLOC(sizeof(uint32) * (p_count ? p_count : 1), MEMORY_TAG_GEOMETRY);
+	assert(counts != NULL && scratch != NULL);
+
+	for (uint32 i = 0; i < p_count; ++i) {
+		scratch[i] = i;
+	}
+
+	// Least significant first, the stable second pass keeps the first pass's order within each key
+	counting_sort(p_second, p_value_count, scratch, p_count, counts, p_order);
+	counting_sort(p_first, p_value_count, p_order, p_count, counts, scratch);
+	memcpy(p_order, scratch, sizeof(uint32) * p_count);
+
+	MEMORY_FREE(scratch);
+	MEMORY_FREE(counts);
+}
+
+mesh_topology::mesh_topology()
+{
+	m_index_buffer = NULL;
+	m_face_count = 0;
+	m_vertex_count = 0;
+	m_edge_count = 0;
+	m_edge_start = NULL;
+	m_half_edges = NULL;
+	m_face_edges = NULL;
+	m_vertex_start = NULL;
+	m_vertex_faces = NULL;
+}
+
+mesh_topology::~mesh_topology()
+{
+	release();
+}
+
+void mesh_topology::release()
+{
+	MEMORY_FREE(m_edge_start);
+	MEMORY_FREE(m_half_edges);
+	MEMORY_FREE(m_face_edges);
+	MEMORY_FREE(m_vertex_start);
+	MEMORY_FREE(m_vertex_faces);
+
+	m_edge_start = NULL;
+	m_half_edges = NULL;
+	m_face_edges = NULL;
+	m_vertex_start = NULL;
+	m_vertex_faces = NULL;
+	m_edge_count = 0;
+	m_face_count = 0;
+}
+
+void mesh_topology::build(unsigned long const* p_index_buffer, uint32 p_index_count, uint32 p_vertex_count)
+{
+	release();
+
+	m_index_buffer = p_index_buffer;
+	m_face_count = p_index_count / 3;
+	m_vertex_count = p_vertex_count;
+
+	uint32 half_edge_count = m_face_count * 3;
+	uint32 *low = (uint32 *)MEMORY_ALLOC(sizeof(uint32) * (half_edge_count ? half_edge_count : 1), MEMORY_TAG_GEOMETRY);
+	uint32 *high = (uint32 *)MEMORY_ALLOC(sizeof(uint32) * (half_edge_count ? half_edge_count : 1), MEMORY_TAG_GEOMETRY);
+	uint32 *order = (uint32 *)MEMORY_ALLOC(sizeof(uint32) * (half_edge_count ? half_edge_count : 1), MEMORY_TAG_GEOMETRY);
+	assert(low != NULL && high != NULL && order != NULL);
+
+	for (uint32 i = 0; i < half_edge_count; ++i) {
+		uint32 face = i / 3;
+		uint32 a = p_index_buffer[i];
+		uint32 b = p_index_buffer[(face * 3) + ((i + 1) % 3)];
+		assert(a < p_vertex_count && b < p_vertex_count);
+
+		low[i] = (a < b) ? a : b;
+		high[i] = (a < b) ? b : a;
+	}
+
+	// Half edges of the same edge end up next to each other
+	mesh_topology_sort_pairs(low, high, half_edge_count, p_vertex_count, order);
+
+	m_half_edges = (mesh_topology_half_edge *)MEMORY_ALLOC(sizeof(mesh_topology_half_edge) * (half_edge_count ? half_edge_count : 1), MEMORY_TAG_GEOMETRY);
+	m_edge_start = (uint32 *)MEMORY_ALLOC(sizeof(uint32) * (half_edge_count + 1), MEMORY_TAG_GEOMETRY);
+	m_face_edges = (uint32 *)MEMORY_ALLOC(sizeof(uint32) * (half_edge_count ? half_edge_count : 1), MEMORY_TAG_GEOMETRY);
+	assert(m_half_edges != NULL && m_edge_start != NULL && m_face_edges != NULL);
+
+	m_edge_count = 0;
+	for (uint32 i = 0; i < half_edge_count; ++i) {
+		uint32 half_edge = order[i];
+		if (i == 0 || low[half_edge] != low[order[i - 1]] || high[half_edge] != high[order[i - 1]]) {
+			m_edge_start[m_edge_count++] = i;
+		}
+
+		m_half_edges[i].m_face = half_edge / 3;
+		m_half_edges[i].m_side = half_edge % 3;
+		m_face_edges[half_edge] = m_edge_count - 1;
+	}
+	m_edge_start[m_edge_count] = half_edge_count;
+
+	MEMORY_FREE(order);
+	MEMORY_FREE(high);
+	MEMORY_FREE(low);
+
+	// Vertex to face, a counting sort of the corners by vertex
+	m_vertex_start = (uint32 *)MEMORY_CALLOC(sizeof(uint32) * (p_vertex_count + 1), MEMORY_TAG_GEOMETRY);
+	m_vertex_faces = (uint32 *)MEMORY_ALLOC(sizeof(uint32) * (half_edge_count ? half_edge_count : 1), MEMORY_TAG_GEOMETRY);
+	assert(m_vertex_start != NULL && m_vertex_faces != NULL);
+
+	for (uint32 i = 0; i < half_edge_count; ++i) {
+		m_vertex_start[p_index_buffer[i] + 1]++;
+	}
+
+	for (uint32 v = 0; v < p_vertex_count; ++v) {
+		m_vertex_start[v + 1] += m_vertex_start[v];
+	}
+
+	for (uint32 i = 0; i < half_edge_count; ++i) {
+		m_vertex_faces[m_vertex_start[p_index_buffer[i]]++] = i / 3;
+	}
+
+	for (uint32 v = p_vertex_count; v > 0; --v) {
+		m_vertex_start[v] = m_vertex_start[v - 1];
+	}
+	m_vertex_start[0] = 0;
+}
+
+uint32 mesh_topology::get_face_count() const
+{
+	return m_face_count;
+}
+
+uint32 mesh_topology::get_edge_count() const
+{
+	return m_edge_count;
+}
+
+void mesh_topology::get_edge_vertices(uint32 p_edge, uint32 *p_vertex_a, uint32 *p_vertex_b) const
+{
+	mesh_topology_half_edge const& half_edge = m_half_edges[m_edge_start[p_edge]];
+	uint32 a = m_index_buffer[(half_edge.m_face * 3) + half_edge.m_side];
+	uint32 b = m_index_buffer[(half_edge.m_face * 3) + ((half_edge.m_side + 1) % 3)];
+
+	*p_vertex_a = (a < b) ? a : b;
+	*p_vertex_b = (a < b) ? b : a;
+}
+
+mesh_topology_half_edge const* mesh_topology::get_edge_half_edges(uint32 p_edge, uint32 *p_count) const
+{
+	*p_count = m_edge_start[p_edge + 1] - m_edge_start[p_edge];
+	return &m_half_edges[m_edge_start[p_edge]];
+}
+
+uint32 mesh_topology::get_face_edge(uint32 p_face, uint32 p_side) const
+{
+	return m_face_edges[(p_face * 3) + p_side];
+}
+
+uint32 mesh_topology::get_opposite_vertex(mesh_topology_half_edge const& p_half_edge) const
+{
+	return m_index_buffer[(p_half_edge.m_face * 3) + ((p_half_edge.m_side + 2) % 3)];
+}
+
+uint32 mesh_topology::get_adjacent_face(uint32 p_face, uint32 p_side) const
+{
+	uint32 count;
+	mesh_topology_half_edge const* half_edges = get_edge_half_edges(get_face_edge(p_face, p_side), &count);
+	for (uint32 i = 0; i < count; ++i) {
+		if (half_edges[i].m_face != p_face) {
+			return half_edges[i].m_face;
+		}
+	}
+
+	return MESH_TOPOLOGY_NONE;
+}
+
+uint32 const* mesh_topology::get_vertex_faces(uint32 p_vertex, uint32 *p_count) const
+{
+	*p_count = m_vertex_start[p_vertex + 1] - m_vertex_start[p_vertex];
+	return &m_vertex_faces[m_vertex_start[p_vertex]];
+}
\ No newline at end of file
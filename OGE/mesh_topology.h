@@ -0,0 +1,70 @@
+#ifndef __MESH_TOPOLOGY_H_
+#define __MESH_TOPOLOGY_H_
+
+#include "core_types.h"
+
+#define MESH_TOPOLOGY_NONE (0xffffffff)
+
+// One side of one triangle, side s runs from corner s to corner s + 1
+class mesh_topology_half_edge
+{
+public:
+	uint32 m_face;
+	uint32 m_side;
+};
+
+// Edge and vertex adjacency of an indexed triangle list. Built in linear time with counting sorts, so
+// edges come out ordered by their lower vertex and then their higher one.
+class mesh_topology
+{
+public:
+	mesh_topology();
+	~mesh_topology();
+
+	// The index buffer is read again by the queries, it has to outlive the topology
+	void build(unsigned long const* p_index_buffer, uint32 p_index_count, uint32 p_vertex_count);
+	void release();
+
+	uint32 get_face_count() const;
+	uint32 get_edge_count() const;
+
+	// Lower vertex first
+	void get_edge_vertices(uint32 p_edge, uint32 *p_vertex_a, uint32 *p_vertex_b) const;
+
+	// Every triangle side on the edge, two for an interior edge, one on a boundary, more if non manifold
+	mesh_topology_half_edge const* get_edge_half_edges(uint32 p_edge, uint32 *p_count) const;
+
+	uint32 get_face_edge(uint32 p_face, uint32 p_side) const;
+
+	// The corner of the face across from the side
+	uint32 get_opposite_vertex(mesh_topology_half_edge const& p_half_edge) const;
+
+	// The other face on the side's edge, MESH_TOPOLOGY_NONE on a boundary. Non manifold edges give the first other one.
+	uint32 get_adjacent_face(uint32 p_face, uint32 p_side) const;
+
+	// Faces using the vertex, in face order
+	uint32 const* get_vertex_faces(uint32 p_vertex, uint32 *p_count) const;
+
+private:
+	unsigned long const* m_index_buffer;
+	uint32 m_face_count;
+	uint32 m_vertex_count;
+
+	// Edge e owns m_half_edges[m_edge_start[e]] up to m_half_edges[m_edge_start[e + 1]]
+	uint32 m_edge_count;
+	uint32 *m_edge_start;
+	mesh_topology_half_edge *m_half_edges;
+
+	// Three per face
+	uint32 *m_face_edges;
+
+	// Vertex v is used by m_vertex_faces[m_vertex_start[v]] up to m_vertex_faces[m_vertex_start[v + 1]]
+	uint32 *m_vertex_start;
+	uint32 *m_vertex_faces;
+};
+
+// Stable order of p_count pairs sorted by first and then second value, both below p_value_count.
+// Two counting sort passes, the same ordering the topology's edges use.
+void mesh_topology_sort_pairs(uint32 const* p_first, uint32 const* p_second, uint32 p_count, uint32 p_value_count, uint32 *p_order);
+
+#endif /* __MESH_TOPOLOGY_H_ */
\ No newline at end of file
@@ -9,6 +9,8 @@
 #include "resource_manager.h"
 
 #include "render_lib.h"
+#include "memory_lib.h"
+#include "mesh_topology.h"
 
 #include "SDL_OpenGL.h"
 
@@ -23,163 +25,99 @@ void obj_cloth::simulate_post()
 
 }
 
-bool obj_cloth::get_unshared_verts(unsigned long p_face_index_a, unsigned long p_face_index_b, 
-											  unsigned long p_face_index_a_verts[3], unsigned long &p_face_a_count, 
-											  unsigned long p_face_index_b_verts[3], unsigned long &p_face_b_count)
+void obj_cloth::generate_constraints(unsigned long p_face_count)
 {
-	p_face_a_count = 0;
-	p_face_b_count = 0;
-
-	mesh const*mesh = m_mesh_instance->m_mesh;
-	render_block const* render_block_ptr = &mesh->m_render_blocks[0];
-
-	for (unsigned long i = 0; i < 3; i++) {
-		bool in_common = false;
-		for (unsigned long j = 0; j < 3; j++) {
-			if (render_block_ptr->m_index_buffer[(p_face_index_a * 3) + i] == render_block_ptr->m_index_buffer[(p_face_index_b * 3) + j]) {
-				in_common = true;
-				break;
-			}
-		}
-
-		if (in_common == false) {
-			p_face_index_a_verts[p_face_a_count++] = render_block_ptr->m_index_buffer[(p_face_index_a * 3) + i];
-		}
-	}
+	mesh const*mesh_ptr = m_mesh_instance->m_mesh;
+	render_block *render_block_ptr = &mesh_ptr->m_render_blocks[0];
 
-	for (unsigned long i = 0; i < 3; i++) {
-		bool in_common = false;
-		for (unsigned long j = 0; j < 3; j++) {
-			if (render_block_ptr->m_index_buffer[(p_face_index_a * 3) + j] == render_block_ptr->m_index_buffer[(p_face_index_b * 3) + i]) {
-				in_common = true;
-				break;
-			}
-		}
+	mesh_topology topology;
+	topology.build(render_block_ptr->m_index_buffer, render_block_ptr->m_index_count, render_block_ptr->m_vertex_count);
 
-		if (in_common == false) {
-			p_face_index_b_verts[p_face_b_count++] = render_block_ptr->m_index_buffer[(p_face_index_b * 3) + i];
-		}
+	// One stretch constraint per edge, and one between the far corners of every pair of faces sharing it,
+	// which resists shearing while the faces are flat and bending once they fold
+	unsigned long constraints_max = 1 + topology.get_edge_count();
+	for (uint32 edge = 0; edge < topology.get_edge_count(); ++edge) {
+		uint32 count;
+		topology.get_edge_half_edges(edge, &count);
+		constraints_max += (count * (count - 1)) / 2;
 	}
 
-	// If there are no unique verts then this is totally shared
-	if ((p_face_a_count == 0) && (p_face_b_count == 0)) {
-		return false;
-	}
+	constraint *constraints = (constraint *)MEMORY_ALLOC(sizeof(constraint) * constraints_max, MEMORY_TAG_PHYSICS);
+	unsigned long constraint_index = 0;
 
-	// If they are all unshared then there is nothing in common
-	if ((p_face_a_count == 3) && (p_face_b_count == 3)) {
-		return false;
-	}
+	constraints[constraint_index].m_constraint_type = constraint::CONSTRAINT_TYPE_FIXED;
+	constraints[constraint_index].m_particle_a_index = 0;
+	constraints[constraint_index].m_particle_b_index = 0;
+	constraints[constraint_index].m_fixed_pos = render_block_ptr->m_pos[0];
+	constraint_index++;
 
-	if (p_face_a_count == 1) {
-		return true;
-	}
+	Vector3 diff;
 
-	return false;
-}
+	for (uint32 edge = 0; edge < topology.get_edge_count(); ++edge) {
+		uint32 a;
+		uint32 b;
+		topology.get_edge_vertices(edge, &a, &b);
+
+		// Degenerate triangles give edges from a vertex to itself
+		if (a != b) {
+			constraints[constraint_index].m_constraint_type = constraint::CONSTRAINT_TYPE_RESTLENGTH;
+			constraints[constraint_index].m_particle_a_index = a;
+			constraints[constraint_index].m_particle_b_index = b;
+			diff = render_block_ptr->m_pos[a] - render_block_ptr->m_pos[b];
+			constraints[constraint_index].m_rest_length = diff.len();
+			constraint_index++;
+		}
 
-void obj_cloth::generate_constraints(unsigned long p_face_count)
-{
-	// Find all constraints
-	// First set is three for each triangle	
-	mesh const*mesh_ptr = m_mesh_instance->m_mesh;
-	render_block *render_block_ptr = &mesh_ptr->m_render_blocks[0];
-	m_constraint_count = render_block_ptr->m_index_count;
-
-	// Loop through each triangle and find all triangles that are adjacent
-	for (unsigned long i = 0; i < render_block_ptr->m_index_count; i += 3) {
-		// Find every face that shares a point with this triangle
-		for (unsigned long j = i; j < render_block_ptr->m_index_count; j+=3) {
-			unsigned long face_index_a_verts[3];
-			unsigned long face_index_b_verts[3];
-			unsigned long face_a_count;
-			unsigned long face_b_count;
-
-			if (get_unshared_verts(i / 3, j / 3, face_index_a_verts, face_a_count, face_index_b_verts, face_b_count)) {
-				// Create a constraint between all of these
-				for (unsigned long a_index = 0; a_index < face_a_count; a_index++) {
-					for (unsigned long b_index = 0; b_index < face_b_count; b_index++) {
-						m_constraint_count++;
-					}
+		uint32 count;
+		mesh_topology_half_edge const* half_edges = topology.get_edge_half_edges(edge, &count);
+		for (uint32 i = 0; i < count; ++i) {
+			for (uint32 j = i + 1; j < count; ++j) {
+				uint32 opposite_a = topology.get_opposite_vertex(half_edges[i]);
+				uint32 opposite_b = topology.get_opposite_vertex(half_edges[j]);
+				if (opposite_a == opposite_b) {
+					continue;
 				}
+
+				constraints[constraint_index].m_constraint_type = constraint::CONSTRAINT_TYPE_RESTLENGTH;
+				constraints[constraint_index].m_particle_a_index = (opposite_a < opposite_b) ? opposite_a : opposite_b;
+				constraints[constraint_index].m_particle_b_index = (opposite_a < opposite_b) ? opposite_b : opposite_a;
+				diff = render_block_ptr->m_pos[opposite_a] - render_block_ptr->m_pos[opposite_b];
+				constraints[constraint_index].m_rest_length = diff.len();
+				constraint_index++;
 			}
 		}
 	}
 
-	// Allocate constraint memory
-	m_constraint_count += 1;
-	m_constraints = (constraint *)malloc(sizeof(constraint) * m_constraint_count);
-	unsigned long constraint_index = 0;
+	m_constraint_count = constraint_index;
 
-	
-	m_constraints[constraint_index].m_constraint_type = constraint::CONSTRAINT_TYPE_FIXED;
-	m_constraints[constraint_index].m_particle_a_index = 0;
-	m_constraints[constraint_index].m_fixed_pos = render_block_ptr->m_pos[0];
-	m_fixed_constraint_index = constraint_index;
-	m_pos.set(0.0f, 0.0f, 0.0f);
-	constraint_index++;
-
-	Vector3 diff;
-
-	for (unsigned long i = 0; i < render_block_ptr->m_index_count; i += 3) {
-		m_constraints[constraint_index].m_constraint_type = constraint::CONSTRAINT_TYPE_RESTLENGTH;
-		m_constraints[constraint_index].m_particle_a_index = render_block_ptr->m_index_buffer[i];
-		m_constraints[constraint_index].m_particle_b_index = render_block_ptr->m_index_buffer[i + 1];
-		diff = render_block_ptr->m_pos[render_block_ptr->m_index_buffer[i]] - render_block_ptr->m_pos[render_block_ptr->m_index_buffer[i + 1]];
-		m_constraints[constraint_index].m_rest_length = diff.len();
-		constraint_index++;
-
-		m_constraints[constraint_index].m_constraint_type = constraint::CONSTRAINT_TYPE_RESTLENGTH;
-		m_constraints[constraint_index].m_particle_a_index = render_block_ptr->m_index_buffer[i + 1];
-		m_constraints[constraint_index].m_particle_b_index = render_block_ptr->m_index_buffer[i + 2];
-		diff = render_block_ptr->m_pos[render_block_ptr->m_index_buffer[i + 1]] - render_block_ptr->m_pos[render_block_ptr->m_index_buffer[i + 2]];
-		m_constraints[constraint_index].m_rest_length = diff.len();
-		constraint_index++;
-
-		m_constraints[constraint_index].m_constraint_type = constraint::CONSTRAINT_TYPE_RESTLENGTH;
-		m_constraints[constraint_index].m_particle_a_index = render_block_ptr->m_index_buffer[i + 2];
-		m_constraints[constraint_index].m_particle_b_index = render_block_ptr->m_index_buffer[i];
-		diff = render_block_ptr->m_pos[render_block_ptr->m_index_buffer[i + 2]] - render_block_ptr->m_pos[render_block_ptr->m_index_buffer[i]];
-		m_constraints[constraint_index].m_rest_length = diff.len();
-		constraint_index++;
+	// Ordered by particle so the solver walks the positions roughly front to back
+	uint32 *first = (uint32 *)MEMORY_ALLOC(sizeof(uint32) * m_constraint_count * 3, MEMORY_TAG_PHYSICS);
+	uint32 *second = first + m_constraint_count;
+	uint32 *order = second + m_constraint_count;
+	for (unsigned long i = 0; i < m_constraint_count; ++i) {
+		first[i] = constraints[i].m_particle_a_index;
+		second[i] = constraints[i].m_particle_b_index;
 	}
 
-	// Loop through each triangle and find all triangles that are adjacent and create constraints
-	for (unsigned long i = 0; i < render_block_ptr->m_index_count; i += 3) {
-		// Find every face that shares a point with this triangle
-		for (unsigned long j = i; j < render_block_ptr->m_index_count; j += 3) {
-			unsigned long face_index_a_verts[3];
-			unsigned long face_index_b_verts[3];
-			unsigned long face_a_count;
-			unsigned long face_b_count;
-
-			if (get_unshared_verts(i / 3, j / 3, face_index_a_verts, face_a_count, face_index_b_verts, face_b_count)) {
-				// Create a constraint between all of these
-				for (unsigned long a_index = 0; a_index < face_a_count; a_index++) {
-					for (unsigned long b_index = 0; b_index < face_b_count; b_index++) {
-						m_constraints[constraint_index].m_constraint_type = constraint::CONSTRAINT_TYPE_RESTLENGTH;
-						m_constraints[constraint_index].m_particle_a_index = face_index_a_verts[a_index];
-						m_constraints[constraint_index].m_particle_b_index = face_index_b_verts[b_index];
-						diff = render_block_ptr->m_pos[face_index_a_verts[a_index]] - render_block_ptr->m_pos[face_index_b_verts[b_index]];
-						m_constraints[constraint_index].m_rest_length = diff.len();
-						constraint_index++;
-					}
-				}
-			}
+	mesh_topology_sort_pairs(first, second, m_constraint_count, render_block_ptr->m_vertex_count, order);
+
+	m_constraints = (constraint *)MEMORY_ALLOC(sizeof(constraint) * m_constraint_count, MEMORY_TAG_PHYSICS);
+	for (unsigned long i = 0; i < m_constraint_count; ++i) {
+		m_constraints[i] = constraints[order[i]];
+		if (m_constraints[i].m_constraint_type == constraint::CONSTRAINT_TYPE_FIXED) {
+			m_fixed_constraint_index = i;
 		}
 	}
 
-	if (constraint_index != m_constraint_count) {
-		int a =0;
-		a++;
-	}
+	MEMORY_FREE(first);
+	MEMORY_FREE(constraints);
 }
 
 bool obj_cloth::set_obj(mesh_instance_dynamic *p_mesh_instance)
 {
 	m_mesh_instance = p_mesh_instance;
 
-	m_vert_data = (Vector3 *)malloc(sizeof(Vector3) * m_mesh_instance->m_mesh->m_render_blocks[0].m_vertex_count);
+	m_vert_data = (Vector3 *)MEMORY_ALLOC(sizeof(Vector3) * m_mesh_instance->m_mesh->m_render_blocks[0].m_vertex_count, MEMORY_TAG_PHYSICS);
 
 	for (unsigned long i = 0; i < m_mesh_instance->m_mesh->m_render_blocks[0].m_vertex_count; i++) {
 		m_vert_data[i] = m_mesh_instance->m_mesh->m_render_blocks[0].m_pos[i];
@@ -195,7 +133,7 @@ bool obj_cloth::set_obj(mesh_instance_dynamic *p_mesh_instance)
 	//m_particle_system.add_collision_sphere(p_center,20.0f);
 
 	m_mesh_instance->m_type = RENDER_LIB_MESH_INSTANCE_TYPE_DYNAMIC;
-	m_mesh_instance->m_dynamic_pos = (Vector3 *)malloc(sizeof(Vector3) * m_mesh_instance->m_mesh->m_render_blocks[0].m_vertex_count);
+	m_mesh_instance->m_dynamic_pos = (Vector3 *)MEMORY_ALLOC(sizeof(Vector3) * m_mesh_instance->m_mesh->m_render_blocks[0].m_vertex_count, MEMORY_TAG_PHYSICS);
 	memcpy(m_mesh_instance->m_dynamic_pos, m_mesh_instance->m_mesh->m_render_blocks[0].m_pos, m_mesh_instance->m_mesh->m_render_blocks[0].m_vertex_count);
 
 	render_lib_mesh_instance_add(m_mesh_instance);
@@ -211,11 +149,13 @@ bool obj_cloth::load_obj(char *const p_filename)
 //		return false;
 //	}
 
-	m_mesh_instance = new mesh_instance_dynamic;
+	m_mesh_instance = MEMORY_NEW(mesh_instance_dynamic, MEMORY_TAG_SCENE);
+	// Not streamed, the particle system is built from the CPU positions that the async upload frees
 	m_mesh_instance->m_mesh = resource_manager_get_mesh(p_filename);
 	
 	if (m_mesh_instance->m_mesh == NULL) {
-		free(m_mesh_instance);
+		MEMORY_DELETE(m_mesh_instance);
+		m_mesh_instance = NULL;
 		return false;
 	}
 	
@@ -223,17 +163,4 @@ bool obj_cloth::load_obj(char *const p_filename)
 	
 	
 	return true;
-}
-
-void obj_cloth::simulate(float p_frametime)
-{
-	m_particle_system.simulate(p_frametime, 1.0f, m_pos, m_vert_data);
-
-	// We need to push vert data to the mesh
-	simulate_post();
-}
-
-void obj_cloth::move(Vector3 const& p_adjust)
-{
-	m_pos += p_adjust;
-}
+}
\ No newline at end of file
@@ -17,6 +17,7 @@
 #include "mesh_instance_dynamic.h"
 #include "obj_cloth.h"
 #include "physics_lib.h"
+#include "memory_lib.h"
 
 #include <stdlib.h>
 
@@ -74,62 +75,62 @@ mesh const*g_mesh_CityBlockQ;
 
 void objects_guff_demi_redeems()
 {
-	g_mesh_BuildingA = resource_manager_get_mesh("BuildingA.obj");
-	g_mesh_BuildingB = resource_manager_get_mesh("BuildingB.obj");
-	g_mesh_BuildingC = resource_manager_get_mesh("BuildingC.obj");
+	g_mesh_BuildingA = resource_manager_get_mesh_async("BuildingA.obj");
+	g_mesh_BuildingB = resource_manager_get_mesh_async("BuildingB.obj");
+	g_mesh_BuildingC = resource_manager_get_mesh_async("BuildingC.obj");
 
-	g_mesh_CompoundBuildingA = resource_manager_get_mesh("CompoundBuildingA.obj");
-	g_mesh_CompoundBuildingB = resource_manager_get_mesh("CompoundBuildingB.obj");
-	g_mesh_CompoundBuildingC = resource_manager_get_mesh("CompoundBuildingC.obj");
-	g_mesh_CompoundBuildingD = resource_manager_get_mesh("CompoundBuildingD.obj");
+	g_mesh_CompoundBuildingA = resource_manager_get_mesh_async("CompoundBuildingA.obj");
+	g_mesh_CompoundBuildingB = resource_manager_get_mesh_async("CompoundBuildingB.obj");
+	g_mesh_CompoundBuildingC = resource_manager_get_mesh_async("CompoundBuildingC.obj");
+	g_mesh_CompoundBuildingD = resource_manager_get_mesh_async("CompoundBuildingD.obj");
 
-	g_mesh_Ground = resource_manager_get_mesh("Ground.obj");
-	g_mesh_Globe = resource_manager_get_mesh("Globe.obj");
+	g_mesh_Ground = resource_manager_get_mesh_async("Ground.obj");
+	g_mesh_Globe = resource_manager_get_mesh_async("Globe.obj");
 
-	g_mesh_PipeA = resource_manager_get_mesh("PipeA.obj");
-	g_mesh_PipeACrossJoint = resource_manager_get_mesh("PipeACrossJoint.obj");
-	g_mesh_PipeAJoint = resource_manager_get_mesh("PipeAJoint.obj");
-	g_mesh_PipeATeeJoint = resource_manager_get_mesh("PipeATeeJoint.obj");
+	g_mesh_PipeA = resource_manager_get_mesh_async("PipeA.obj");
+	g_mesh_PipeACrossJoint = resource_manager_get_mesh_async("PipeACrossJoint.obj");
+	g_mesh_PipeAJoint = resource_manager_get_mesh_async("PipeAJoint.obj");
+	g_mesh_PipeATeeJoint = resource_manager_get_mesh_async("PipeATeeJoint.obj");
 
-	g_mesh_PipeB = resource_manager_get_mesh("PipeB.obj");
-	g_mesh_PipeBCrossJoint = resource_manager_get_mesh("PipeBCrossJoint.obj");
-	g_mesh_PipeBJoint = resource_manager_get_mesh("PipeBJoint.obj");
-	g_mesh_PipeBTeeJoint = resource_manager_get_mesh("PipeBTeeJoint.obj");
+	g_mesh_PipeB = resource_manager_get_mesh_async("PipeB.obj");
+	g_mesh_PipeBCrossJoint = resource_manager_get_mesh_async("PipeBCrossJoint.obj");
+	g_mesh_PipeBJoint = resource_manager_get_mesh_async("PipeBJoint.obj");
+	g_mesh_PipeBTeeJoint = resource_manager_get_mesh_async("PipeBTeeJoint.obj");
 
-	g_mesh_PipeC = resource_manager_get_mesh("PipeC.obj");
+	g_mesh_PipeC = resource_manager_get_mesh_async("PipeC.obj");
 
-	g_mesh_PipeCover = resource_manager_get_mesh("PipeCover.obj");
-	g_mesh_PipeRim = resource_manager_get_mesh("PipeRim.obj");
-	g_mesh_PipeRing = resource_manager_get_mesh("PipeRing.obj");
+	g_mesh_PipeCover = resource_manager_get_mesh_async("PipeCover.obj");
+	g_mesh_PipeRim = resource_manager_get_mesh_async("PipeRim.obj");
+	g_mesh_PipeRing = resource_manager_get_mesh_async("PipeRing.obj");
 
-	g_mesh_Platform = resource_manager_get_mesh("Platform.obj");
+	g_mesh_Platform = resource_manager_get_mesh_async("Platform.obj");
 	
-	g_mesh_ship = resource_manager_get_mesh("Ship.obj");
-
-	g_mesh_CityBlockA = resource_manager_get_mesh("CityBlockA.obj");
-	g_mesh_CityBlockB = resource_manager_get_mesh("CityBlockB.obj");
-	g_mesh_CityBlockC = resource_manager_get_mesh("CityBlockC.obj");
-	g_mesh_CityBlockD = resource_manager_get_mesh("CityBlockD.obj");
-	g_mesh_CityBlockE = resource_manager_get_mesh("CityBlockE.obj");
-	g_mesh_CityBlockF = resource_manager_get_mesh("CityBlockF.obj");
-	g_mesh_CityBlockG = resource_manager_get_mesh("CityBlockG.obj");
-	g_mesh_CityBlockH = resource_manager_get_mesh("CityBlockH.obj");
-	g_mesh_CityBlockI = resource_manager_get_mesh("CityBlockI.obj");
-	g_mesh_CityBlockJ = resource_manager_get_mesh("CityBlockJ.obj");
-	g_mesh_CityBlockK = resource_manager_get_mesh("CityBlockK.obj");
-	g_mesh_CityBlockL = resource_manager_get_mesh("CityBlockL.obj");
-	g_mesh_CityBlockM = resource_manager_get_mesh("CityBlockM.obj");
-	g_mesh_CityBlockN = resource_manager_get_mesh("CityBlockN.obj");
-	g_mesh_CityBlockO = resource_manager_get_mesh("CityBlockO.obj");
-	g_mesh_CityBlockP = resource_manager_get_mesh("CityBlockP.obj");
-	g_mesh_CityBlockQ = resource_manager_get_mesh("CityBlockQ.obj");
+	g_mesh_ship = resource_manager_get_mesh_async("Ship.obj");
+
+	g_mesh_CityBlockA = resource_manager_get_mesh_async("CityBlockA.obj");
+	g_mesh_CityBlockB = resource_manager_get_mesh_async("CityBlockB.obj");
+	g_mesh_CityBlockC = resource_manager_get_mesh_async("CityBlockC.obj");
+	g_mesh_CityBlockD = resource_manager_get_mesh_async("CityBlockD.obj");
+	g_mesh_CityBlockE = resource_manager_get_mesh_async("CityBlockE.obj");
+	g_mesh_CityBlockF = resource_manager_get_mesh_async("CityBlockF.obj");
+	g_mesh_CityBlockG = resource_manager_get_mesh_async("CityBlockG.obj");
+	g_mesh_CityBlockH = resource_manager_get_mesh_async("CityBlockH.obj");
+	g_mesh_CityBlockI = resource_manager_get_mesh_async("CityBlockI.obj");
+	g_mesh_CityBlockJ = resource_manager_get_mesh_async("CityBlockJ.obj");
+	g_mesh_CityBlockK = resource_manager_get_mesh_async("CityBlockK.obj");
+	g_mesh_CityBlockL = resource_manager_get_mesh_async("CityBlockL.obj");
+	g_mesh_CityBlockM = resource_manager_get_mesh_async("CityBlockM.obj");
+	g_mesh_CityBlockN = resource_manager_get_mesh_async("CityBlockN.obj");
+	g_mesh_CityBlockO = resource_manager_get_mesh_async("CityBlockO.obj");
+	g_mesh_CityBlockP = resource_manager_get_mesh_async("CityBlockP.obj");
+	g_mesh_CityBlockQ = resource_manager_get_mesh_async("CityBlockQ.obj");
 }
 
 
 mesh_instance *objects_guff_create_instance(mesh const*p_mesh, float p_x, float p_y, float p_z, float p_xrot, float p_yrot, float p_zrot,
 											float p_xscale, float p_yscale, float p_zscale)
 {
-	mesh_instance *ml = new mesh_instance;
+	mesh_instance *ml = MEMORY_NEW(mesh_instance, MEMORY_TAG_SCENE);
 	ml->m_mesh = p_mesh;
 	ml->m_type = RENDER_LIB_MESH_INSTANCE_TYPE_STATIC;
 	
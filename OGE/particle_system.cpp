@@ -1,84 +1,475 @@
 #include "particle_system.h"
+#include "memory_lib.h"
+#include "job_system.h"
+#include "profiler.h"
+#include "assert.h"
 
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <math.h>
 
 //#define NULL (0)
 
-// Verlet integration step
-void particle_system::verlet() {
-	for(uint32 i = 0; i < m_vertex_count; i++) {
-		Vector3& x = m_position_data_current[i]; //(Vector3 *)(((unsigned char *)m_simulation_output) + (i * m_stride));
-		Vector3 temp = x;
-		Vector3& oldx = m_position_data_old[i];
-		Vector3 velocity = x - oldx;
-		velocity *= m_damp_factor;
+#define NUM_ITERATIONS (5)
+
+// Kernels are written once against these, the AVX build takes eight particles at a time and SSE four
+#if defined(MATH_SSE) && defined(MATH_AVX)
+#include <immintrin.h>
+#define PARTICLE_SIMD_WIDTH (8)
+typedef __m256 simd_real;
+#define simd_set1 _mm256_set1_ps
+#define simd_load _mm256_loadu_ps
+#define simd_store _mm256_storeu_ps
+#define simd_add _mm256_add_ps
+#define simd_sub _mm256_sub_ps
+#define simd_mul _mm256_mul_ps
+#define simd_div _mm256_div_ps
+#define simd_min _mm256_min_ps
+#define simd_max _mm256_max_ps
+#define simd_sqrt _mm256_sqrt_ps
+#define simd_and _mm256_and_ps
+#define simd_greater(a, b) _mm256_cmp_ps((a), (b), _CMP_GT_OQ)
+#elif defined(MATH_SSE)
+#include <xmmintrin.h>
+#define PARTICLE_SIMD_WIDTH (4)
+typedef __m128 simd_real;
+#define simd_set1 _mm_set1_ps
+#define simd_load _mm_loadu_ps
+#define simd_store _mm_storeu_ps
+#define simd_add _mm_add_ps
+#define simd_sub _mm_sub_ps
+#define simd_mul _mm_mul_ps
+#define simd_div _mm_div_ps
+#define simd_min _mm_min_ps
+#define simd_max _mm_max_ps
+#define simd_sqrt _mm_sqrt_ps
+#define simd_and _mm_and_ps
+#define simd_greater(a, b) _mm_cmpgt_ps((a), (b))
+#endif
+
+#if defined(PARTICLE_SIMD_WIDTH) && (PARTICLE_SYSTEM_SIMD_WIDTH % PARTICLE_SIMD_WIDTH) != 0
+#error PARTICLE_SYSTEM_SIMD_WIDTH has to be a multiple of the kernel width
+#endif
+
+#define BOX_MIN (-30.0f)
+#define BOX_MAX (30.0f)
 
-		Vector3 gravity(0.0f, -1.0f, 0.0f);
+// Verlet integration step
+void particle_system::verlet(uint32 p_begin, uint32 p_end) {
+	Vector3 gravity(0.0f, -1.0f, 0.0f);
+	Vector3 accel = (m_force + gravity) * m_timestep * m_timestep;
+
+	real *current[3] = { m_x, m_y, m_z };
+	real *old[3] = { m_old_x, m_old_y, m_old_z };
+
+	// Axes don't interact, so each is one straight pass
+	for (uint32 axis = 0; axis < 3; ++axis) {
+		real *x = current[axis];
+		real *oldx = old[axis];
+
+#if defined(PARTICLE_SIMD_WIDTH)
+		simd_real damp = simd_set1(m_damp_factor);
+		simd_real a = simd_set1(accel.m_data[axis]);
+		for (uint32 i = p_begin; i < p_end; i += PARTICLE_SIMD_WIDTH) {
+			simd_real pos = simd_load(&x[i]);
+			simd_real velocity = simd_mul(simd_sub(pos, simd_load(&oldx[i])), damp);
+			simd_store(&oldx[i], pos);
+			simd_store(&x[i], simd_add(pos, simd_add(velocity, a)));
+		}
+#else
+		for (uint32 i = p_begin; i < p_end; i++) {
+			real pos = x[i];
+			real velocity = (pos - oldx[i]) * m_damp_factor;
+			oldx[i] = pos;
+			x[i] = pos + (velocity + accel.m_data[axis]);
+		}
+#endif
+	}
+}
 
-		x += velocity + ((m_force + gravity) * m_timestep * m_timestep);
-		oldx = temp;
+void particle_system::collide_sphere(uint32 p_begin, uint32 p_end, Vector3 const& p_center, real p_radius) {
+	// One square root per particle, and particles sitting exactly on the center are left alone
+#if defined(PARTICLE_SIMD_WIDTH)
+	simd_real center_x = simd_set1(p_center.m_data[0]);
+	simd_real center_y = simd_set1(p_center.m_data[1]);
+	simd_real center_z = simd_set1(p_center.m_data[2]);
+	simd_real radius = simd_set1(p_radius);
+	simd_real zero = simd_set1(0.0f);
+	for (uint32 i = p_begin; i < p_end; i += PARTICLE_SIMD_WIDTH) {
+		simd_real x = simd_load(&m_x[i]);
+		simd_real y = simd_load(&m_y[i]);
+		simd_real z = simd_load(&m_z[i]);
+		simd_real delta_x = simd_sub(center_x, x);
+		simd_real delta_y = simd_sub(center_y, y);
+		simd_real delta_z = simd_sub(center_z, z);
+
+		simd_real len = simd_sqrt(simd_add(simd_add(simd_mul(delta_x, delta_x), simd_mul(delta_y, delta_y)), simd_mul(delta_z, delta_z)));
+		simd_real difference = simd_sub(radius, len);
+		simd_real inside = simd_and(simd_greater(difference, zero), simd_greater(len, zero));
+		simd_real scale = simd_and(simd_div(difference, len), inside);
+
+		simd_store(&m_x[i], simd_sub(x, simd_mul(delta_x, scale)));
+		simd_store(&m_y[i], simd_sub(y, simd_mul(delta_y, scale)));
+		simd_store(&m_z[i], simd_sub(z, simd_mul(delta_z, scale)));
+	}
+#else
+	for (uint32 i = p_begin; i < p_end; i++) {
+		real delta_x = p_center.m_data[0] - m_x[i];
+		real delta_y = p_center.m_data[1] - m_y[i];
+		real delta_z = p_center.m_data[2] - m_z[i];
+
+		real len = sqrtf((delta_x * delta_x) + (delta_y * delta_y) + (delta_z * delta_z));
+		real difference = p_radius - len;
+
+		if (difference > 0 && len > 0) {
+			real scale = difference / len;
+			m_x[i] -= delta_x * scale;
+			m_y[i] -= delta_y * scale;
+			m_z[i] -= delta_z * scale;
+		}
 	}
+#endif
 }
 
-// Implements particles in a box
-void particle_system::satisfy_constraints(Vector3 const& p_adjust) {
-#define NUM_ITERATIONS (5)
-	for(unsigned long j = 0; j < NUM_ITERATIONS; j++) {
-	// Collisions
+void particle_system::collide(uint32 p_begin, uint32 p_end) {
+	if (m_primitive_count == 0) {
+		return;
+	}
 
-#if 1
-	for (unsigned long points = 0; points < m_vertex_count; points++) {
-		Vector3& x = m_position_data_current[points];
-		Vector3 delta_vec = m_center - x;
-		real difference = m_radius - delta_vec.len();
+	// Unbinned spheres are usually the big ones most particles are near, so sweep them over the whole range
+	uint32 unbinned_count;
+	uint32 const* unbinned = m_primitive_grid.get_unbinned(&unbinned_count);
+	for (uint32 k = 0; k < unbinned_count; ++k) {
+		collision_primitive const& primitive = m_primitives[unbinned[k]];
+		if (primitive.m_shape == COLLISION_SHAPE_SPHERE) {
+			collide_sphere(p_begin, p_end, primitive.m_position, primitive.m_radius + m_collision_radius);
+		}
+	}
 
-		Vector3 delta_vec_norm = delta_vec / delta_vec.len();
+	// Everything else only against the particles in the cells it was binned into
+	uint32 end = (p_end < m_vertex_count) ? p_end : m_vertex_count;
+	for (uint32 i = p_begin; i < end; i++) {
+		for (uint32 k = 0; k < unbinned_count; ++k) {
+			collision_primitive const& primitive = m_primitives[unbinned[k]];
+			if (primitive.m_shape != COLLISION_SHAPE_SPHERE) {
+				collision_primitive_push_out(&primitive, m_collision_radius, &m_x[i], &m_y[i], &m_z[i]);
+			}
+		}
 
-		if (difference > 0) {
-			delta_vec_norm *= difference;
-			x -= delta_vec_norm;
+		uint32 count;
+		uint32 const* entries = m_primitive_grid.get_entries(m_primitive_grid.get_bucket(m_x[i], m_y[i], m_z[i]), &count);
+		for (uint32 k = 0; k < count; ++k) {
+			collision_primitive_push_out(&m_primitives[entries[k]], m_collision_radius, &m_x[i], &m_y[i], &m_z[i]);
 		}
 	}
-#endif
-	
-	
-	// Constraints
-      for(uint32 i = 0; i < m_constraint_count; i++) {
-			constraint const& c = m_constraints[i];
-			Vector3& x1 = m_position_data_current[c.m_particle_a_index];
-			Vector3& x2 = m_position_data_current[c.m_particle_b_index];
-
-			switch (c.m_constraint_type) {
-				case constraint::CONSTRAINT_TYPE_FIXED:
-					x1 = c.m_fixed_pos;
-					x1 += p_adjust;
-					break;
-				case constraint::CONSTRAINT_TYPE_RESTLENGTH:
-				{
-					real restlength = c.m_rest_length;
-					Vector3 delta = x2 - x1;
-
-					delta *= (restlength * restlength) / ((delta * delta) + (restlength * restlength)) - 0.5f;
-					x1 -= delta;
-					x2 += delta;
+}
+
+// Jacobi style, every particle only reads positions and writes its own correction, so any range can run
+// alongside any other. Each particle takes half of the overlap, its neighbour takes the other half.
+void particle_system::self_collide(uint32 p_begin, uint32 p_end) {
+	real diameter = m_collision_radius * 2.0f;
+	real diameter_sq = diameter * diameter;
+
+	for (uint32 i = p_begin; i < p_end; i++) {
+		real correction_x = 0.0f;
+		real correction_y = 0.0f;
+		real correction_z = 0.0f;
+
+		if (i < m_vertex_count) {
+			int32 cell_x = m_particle_grid.get_cell(m_x[i]);
+			int32 cell_y = m_particle_grid.get_cell(m_y[i]);
+			int32 cell_z = m_particle_grid.get_cell(m_z[i]);
+
+			// Neighbouring cells can hash to the same bucket, only visit each once
+			uint32 buckets[27];
+			uint32 bucket_count = 0;
+			for (int32 z = -1; z <= 1; ++z) {
+				for (int32 y = -1; y <= 1; ++y) {
+					for (int32 x = -1; x <= 1; ++x) {
+						uint32 bucket = m_particle_grid.get_bucket(cell_x + x, cell_y + y, cell_z + z);
+						uint32 b = 0;
+						while (b < bucket_count && buckets[b] != bucket) {
+							++b;
+						}
+
+						if (b == bucket_count) {
+							buckets[bucket_count++] = bucket;
+						}
+					}
+				}
+			}
+
+			for (uint32 b = 0; b < bucket_count; ++b) {
+				uint32 count;
+				uint32 const* entries = m_particle_grid.get_entries(buckets[b], &count);
+				for (uint32 k = 0; k < count; ++k) {
+					uint32 j = entries[k];
+					if (j == i) {
+						continue;
+					}
+
+					real delta_x = m_x[i] - m_x[j];
+					real delta_y = m_y[i] - m_y[j];
+					real delta_z = m_z[i] - m_z[j];
+					real len_sq = (delta_x * delta_x) + (delta_y * delta_y) + (delta_z * delta_z);
+					if (len_sq >= diameter_sq || len_sq == 0.0f) {
+						continue;
+					}
+
+					// Neighbours in the cloth itself are held apart by their constraints
+					real rest_x = m_rest_x[i] - m_rest_x[j];
+					real rest_y = m_rest_y[i] - m_rest_y[j];
+					real rest_z = m_rest_z[i] - m_rest_z[j];
+					if ((rest_x * rest_x) + (rest_y * rest_y) + (rest_z * rest_z) < diameter_sq) {
+						continue;
+					}
+
+					real len = sqrtf(len_sq);
+					real scale = ((diameter - len) * 0.5f) / len;
+					correction_x += delta_x * scale;
+					correction_y += delta_y * scale;
+					correction_z += delta_z * scale;
 				}
-					break;
-				default:
+			}
+		}
+
+		m_delta_x[i] = correction_x;
+		m_delta_y[i] = correction_y;
+		m_delta_z[i] = correction_z;
+	}
+}
+
+void particle_system::apply_self_collision(uint32 p_begin, uint32 p_end) {
+	for (uint32 i = p_begin; i < p_end; i++) {
+		m_x[i] += m_delta_x[i];
+		m_y[i] += m_delta_y[i];
+		m_z[i] += m_delta_z[i];
+	}
+}
+
+void particle_system::satisfy_constraints(constraint const* p_constraints, uint32 p_begin, uint32 p_end, Vector3 const& p_adjust) {
+	for(uint32 i = p_begin; i < p_end; i++) {
+		constraint const& c = p_constraints[i];
+		uint32 a = c.m_particle_a_index;
+
+		switch (c.m_constraint_type) {
+			case constraint::CONSTRAINT_TYPE_FIXED:
+				m_x[a] = c.m_fixed_pos.m_data[0] + p_adjust.m_data[0];
+				m_y[a] = c.m_fixed_pos.m_data[1] + p_adjust.m_data[1];
+				m_z[a] = c.m_fixed_pos.m_data[2] + p_adjust.m_data[2];
+				break;
+			case constraint::CONSTRAINT_TYPE_RESTLENGTH:
+			{
+				uint32 b = c.m_particle_b_index;
+				real restlength_sq = c.m_rest_length * c.m_rest_length;
+				real delta_x = m_x[b] - m_x[a];
+				real delta_y = m_y[b] - m_y[a];
+				real delta_z = m_z[b] - m_z[a];
+
+				real scale = restlength_sq / ((delta_x * delta_x) + (delta_y * delta_y) + (delta_z * delta_z) + restlength_sq) - 0.5f;
+				delta_x *= scale;
+				delta_y *= scale;
+				delta_z *= scale;
+
+				m_x[a] -= delta_x;
+				m_y[a] -= delta_y;
+				m_z[a] -= delta_z;
+				m_x[b] += delta_x;
+				m_y[b] += delta_y;
+				m_z[b] += delta_z;
+			}
 				break;
-			};
+			default:
+			break;
+		};
+	}
+}
+
+void particle_system::adjust_to_weight(uint32 p_begin, uint32 p_end, real p_simulation_weight, Vector3 const& p_adjust)
+{
+	real *current[3] = { m_x, m_y, m_z };
+	real *rest[3] = { m_rest_x, m_rest_y, m_rest_z };
+
+	for (uint32 axis = 0; axis < 3; ++axis) {
+		real *x = current[axis];
+		real *restx = rest[axis];
+
+#if defined(PARTICLE_SIMD_WIDTH)
+		simd_real box_min = simd_set1(BOX_MIN);
+		simd_real box_max = simd_set1(BOX_MAX);
+		simd_real adjust = simd_set1(p_adjust.m_data[axis]);
+		simd_real weight = simd_set1(p_simulation_weight);
+		for (uint32 i = p_begin; i < p_end; i += PARTICLE_SIMD_WIDTH) {
+			// Do a box constraint
+			simd_real pos = simd_min(simd_max(simd_load(&x[i]), box_min), box_max);
+
+			simd_real orig = simd_add(simd_load(&restx[i]), adjust);
+			simd_store(&x[i], simd_add(orig, simd_mul(simd_sub(pos, orig), weight)));
+		}
+#else
+		for (uint32 i = p_begin; i < p_end; i++) {
+			// Do a box constraint
+			real pos = x[i];
+			pos = (pos < BOX_MIN) ? BOX_MIN : ((pos > BOX_MAX) ? BOX_MAX : pos);
+
+			real orig = restx[i] + p_adjust.m_data[axis];
+			x[i] = orig + ((pos - orig) * p_simulation_weight);
 		}
-   }
+#endif
+	}
+}
+
+void particle_system::write_output()
+{
+	//////////
+	// NOTE: JWT: This code is not safe if vector components are doubles instead of floats
+	///////////
 
-   // Constrain one particle of the cloth to origo
-   //m_x[0] = Vector3(0,0,0);
+	unsigned char *output = (unsigned char *)m_simulation_output;
+	for (uint32 i = 0; i < m_vertex_count; i++) {
+		real *pos = (real *)(output + (m_stride * i));
+		pos[0] = m_x[i];
+		pos[1] = m_y[i];
+		pos[2] = m_z[i];
+	}
+}
+
+void particle_system::step_serial(real p_simulation_weight, Vector3 const& p_adjust)
+{
+	PROFILE_SCOPE("particle_system::step");
+
+	verlet(0, m_padded_count);
 
-	// Do a box constraint
-	for(uint32 i = 0; i < m_vertex_count; i++) { // For all particles
-		Vector3& x = m_position_data_current[i];
-		x = vmin(vmax(x, Vector3(-30.0f, -30.0f, -30.0f)), Vector3(30.0f, 30.0f, 30.0f));
+	if (m_self_collision) {
+		m_particle_grid.build_points(m_x, m_y, m_z, m_vertex_count, m_cell_size);
+		self_collide(0, m_padded_count);
+		apply_self_collision(0, m_padded_count);
 	}
+
+	for(uint32 j = 0; j < NUM_ITERATIONS; j++) {
+		collide(0, m_padded_count);
+		satisfy_constraints(m_constraints, 0, m_constraint_count, p_adjust);
+	}
+
+	adjust_to_weight(0, m_padded_count, p_simulation_weight, p_adjust);
+}
+
+void particle_system::verlet_job(void *p_data, uint32 p_begin, uint32 p_end)
+{
+	((particle_system *)p_data)->verlet(p_begin, p_end);
+}
+
+void particle_system::collide_job(void *p_data, uint32 p_begin, uint32 p_end)
+{
+	((particle_system *)p_data)->collide(p_begin, p_end);
+}
+
+void particle_system::self_collide_job(void *p_data, uint32 p_begin, uint32 p_end)
+{
+	((particle_system *)p_data)->self_collide(p_begin, p_end);
+}
+
+void particle_system::apply_self_collision_job(void *p_data, uint32 p_begin, uint32 p_end)
+{
+	((particle_system *)p_data)->apply_self_collision(p_begin, p_end);
+}
+
+void particle_system::satisfy_constraints_job(void *p_data, uint32 p_begin, uint32 p_end)
+{
+	particle_system *system = (particle_system *)p_data;
+	uint32 base = system->m_step_constraint_begin;
+	system->satisfy_constraints(system->m_colored_constraints, base + p_begin, base + p_end, system->m_step_adjust);
+}
+
+void particle_system::adjust_to_weight_job(void *p_data, uint32 p_begin, uint32 p_end)
+{
+	particle_system *system = (particle_system *)p_data;
+	system->adjust_to_weight(p_begin, p_end, system->m_step_weight, system->m_step_adjust);
+}
+
+// Constraints of one color touch disjoint particles, so splitting a color across threads gives exactly
+// the result of solving it in order. Each pass waits for its batches before the next one starts.
+void particle_system::step_parallel(real p_simulation_weight, Vector3 const& p_adjust)
+{
+	PROFILE_SCOPE("particle_system::step");
+
+	m_step_adjust = p_adjust;
+	m_step_weight = p_simulation_weight;
+
+	job_parallel_for(m_padded_count, PARTICLE_SYSTEM_PARTICLE_BATCH_SIZE, verlet_job, this);
+
+	// The grid is one counting sort, cheap enough to leave on this thread
+	if (m_self_collision) {
+		m_particle_grid.build_points(m_x, m_y, m_z, m_vertex_count, m_cell_size);
+		job_parallel_for(m_padded_count, PARTICLE_SYSTEM_PARTICLE_BATCH_SIZE, self_collide_job, this);
+		job_parallel_for(m_padded_count, PARTICLE_SYSTEM_PARTICLE_BATCH_SIZE, apply_self_collision_job, this);
+	}
+
+	for(uint32 j = 0; j < NUM_ITERATIONS; j++) {
+		job_parallel_for(m_padded_count, PARTICLE_SYSTEM_PARTICLE_BATCH_SIZE, collide_job, this);
+
+		for (uint32 color = 0; color < m_color_count; ++color) {
+			m_step_constraint_begin = m_color_offsets[color];
+			job_parallel_for(m_color_offsets[color + 1] - m_color_offsets[color], PARTICLE_SYSTEM_CONSTRAINT_BATCH_SIZE, satisfy_constraints_job, this);
+		}
+
+		satisfy_constraints(m_colored_constraints, m_color_offsets[PARTICLE_SYSTEM_COLORS_MAX], m_color_offsets[PARTICLE_SYSTEM_COLORS_MAX + 1], p_adjust);
+	}
+
+	job_parallel_for(m_padded_count, PARTICLE_SYSTEM_PARTICLE_BATCH_SIZE, adjust_to_weight_job, this);
+}
+
+// Greedy, in the given order, each constraint takes the lowest color neither of its particles has yet
+void particle_system::color_constraints()
+{
+	uint64 *particle_colors = (uint64 *)MEMORY_CALLOC(sizeof(uint64) * m_vertex_count, MEMORY_TAG_PHYSICS);
+	uint8 *constraint_colors = (uint8 *)MEMORY_ALLOC(sizeof(uint8) * m_constraint_count, MEMORY_TAG_PHYSICS);
+	assert(particle_colors != NULL && constraint_colors != NULL);
+
+	uint32 counts[PARTICLE_SYSTEM_COLORS_MAX + 1];
+	memset(counts, 0, sizeof(counts));
+
+	m_color_count = 0;
+	for (uint32 i = 0; i < m_constraint_count; ++i) {
+		constraint const& c = m_constraints[i];
+		uint32 a = c.m_particle_a_index;
+		uint32 b = (c.m_constraint_type == constraint::CONSTRAINT_TYPE_RESTLENGTH) ? c.m_particle_b_index : a;
+
+		uint64 used = particle_colors[a] | particle_colors[b];
+		uint32 color = 0;
+		while (color < PARTICLE_SYSTEM_COLORS_MAX && (used & ((uint64)1 << color))) {
+			++color;
+		}
+
+		if (color < PARTICLE_SYSTEM_COLORS_MAX) {
+			particle_colors[a] |= (uint64)1 << color;
+			particle_colors[b] |= (uint64)1 << color;
+
+			if (color >= m_color_count) {
+				m_color_count = color + 1;
+			}
+		}
+
+		constraint_colors[i] = (uint8)color;
+		counts[color]++;
+	}
+
+	m_color_offsets[0] = 0;
+	for (uint32 color = 0; color <= PARTICLE_SYSTEM_COLORS_MAX; ++color) {
+		m_color_offsets[color + 1] = m_color_offsets[color] + counts[color];
+		counts[color] = m_color_offsets[color];
+	}
+
+	// Stable, so each color keeps the original relative order
+	m_colored_constraints = (constraint *)MEMORY_ALLOC(sizeof(constraint) * (m_constraint_count ? m_constraint_count : 1), MEMORY_TAG_PHYSICS);
+	assert(m_colored_constraints != NULL);
+	for (uint32 i = 0; i < m_constraint_count; ++i) {
+		m_colored_constraints[counts[constraint_colors[i]]++] = m_constraints[i];
+	}
+
+	MEMORY_FREE(constraint_colors);
+	MEMORY_FREE(particle_colors);
 }
 
 particle_system::particle_system() 
@@ -87,24 +478,48 @@ particle_system::particle_system()
 	m_vertex_count = 0;
 	m_stride = 0;
 	m_time_accumulated = 0.0f;
-	m_position_data_current = NULL;
-	m_position_data_old = NULL;
+	m_padded_count = 0;
+	m_particle_memory = NULL;
+	m_x = m_y = m_z = NULL;
+	m_old_x = m_old_y = m_old_z = NULL;
+	m_rest_x = m_rest_y = m_rest_z = NULL;
 	m_constraint_count = 0;
 	m_force.m_data[0] = 0.0f;
 	m_force.m_data[1] = 0.0f;
 	m_force.m_data[2] = 0.0f;
+	m_primitives = NULL;
+	m_primitive_count = 0;
+	m_primitives_max = 0;
+	m_primitives_dirty = false;
+	m_collision_radius = 0.0f;
+	m_self_collision = false;
+	m_cell_size = 1.0f;
+	m_owned_constraints = NULL;
+	m_colored_constraints = NULL;
+	m_color_count = 0;
+	m_parallel = true;
 };
 
 particle_system::~particle_system()
 {
-	if (m_position_data_current) {
-		free(m_position_data_current);
-		m_position_data_current = NULL;
+	if (m_particle_memory) {
+		MEMORY_FREE(m_particle_memory);
+		m_particle_memory = NULL;
+	}
+
+	if (m_colored_constraints) {
+		MEMORY_FREE(m_colored_constraints);
+		m_colored_constraints = NULL;
 	}
 
-	if (m_position_data_old) {
-		free(m_position_data_old);
-		m_position_data_old = NULL;
+	if (m_owned_constraints) {
+		MEMORY_FREE(m_owned_constraints);
+		m_owned_constraints = NULL;
+	}
+
+	if (m_primitives) {
+		MEMORY_FREE(m_primitives);
+		m_primitives = NULL;
 	}
 }
 
@@ -115,12 +530,22 @@ void particle_system::init_particle_system(void const*p_vertex_data, uint32 p_ve
 	m_vertex_count = p_vertex_count;
 	m_stride = p_stride;
 	m_time_accumulated = 0.0f;
-	m_position_data_current = (Vector3 *)malloc(sizeof(Vector3) * m_vertex_count);
-	m_position_data_old = (Vector3 *)malloc(sizeof(Vector3) * m_vertex_count);
+	m_padded_count = (m_vertex_count + PARTICLE_SYSTEM_SIMD_WIDTH - 1) & ~(PARTICLE_SYSTEM_SIMD_WIDTH - 1);
+
+	// Twelve arrays of m_padded_count reals back to back
+	m_particle_memory = (real *)MEMORY_CALLOC(sizeof(real) * m_padded_count * 12, MEMORY_TAG_PHYSICS);
+	assert(m_particle_memory != NULL);
+	real **arrays[12] = { &m_x, &m_y, &m_z, &m_old_x, &m_old_y, &m_old_z, &m_rest_x, &m_rest_y, &m_rest_z, &m_delta_x, &m_delta_y, &m_delta_z };
+	for (uint32 i = 0; i < 12; ++i) {
+		*arrays[i] = m_particle_memory + (m_padded_count * i);
+	}
 	m_constraint_count = p_constraint_count;
 	m_constraints = p_constraints;
 	m_timestep = p_timestep;
 	m_damp_factor = p_damp_factor;
+
+	color_constraints();
+	update_cell_size();
 	
 	//////////
 	// NOTE: JWT: This code is not safe if vector components are doubles instead of floats
@@ -129,55 +554,57 @@ void particle_system::init_particle_system(void const*p_vertex_data, uint32 p_ve
 	// Fill out current state of data
 	unsigned long i;
 	for (i = 0; i < p_vertex_count; i++) {
-		memcpy(m_position_data_current[i].m_data, ((unsigned char *)p_vertex_data) + (m_stride * i), sizeof(float) * 3);
-		memcpy(m_position_data_old[i].m_data, ((unsigned char *)p_vertex_data) + (m_stride * i), sizeof(float) * 3);
-	}
-}
-
-void particle_system::adjust_to_weight(float p_simulation_weight, Vector3 const& p_adjust)
-{
-	for(uint32 i = 0; i < m_vertex_count; i++) {
-		Vector3& x = m_position_data_current[i]; //(Vector3 *)(((unsigned char *)m_simulation_output) + (i * m_stride));
-		
-		Vector3 orig = *(Vector3 *)(((unsigned char *)m_vertex_data) + (i * m_stride)) + p_adjust;
-
-		x = orig + ((x - orig) * p_simulation_weight);
+		real const* pos = (real const*)(((unsigned char *)p_vertex_data) + (m_stride * i));
+		m_x[i] = m_old_x[i] = m_rest_x[i] = pos[0];
+		m_y[i] = m_old_y[i] = m_rest_y[i] = pos[1];
+		m_z[i] = m_old_z[i] = m_rest_z[i] = pos[2];
 	}
 }
 
 // Simulate the particle system
-void particle_system::simulate(real p_time, real p_simulation_weight, Vector3 const& p_adjust, void *p_simulation_output)
+uint32 particle_system::simulate(real p_time, real p_simulation_weight, Vector3 const& p_adjust, void *p_simulation_output)
 {
+	PROFILE_SCOPE("particle_system::simulate");
+
 	m_simulation_output = p_simulation_output;
 
 	// Find out how much time we have to simulate all together
 	real total_time = p_time + m_time_accumulated;
 
-	if (m_stride != sizeof(Vector3)) {
-		memcpy((unsigned char *)m_simulation_output, (unsigned char *)m_vertex_data, m_vertex_count * m_stride);
+	// Primitives only change between calls
+	if (m_primitives_dirty) {
+		m_primitive_grid.build_primitives(m_primitives, m_primitive_count, m_collision_radius, m_cell_size);
+		m_primitives_dirty = false;
 	}
 
 	// Loop through simulation steps
-	while(total_time >= m_timestep) {
-		verlet();
-		satisfy_constraints(p_adjust);
-		adjust_to_weight(p_simulation_weight, p_adjust);
-		
-		//////////
-		// NOTE: JWT: This code is not safe if vector components are doubles instead of floats
-		///////////
-
-		unsigned long i;
-		for (i = 0; i < m_vertex_count; i++) {
-			memcpy(((unsigned char *)m_simulation_output) + (m_stride * i), m_position_data_current[i].m_data, sizeof(float) * 3);
+	uint32 step_count = 0;
+	while(total_time >= m_timestep && step_count < PARTICLE_SYSTEM_STEPS_MAX) {
+		if (m_parallel) {
+			step_parallel(p_simulation_weight, p_adjust);
+		} else {
+			step_serial(p_simulation_weight, p_adjust);
 		}
 
 		// Subtract out the time we just simulated
 		total_time -= m_timestep;
+		step_count++;
 	}
 
-	// Save out any unused time
-	m_time_accumulated = total_time;
+	// Save out any unused time. After a long frame catching up fully would only make the next frame longer
+	// still, so whatever the step limit left over is dropped and the cloth falls behind instead.
+	m_time_accumulated = (total_time >= m_timestep) ? 0.0f : total_time;
+
+	// Only the state after the last step is ever seen
+	if (step_count > 0) {
+		if (m_stride != sizeof(Vector3)) {
+			memcpy((unsigned char *)m_simulation_output, (unsigned char *)m_vertex_data, m_vertex_count * m_stride);
+		}
+
+		write_output();
+	}
+
+	return step_count;
 }
 
 
@@ -195,11 +622,100 @@ void particle_system::reset_force()
 	m_force.m_data[2] = 0.0f;
 }
 
-void particle_system::add_constraints(constraint const*p_constraints, uint32 p_constraint_count) {}
-void particle_system::add_collision_primitive(void *p_primitive, uint32 p_primitive_count) {}
+// Copies the constraints given so far and the new ones into one array of our own, then recolors
+void particle_system::add_constraints(constraint const*p_constraints, uint32 p_constraint_count)
+{
+	constraint *combined = (constraint *)MEMORY_ALLOC(sizeof(constraint) * (m_constraint_count + p_constraint_count), MEMORY_TAG_PHYSICS);
+	assert(combined != NULL);
+	memcpy(combined, m_constraints, sizeof(constraint) * m_constraint_count);
+	memcpy(combined + m_constraint_count, p_constraints, sizeof(constraint) * p_constraint_count);
+
+	if (m_owned_constraints) {
+		MEMORY_FREE(m_owned_constraints);
+	}
+	m_owned_constraints = combined;
+	m_constraints = combined;
+	m_constraint_count += p_constraint_count;
+
+	if (m_colored_constraints) {
+		MEMORY_FREE(m_colored_constraints);
+		m_colored_constraints = NULL;
+	}
+	color_constraints();
+	update_cell_size();
+}
+
+void particle_system::add_collision_primitive(collision_primitive const* p_primitives, uint32 p_primitive_count)
+{
+	if (m_primitive_count + p_primitive_count > m_primitives_max) {
+		while (m_primitive_count + p_primitive_count > m_primitives_max) {
+			m_primitives_max = (m_primitives_max == 0) ? 16 : m_primitives_max * 2;
+		}
+
+		m_primitives = (collision_primitive *)MEMORY_REALLOC(m_primitives, sizeof(collision_primitive) * m_primitives_max, MEMORY_TAG_PHYSICS);
+		assert(m_primitives != NULL);
+	}
+
+	memcpy(&m_primitives[m_primitive_count], p_primitives, sizeof(collision_primitive) * p_primitive_count);
+	m_primitive_count += p_primitive_count;
+	m_primitives_dirty = true;
+}
+
+void particle_system::clear_collision_primitives()
+{
+	m_primitive_count = 0;
+	m_primitives_dirty = true;
+}
 
 void particle_system::add_collision_sphere(Vector3 p_center, real p_radius)
 {
-	m_center = p_center;
-	m_radius = p_radius;
+	collision_primitive sphere = collision_primitive_sphere(p_center, p_radius);
+	add_collision_primitive(&sphere, 1);
+}
+
+void particle_system::set_collision_radius(real p_radius)
+{
+	m_collision_radius = p_radius;
+	m_primitives_dirty = true;
+	update_cell_size();
+}
+
+void particle_system::set_self_collision(bool p_self_collision)
+{
+	m_self_collision = p_self_collision;
+}
+
+// Cells about two cloth edges across keep the per cell lists short, and never smaller than a particle's
+// diameter so self collision only has to look at the neighbouring cells
+void particle_system::update_cell_size()
+{
+	real rest_length_total = 0.0f;
+	uint32 rest_length_count = 0;
+	for (uint32 i = 0; i < m_constraint_count; ++i) {
+		if (m_constraints[i].m_constraint_type == constraint::CONSTRAINT_TYPE_RESTLENGTH) {
+			rest_length_total += m_constraints[i].m_rest_length;
+			rest_length_count++;
+		}
+	}
+
+	m_cell_size = (rest_length_count > 0) ? (rest_length_total / rest_length_count) * 2.0f : 1.0f;
+	if (m_cell_size < m_collision_radius * 2.0f) {
+		m_cell_size = m_collision_radius * 2.0f;
+	}
+
+	if (m_cell_size <= 0.0f) {
+		m_cell_size = 1.0f;
+	}
+
+	m_primitives_dirty = true;
+}
+
+void particle_system::set_parallel(bool p_parallel)
+{
+	m_parallel = p_parallel;
+}
+
+uint32 particle_system::get_particle_count() const
+{
+	return m_vertex_count;
 }
\ No newline at end of file
@@ -4,6 +4,25 @@
 #include "Vector3.h"
 
 #include "core_types.h"
+#include "collision.h"
+
+// Particle arrays are padded to a multiple of this so the kernels never need a scalar tail
+#define PARTICLE_SYSTEM_SIMD_WIDTH (8)
+
+// Constraints are greedily colored so no two of the same color share a particle. Any that don't fit in
+// the colors go in one last batch that is always solved serially.
+#define PARTICLE_SYSTEM_COLORS_MAX (64)
+
+// Particles and constraints per job, a system smaller than one batch never leaves the calling thread.
+// The particle batch has to stay a multiple of PARTICLE_SYSTEM_SIMD_WIDTH.
+#define PARTICLE_SYSTEM_PARTICLE_BATCH_SIZE (512)
+#define PARTICLE_SYSTEM_CONSTRAINT_BATCH_SIZE (512)
+
+// Systems with fewer particles are better stepped alongside others than split up themselves
+#define PARTICLE_SYSTEM_PARALLEL_MIN (2048)
+
+// Most timesteps one simulate will take, time beyond that is dropped rather than caught up on later
+#define PARTICLE_SYSTEM_STEPS_MAX (4)
 
 struct constraint {
    uint32 m_particle_a_index;
@@ -34,44 +53,125 @@ public:
 	// Initializes a particle system with a pointer to base vertex data
 	void init_particle_system(void const*p_vertex_data, uint32 p_vertex_count, uint32 p_stride, constraint const*p_constraints, uint32 p_constraint_count, real p_timestep, real p_damp_factor);
 
-	// Simulate the particle system
-	void simulate(real p_time, real p_simulation_weight, Vector3 const& p_adjust, void *p_simulation_output);
+	// Simulate the particle system, returns the number of timesteps taken. The output is only written when
+	// that isn't zero.
+	uint32 simulate(real p_time, real p_simulation_weight, Vector3 const& p_adjust, void *p_simulation_output);
 
 	// Add a force to the particle system. Can be used for wind, gravity, etc.
 	void add_force(Vector3 const&p_force);
 	
 	void reset_force();
 
+	// Copied, along with the ones passed to init, into an array the particle system owns
 	void add_constraints(constraint const*p_constraints, uint32 p_constraint_count);
-	void add_collision_primitive(void *p_primitive, uint32 p_primitive_count);
+
+	// Copied, to follow a moving rig clear and add the whole set again before each simulate
+	void add_collision_primitive(collision_primitive const* p_primitives, uint32 p_primitive_count);
+	void clear_collision_primitives();
 	
 	void add_collision_sphere(Vector3 p_center, real p_radius);
 
+	// How far particles keep from the collision primitives, and from each other with self collision on.
+	// Particles closer than twice this in the rest pose never push each other apart. Zero by default.
+	void set_collision_radius(real p_radius);
+	void set_self_collision(bool p_self_collision);
+
+	// On by default. Off solves the constraints one at a time in the order they were given, as a reference.
+	void set_parallel(bool p_parallel);
+
+	uint32 get_particle_count() const;
+
 private:
 	void const*m_vertex_data;
 	uint32 m_vertex_count;
 	uint32 m_stride;
 
 	real m_time_accumulated;
-	Vector3 *m_position_data_current;
-	Vector3 *m_position_data_old;
+
+	// Structure of arrays, all in one block and padded to m_padded_count. The padding particles have no
+	// constraints and are simulated along with the rest, but never written out.
+	uint32 m_padded_count;
+	real *m_particle_memory;
+	real *m_x;
+	real *m_y;
+	real *m_z;
+	real *m_old_x;
+	real *m_old_y;
+	real *m_old_z;
+	// Copy of the base vertex positions, so the weighting doesn't read through the stride
+	real *m_rest_x;
+	real *m_rest_y;
+	real *m_rest_z;
+	// Self collision corrections, applied once every particle has been looked at
+	real *m_delta_x;
+	real *m_delta_y;
+	real *m_delta_z;
+
 	constraint const*m_constraints;
+	// Set once add_constraints has combined the constraints, m_constraints then points to it
+	constraint *m_owned_constraints;
 	uint32 m_constraint_count;
 	real m_timestep;
 	Vector3 m_force;
 	void *m_simulation_output;
 	real m_damp_factor;
 	
-	Vector3 m_center;
-	real m_radius;
+	collision_primitive *m_primitives;
+	uint32 m_primitive_count;
+	uint32 m_primitives_max;
+	bool m_primitives_dirty;
+	real m_collision_radius;
+	bool m_self_collision;
+	real m_cell_size;
+
+	// Primitives are binned once per simulate, particles every step for self collision
+	collision_grid m_primitive_grid;
+	collision_grid m_particle_grid;
+
+	// m_constraints reordered by color, color i is [m_color_offsets[i], m_color_offsets[i + 1]).
+	// The overflow batch is the one at PARTICLE_SYSTEM_COLORS_MAX.
+	constraint *m_colored_constraints;
+	uint32 m_color_offsets[PARTICLE_SYSTEM_COLORS_MAX + 2];
+	uint32 m_color_count;
+	bool m_parallel;
+
+	// Read by the jobs of the step in flight, particle ranges always start on a multiple of the SIMD width
+	Vector3 m_step_adjust;
+	real m_step_weight;
+	uint32 m_step_constraint_begin;
+
+	void color_constraints();
+	void update_cell_size();
+
+	// One timestep: Verlet, then the collision and constraint iterations, then the box and the weighting
+	void step_serial(real p_simulation_weight, Vector3 const& p_adjust);
+
+	// Same step split into job_parallel_for passes, constraints a color at a time
+	void step_parallel(real p_simulation_weight, Vector3 const& p_adjust);
 
 	// Verlet integration step
-	void verlet();
+	void verlet(uint32 p_begin, uint32 p_end);
+
+	// Pushes particles out of the collision primitives
+	void collide(uint32 p_begin, uint32 p_end);
+	void collide_sphere(uint32 p_begin, uint32 p_end, Vector3 const& p_center, real p_radius);
+
+	void self_collide(uint32 p_begin, uint32 p_end);
+	void apply_self_collision(uint32 p_begin, uint32 p_end);
+	void satisfy_constraints(constraint const* p_constraints, uint32 p_begin, uint32 p_end, Vector3 const& p_adjust);
+
+	// Implements particles in a box, then pulls them back towards the rest pose by the weight
+	void adjust_to_weight(uint32 p_begin, uint32 p_end, real p_simulation_weight, Vector3 const& p_adjust);
 
-	// Implements particles in a box
-	void satisfy_constraints(Vector3 const& p_adjust);
+	static void verlet_job(void *p_data, uint32 p_begin, uint32 p_end);
+	static void collide_job(void *p_data, uint32 p_begin, uint32 p_end);
+	static void self_collide_job(void *p_data, uint32 p_begin, uint32 p_end);
+	static void apply_self_collision_job(void *p_data, uint32 p_begin, uint32 p_end);
+	static void satisfy_constraints_job(void *p_data, uint32 p_begin, uint32 p_end);
+	static void adjust_to_weight_job(void *p_data, uint32 p_begin, uint32 p_end);
 
-	void adjust_to_weight(real p_simulation_weight, Vector3 const& p_adjust);
+	// Positions into the strided vertex data, once after the last step of a simulate
+	void write_output();
 };
 
 #endif // __PARTICLE_SYSTEM_H_
\ No newline at end of file
@@ -1,20 +1,338 @@
 #include "physics_lib.h"
 
 #include "cloth_sim.h"
+#include "cape.h"
+#include "job_system.h"
+#include "memory_lib.h"
+#include "frametime.h"
+#include "profiler.h"
+#include "assert.h"
 
-#include <list>
+#include "SDL.h"
+#include "SDL_thread.h"
 
-static std::list<cloth_sim *>g_cloth_sims;
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+// Added to on the main thread, the physics thread steps its own copy of the list
+static cloth_sim **g_cloth_sims = NULL;
+static uint32 g_cloth_sim_count = 0;
+static uint32 g_cloth_sims_max = 0;
+
+static cloth_sim **g_tick_sims = NULL;
+static uint32 g_tick_sim_count = 0;
+static uint32 g_tick_sims_max = 0;
+
+// Sims stepped one per job this tick
+static cloth_sim **g_cloth_sim_jobs = NULL;
+
+static SDL_Thread *g_physics_thread = NULL;
+static volatile bool g_physics_quit = false;
+
+// Guards the sim list while it's copied, the stats and g_tick_clock
+static SDL_mutex *g_physics_lock = NULL;
+
+static real g_tick_time = 1.0f / PHYSICS_LIB_TICK_RATE_DEFAULT;
+static uint32 g_ticks_max = PHYSICS_LIB_TICKS_MAX_DEFAULT;
+
+// Threaded, the wall clock time the newest tick stands for. Otherwise the frame time not yet ticked.
+static double g_tick_clock = 0.0;
+static double g_time_owed = 0.0;
+
+static physics_lib_stats g_physics_stats;
+static physics_lib_stats g_physics_stats_read;
+static real g_tick_ms[PHYSICS_LIB_STATS_TICKS];
+
+static void print(char const* p_text)
+{
+#ifdef _WIN32
+	OutputDebugStringA(p_text);
+#else
+	fputs(p_text, stdout);
+#endif
+}
+
+static void simulate_job(void *p_data, uint32 p_begin, uint32 p_end)
+{
+	real timestep = *(real const*)p_data;
+	for (uint32 i = p_begin; i < p_end; ++i) {
+		g_cloth_sim_jobs[i]->tick(timestep);
+	}
+}
+
+static void update_tick_sims()
+{
+	SDL_mutexP(g_physics_lock);
+	if (g_tick_sim_count != g_cloth_sim_count) {
+		if (g_tick_sims_max < g_cloth_sims_max) {
+			g_tick_sims_max = g_cloth_sims_max;
+			g_tick_sims = (cloth_sim **)MEMORY_REALLOC(g_tick_sims, sizeof(cloth_sim *) * g_tick_sims_max, MEMORY_TAG_PHYSICS);
+			g_cloth_sim_jobs = (cloth_sim **)MEMORY_REALLOC(g_cloth_sim_jobs, sizeof(cloth_sim *) * g_tick_sims_max, MEMORY_TAG_PHYSICS);
+			assert(g_tick_sims != NULL && g_cloth_sim_jobs != NULL);
+		}
+
+		memcpy(g_tick_sims, g_cloth_sims, sizeof(cloth_sim *) * g_cloth_sim_count);
+		g_tick_sim_count = g_cloth_sim_count;
+	}
+	SDL_mutexV(g_physics_lock);
+}
+
+// Large cloth sims are stepped one at a time with the solver split across the job system, the rest are
+// stepped side by side, one per job
+static void tick_sims()
+{
+	PROFILE_SCOPE("physics_lib tick");
+
+	double start = frametime_get_clock();
+
+	update_tick_sims();
+
+	uint32 job_count = 0;
+	for (uint32 i = 0; i < g_tick_sim_count; ++i) {
+		if (g_tick_sims[i]->get_particle_count() >= PARTICLE_SYSTEM_PARALLEL_MIN) {
+			g_tick_sims[i]->tick(g_tick_time);
+		} else {
+			g_cloth_sim_jobs[job_count++] = g_tick_sims[i];
+		}
+	}
+
+	job_parallel_for(job_count, 1, simulate_job, &g_tick_time);
+
+	real tick_ms = (real)((frametime_get_clock() - start) * 1000.0);
+
+	SDL_mutexP(g_physics_lock);
+	g_tick_ms[g_physics_stats.m_ticks % PHYSICS_LIB_STATS_TICKS] = tick_ms;
+	g_physics_stats.m_ticks++;
+	SDL_mutexV(g_physics_lock);
+}
+
+// Runs the ticks p_owed seconds add up to and returns the time still owed. More than g_ticks_max due at
+// once means stepping is slower than real time, catching up would only put it further behind.
+static double run_ticks(double p_owed)
+{
+	uint32 due = (uint32)(p_owed / g_tick_time);
+	if (due > g_ticks_max) {
+		SDL_mutexP(g_physics_lock);
+		g_physics_stats.m_ticks_dropped += due - g_ticks_max;
+		SDL_mutexV(g_physics_lock);
+
+		p_owed -= (due - g_ticks_max) * (double)g_tick_time;
+		due = g_ticks_max;
+	}
+
+	for (uint32 i = 0; i < due; ++i) {
+		tick_sims();
+		p_owed -= g_tick_time;
+	}
+
+	return p_owed;
+}
+
+static int physics_thread(void *p_data)
+{
+	PROFILE_THREAD_NAME("physics");
+
+	double last = frametime_get_clock();
+	double owed = 0.0;
+	while (g_physics_quit == false) {
+		double now = frametime_get_clock();
+		owed = run_ticks(owed + (now - last));
+		last = now;
+
+		SDL_mutexP(g_physics_lock);
+		g_tick_clock = now - owed;
+		SDL_mutexV(g_physics_lock);
+
+		// Sleep until the next tick is due, SDL_Delay only ever oversleeps
+		double wait = g_tick_time - (frametime_get_clock() - g_tick_clock);
+		if (wait >= 0.001) {
+			SDL_Delay((uint32)(wait * 1000.0));
+		}
+	}
+
+	return 0;
+}
+
+bool physics_lib_init(uint32 p_tick_rate, uint32 p_ticks_max, bool p_threaded)
+{
+	assert(p_tick_rate > 0 && p_ticks_max > 0);
+
+	g_tick_time = 1.0f / p_tick_rate;
+	g_ticks_max = p_ticks_max;
+	g_time_owed = 0.0;
+
+	memset(&g_physics_stats, 0, sizeof(g_physics_stats));
+	memset(g_tick_ms, 0, sizeof(g_tick_ms));
+	g_physics_stats.m_tick_rate = p_tick_rate;
+
+	g_physics_lock = SDL_CreateMutex();
+	if (g_physics_lock == NULL) {
+		return false;
+	}
+
+	g_tick_clock = frametime_get_clock();
+
+	g_physics_quit = false;
+	g_physics_thread = NULL;
+	if (p_threaded) {
+		g_physics_thread = SDL_CreateThread(physics_thread, NULL);
+		if (g_physics_thread == NULL) {
+			SDL_DestroyMutex(g_physics_lock);
+			g_physics_lock = NULL;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void physics_lib_shutdown()
+{
+	if (g_physics_thread) {
+		g_physics_quit = true;
+		SDL_WaitThread(g_physics_thread, NULL);
+		g_physics_thread = NULL;
+	}
+
+	if (g_physics_lock) {
+		SDL_DestroyMutex(g_physics_lock);
+		g_physics_lock = NULL;
+	}
+
+	MEMORY_FREE(g_cloth_sims);
+	MEMORY_FREE(g_tick_sims);
+	MEMORY_FREE(g_cloth_sim_jobs);
+	g_cloth_sims = g_tick_sims = g_cloth_sim_jobs = NULL;
+	g_cloth_sim_count = g_cloth_sims_max = 0;
+	g_tick_sim_count = g_tick_sims_max = 0;
+}
 
 void physics_lib_cloth_sim_add(cloth_sim *p_cloth_sim)
 {
-	g_cloth_sims.push_back(p_cloth_sim);
+	assert(job_system_is_main_thread());
+
+	SDL_mutexP(g_physics_lock);
+	if (g_cloth_sim_count == g_cloth_sims_max) {
+		g_cloth_sims_max = (g_cloth_sims_max == 0) ? 16 : g_cloth_sims_max * 2;
+		g_cloth_sims = (cloth_sim **)MEMORY_REALLOC(g_cloth_sims, sizeof(cloth_sim *) * g_cloth_sims_max, MEMORY_TAG_PHYSICS);
+		assert(g_cloth_sims != NULL);
+	}
+
+	g_cloth_sims[g_cloth_sim_count++] = p_cloth_sim;
+	SDL_mutexV(g_physics_lock);
 }
 
 void physics_lib_simulate(real p_frametime)
 {
-	std::list<cloth_sim *>::iterator cloth_sim_iter;
-	for (cloth_sim_iter = g_cloth_sims.begin(); cloth_sim_iter != g_cloth_sims.end(); ++cloth_sim_iter) {
-		(*cloth_sim_iter)->simulate(p_frametime);
+	assert(job_system_is_main_thread());
+
+	real alpha;
+	if (g_physics_thread) {
+		SDL_mutexP(g_physics_lock);
+		alpha = (real)((frametime_get_clock() - g_tick_clock) / g_tick_time);
+		SDL_mutexV(g_physics_lock);
+	} else {
+		g_time_owed = run_ticks(g_time_owed + p_frametime);
+		alpha = (real)(g_time_owed / g_tick_time);
+	}
+
+	// Stalled physics leaves the cloth on its newest tick rather than guessing past it
+	alpha = (alpha < 0.0f) ? 0.0f : ((alpha > 1.0f) ? 1.0f : alpha);
+
+	SDL_mutexP(g_physics_lock);
+	g_physics_stats.m_alpha = alpha;
+	uint32 count = g_cloth_sim_count;
+	SDL_mutexV(g_physics_lock);
+
+	for (uint32 i = 0; i < count; ++i) {
+		g_cloth_sims[i]->interpolate(alpha);
+	}
+}
+
+physics_lib_stats const* physics_lib_get_stats()
+{
+	SDL_mutexP(g_physics_lock);
+	g_physics_stats_read = g_physics_stats;
+
+	uint32 count = (g_physics_stats.m_ticks < PHYSICS_LIB_STATS_TICKS) ? g_physics_stats.m_ticks : PHYSICS_LIB_STATS_TICKS;
+	real total = 0.0f;
+	real tick_max = 0.0f;
+	for (uint32 i = 0; i < count; ++i) {
+		total += g_tick_ms[i];
+		tick_max = (g_tick_ms[i] > tick_max) ? g_tick_ms[i] : tick_max;
 	}
+	SDL_mutexV(g_physics_lock);
+
+	g_physics_stats_read.m_tick_ms_avg = (count > 0) ? total / count : 0.0f;
+	g_physics_stats_read.m_tick_ms_max = tick_max;
+
+	return &g_physics_stats_read;
+}
+
+void physics_lib_print_stats()
+{
+	physics_lib_stats const* stats = physics_lib_get_stats();
+
+	char buffer[256];
+	sprintf(buffer, "physics: %lu Hz  %lu ticks  %lu dropped  tick %.2f ms avg %.2f ms max  alpha %.2f  %s\n",
+		stats->m_tick_rate, stats->m_ticks, stats->m_ticks_dropped, stats->m_tick_ms_avg, stats->m_tick_ms_max, stats->m_alpha,
+		g_physics_thread ? "threaded" : "inline");
+	print(buffer);
+}
+
+static uint32 simulate_frames(cloth_sim *p_cloth_sim, uint32 p_frames)
+{
+	uint32 start = SDL_GetTicks();
+	for (uint32 i = 0; i < p_frames; ++i) {
+		p_cloth_sim->simulate(1.0f / 30.0f);
+	}
+
+	return SDL_GetTicks() - start;
+}
+
+static real get_max_difference(cloth_sim const* p_a, cloth_sim const* p_b)
+{
+	real max_difference = 0.0f;
+	Vector3 const* a_pos = p_a->get_positions();
+	Vector3 const* b_pos = p_b->get_positions();
+	for (uint32 i = 0; i < p_a->get_particle_count(); ++i) {
+		Vector3 diff = a_pos[i] - b_pos[i];
+		real difference = diff.len();
+		if (difference > max_difference) {
+			max_difference = difference;
+		}
+	}
+
+	return max_difference;
+}
+
+void physics_lib_benchmark(uint32 p_width, uint32 p_height, uint32 p_frames)
+{
+	cape *serial = new(MEMORY_ALLOC(sizeof(cape), MEMORY_TAG_PHYSICS)) cape(p_width, p_height);
+	cape *parallel = new(MEMORY_ALLOC(sizeof(cape), MEMORY_TAG_PHYSICS)) cape(p_width, p_height);
+	serial->init();
+	parallel->init();
+	serial->set_parallel(false);
+
+	// The colored order is a different Gauss-Seidel sweep, so the two only agree to a tolerance. The first
+	// frame shows how far apart one step puts them, after that the swinging cloth magnifies the difference.
+	simulate_frames(serial, 1);
+	simulate_frames(parallel, 1);
+	real step_difference = get_max_difference(serial, parallel);
+
+	uint32 serial_ms = simulate_frames(serial, p_frames);
+	uint32 parallel_ms = simulate_frames(parallel, p_frames);
+
+	char buffer[256];
+	sprintf(buffer, "physics: cape %lux%lu %lu frames  serial %5lu ms  parallel %5lu ms  %lu threads  difference %f first frame, %f last\n",
+		p_width, p_height, p_frames, serial_ms, parallel_ms, job_system_get_thread_count() + 1, step_difference, get_max_difference(serial, parallel));
+	print(buffer);
+
+	MEMORY_DELETE(serial);
+	MEMORY_DELETE(parallel);
 }
\ No newline at end of file
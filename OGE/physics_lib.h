@@ -3,10 +3,49 @@
 
 #include "core_types.h"
 
+// Print serial against parallel cloth solver timings at startup
+//#define PHYSICS_BENCHMARK
+
+// Cloth sims are built with a 1/30 s timestep, ticking at the same rate steps each of them once a tick
+#define PHYSICS_LIB_TICK_RATE_DEFAULT (30)
+
+// Most ticks run back to back before the time still owed is dropped
+#define PHYSICS_LIB_TICKS_MAX_DEFAULT (4)
+
+// Ticks the tick cost stats are taken over
+#define PHYSICS_LIB_STATS_TICKS (64)
+
 class cloth_sim;
 
+class physics_lib_stats
+{
+public:
+	uint32 m_tick_rate;
+	uint32 m_ticks;
+	// Ticks skipped because more than the most allowed were due at once
+	uint32 m_ticks_dropped;
+	real m_tick_ms_avg;
+	real m_tick_ms_max;
+	// How far between the previous and the current tick the last frame was drawn
+	real m_alpha;
+};
+
+// Cloth sims step at a fixed p_tick_rate. Threaded they tick on a physics thread of their own, on the
+// wall clock, otherwise physics_lib_simulate runs the ticks the frame time adds up to.
+bool physics_lib_init(uint32 p_tick_rate, uint32 p_ticks_max, bool p_threaded);
+void physics_lib_shutdown();
+
+// Main thread, the physics thread picks the sim up at its next tick
 void physics_lib_cloth_sim_add(cloth_sim *p_cloth_sim);
 
+// Main thread, once a frame before rendering. Runs the ticks due if there's no physics thread, then
+// interpolates every cloth sim between its last two ticks.
 void physics_lib_simulate(real p_frametime);
 
+physics_lib_stats const* physics_lib_get_stats();
+void physics_lib_print_stats();
+
+// Steps a p_width by p_height cape p_frames times with the serial and the parallel solver
+void physics_lib_benchmark(uint32 p_width, uint32 p_height, uint32 p_frames);
+
 #endif // __PHYSICS_LIB_H_
\ No newline at end of file
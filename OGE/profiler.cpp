@@ -0,0 +1,521 @@
+#include "profiler.h"
+
+#include "memory_lib.h"
+#include "job_system.h"
+#include "assert.h"
+
+#include "SDL.h"
+#include "SDL_thread.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif
+
+#if defined(PROFILER_ENABLED)
+
+#ifdef _WIN32
+#define PROFILER_THREAD_LOCAL __declspec(thread)
+#define profiler_compiler_barrier() _ReadWriteBarrier()
+#else
+#define PROFILER_THREAD_LOCAL __thread
+#define profiler_compiler_barrier() __asm__ __volatile__("" ::: "memory")
+#endif
+
+#define PROFILER_MARKER_SLOTS (PROFILER_MARKERS_MAX * 2)
+#define PROFILER_THREAD_NAME_LENGTH (32)
+
+class profiler_event
+{
+public:
+	char const* m_name;
+	uint64 m_begin;
+	uint64 m_end;
+};
+
+// One per thread, written only by its thread and read only by profiler_frame. Stores stay in order on
+// x86, so only the compiler needs holding back for the ring to work without a lock.
+class profiler_thread
+{
+public:
+	profiler_event m_events[PROFILER_THREAD_EVENTS];
+	volatile uint32 m_write;
+	volatile uint32 m_read;
+	// Only ever counts up, profiler_frame diffs it against what it has already added
+	volatile uint32 m_dropped;
+	uint32 m_dropped_seen;
+	char m_name[PROFILER_THREAD_NAME_LENGTH];
+};
+
+class profiler_marker
+{
+public:
+	char const* m_name;
+	uint64 m_frame_ticks;
+	uint32 m_frame_calls;
+	double m_window_ms_min;
+	double m_window_ms_max;
+	double m_window_ms_total;
+	uint32 m_window_calls;
+	profiler_marker_stats m_stats;
+};
+
+// Marker name pointers to markers. The same text in two files may be two pointers, both map to one marker.
+class profiler_marker_slot
+{
+public:
+	char const* m_name;
+	uint32 m_marker;
+};
+
+// An event kept for a capture, a NULL name marks the start of a frame
+class profiler_capture_event
+{
+public:
+	profiler_event m_event;
+	uint32 m_thread;
+};
+
+static SDL_mutex *g_profiler_lock = NULL;
+static profiler_thread *g_profiler_threads[PROFILER_THREADS_MAX];
+static uint32 g_profiler_thread_count = 0;
+static PROFILER_THREAD_LOCAL profiler_thread *g_profiler_thread = NULL;
+
+#ifdef _WIN32
+static double g_profiler_ms_per_tick = 0.0;
+#endif
+
+static profiler_marker g_markers[PROFILER_MARKERS_MAX];
+static uint32 g_marker_count = 0;
+static profiler_marker_slot g_marker_slots[PROFILER_MARKER_SLOTS];
+static uint32 g_marker_slot_count = 0;
+static uint32 g_window_frames = 0;
+static uint32 g_dropped = 0;
+
+static char g_capture_filename[256];
+static uint32 g_capture_frames_left = 0;
+static profiler_capture_event *g_capture_events = NULL;
+static uint32 g_capture_event_count = 0;
+static uint32 g_capture_events_max = 0;
+static uint64 g_capture_begin = 0;
+
+static void print(char const* p_text)
+{
+#ifdef _WIN32
+	OutputDebugStringA(p_text);
+#else
+	fputs(p_text, stdout);
+#endif
+}
+
+static profiler_thread *get_thread()
+{
+	profiler_thread *thread = g_profiler_thread;
+	if (thread != NULL || g_profiler_lock == NULL) {
+		return thread;
+	}
+
+	SDL_mutexP(g_profiler_lock);
+	if (g_profiler_thread_count < PROFILER_THREADS_MAX) {
+		thread = (profiler_thread *)MEMORY_CALLOC(sizeof(profiler_thread), MEMORY_TAG_GENERAL);
+		assert(thread != NULL);
+		sprintf(thread->m_name, "thread %lu", g_profiler_thread_count);
+		g_profiler_threads[g_profiler_thread_count++] = thread;
+	}
+	SDL_mutexV(g_profiler_lock);
+
+	g_profiler_thread = thread;
+	return thread;
+}
+
+static uint32 find_marker(char const* p_name)
+{
+	uint32 slot = (uint32)(((size_t)p_name >> 2) * 2654435761u) & (PROFILER_MARKER_SLOTS - 1);
+	while (g_marker_slots[slot].m_name != NULL) {
+		if (g_marker_slots[slot].m_name == p_name) {
+			return g_marker_slots[slot].m_marker;
+		}
+
+		slot = (slot + 1) & (PROFILER_MARKER_SLOTS - 1);
+	}
+
+	// Leave one slot free so lookups always end
+	if (g_marker_slot_count + 1 == PROFILER_MARKER_SLOTS) {
+		return PROFILER_MARKERS_MAX;
+	}
+
+	uint32 marker = 0;
+	while (marker < g_marker_count && strcmp(g_markers[marker].m_name, p_name) != 0) {
+		marker++;
+	}
+
+	if (marker == g_marker_count) {
+		if (g_marker_count == PROFILER_MARKERS_MAX) {
+			return PROFILER_MARKERS_MAX;
+		}
+
+		memset(&g_markers[marker], 0, sizeof(profiler_marker));
+		g_markers[marker].m_name = p_name;
+		g_markers[marker].m_window_ms_min = -1.0;
+		g_markers[marker].m_stats.m_name = p_name;
+		g_marker_count++;
+	}
+
+	g_marker_slots[slot].m_name = p_name;
+	g_marker_slots[slot].m_marker = marker;
+	g_marker_slot_count++;
+
+	return marker;
+}
+
+static void capture_add(profiler_event const* p_event, uint32 p_thread)
+{
+	if (g_capture_event_count == g_capture_events_max) {
+		g_capture_events_max = (g_capture_events_max == 0) ? 4096 : g_capture_events_max * 2;
+		g_capture_events = (profiler_capture_event *)MEMORY_REALLOC(g_capture_events, sizeof(profiler_capture_event) * g_capture_events_max, MEMORY_TAG_GENERAL);
+		assert(g_capture_events != NULL);
+	}
+
+	g_capture_events[g_capture_event_count].m_event = *p_event;
+	g_capture_events[g_capture_event_count].m_thread = p_thread;
+	g_capture_event_count++;
+}
+
+static void write_string(FILE *p_file, char const* p_string)
+{
+	fputc('"', p_file);
+	for (char const* c = p_string; *c != '\0'; ++c) {
+		if (*c == '"' || *c == '\\') {
+			fputc('\\', p_file);
+		}
+		fputc(*c, p_file);
+	}
+	fputc('"', p_file);
+}
+
+// Chrome trace event format: complete events with microsecond timestamps, one tid per profiled thread
+static void write_capture()
+{
+	FILE *file = fopen(g_capture_filename, "w");
+	if (file == NULL) {
+		print("profiler: couldn't open the capture file\n");
+		return;
+	}
+
+	fputs("{\"traceEvents\":[\n", file);
+
+	SDL_mutexP(g_profiler_lock);
+	uint32 thread_count = g_profiler_thread_count;
+	SDL_mutexV(g_profiler_lock);
+
+	for (uint32 i = 0; i < thread_count; ++i) {
+		fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%lu,\"args\":{\"name\":", (i > 0) ? ",\n" : "", i);
+		write_string(file, g_profiler_threads[i]->m_name);
+		fputs("}}", file);
+	}
+
+	for (uint32 i = 0; i < g_capture_event_count; ++i) {
+		profiler_capture_event const* capture_event = &g_capture_events[i];
+		double begin_us = profiler_ticks_to_ms(capture_event->m_event.m_begin - g_capture_begin) * 1000.0;
+		if (capture_event->m_event.m_name == NULL) {
+			fprintf(file, ",\n{\"name\":\"frame\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":0,\"ts\":%.3f}", begin_us);
+			continue;
+		}
+
+		double duration_us = profiler_ticks_to_ms(capture_event->m_event.m_end - capture_event->m_event.m_begin) * 1000.0;
+		fputs(",\n{\"name\":", file);
+		write_string(file, capture_event->m_event.m_name);
+		fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%lu,\"ts\":%.3f,\"dur\":%.3f}", capture_event->m_thread, begin_us, duration_us);
+	}
+
+	fputs("\n]}\n", file);
+	fclose(file);
+
+	char buffer[512];
+	sprintf(buffer, "profiler: wrote %lu events to %s\n", g_capture_event_count, g_capture_filename);
+	print(buffer);
+}
+
+bool profiler_init()
+{
+#ifdef _WIN32
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	g_profiler_ms_per_tick = 1000.0 / (double)frequency.QuadPart;
+#endif
+
+	g_profiler_lock = SDL_CreateMutex();
+	if (g_profiler_lock == NULL) {
+		return false;
+	}
+
+	g_profiler_thread_count = 0;
+	g_marker_count = 0;
+	g_marker_slot_count = 0;
+	memset(g_marker_slots, 0, sizeof(g_marker_slots));
+	g_window_frames = 0;
+	g_dropped = 0;
+	g_capture_frames_left = 0;
+
+	profiler_set_thread_name("main");
+
+	return true;
+}
+
+void profiler_shutdown()
+{
+	for (uint32 i = 0; i < g_profiler_thread_count; ++i) {
+		MEMORY_FREE(g_profiler_threads[i]);
+		g_profiler_threads[i] = NULL;
+	}
+	g_profiler_thread_count = 0;
+	g_profiler_thread = NULL;
+
+	MEMORY_FREE(g_capture_events);
+	g_capture_events = NULL;
+	g_capture_event_count = g_capture_events_max = 0;
+	g_capture_frames_left = 0;
+
+	if (g_profiler_lock) {
+		SDL_DestroyMutex(g_profiler_lock);
+		g_profiler_lock = NULL;
+	}
+}
+
+uint64 profiler_get_ticks()
+{
+#ifdef _WIN32
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	return (uint64)now.QuadPart;
+#else
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	return ((uint64)now.tv_sec * 1000000) + now.tv_usec;
+#endif
+}
+
+double profiler_ticks_to_ms(uint64 p_ticks)
+{
+#ifdef _WIN32
+	return (double)p_ticks * g_profiler_ms_per_tick;
+#else
+	return (double)p_ticks * 0.001;
+#endif
+}
+
+void profiler_set_thread_name(char const* p_name)
+{
+	profiler_thread *thread = get_thread();
+	if (thread) {
+		strncpy(thread->m_name, p_name, PROFILER_THREAD_NAME_LENGTH - 1);
+		thread->m_name[PROFILER_THREAD_NAME_LENGTH - 1] = '\0';
+	}
+}
+
+void profiler_record(char const* p_name, uint64 p_begin, uint64 p_end)
+{
+	profiler_thread *thread = get_thread();
+	if (thread == NULL) {
+		return;
+	}
+
+	uint32 write = thread->m_write;
+	if (write - thread->m_read >= PROFILER_THREAD_EVENTS) {
+		thread->m_dropped++;
+		return;
+	}
+
+	profiler_event *event = &thread->m_events[write % PROFILER_THREAD_EVENTS];
+	event->m_name = p_name;
+	event->m_begin = p_begin;
+	event->m_end = p_end;
+
+	// The event has to be written before it's published
+	profiler_compiler_barrier();
+	thread->m_write = write + 1;
+}
+
+void profiler_frame()
+{
+	assert(job_system_is_main_thread());
+
+	uint64 frame_begin = profiler_get_ticks();
+
+	SDL_mutexP(g_profiler_lock);
+	uint32 thread_count = g_profiler_thread_count;
+	SDL_mutexV(g_profiler_lock);
+
+	bool capturing = g_capture_frames_left > 0;
+
+	for (uint32 i = 0; i < thread_count; ++i) {
+		profiler_thread *thread = g_profiler_threads[i];
+		uint32 write = thread->m_write;
+		profiler_compiler_barrier();
+
+		for (uint32 read = thread->m_read; read != write; ++read) {
+			profiler_event const* event = &thread->m_events[read % PROFILER_THREAD_EVENTS];
+			uint32 marker = find_marker(event->m_name);
+			if (marker < PROFILER_MARKERS_MAX) {
+				g_markers[marker].m_frame_ticks += event->m_end - event->m_begin;
+				g_markers[marker].m_frame_calls++;
+			}
+
+			if (capturing && event->m_begin >= g_capture_begin) {
+				capture_add(event, i);
+			}
+		}
+
+		// Done with the slots before handing them back
+		profiler_compiler_barrier();
+		thread->m_read = write;
+
+		uint32 dropped = thread->m_dropped;
+		g_dropped += dropped - thread->m_dropped_seen;
+		thread->m_dropped_seen = dropped;
+	}
+
+	for (uint32 i = 0; i < g_marker_count; ++i) {
+		profiler_marker *marker = &g_markers[i];
+		double ms = profiler_ticks_to_ms(marker->m_frame_ticks);
+		if (marker->m_window_ms_min < 0.0 || ms < marker->m_window_ms_min) {
+			marker->m_window_ms_min = ms;
+		}
+		if (ms > marker->m_window_ms_max) {
+			marker->m_window_ms_max = ms;
+		}
+		marker->m_window_ms_total += ms;
+		marker->m_window_calls += marker->m_frame_calls;
+
+		marker->m_frame_ticks = 0;
+		marker->m_frame_calls = 0;
+	}
+
+	if (++g_window_frames == PROFILER_STATS_FRAMES) {
+		for (uint32 i = 0; i < g_marker_count; ++i) {
+			profiler_marker *marker = &g_markers[i];
+			marker->m_stats.m_ms_min = (real)marker->m_window_ms_min;
+			marker->m_stats.m_ms_avg = (real)(marker->m_window_ms_total / PROFILER_STATS_FRAMES);
+			marker->m_stats.m_ms_max = (real)marker->m_window_ms_max;
+			marker->m_stats.m_calls_avg = (real)marker->m_window_calls / PROFILER_STATS_FRAMES;
+
+			marker->m_window_ms_min = -1.0;
+			marker->m_window_ms_max = 0.0;
+			marker->m_window_ms_total = 0.0;
+			marker->m_window_calls = 0;
+		}
+
+		g_window_frames = 0;
+	}
+
+	if (capturing) {
+		if (--g_capture_frames_left == 0) {
+			write_capture();
+			g_capture_event_count = 0;
+		} else {
+			profiler_event frame;
+			frame.m_name = NULL;
+			frame.m_begin = frame.m_end = frame_begin;
+			capture_add(&frame, 0);
+		}
+	}
+}
+
+void profiler_capture(char const* p_filename, uint32 p_frames)
+{
+	assert(job_system_is_main_thread());
+
+	if (g_capture_frames_left > 0 || p_frames == 0) {
+		return;
+	}
+
+	strncpy(g_capture_filename, p_filename, sizeof(g_capture_filename) - 1);
+	g_capture_filename[sizeof(g_capture_filename) - 1] = '\0';
+
+	// Counting this frame's profiler_frame, which only collects what came before the request
+	g_capture_frames_left = p_frames + 1;
+	g_capture_event_count = 0;
+	g_capture_begin = profiler_get_ticks();
+}
+
+uint32 profiler_get_marker_count()
+{
+	return g_marker_count;
+}
+
+profiler_marker_stats const* profiler_get_marker_stats(uint32 p_index)
+{
+	assert(p_index < g_marker_count);
+	return &g_markers[p_index].m_stats;
+}
+
+void profiler_print_stats()
+{
+	char buffer[256];
+	sprintf(buffer, "profiler: %lu markers over %lu frames  %lu events dropped\n", g_marker_count, (uint32)PROFILER_STATS_FRAMES, g_dropped);
+	print(buffer);
+
+	for (uint32 i = 0; i < g_marker_count; ++i) {
+		profiler_marker_stats const* stats = &g_markers[i].m_stats;
+		sprintf(buffer, "profile: %-28s %7.3f ms min  %7.3f ms avg  %7.3f ms max  %6.1f calls\n",
+			stats->m_name, stats->m_ms_min, stats->m_ms_avg, stats->m_ms_max, stats->m_calls_avg);
+		print(buffer);
+	}
+}
+
+#else
+
+bool profiler_init()
+{
+	return true;
+}
+
+void profiler_shutdown()
+{
+}
+
+uint64 profiler_get_ticks()
+{
+	return 0;
+}
+
+double profiler_ticks_to_ms(uint64 p_ticks)
+{
+	return 0.0;
+}
+
+void profiler_set_thread_name(char const* p_name)
+{
+}
+
+void profiler_record(char const* p_name, uint64 p_begin, uint64 p_end)
+{
+}
+
+void profiler_frame()
+{
+}
+
+void profiler_capture(char const* p_filename, uint32 p_frames)
+{
+}
+
+uint32 profiler_get_marker_count()
+{
+	return 0;
+}
+
+profiler_marker_stats const* profiler_get_marker_stats(uint32 p_index)
+{
+	return NULL;
+}
+
+void profiler_print_stats()
+{
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,89 @@
+#ifndef __PROFILER_H_
+#define __PROFILER_H_
+
+#include "core_types.h"
+
+// Define PROFILER_DISABLED to compile every marker out, the functions below are then empty
+#if !defined(PROFILER_DISABLED)
+#define PROFILER_ENABLED
+#endif
+
+#define PROFILER_THREADS_MAX (32)
+
+// Events a thread can have recorded before the next profiler_frame, more are dropped and counted
+#define PROFILER_THREAD_EVENTS (16384)
+
+// Distinct marker names, a power of two
+#define PROFILER_MARKERS_MAX (256)
+
+// Frames the min/avg/max are taken over
+#define PROFILER_STATS_FRAMES (120)
+
+#define PROFILER_CAPTURE_FRAMES_DEFAULT (60)
+
+class profiler_marker_stats
+{
+public:
+	char const* m_name;
+	// Time a frame spent in the marker, summed over every thread and every call
+	real m_ms_min;
+	real m_ms_avg;
+	real m_ms_max;
+	real m_calls_avg;
+};
+
+// Call after memory_lib_init and before any other threads are started
+bool profiler_init();
+void profiler_shutdown();
+
+// The high resolution clock the markers use
+uint64 profiler_get_ticks();
+double profiler_ticks_to_ms(uint64 p_ticks);
+
+// Names the calling thread in captures
+void profiler_set_thread_name(char const* p_name);
+
+// Any thread. p_name must outlive the profiler, markers are told apart by their text.
+void profiler_record(char const* p_name, uint64 p_begin, uint64 p_end);
+
+// Main thread, once a frame. Collects every thread's events into the marker stats and any capture.
+void profiler_frame();
+
+// Keeps every event of the next p_frames frames and then writes them to p_filename as Chrome trace
+// JSON, for chrome://tracing or Perfetto
+void profiler_capture(char const* p_filename, uint32 p_frames);
+
+// Markers as of the last full PROFILER_STATS_FRAMES frames
+uint32 profiler_get_marker_count();
+profiler_marker_stats const* profiler_get_marker_stats(uint32 p_index);
+
+void profiler_print_stats();
+
+#if defined(PROFILER_ENABLED)
+
+class profiler_scope
+{
+public:
+	profiler_scope(char const* p_name) : m_name(p_name), m_begin(profiler_get_ticks()) {}
+	~profiler_scope() { profiler_record(m_name, m_begin, profiler_get_ticks()); }
+
+private:
+	char const* m_name;
+	uint64 m_begin;
+};
+
+#define PROFILER_CONCAT_INNER(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_INNER(a, b)
+
+// Times the rest of the enclosing block
+#define PROFILE_SCOPE(name) profiler_scope PROFILER_CONCAT(profile_scope_, __LINE__)(name)
+#define PROFILE_THREAD_NAME(name) profiler_set_thread_name(name)
+
+#else
+
+#define PROFILE_SCOPE(name)
+#define PROFILE_THREAD_NAME(name)
+
+#endif
+
+#endif /* __PROFILER_H_ */
\ No newline at end of file
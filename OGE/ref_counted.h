@@ -3,15 +3,26 @@
 
 #include "core_types.h"
 
+// Slot index in the low 16 bits, the slot's generation in the high 16 so a handle to a freed object goes stale
+typedef uint32 ref_counted_handle;
+
+#define REF_COUNTED_HANDLE_INVALID (0xffffffff)
+#define REF_COUNTED_HANDLE_INDEX_BITS (16)
+#define REF_COUNTED_HANDLE_INDEX_MASK ((1 << REF_COUNTED_HANDLE_INDEX_BITS) - 1)
+
 template<class T, uint32 T_MAX_NAME_LEN>
 class ref_count_store
 {
 public:
 	T m_data;
 	char m_name[T_MAX_NAME_LEN];
+	uint32 m_name_hash;
 	uint32 m_reference_count;
 };
 
+// Named, reference counted objects. Names are found through an open addressing table of their hashes.
+// T_ALLOCATOR needs init/shutdown/allocate/destroy, get_from_index (NULL for a free slot), get_index and get_index_max,
+// allocator_pool and allocator_array both fit. get_from_dense also needs get_dense, which only allocator_pool has.
 template<class T, uint32 T_MAX_NAME_LEN, typename T_ALLOCATOR>
 class ref_counted
 {
@@ -19,17 +30,46 @@ public:
 	void init(uint32 p_elements_max);
 	void shutdown();
 
+	// Returns the existing object with this name, or a new one, with a reference added either way
 	T* create(char p_name[T_MAX_NAME_LEN]);
+	// Find without creating, NULL if nothing has the name
+	T* find(char const* p_name);
+	// Another reference to an object the caller already holds one on
+	void add_ref(T* p_obj);
+	// Drop a reference, the object is destroyed when the last one goes
 	void release(T* p_obj);
 
 	uint32 get_allocated_count();
+	// Upper bound for get_from_index, slots below it may be empty
+	uint32 get_index_max();
+	// Adds a reference, NULL for an empty slot
 	T * get_from_index(uint32 p_index);
+	// Adds a reference. Every index below get_allocated_count is live, the order changes as objects are destroyed.
+	T * get_from_dense(uint32 p_dense_index);
+
+	ref_counted_handle get_handle(T const* p_obj);
+	// Adds a reference, NULL once the object the handle was taken from has been destroyed
+	T * get_from_handle(ref_counted_handle p_handle);
 
 private:
-	static bool find(ref_count_store<T, T_MAX_NAME_LEN> const* p_obj_a, ref_count_store<T, T_MAX_NAME_LEN> const* p_obj_b);
+	typedef ref_count_store<T, T_MAX_NAME_LEN> store;
+
+	class hash_entry
+	{
+	public:
+		uint32 m_hash;
+		uint32 m_index;
+	};
+
+	uint32 find_entry(char const* p_name, uint32 p_hash);
 
 	T_ALLOCATOR m_allocator;
 	uint32 m_elements_max;
+
+	hash_entry *m_hash_entries;
+	uint32 m_hash_size;
+
+	uint32 *m_generations;
 };
 
 #include "ref_counted.inl"
@@ -1,73 +1,209 @@
-
+#include <stdlib.h>
 #include <string.h>
 
-template<class T, uint32 T_MAX_NAME_LEN, class T_ALLOCATOR>
-bool ref_counted<T, T_MAX_NAME_LEN, T_ALLOCATOR>::find(ref_count_store<T, T_MAX_NAME_LEN> const* p_obj_a, ref_count_store<T, T_MAX_NAME_LEN> const* p_obj_b)
-{
-	if (!strncmp(p_obj_a->m_name, p_obj_b->m_name, T_MAX_NAME_LEN)) {
-		return true;
-	}
+#include "assert.h"
+#include "hash.h"
 
-	return false;
-}
+#define REF_COUNTED_HASH_EMPTY (0xffffffff)
+#define REF_COUNTED_HASH_DELETED (0xfffffffe)
 
 template<class T, uint32 T_MAX_NAME_LEN, class T_ALLOCATOR>
 void ref_counted<T, T_MAX_NAME_LEN, T_ALLOCATOR>::init(uint32 p_elements_max)
 {
+	assert(p_elements_max <= REF_COUNTED_HANDLE_INDEX_MASK);
+
 	m_allocator.init(p_elements_max);
 	m_elements_max = p_elements_max;
+
+	// Keep the table at most half full so probe runs stay short
+	m_hash_size = 16;
+	while (m_hash_size < p_elements_max * 2) {
+		m_hash_size *= 2;
+	}
+
+	m_hash_entries = (hash_entry *)malloc(sizeof(hash_entry) * m_hash_size);
+	assert(m_hash_entries != NULL);
+	for (uint32 i = 0; i < m_hash_size; ++i) {
+		m_hash_entries[i].m_index = REF_COUNTED_HASH_EMPTY;
+	}
+
+	m_generations = (uint32 *)calloc(p_elements_max, sizeof(uint32));
+	assert(m_generations != NULL);
 }
 
 template<class T, uint32 T_MAX_NAME_LEN, class T_ALLOCATOR>
 void ref_counted<T, T_MAX_NAME_LEN, T_ALLOCATOR>::shutdown()
 {
 	m_allocator.shutdown();
+
+	free(m_hash_entries);
+	m_hash_entries = NULL;
+	m_hash_size = 0;
+
+	free(m_generations);
+	m_generations = NULL;
 }
 
+// Table slot holding p_name, or REF_COUNTED_HASH_EMPTY
 template<class T, uint32 T_MAX_NAME_LEN, class T_ALLOCATOR>
-T* ref_counted<T, T_MAX_NAME_LEN, T_ALLOCATOR>::create(char p_name[T_MAX_NAME_LEN])
+uint32 ref_counted<T, T_MAX_NAME_LEN, T_ALLOCATOR>::find_entry(char const* p_name, uint32 p_hash)
 {
-	// Do we already have this texture loaded?
-	// If so, increment reference count and return
-	ref_count_store<T, T_MAX_NAME_LEN> tmp_store;
-	strncpy(tmp_store.m_name, p_name, m_elements_max);
-	ref_count_store<T, T_MAX_NAME_LEN> *ref_store = m_allocator.element_find(&tmp_store, find);
+	uint32 mask = m_hash_size - 1;
+	uint32 slot = p_hash & mask;
+
+	for (uint32 i = 0; i < m_hash_size; ++i, slot = (slot + 1) & mask) {
+		hash_entry const& entry = m_hash_entries[slot];
+		if (entry.m_index == REF_COUNTED_HASH_EMPTY) {
+			break;
+		}
+
+		if (entry.m_index != REF_COUNTED_HASH_DELETED && entry.m_hash == p_hash) {
+			store *ref_store = m_allocator.get_from_index(entry.m_index);
+			// Names are stored and hashed truncated to T_MAX_NAME_LEN - 1 characters, compare the same
+			if (!strncmp(ref_store->m_name, p_name, T_MAX_NAME_LEN - 1)) {
+				return slot;
+			}
+		}
+	}
+
+	return REF_COUNTED_HASH_EMPTY;
+}
 
-	if (ref_store != NULL) {
+template<class T, uint32 T_MAX_NAME_LEN, class T_ALLOCATOR>
+T* ref_counted<T, T_MAX_NAME_LEN, T_ALLOCATOR>::create(char p_name[T_MAX_NAME_LEN])
+{
+	// Already loaded? Then just add a reference
+	uint32 hash = hash_string(p_name, T_MAX_NAME_LEN - 1);
+	uint32 slot = find_entry(p_name, hash);
+	if (slot != REF_COUNTED_HASH_EMPTY) {
+		store *ref_store = m_allocator.get_from_index(m_hash_entries[slot].m_index);
 		ref_store->m_reference_count++;
 		return &ref_store->m_data;
 	}
-		
-	ref_store = m_allocator.allocate();
+
+	store *ref_store = m_allocator.allocate();
 	if (ref_store == NULL) {
 		return NULL;
 	}
 
-	strncpy(ref_store->m_name, p_name, T_MAX_NAME_LEN);
+	strncpy(ref_store->m_name, p_name, T_MAX_NAME_LEN - 1);
+	ref_store->m_name[T_MAX_NAME_LEN - 1] = '\0';
+	ref_store->m_name_hash = hash;
 	ref_store->m_reference_count = 1;
-	
-	return (T *)&ref_store->m_data;
+
+	// First free slot along the probe run, deleted entries get reused
+	uint32 mask = m_hash_size - 1;
+	slot = hash & mask;
+	while (m_hash_entries[slot].m_index != REF_COUNTED_HASH_EMPTY && m_hash_entries[slot].m_index != REF_COUNTED_HASH_DELETED) {
+		slot = (slot + 1) & mask;
+	}
+
+	m_hash_entries[slot].m_hash = hash;
+	m_hash_entries[slot].m_index = m_allocator.get_index(ref_store);
+
+	return &ref_store->m_data;
+}
+
+template<class T, uint32 T_MAX_NAME_LEN, class T_ALLOCATOR>
+T* ref_counted<T, T_MAX_NAME_LEN, T_ALLOCATOR>::find(char const* p_name)
+{
+	uint32 slot = find_entry(p_name, hash_string(p_name, T_MAX_NAME_LEN - 1));
+	if (slot == REF_COUNTED_HASH_EMPTY) {
+		return NULL;
+	}
+
+	store *ref_store = m_allocator.get_from_index(m_hash_entries[slot].m_index);
+	ref_store->m_reference_count++;
+	return &ref_store->m_data;
+}
+
+template<class T, uint32 T_MAX_NAME_LEN, class T_ALLOCATOR>
+void ref_counted<T, T_MAX_NAME_LEN, T_ALLOCATOR>::add_ref(T* p_obj)
+{
+	store *ref_store = (store *)p_obj;
+	assert(ref_store->m_reference_count > 0);
+
+	ref_store->m_reference_count++;
 }
 
 template<class T, uint32 T_MAX_NAME_LEN, class T_ALLOCATOR>
 void ref_counted<T, T_MAX_NAME_LEN, T_ALLOCATOR>::release(T* p_obj)
 {
+	if (p_obj == NULL) {
+		return;
+	}
+
+	// m_data is the first member, so the object is its store
+	store *ref_store = (store *)p_obj;
+	assert(ref_store->m_reference_count > 0);
+
+	ref_store->m_reference_count--;
+	if (ref_store->m_reference_count > 0) {
+		return;
+	}
+
+	uint32 slot = find_entry(ref_store->m_name, ref_store->m_name_hash);
+	assert(slot != REF_COUNTED_HASH_EMPTY);
+	m_hash_entries[slot].m_index = REF_COUNTED_HASH_DELETED;
+
+	m_generations[m_allocator.get_index(ref_store)]++;
+	m_allocator.destroy(ref_store);
 }
 
 template<class T, uint32 T_MAX_NAME_LEN, class T_ALLOCATOR>
 uint32 ref_counted<T, T_MAX_NAME_LEN, T_ALLOCATOR>::get_allocated_count()
 {
-	return m_allocator.get_allocated_count();;
+	return m_allocator.get_allocated_count();
+}
+
+template<class T, uint32 T_MAX_NAME_LEN, class T_ALLOCATOR>
+uint32 ref_counted<T, T_MAX_NAME_LEN, T_ALLOCATOR>::get_index_max()
+{
+	return m_allocator.get_index_max();
 }
 
 template<class T, uint32 T_MAX_NAME_LEN, class T_ALLOCATOR>
 T * ref_counted<T, T_MAX_NAME_LEN, T_ALLOCATOR>::get_from_index(uint32 p_index)
 {
-	ref_count_store<T, T_MAX_NAME_LEN> *ref_store = m_allocator.get_from_index(p_index);
+	store *ref_store = m_allocator.get_from_index(p_index);
 	if (ref_store) {
 		ref_store->m_reference_count++;
 		return (T *)&ref_store->m_data;
 	}
 
 	return NULL;
+}
+
+template<class T, uint32 T_MAX_NAME_LEN, class T_ALLOCATOR>
+T * ref_counted<T, T_MAX_NAME_LEN, T_ALLOCATOR>::get_from_dense(uint32 p_dense_index)
+{
+	store *ref_store = m_allocator.get_dense(p_dense_index);
+	ref_store->m_reference_count++;
+	return (T *)&ref_store->m_data;
+}
+
+template<class T, uint32 T_MAX_NAME_LEN, class T_ALLOCATOR>
+ref_counted_handle ref_counted<T, T_MAX_NAME_LEN, T_ALLOCATOR>::get_handle(T const* p_obj)
+{
+	if (p_obj == NULL) {
+		return REF_COUNTED_HANDLE_INVALID;
+	}
+
+	uint32 index = m_allocator.get_index((store const*)p_obj);
+	return ((m_generations[index] << REF_COUNTED_HANDLE_INDEX_BITS) | index) & 0xffffffff;
+}
+
+template<class T, uint32 T_MAX_NAME_LEN, class T_ALLOCATOR>
+T * ref_counted<T, T_MAX_NAME_LEN, T_ALLOCATOR>::get_from_handle(ref_counted_handle p_handle)
+{
+	if (p_handle == REF_COUNTED_HANDLE_INVALID) {
+		return NULL;
+	}
+
+	uint32 index = p_handle & REF_COUNTED_HANDLE_INDEX_MASK;
+	if (index >= m_elements_max || ((m_generations[index] << REF_COUNTED_HANDLE_INDEX_BITS) & 0xffffffff) != (p_handle & ~REF_COUNTED_HANDLE_INDEX_MASK)) {
+		return NULL;
+	}
+
+	return get_from_index(index);
 }
\ No newline at end of file
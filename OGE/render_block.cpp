@@ -1,26 +1,167 @@
 #include "render_block.h"
 
 #include "render_lib.h"
+#include "memory_lib.h"
+#include "render_stats.h"
 #include "glew/glew.h"
 
+#include <stdlib.h>
+#include <stddef.h>
+#include <math.h>
+
+#define BUFFER_OFFSET(i) ((char *)NULL + (i))
+
 render_block::render_block()
 {
 	m_prepared = false;
+	m_cpu_data_mapped = false;
+}
+
+void render_block::compute_bounds()
+{
+	if (m_pos == NULL || m_vertex_count == 0) {
+		m_bound_min.set(0.0f, 0.0f, 0.0f);
+		m_bound_max.set(0.0f, 0.0f, 0.0f);
+		m_bound_center.set(0.0f, 0.0f, 0.0f);
+		m_bound_radius = 0.0f;
+		return;
+	}
+
+	m_bound_min = m_pos[0];
+	m_bound_max = m_pos[0];
+	for (unsigned long i = 1; i < m_vertex_count; ++i) {
+		m_bound_min = vmin(m_bound_min, m_pos[i]);
+		m_bound_max = vmax(m_bound_max, m_pos[i]);
+	}
+
+	m_bound_center = (m_bound_min + m_bound_max) * 0.5f;
+
+	// Tighter than the half diagonal whenever the corners are empty
+	real radius_sq = 0.0f;
+	for (unsigned long i = 0; i < m_vertex_count; ++i) {
+		Vector3 offset = m_pos[i] - m_bound_center;
+		real dist_sq = offset * offset;
+		if (dist_sq > radius_sq) {
+			radius_sq = dist_sq;
+		}
+	}
+
+	m_bound_radius = sqrtf(radius_sq);
 }
 
-void render_block::prepare()
+void render_block::prepare(bool p_keep_cpu_data)
 {
-	m_display_list_id = glGenLists(1);
-	glNewList(m_display_list_id, GL_COMPILE);
+	// Interleave everything into one static vertex buffer
+	render_vertex *vertices = (render_vertex *)MEMORY_ALLOC(sizeof(render_vertex) * m_vertex_count, MEMORY_TAG_GEOMETRY);
+	for (unsigned long i = 0; i < m_vertex_count; ++i) {
+		render_vertex &v = vertices[i];
+		v.m_pos[0] = m_pos[i].m_data[0];
+		v.m_pos[1] = m_pos[i].m_data[1];
+		v.m_pos[2] = m_pos[i].m_data[2];
+
+		if (m_normal) {
+			v.m_normal[0] = m_normal[i].m_data[0];
+			v.m_normal[1] = m_normal[i].m_data[1];
+			v.m_normal[2] = m_normal[i].m_data[2];
+		} else {
+			v.m_normal[0] = v.m_normal[1] = v.m_normal[2] = 0.0f;
+		}
+
+		if (m_uv) {
+			v.m_uv[0] = m_uv[i].m_data[0];
+			v.m_uv[1] = m_uv[i].m_data[1];
+		} else {
+			v.m_uv[0] = v.m_uv[1] = 0.0f;
+		}
+	}
+
+	glGenBuffersARB(1, (GLuint *)&m_vertex_buffer_id);
+	glBindBufferARB(GL_ARRAY_BUFFER_ARB, m_vertex_buffer_id);
+	glBufferDataARB(GL_ARRAY_BUFFER_ARB, sizeof(render_vertex) * m_vertex_count, vertices, GL_STATIC_DRAW_ARB);
+	glBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+	MEMORY_FREE(vertices);
 
-	render_lib_render_block(this, 0);
+	// Narrow indices to 16 bits whenever the vertices fit
+	glGenBuffersARB(1, (GLuint *)&m_index_buffer_id);
+	glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, m_index_buffer_id);
+	if (m_vertex_count < 65536) {
+		uint16 *indices = (uint16 *)MEMORY_ALLOC(sizeof(uint16) * m_index_count, MEMORY_TAG_GEOMETRY);
+		for (unsigned long i = 0; i < m_index_count; ++i) {
+			indices[i] = (uint16)m_index_buffer[i];
+		}
+		glBufferDataARB(GL_ELEMENT_ARRAY_BUFFER_ARB, sizeof(uint16) * m_index_count, indices, GL_STATIC_DRAW_ARB);
+		MEMORY_FREE(indices);
+		m_index_type = GL_UNSIGNED_SHORT;
+	} else {
+		uint32 *indices = (uint32 *)MEMORY_ALLOC(sizeof(uint32) * m_index_count, MEMORY_TAG_GEOMETRY);
+		for (unsigned long i = 0; i < m_index_count; ++i) {
+			indices[i] = (uint32)m_index_buffer[i];
+		}
+		glBufferDataARB(GL_ELEMENT_ARRAY_BUFFER_ARB, sizeof(uint32) * m_index_count, indices, GL_STATIC_DRAW_ARB);
+		MEMORY_FREE(indices);
+		m_index_type = GL_UNSIGNED_INT;
+	}
+	glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, 0);
 
-	glEndList();
+	if (p_keep_cpu_data == false) {
+		if (m_cpu_data_mapped == false) {
+			MEMORY_FREE(m_pos);
+			MEMORY_FREE(m_normal);
+			MEMORY_FREE(m_uv);
+			MEMORY_FREE(m_index_buffer);
+		}
+		m_pos = NULL;
+		m_normal = NULL;
+		m_uv = NULL;
+		m_index_buffer = NULL;
+	}
 
 	m_prepared = true;
 }
 
-void render_block::draw()
+void render_block::release()
 {
-	glCallList(m_display_list_id);
+	if (m_prepared == false) {
+		return;
+	}
+
+	glDeleteBuffersARB(1, (GLuint const*)&m_vertex_buffer_id);
+	glDeleteBuffersARB(1, (GLuint const*)&m_index_buffer_id);
+	m_prepared = false;
+}
+
+void render_block::bind() const
+{
+	glBindBufferARB(GL_ARRAY_BUFFER_ARB, m_vertex_buffer_id);
+	glVertexPointer(3, GL_FLOAT, sizeof(render_vertex), BUFFER_OFFSET(offsetof(render_vertex, m_pos)));
+	glNormalPointer(GL_FLOAT, sizeof(render_vertex), BUFFER_OFFSET(offsetof(render_vertex, m_normal)));
+	glTexCoordPointer(2, GL_FLOAT, sizeof(render_vertex), BUFFER_OFFSET(offsetof(render_vertex, m_uv)));
+
+	glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, m_index_buffer_id);
+}
+
+void render_block::draw(uint32 p_instance_count) const
+{
+	GLenum mode;
+	uint32 triangle_count;
+	switch (m_format) {
+		case RENDER_LIB_MESH_FORMAT_VA_TRIANGLES:
+			mode = GL_TRIANGLES;
+			triangle_count = m_index_count / 3;
+			break;
+		case RENDER_LIB_MESH_FORMAT_VA_TRIANGLE_STRIP:
+			mode = GL_TRIANGLE_STRIP;
+			triangle_count = (m_index_count > 2) ? m_index_count - 2 : 0;
+			break;
+		default:
+			return;
+	};
+
+	if (p_instance_count > 1) {
+		glDrawElementsInstancedEXT(mode, m_index_count, m_index_type, BUFFER_OFFSET(0), p_instance_count);
+	} else {
+		glDrawElements(mode, m_index_count, m_index_type, BUFFER_OFFSET(0));
+	}
+
+	render_stats_count_draw(triangle_count * p_instance_count);
 }
\ No newline at end of file
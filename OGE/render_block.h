@@ -13,6 +13,15 @@ public:
 	float m_data[2];
 };
 
+// Interleaved layout of the static vertex buffer
+class render_vertex
+{
+public:
+	float m_pos[3];
+	float m_normal[3];
+	float m_uv[2];
+};
+
 class render_block
 {
 public:
@@ -29,11 +38,32 @@ public:
 	material const*m_material;
 	bool m_prepared;
 
+	// CPU arrays point into a cooked mesh mapping rather than owning malloc'd memory
+	bool m_cpu_data_mapped;
+
+	// Object space bounds, the sphere is centered on the box
+	Vector3 m_bound_min;
+	Vector3 m_bound_max;
+	Vector3 m_bound_center;
+	real m_bound_radius;
+
+	// Fit the bounds around m_pos, has to run before prepare() frees it
+	void compute_bounds();
+
+	// Upload to vertex/index buffers. Unless asked to keep them, the CPU side arrays are freed afterwards and
+	// m_pos, m_normal, m_uv and m_index_buffer go NULL, so anything reading them (bounds, cooking, cloth setup)
+	// has to run first or the block has to be prepared with p_keep_cpu_data.
+	void prepare(bool p_keep_cpu_data);
+	// Delete the buffers prepare() made, whoever frees a prepared block calls this first
+	void release();
 
-	void prepare();
-	void draw();
+	// Point the vertex arrays at the uploaded buffers
+	void bind() const;
+	void draw(uint32 p_instance_count) const;
 
-	uint32 m_display_list_id;
+	uint32 m_vertex_buffer_id;
+	uint32 m_index_buffer_id;
+	uint32 m_index_type;
 };
 
 #endif /* __RENDER_BLOCK_H_ */
\ No newline at end of file
@@ -17,8 +17,18 @@
 #include "matrix.h"
 
 #include "frametime.h"
+#include "render_queue.h"
+#include "vertex_buffer_ring.h"
+#include "light_tiles.h"
+#include "light_volume.h"
+#include "render_state.h"
+#include "render_stats.h"
+#include "frustum.h"
+#include "profiler.h"
+#include "job_system.h"
+#include "memory_lib.h"
+#include "asset_stream.h"
 
-#include <list>
 #include <map>
 
 
@@ -29,6 +39,28 @@
 #define DEFAULT_CLIP_PLANE_FAR (32000.0f)
 #define DEFAULT_WIDTH (640)
 #define DEFAULT_HEIGHT (480)
+#define DEFAULT_DYNAMIC_VERTEX_BUFFER_SIZE (4 * 1024 * 1024)
+
+#define BUFFER_OFFSET(i) ((char *)NULL + (i))
+
+// Render blocks shared by at least this many instances are drawn with one instanced call
+#define INSTANCING_MIN_INSTANCES (2)
+#define INSTANCING_FLOATS_PER_INSTANCE (16)
+#define INSTANCING_TEXTURE_UNIT (1)
+
+// Renderables per job when updating bounds and culling
+#define CULL_BATCH_SIZE (256)
+
+// Dynamic blocks move every vertex, so they get a radius that never culls
+#define CULL_RADIUS_INFINITE (1e30f)
+
+// Not in the bundled glew, from GL_ARB_texture_rg
+#ifndef GL_RG16
+#define GL_RG16 (0x822C)
+#endif
+
+#define LIGHT_VOLUME_SPHERE_RINGS (8)
+#define LIGHT_VOLUME_SEGMENTS (16)
 
 #ifdef MAC_OS_X
 #define BITMAP_NAME "OGE-osx.app/Contents/Resources/Tim.bmp"
@@ -42,10 +74,54 @@ bool g_swap = false;
 
 //#define DEFER 1
 
-static std::map<render_block *, std::list<mesh_instance *>>g_render_block_to_mesh_instance_list_map;
-static std::map<shader *, std::map<render_block *, std::list<mesh_instance *>>>g_shader_to_render_blocks_map;
-
-static std::list<mesh_instance *>g_mesh_instances;
+// One entry for every render block of every mesh instance added to the renderer
+class renderable
+{
+public:
+	render_block *m_render_block;
+	mesh_instance *m_mesh_instance;
+	render_queue_key m_key;
+	// Transform version the cull bounds were built from, zero forces a rebuild
+	uint32 m_transform_version;
+};
+
+static renderable *g_renderables = NULL;
+static uint32 g_renderable_count = 0;
+static uint32 g_renderables_max = 0;
+
+// Instances whose mesh is still streaming in, added as renderables once its render blocks arrive
+static mesh_instance **g_pending_instances = NULL;
+static uint32 g_pending_instance_count = 0;
+static uint32 g_pending_instances_max = 0;
+
+// Small sort ids handed out as shaders, materials and render blocks are first seen
+static std::map<void const*, uint32>g_shader_sort_ids;
+static std::map<void const*, uint32>g_material_sort_ids;
+static std::map<void const*, uint32>g_render_block_sort_ids;
+
+static render_queue g_render_queue;
+static render_queue g_shadow_render_queue;
+
+// World space bounding spheres of every renderable, kept alongside g_renderables and only rebuilt when the
+// instance's transform moves. Tested against each frustum, the results go in the frame arena.
+static real *g_cull_x = NULL;
+static real *g_cull_y = NULL;
+static real *g_cull_z = NULL;
+static real *g_cull_radius = NULL;
+static uint8 *g_cull_visible = NULL;
+
+// Positions of dynamic mesh instances are streamed through here every frame
+static vertex_buffer_ring g_dynamic_vertex_buffer;
+
+// Instancing packs every instance's transform into a texture buffer fetched by gl_InstanceID
+static bool g_instancing_supported = false;
+static bool g_instancing_enabled = false;
+static shader *g_shader_default = NULL;
+static shader *g_shader_default_instanced = NULL;
+static shader *g_shader_prepass_instanced = NULL;
+static GLuint g_instance_buffer = 0;
+static GLuint g_instance_texture = 0;
+static uint32 g_instance_buffer_max = 0;
 
 
 static Vector3 g_camera_pos;
@@ -61,7 +137,11 @@ static GLuint g_base_pass_color_texture;
 static GLuint g_base_pass_normal_texture;
 static GLuint g_base_pass_depth_texture;
 static GLuint g_base_pass_posxy_texture;
+// Slim layout with light volumes, the depth the lighting shaders sample
+static GLuint g_base_pass_depth_copy_texture = 0;
 static framebuffer_object g_framebuffer_object_base_pass;
+static gbuffer_layout g_gbuffer_layout = RENDER_LIB_GBUFFER_LAYOUT_PACKED;
+static uint32 g_gbuffer_target_count = 4;
 
 static GLuint g_lighting_pass_color_texture;
 static framebuffer_object g_framebuffer_object_lighting_pass;
@@ -72,24 +152,229 @@ static framebuffer_object g_framebuffer_object_shadowmap_pass;
 static char g_shader_name[MAX_SHADER_NAME_LENGTH];
 shader *g_shader_lighting;
 static shader *g_shader_prepass;
+static shader *g_shader_lighting_tiled;
+
+static lighting_mode g_lighting_mode = RENDER_LIB_LIGHTING_MODE_QUADS;
+static bool g_light_tiles_supported = false;
+static light_tile_grid g_light_tile_grid;
+
+static real g_light_attenuation_cutoff = LIGHT_ATTENUATION_CUTOFF_DEFAULT;
+
+static bool g_light_volumes_supported = false;
+static shader *g_shader_lighting_volume;
+static light_volume g_light_volume_sphere;
+static light_volume g_light_volume_cone;
+static framebuffer_object g_framebuffer_object_light_volume_pass;
 
 static texture *g_texture_shadow;
 static texture *g_texture_invalid;
 
 camera g_camera;
 
-static void add_render_block_to_shader(mesh_instance *p_mesh_instance, render_block *p_render_block)
+static uint32 get_sort_id(std::map<void const*, uint32> &p_ids, void const* p_ptr)
+{
+	std::map<void const*, uint32>::iterator it = p_ids.find(p_ptr);
+	if (it != p_ids.end()) {
+		return it->second;
+	}
+
+	uint32 id = (uint32)p_ids.size();
+	p_ids[p_ptr] = id;
+	return id;
+}
+
+static void add_renderable(mesh_instance *p_mesh_instance, render_block *p_render_block)
 {
-	// 
-	// First add in the render block to the shader list
-	//
 	assert(p_render_block != NULL);
 	assert(p_render_block->m_material != NULL);
 
 	shader *shader_ptr = p_render_block->m_material->m_shader;
 	assert(shader_ptr != NULL);
 
-	(g_shader_to_render_blocks_map[p_render_block->m_material->m_shader])[p_render_block].push_back(p_mesh_instance);
+	// Simulations read the CPU copy, so upload dynamic blocks now and keep it around
+	if (p_mesh_instance->m_type == RENDER_LIB_MESH_INSTANCE_TYPE_DYNAMIC && p_render_block->m_prepared == false) {
+		p_render_block->prepare(true);
+	}
+
+	if (g_renderable_count == g_renderables_max) {
+		g_renderables_max = (g_renderables_max == 0) ? 256 : g_renderables_max * 2;
+		g_renderables = (renderable *)MEMORY_REALLOC(g_renderables, sizeof(renderable) * g_renderables_max, MEMORY_TAG_SCENE);
+		assert(g_renderables != NULL);
+
+		g_cull_x = (real *)MEMORY_REALLOC(g_cull_x, sizeof(real) * g_renderables_max, MEMORY_TAG_SCENE);
+		g_cull_y = (real *)MEMORY_REALLOC(g_cull_y, sizeof(real) * g_renderables_max, MEMORY_TAG_SCENE);
+		g_cull_z = (real *)MEMORY_REALLOC(g_cull_z, sizeof(real) * g_renderables_max, MEMORY_TAG_SCENE);
+		g_cull_radius = (real *)MEMORY_REALLOC(g_cull_radius, sizeof(real) * g_renderables_max, MEMORY_TAG_SCENE);
+		assert(g_cull_x != NULL && g_cull_y != NULL && g_cull_z != NULL && g_cull_radius != NULL);
+	}
+
+	// Everything but the depth is fixed for the lifetime of the instance, so build it once
+	renderable &r = g_renderables[g_renderable_count++];
+	r.m_render_block = p_render_block;
+	r.m_mesh_instance = p_mesh_instance;
+	r.m_key = render_queue::make_key(RENDER_QUEUE_PASS_OPAQUE,
+									get_sort_id(g_shader_sort_ids, shader_ptr),
+									get_sort_id(g_material_sort_ids, p_render_block->m_material),
+									0,
+									get_sort_id(g_render_block_sort_ids, p_render_block));
+	r.m_transform_version = 0;
+}
+
+static bool is_instanceable(render_block const* p_render_block)
+{
+	return g_instancing_enabled && (p_render_block->m_material->m_shader == g_shader_default);
+}
+
+// Number of queue items starting at p_index that can go out as one instanced draw, 1 if none
+static uint32 get_instance_run(render_queue_item const* p_items, uint32 p_count, uint32 p_index)
+{
+	render_block const* rb = p_items[p_index].m_render_block;
+	if (is_instanceable(rb) == false || p_items[p_index].m_mesh_instance->m_type != RENDER_LIB_MESH_INSTANCE_TYPE_STATIC) {
+		return 1;
+	}
+
+	uint32 end = p_index + 1;
+	while (end < p_count && p_items[end].m_render_block == rb && p_items[end].m_mesh_instance->m_type == RENDER_LIB_MESH_INSTANCE_TYPE_STATIC) {
+		++end;
+	}
+
+	return (end - p_index >= INSTANCING_MIN_INSTANCES) ? (end - p_index) : 1;
+}
+
+static void update_cull_bounds_job(void *p_data, uint32 p_begin, uint32 p_end)
+{
+	for (uint32 i = p_begin; i < p_end; ++i) {
+		renderable &r = g_renderables[i];
+
+		uint32 version = transform_system_get_version(r.m_mesh_instance->m_transform.get_id());
+		if (version == r.m_transform_version) {
+			continue;
+		}
+		r.m_transform_version = version;
+
+		render_block const* rb = r.m_render_block;
+		matrix44 const& transform = r.m_mesh_instance->m_transform.get_world_matrix();
+
+		Vector3 center = transform * rb->m_bound_center;
+		g_cull_x[i] = center.m_data[0];
+		g_cull_y[i] = center.m_data[1];
+		g_cull_z[i] = center.m_data[2];
+
+		if (r.m_mesh_instance->m_type == RENDER_LIB_MESH_INSTANCE_TYPE_DYNAMIC) {
+			g_cull_radius[i] = CULL_RADIUS_INFINITE;
+			continue;
+		}
+
+		// Scale the radius by the largest axis so non uniform scales stay conservative
+		real scale_sq = 0.0f;
+		for (uint32 j = 0; j < 3; ++j) {
+			real const* axis = &transform.m_data[j * 4];
+			real len_sq = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+			if (len_sq > scale_sq) {
+				scale_sq = len_sq;
+			}
+		}
+
+		g_cull_radius[i] = rb->m_bound_radius * sqrtf(scale_sq);
+	}
+}
+
+static void update_cull_bounds()
+{
+	PROFILE_SCOPE("update_cull_bounds");
+
+	g_cull_visible = (uint8 *)memory_frame_alloc(sizeof(uint8) * g_renderable_count);
+
+	job_parallel_for(g_renderable_count, CULL_BATCH_SIZE, update_cull_bounds_job, NULL);
+}
+
+static void cull_job(void *p_data, uint32 p_begin, uint32 p_end)
+{
+	frustum_cull_spheres((frustum const*)p_data, &g_cull_x[p_begin], &g_cull_y[p_begin], &g_cull_z[p_begin], &g_cull_radius[p_begin], p_end - p_begin, &g_cull_visible[p_begin]);
+}
+
+// Cull every renderable against p_frustum and queue the survivors, sorted front to back along p_fvec.
+// Returns the number of renderables culled.
+static uint32 build_render_queue(render_queue *p_queue, frustum const* p_frustum, Vector3 const& p_pos, Vector3 const& p_fvec)
+{
+	PROFILE_SCOPE("build_render_queue");
+
+	p_queue->reset(g_renderable_count);
+
+	job_parallel_for(g_renderable_count, CULL_BATCH_SIZE, cull_job, (void *)p_frustum);
+
+	uint32 culled_count = 0;
+	for (uint32 i = 0; i < g_renderable_count; ++i) {
+		if (g_cull_visible[i] == 0) {
+			culled_count++;
+			continue;
+		}
+
+		renderable const& r = g_renderables[i];
+
+		// Bucket by distance along the view direction
+		Vector3 offset = r.m_mesh_instance->m_transform.get_world_matrix().get_trans() - p_pos;
+		uint32 depth = render_queue::quantize_depth(offset * p_fvec, DEFAULT_CLIP_PLANE_NEAR, DEFAULT_CLIP_PLANE_FAR);
+
+		// Drop the depth so every copy of an instanced block ends up next to each other
+		if (is_instanceable(r.m_render_block)) {
+			depth = 0;
+		}
+
+		p_queue->push(r.m_key | ((render_queue_key)depth << RENDER_QUEUE_DEPTH_SHIFT), r.m_render_block, r.m_mesh_instance);
+	}
+
+	p_queue->sort();
+
+	return culled_count;
+}
+
+// Pack the transforms of every instanced run into the instance buffer, in queue order
+static void build_instance_buffer(render_queue const* p_queue)
+{
+	if (g_instancing_enabled == false) {
+		return;
+	}
+
+	uint32 item_count = p_queue->get_count();
+	render_queue_item const* items = p_queue->get_items();
+
+	float *instance_data = (float *)memory_frame_alloc(sizeof(float) * INSTANCING_FLOATS_PER_INSTANCE * item_count);
+
+	uint32 instance_count = 0;
+	uint32 i = 0;
+	while (i < item_count) {
+		uint32 run = get_instance_run(items, item_count, i);
+		if (run > 1) {
+			for (uint32 j = 0; j < run; ++j) {
+				memcpy(&instance_data[instance_count * INSTANCING_FLOATS_PER_INSTANCE],
+					items[i + j].m_mesh_instance->m_transform.get_world_matrix().m_data,
+					sizeof(float) * INSTANCING_FLOATS_PER_INSTANCE);
+				instance_count++;
+			}
+		}
+		i += run;
+	}
+
+	if (instance_count == 0) {
+		return;
+	}
+
+	glBindBufferARB(GL_TEXTURE_BUFFER_EXT, g_instance_buffer);
+
+	if (instance_count > g_instance_buffer_max) {
+		g_instance_buffer_max = instance_count * 2;
+		glBufferDataARB(GL_TEXTURE_BUFFER_EXT, sizeof(float) * INSTANCING_FLOATS_PER_INSTANCE * g_instance_buffer_max, NULL, GL_STREAM_DRAW_ARB);
+
+		render_state_bind_texture(INSTANCING_TEXTURE_UNIT, GL_TEXTURE_BUFFER_EXT, g_instance_texture);
+		glTexBufferEXT(GL_TEXTURE_BUFFER_EXT, GL_RGBA32F_ARB, g_instance_buffer);
+	} else {
+		// Orphan last frame's storage so the driver doesn't stall on it
+		glBufferDataARB(GL_TEXTURE_BUFFER_EXT, sizeof(float) * INSTANCING_FLOATS_PER_INSTANCE * g_instance_buffer_max, NULL, GL_STREAM_DRAW_ARB);
+	}
+
+	glBufferSubDataARB(GL_TEXTURE_BUFFER_EXT, 0, sizeof(float) * INSTANCING_FLOATS_PER_INSTANCE * instance_count, instance_data);
+	glBindBufferARB(GL_TEXTURE_BUFFER_EXT, 0);
 }
 
 static SDL_Surface *LoadBMP(char *p_filename)
@@ -265,13 +550,34 @@ static bool IsExtensionSupported( char* szTargetExtension )
 	return false;
 }
 
-static void setup_base_pass_framebuffer()
+static void setup_instancing()
 {
-	g_framebuffer_object_base_pass.init(g_width, g_height, framebuffer_object::FRAMEBUFFER_FORMAT_DEPTH24);
+	g_instancing_supported = IsExtensionSupported("GL_EXT_draw_instanced")
+		&& IsExtensionSupported("GL_EXT_gpu_shader4")
+		&& IsExtensionSupported("GL_EXT_texture_buffer_object")
+		&& IsExtensionSupported("GL_ARB_texture_float");
+
+	if (g_instancing_supported == false) {
+		printf("GL_EXT_draw_instanced not supported, instancing disabled\n");
+		return;
+	}
 
-	// Bind a color texture to target
-	glGenTextures(1, &g_base_pass_color_texture);
-	glBindTexture(GL_TEXTURE_2D, g_base_pass_color_texture);
+	glGenBuffersARB(1, &g_instance_buffer);
+	glGenTextures(1, &g_instance_texture);
+
+	g_shader_prepass_instanced = shader_create("prepass_instanced");
+	if (g_shader_prepass_instanced->is_valid() == false) {
+		printf("prepass_instanced failed to build, instancing disabled\n");
+		g_instancing_supported = false;
+	}
+}
+
+// Depth packed into RGB8 and the normal's z in a fourth target
+static void setup_base_pass_packed_targets()
+{
+	// Bind a normal texture to target
+	glGenTextures(1, &g_base_pass_posxy_texture);
+	glBindTexture(GL_TEXTURE_2D, g_base_pass_posxy_texture);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
@@ -280,9 +586,9 @@ static void setup_base_pass_framebuffer()
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8,  g_width, g_height, 0, GL_RGBA, GL_FLOAT, NULL);
 	glBindTexture(GL_TEXTURE_2D, 0);
 
-	// Bind a normal texture to target
-	glGenTextures(1, &g_base_pass_normal_texture);
-	glBindTexture(GL_TEXTURE_2D, g_base_pass_normal_texture);
+	// Bind a depth texture to target
+	glGenTextures(1, &g_base_pass_depth_texture);
+	glBindTexture(GL_TEXTURE_2D, g_base_pass_depth_texture);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
@@ -291,9 +597,28 @@ static void setup_base_pass_framebuffer()
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8,  g_width, g_height, 0, GL_RGBA, GL_FLOAT, NULL);
 	glBindTexture(GL_TEXTURE_2D, 0);
 
-	// Bind a normal texture to target
-	glGenTextures(1, &g_base_pass_posxy_texture);
-	glBindTexture(GL_TEXTURE_2D, g_base_pass_posxy_texture);
+
+	g_framebuffer_object_base_pass.bind();
+	g_framebuffer_object_base_pass.set_target_texture(g_base_pass_color_texture, 0);
+	g_framebuffer_object_base_pass.set_target_texture(g_base_pass_normal_texture, 1);
+	g_framebuffer_object_base_pass.set_target_texture(g_base_pass_depth_texture, 2);
+	g_framebuffer_object_base_pass.set_target_texture(g_base_pass_posxy_texture, 3);
+
+	g_gbuffer_target_count = 4;
+}
+
+static void setup_base_pass_framebuffer()
+{
+	// Light volumes are stencil tested against the base pass depth
+	if (g_light_volumes_supported) {
+		g_framebuffer_object_base_pass.init(g_width, g_height, framebuffer_object::FRAMEBUFFER_FORMAT_DEPTH24_STENCIL8);
+	} else {
+		g_framebuffer_object_base_pass.init(g_width, g_height, framebuffer_object::FRAMEBUFFER_FORMAT_DEPTH24);
+	}
+
+	// Bind a color texture to target
+	glGenTextures(1, &g_base_pass_color_texture);
+	glBindTexture(GL_TEXTURE_2D, g_base_pass_color_texture);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
@@ -302,23 +627,60 @@ static void setup_base_pass_framebuffer()
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8,  g_width, g_height, 0, GL_RGBA, GL_FLOAT, NULL);
 	glBindTexture(GL_TEXTURE_2D, 0);
 
-	// Bind a depth texture to target
-	glGenTextures(1, &g_base_pass_depth_texture);
-	glBindTexture(GL_TEXTURE_2D, g_base_pass_depth_texture);
+	// Slim layout keeps the octahedral normal at 16 bits per component, two channels where GL has them
+	GLint normal_format = GL_RGBA8;
+	if (g_gbuffer_layout == RENDER_LIB_GBUFFER_LAYOUT_SLIM) {
+		normal_format = IsExtensionSupported("GL_ARB_texture_rg") ? GL_RG16 : GL_RGBA16;
+	}
+
+	// Bind a normal texture to target
+	glGenTextures(1, &g_base_pass_normal_texture);
+	glBindTexture(GL_TEXTURE_2D, g_base_pass_normal_texture);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
 
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8,  g_width, g_height, 0, GL_RGBA, GL_FLOAT, NULL);
+	glTexImage2D(GL_TEXTURE_2D, 0, normal_format,  g_width, g_height, 0, GL_RGBA, GL_FLOAT, NULL);
 	glBindTexture(GL_TEXTURE_2D, 0);
 
+	// Slim layout packs the normal into two channels and reads depth back from the depth buffer
+	if (g_gbuffer_layout == RENDER_LIB_GBUFFER_LAYOUT_SLIM) {
+		g_base_pass_depth_texture = g_framebuffer_object_base_pass.get_depth_buffer_id();
+		glBindTexture(GL_TEXTURE_2D, g_base_pass_depth_texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		// The light volume pass keeps the base pass depth attached for its stencil test, sampling it there
+		// too would be a feedback loop. The lighting shaders read a copy taken at the end of the base pass.
+		if (g_light_volumes_supported) {
+			glGenTextures(1, &g_base_pass_depth_copy_texture);
+			glBindTexture(GL_TEXTURE_2D, g_base_pass_depth_copy_texture);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, g_width, g_height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+			glBindTexture(GL_TEXTURE_2D, 0);
+
+			g_base_pass_depth_texture = g_base_pass_depth_copy_texture;
+		}
 
-	g_framebuffer_object_base_pass.bind();
-	g_framebuffer_object_base_pass.set_target_texture(g_base_pass_color_texture, 0);
-	g_framebuffer_object_base_pass.set_target_texture(g_base_pass_normal_texture, 1);
-	g_framebuffer_object_base_pass.set_target_texture(g_base_pass_depth_texture, 2);
-	g_framebuffer_object_base_pass.set_target_texture(g_base_pass_posxy_texture, 3);
+		g_base_pass_posxy_texture = 0;
+		g_gbuffer_target_count = 2;
+
+		g_framebuffer_object_base_pass.bind();
+		g_framebuffer_object_base_pass.set_target_texture(g_base_pass_color_texture, 0);
+		g_framebuffer_object_base_pass.set_target_texture(g_base_pass_normal_texture, 1);
+	} else {
+		setup_base_pass_packed_targets();
+	}
 
 	bool ret = g_framebuffer_object_base_pass.is_status_ready();
 	if (ret == false) {
@@ -355,6 +717,42 @@ static void setup_lighting_pass_framebuffer()
 	}
 }
 
+static void setup_light_volumes()
+{
+	g_light_volumes_supported = IsExtensionSupported("GL_EXT_packed_depth_stencil") && glStencilOpSeparate != NULL;
+	if (g_light_volumes_supported == false) {
+		printf("GL_EXT_packed_depth_stencil not supported, light volumes disabled\n");
+		return;
+	}
+
+	g_light_volume_sphere.init_sphere(LIGHT_VOLUME_SPHERE_RINGS, LIGHT_VOLUME_SEGMENTS);
+	g_light_volume_cone.init_cone(LIGHT_VOLUME_SEGMENTS);
+
+	g_shader_lighting_volume = shader_create("deferred_lighting_volume");
+}
+
+static void setup_light_volume_pass_framebuffer()
+{
+	if (g_light_volumes_supported == false) {
+		return;
+	}
+
+	// Writes into the lighting pass target, tests against the base pass depth and stencil.
+	// Nothing samples the attached depth, the slim g-buffer reads g_base_pass_depth_copy_texture.
+	g_framebuffer_object_light_volume_pass.init(g_width, g_height, 0);
+
+	g_framebuffer_object_light_volume_pass.bind();
+	g_framebuffer_object_light_volume_pass.set_target_texture(g_lighting_pass_color_texture, 0);
+	g_framebuffer_object_light_volume_pass.set_depth_stencil_texture(g_framebuffer_object_base_pass.get_depth_buffer_id());
+
+	bool ret = g_framebuffer_object_light_volume_pass.is_status_ready();
+	if (ret == false) {
+		assert(!"framebuffer object not initialized successfully\n");
+	}
+
+	g_framebuffer_object_light_volume_pass.unbind();
+}
+
 static void setup_shadowmap_pass_framebuffer()
 {
 	g_framebuffer_object_shadowmap_pass.init(g_width, g_height, framebuffer_object::FRAMEBUFFER_FORMAT_DEPTH24);
@@ -365,8 +763,28 @@ static void setup_shadowmap_pass_framebuffer()
 	}
 }
 
-static void draw_geometry(bool p_depthonly, matrix44 const* modelview_mat)
+static void set_base_pass_uniforms(shader *p_shader, matrix44 const* modelview_mat)
+{
+	p_shader->set_uniform_1i(SHADER_UNIFORM_BASE_TEXTURE, 0);
+
+	light *light_ptr = light_get_from_index(0);
+	if (light_ptr == NULL) {
+		return;
+	}
+
+	Vector3 pos = light_ptr->m_transform.get_world_position();
+	Vector3 light_pos = *modelview_mat * pos;
+	p_shader->set_uniform_4f(SHADER_UNIFORM_LIGHT_POSITION, light_pos.m_data[0], light_pos.m_data[1], light_pos.m_data[2], 1.0f);
+	p_shader->set_uniform_4fv(SHADER_UNIFORM_LIGHT_DIFFUSE, light_ptr->m_diffuse);
+	p_shader->set_uniform_4fv(SHADER_UNIFORM_LIGHT_AMBIENT, light_ptr->m_ambient);
+
+	light_release(light_ptr);
+}
+
+static void draw_geometry(bool p_depthonly, matrix44 const* modelview_mat, render_queue const* p_queue)
 {
+	PROFILE_SCOPE("draw_geometry");
+
 	if (p_depthonly) {
 		g_shader_prepass->activate();
 	}
@@ -374,208 +792,126 @@ static void draw_geometry(bool p_depthonly, matrix44 const* modelview_mat)
 	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
 	glEnableClientState(GL_NORMAL_ARRAY);
 
-
-	glActiveTexture(GL_TEXTURE0);
+	if (g_instancing_enabled) {
+		render_state_bind_texture(INSTANCING_TEXTURE_UNIT, GL_TEXTURE_BUFFER_EXT, g_instance_texture);
+	}
 
 	
 
-	bool texture_coord = false;
-	bool normal = false;
-	shader *active_shader = 0;
-	uint32 my_sampler_uniform_location;
+	shader *active_shader = p_depthonly ? g_shader_prepass : NULL;
+	material const* active_material = NULL;
+	render_block *active_render_block = NULL;
 
 	uint32 triangle_count = 0;
 	uint32 block_count = 0;
 
 	uint32 shader_count = 0;
+	uint32 draw_count = 0;
+	uint32 instance_offset = 0;
+
+	// Queue is sorted by shader, then material, then depth so state only changes on boundaries
+	uint32 item_count = p_queue->get_count();
+	render_queue_item const* items = p_queue->get_items();
+
+	uint32 run = 1;
+	for (uint32 i = 0; i < item_count; i += run) {
+		render_block &rb = *items[i].m_render_block;
+		mesh_instance *mi = items[i].m_mesh_instance;
+
+		run = get_instance_run(items, item_count, i);
+
+		// Instanced runs swap in the variant of the shader that reads transforms from the instance buffer
+		shader *shader_ptr;
+		if (p_depthonly) {
+			shader_ptr = (run > 1) ? g_shader_prepass_instanced : g_shader_prepass;
+		} else {
+			shader_ptr = (run > 1) ? g_shader_default_instanced : rb.m_material->m_shader;
+		}
 
-//#define RENDER_LIST
-#if defined(RENDER_LIST)
-	std::list<mesh_instance *>::iterator mesh_iter;
-	for (mesh_iter = g_mesh_instances.begin(); mesh_iter != g_mesh_instances.end(); ++mesh_iter) {
-		mesh const* mesh_ptr = (*mesh_iter)->m_mesh;
-
-		for (unsigned long i = 0; i < mesh_ptr->m_render_block_count; i++) {
-			render_block &rb = mesh_ptr->m_render_blocks[i];
-
-			glPushMatrix();
-
-			mesh_instance *mi = *mesh_iter;
-			glTranslatef(mi->m_position.m_data[0], mi->m_position.m_data[1], mi->m_position.m_data[2]);
-			matrix44 matrix;
-			mi->m_orientation.CreateMatrix(matrix.m_data);
-			glMultMatrixf(matrix.m_data);
-			
-			glScalef(mi->m_scale.m_data[0], mi->m_scale.m_data[1], mi->m_scale.m_data[2]);
-
-			//glMultMatrixf(rb.m_transform.m_data);
+		if (shader_ptr != active_shader) {
+			shader_ptr->activate();
+			active_shader = shader_ptr;
+			shader_count++;
 
 			if (p_depthonly == false) {
-				assert(rb.m_material->m_shader != NULL);
-				if (rb.m_material->m_shader && (active_shader != rb.m_material->m_shader)) {
-					rb.m_material->m_shader->activate();
-					my_sampler_uniform_location = rb.m_material->m_shader->get_location("base_texture");
-					glUniform1iARB(my_sampler_uniform_location, 0);
-					active_shader = rb.m_material->m_shader;
-
-					uint32 uniform_location8 = rb.m_material->m_shader->get_location("camera_position");
-					uint32 uniform_location9 = rb.m_material->m_shader->get_location("camera_direction");
-					uint32 uniform_location10 = rb.m_material->m_shader->get_location("depth_near");
-					uint32 uniform_location11 = rb.m_material->m_shader->get_location("depth_far");
-
-					matrix44 orient;
-					g_camera_orient.CreateMatrix(orient.m_data);
-	
-					glUniform3fvARB(uniform_location8, 1, g_camera_pos.m_data);
-					glUniform3fvARB(uniform_location9, 1, orient.get_fvec().m_data);
-					glUniform1fARB(uniform_location10, DEFAULT_CLIP_PLANE_NEAR);
-					glUniform1fARB(uniform_location11, DEFAULT_CLIP_PLANE_FAR);
-				}
+				set_base_pass_uniforms(shader_ptr, modelview_mat);
 			}
 
-			if (rb.m_prepared == false) {
-				rb.prepare();
+			if (run > 1) {
+				shader_ptr->set_uniform_1i(SHADER_UNIFORM_INSTANCE_DATA, INSTANCING_TEXTURE_UNIT);
 			}
+		}
 
-#if 0
-	matrix44 orient;
-	g_camera_orient.CreateMatrix(orient.m_data);
-	glMultMatrixf(orient.m_data);
-	glTranslatef( g_camera_pos.m_data[0], g_camera_pos.m_data[1], g_camera_pos.m_data[2]);
+		if (p_depthonly == false) {
+			if (rb.m_material != active_material) {
+				active_material = rb.m_material;
+#if MATERIAL_SUPPORT
+				glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT, rb.m_material->m_color_ambient);
+				glMaterialfv(GL_FRONT_AND_BACK, GL_DIFFUSE, rb.m_material->m_color_diffuse);
+				glMaterialfv(GL_FRONT_AND_BACK, GL_SPECULAR, rb.m_material->m_color_spec);
 #endif
-
-
-			if (rb.m_prepared == true) {
-				rb.draw();
-			} else {
-				if ((*mesh_iter)->m_type == RENDER_LIB_MESH_INSTANCE_TYPE_DYNAMIC) {
-					mesh_instance_dynamic *mid = (mesh_instance_dynamic *)*mesh_iter;
-					render_lib_render_block(&rb, mid);
-				} else {
-					render_lib_render_block(&rb, 0);
+				if (rb.m_material->m_texture != 0) {
+					rb.m_material->m_texture->activate();
 				}
 			}
+		}
 
-			triangle_count += rb.m_index_count / 3;
+		if (&rb != active_render_block) {
+			active_render_block = &rb;
 			block_count++;
 
-			
+			if (rb.m_prepared == false) {
+				rb.prepare(false);
+			}
 
-			glPopMatrix();
+			rb.bind();
 		}
-	}
-#else /* RENDER_LIST */
-	//static std::map<shader *, std::map<render_block *, std::list<mesh_instance *>>>g_shader_to_render_blocks_map;
-
-	std::map<shader *, std::map<render_block *, std::list<mesh_instance *>>>::iterator shader_iter;
-	std::map<render_block *, std::list<mesh_instance *>>::iterator render_block_iter;
-	std::list<mesh_instance *>::iterator mesh_instance_iter;
-	// For each shader
-	for (shader_iter = g_shader_to_render_blocks_map.begin(); shader_iter != g_shader_to_render_blocks_map.end(); ++shader_iter) {
-		// For each render block
-		shader *shader_ptr = (*shader_iter).first;
-		shader_count++;
-
-		if (p_depthonly == false) {
-			shader_ptr->activate();
-
-			my_sampler_uniform_location = shader_ptr->get_location("base_texture");
-			glUniform1iARB(my_sampler_uniform_location, 0);
 
-			uint32 uniform_location3 = shader_ptr->get_location("light_position");
-			light *light_ptr = light_get_from_index(0);
-			Vector3 const& pos = light_ptr->m_transform.get_position();
-			Vector3 light_pos = *modelview_mat * pos;
-			glUniform4fARB(uniform_location3, light_pos.m_data[0], light_pos.m_data[1], light_pos.m_data[2], 1.0f);
-
-			uint32 uniform_location6 = shader_ptr->get_location("light_diffuse");
-			glUniform4fvARB(uniform_location6, 1, light_ptr->m_diffuse);
-
-			uint32 uniform_location5 = shader_ptr->get_location("light_ambient");
-			glUniform4fvARB(uniform_location5, 1, light_ptr->m_ambient);
+		if (mi->m_type == RENDER_LIB_MESH_INSTANCE_TYPE_DYNAMIC) {
+			// Stream the simulated positions, normals and uv's still come from the static buffer
+			uint32 offset = g_dynamic_vertex_buffer.write(((mesh_instance_dynamic *)mi)->m_dynamic_pos, sizeof(Vector3) * rb.m_vertex_count);
+			glVertexPointer(3, GL_FLOAT, 0, BUFFER_OFFSET(offset));
 
+			// Next item has to point back at its own buffer
+			active_render_block = NULL;
 		}
 
-		for (render_block_iter = (*shader_iter).second.begin(); render_block_iter != (*shader_iter).second.end(); ++render_block_iter) {
-			// For each mesh instance
-			render_block *render_block_ptr = (*render_block_iter).first;
+		if (run > 1) {
+			active_shader->set_uniform_1i(SHADER_UNIFORM_INSTANCE_OFFSET, instance_offset);
+			instance_offset += run;
 
-			render_block &rb = *render_block_ptr;
+			rb.draw(run);
 
-			if (rb.m_uv != NULL) {
-				glTexCoordPointer(2, GL_FLOAT, 0, rb.m_uv);
-			}
-			
-			if (rb.m_normal) {
-				glNormalPointer(GL_FLOAT, 0, rb.m_normal);
-			}
-			
-			if (rb.m_material) {
-#if MATERIAL_SUPPORT
-				glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT, rb.m_material->m_color_ambient);
-				glMaterialfv(GL_FRONT_AND_BACK, GL_DIFFUSE, rb.m_material->m_color_diffuse);
-				glMaterialfv(GL_FRONT_AND_BACK, GL_SPECULAR, rb.m_material->m_color_spec);
-#endif
-							
-				if (rb.m_material->m_texture != 0) {
-					if (rb.m_material->m_shader != NULL) {
-						rb.m_material->m_texture->activate();
-					} else {
-						rb.m_material->m_texture->activate();
-					}
-				}
-				
-			} else {
-				//glColor3f(mi->m_color.data[0], mi->m_color.data[1], mi->m_color.data[2]);
-				glColor3f(0.0f, 0.0f, 0.0f);
-			}
+			triangle_count += (rb.m_index_count / 3) * run;
+			draw_count++;
+			continue;
+		}
 
-			block_count++;
+		glPushMatrix();
 
-			for (mesh_instance_iter = (*render_block_iter).second.begin(); mesh_instance_iter != (*render_block_iter).second.end(); ++mesh_instance_iter) {
-				glPushMatrix();
-
-				mesh_instance *mi = *mesh_instance_iter;
-
-				glMultMatrixf(mi->m_transform.m_transform_matrix.m_data);
-
-				if (rb.m_prepared == false) {
-					rb.m_display_list_id = glGenLists(1);
-					glNewList(rb.m_display_list_id, GL_COMPILE);
-					glVertexPointer(3, GL_FLOAT, 0, rb.m_pos);
-					switch (rb.m_format) {
-						case RENDER_LIB_MESH_FORMAT_VA_TRIANGLES:
-							glDrawElements(GL_TRIANGLES, rb.m_index_count, GL_UNSIGNED_INT, rb.m_index_buffer);
-							break;
-						case RENDER_LIB_MESH_FORMAT_VA_TRIANGLE_STRIP:
-							glDrawElements(GL_TRIANGLE_STRIP, rb.m_index_count, GL_UNSIGNED_INT, rb.m_index_buffer);
-							break;
-						default:
-							break;
-					};
-					glEndList();
-
-					rb.m_prepared = true;
-				}
+		glMultMatrixf(mi->m_transform.get_world_matrix().m_data);
 
-				glCallList(rb.m_display_list_id);
+		rb.draw(1);
 
-				triangle_count += render_block_ptr->m_index_count / 3;
+		triangle_count += rb.m_index_count / 3;
+		draw_count++;
 
-				glPopMatrix();
-			}
-		}
+		glPopMatrix();
 	}
 
+	glBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+	glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, 0);
 
-#endif /* RENDER_LIST */
+	if (g_instancing_enabled) {
+		render_state_bind_texture(INSTANCING_TEXTURE_UNIT, GL_TEXTURE_BUFFER_EXT, 0);
+	}
 
 	{
 				
 		static int count = 0;
 		if (count >= 100) {
 			char buffer[256];
-			sprintf(buffer, "blocks: %u tri's: %u  shaders: %u\n", block_count, triangle_count, shader_count);
+			sprintf(buffer, "blocks: %u tri's: %u  shaders: %u  draws: %u\n", block_count, triangle_count, shader_count, draw_count);
 			OutputDebugStringA(buffer);
 			count = 0;
 		}
@@ -587,12 +923,10 @@ static void draw_geometry(bool p_depthonly, matrix44 const* modelview_mat)
 static void draw_final_scene()
 {
 	// Step Four: Render final texture to scene
-	glActiveTexture(GL_TEXTURE0);
-
 	if (g_swap) {
-		glBindTexture(GL_TEXTURE_2D, g_base_pass_posxy_texture); // g_lighting_pass_color_texture); //g_lighting_pass_color_texture);
+		render_state_bind_texture(0, GL_TEXTURE_2D, g_base_pass_posxy_texture); // g_lighting_pass_color_texture); //g_lighting_pass_color_texture);
 	} else {
-		glBindTexture(GL_TEXTURE_2D, g_lighting_pass_color_texture); // g_lighting_pass_color_texture); //g_lighting_pass_color_texture);
+		render_state_bind_texture(0, GL_TEXTURE_2D, g_lighting_pass_color_texture); // g_lighting_pass_color_texture); //g_lighting_pass_color_texture);
 	}
 
 	shader_enable_fixed_function_pipeline();
@@ -637,6 +971,8 @@ static void draw_final_scene()
 	glVertex2i(0, 0);	// Top Left Of The Texture and Quad
 	glEnd();
 
+	render_stats_count_draw(2);
+
 	ReSizeGLScene(g_width, g_height);
 }
 
@@ -667,10 +1003,393 @@ static void generate_view_vectors(Vector3 p_view_vectors[4], uint32 p_width, uin
 	}
 }
 
-static void draw_lights(matrix44 const *modelview_mat, matrix44 const* view_proj_inv, matrix44 const *proj_mat_inv)
+static void bind_gbuffer_textures(shader *p_shader)
+{
+	render_state_bind_texture(0, GL_TEXTURE_2D, g_base_pass_color_texture);
+	p_shader->set_uniform_1i(SHADER_UNIFORM_COLOR_TEXTURE, 0);
+
+	render_state_bind_texture(1, GL_TEXTURE_2D, g_base_pass_normal_texture);
+	p_shader->set_uniform_1i(SHADER_UNIFORM_NORMAL_TEXTURE, 1);
+
+	render_state_bind_texture(2, GL_TEXTURE_2D, g_base_pass_depth_texture);
+	p_shader->set_uniform_1i(SHADER_UNIFORM_DEPTH_TEXTURE, 2);
+
+	render_state_bind_texture(4, GL_TEXTURE_2D, g_base_pass_posxy_texture);
+	p_shader->set_uniform_1i(SHADER_UNIFORM_POSXY_TEXTURE, 4);
+}
+
+static void set_light_uniforms(shader *p_shader, light const* p_light, matrix44 const *modelview_mat, real const* p_ambient)
+{
+	Vector3 light_pos = *modelview_mat * p_light->m_transform.get_world_position();
+	float w = (p_light->m_type == light::LIGHT_TYPE_DIRECTION) ? 0.0f : 1.0f;
+	p_shader->set_uniform_4f(SHADER_UNIFORM_LIGHT_POSITION, light_pos.m_data[0], light_pos.m_data[1], light_pos.m_data[2], w);
+
+	p_shader->set_uniform_4fv(SHADER_UNIFORM_LIGHT_AMBIENT, p_ambient);
+	p_shader->set_uniform_4fv(SHADER_UNIFORM_LIGHT_DIFFUSE, p_light->m_diffuse);
+	p_shader->set_uniform_4fv(SHADER_UNIFORM_LIGHT_SPECULAR, p_light->m_specular);
+	p_shader->set_uniform_3f(SHADER_UNIFORM_LIGHT_ATTENUATION, p_light->m_constant_attenuation, p_light->m_linear_attenuation, p_light->m_quadratic_attenuation);
+
+	Vector3 spot_direction = (*modelview_mat * p_light->m_spot_direction) - (*modelview_mat * Vector3(0.0f, 0.0f, 0.0f));
+	p_shader->set_uniform_3fv(SHADER_UNIFORM_SPOT_DIRECTION, spot_direction.m_data);
+	p_shader->set_uniform_1f(SHADER_UNIFORM_SPOT_EXPONENT, p_light->m_spot_exponent);
+	p_shader->set_uniform_1f(SHADER_UNIFORM_SPOT_COS_CUTOFF, p_light->m_spot_cos_cutoff);
+	p_shader->set_uniform_1f(SHADER_UNIFORM_LIGHT_SPECULAR_POWER, p_light->m_specular_power);
+}
+
+static void draw_lighting_quad()
+{
+	// Draw quad
+	glBegin(GL_QUADS);
+	glTexCoord2f( 0.0f, 1.0f); 
+	glVertex2i(0, g_height);	// Bottom Left Of The Texture and Quad
+
+	//glTexCoord2i(g_width, 0);
+	glTexCoord2f(1.0f, 1.0f);
+	glVertex2i(g_width, g_height);	// Bottom Right Of The Texture and Quad
+
+	//glTexCoord2i(g_width, g_height);
+	glTexCoord2f(1.0f, 0.0f);
+	glVertex2i(g_width, 0);	// Top Right Of The Texture and Quad
+
+	//glTexCoord2i(0, g_height);
+	glTexCoord2f(0.0f, 0.0f);
+	glVertex2i(0, 0);	// Top Left Of The Texture and Quad
+	glEnd();
+
+	render_stats_count_draw(2);
+}
+
+static void draw_shadow_map(light *p_light)
+{
+	// Render from light's perspective and get depth map
+	// Enable Shadow FBO
+	// Transform to light
+	render_stats_pass_begin(RENDER_PASS_SHADOW);
+
+	g_framebuffer_object_shadowmap_pass.bind();
+
+	ReSizeGLScene(g_width, g_height);
+
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	g_shader_prepass->activate();
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glEnable(GL_DEPTH_TEST);
+	glCullFace(GL_FRONT);
+	glDepthMask(GL_TRUE);
+	glDrawBuffer(GL_FALSE);
+	glReadBuffer (GL_FALSE);
+
+	// Transform to lights position
+	camera light_camera;
+	light_camera.set_transform(&p_light->m_transform.get_world_matrix());
+	light_camera.set_perspective();
+
+	// Only what the light can see goes into the shadow map
+	matrix44 light_view_mat;
+	glGetFloatv(GL_MODELVIEW_MATRIX, light_view_mat.m_data);
+	matrix44 light_proj_mat;
+	glGetFloatv(GL_PROJECTION_MATRIX, light_proj_mat.m_data);
+
+	frustum light_frustum;
+	matrix44 light_viewproj = light_proj_mat * light_view_mat;
+	light_frustum.set_from_matrix(&light_viewproj);
+
+	matrix44 const* light_transform = light_camera.get_transform();
+	render_stats_count(RENDER_COUNTER_SHADOW_CULLED, build_render_queue(&g_shadow_render_queue, &light_frustum, light_transform->get_trans(), light_transform->get_fvec()));
+	render_stats_count(RENDER_COUNTER_SHADOW_VISIBLE, g_shadow_render_queue.get_count());
+	build_instance_buffer(&g_shadow_render_queue);
+
+	draw_geometry(true, NULL, &g_shadow_render_queue);
+
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	g_framebuffer_object_shadowmap_pass.unbind();
+
+	glCullFace(GL_BACK);
+
+	render_stats_pass_end();
+}
+
+// Every light in one pass, each pixel only walks the lights binned into its tile
+static void draw_lights_tiled(matrix44 const *modelview_mat, matrix44 const *proj_mat, matrix44 const *proj_mat_inv)
+{
+	g_light_tile_grid.build(modelview_mat, proj_mat, g_light_attenuation_cutoff);
+	g_light_tile_grid.upload();
+
+	glPushAttrib(GL_CURRENT_BIT | GL_POLYGON_BIT | GL_LIGHTING_BIT | GL_EVAL_BIT);
+
+	for (uint32 i = 0; i < light_get_count(); ++i) {
+		light *light_ptr = light_get_from_dense(i);
+
+		if (light_ptr->m_type != light::LIGHT_TYPE_NONE && light_ptr->m_shadow_casting) {
+			draw_shadow_map(light_ptr);
+		}
+
+		light_release(light_ptr);
+	}
+
+	g_framebuffer_object_lighting_pass.bind();
+	glDrawBuffer(GL_COLOR_ATTACHMENT0_EXT);
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	shader *lighting_shader = g_shader_lighting_tiled;
+	lighting_shader->activate();
+
+	bind_gbuffer_textures(lighting_shader);
+
+	g_light_tile_grid.bind(5, 6, 7);
+	lighting_shader->set_uniform_1i(SHADER_UNIFORM_LIGHT_DATA_TEXTURE, 5);
+	lighting_shader->set_uniform_1i(SHADER_UNIFORM_TILE_TEXTURE, 6);
+	lighting_shader->set_uniform_1i(SHADER_UNIFORM_LIGHT_INDEX_TEXTURE, 7);
+
+	lighting_shader->set_uniform_2f(SHADER_UNIFORM_TILE_COUNT, (float)g_light_tile_grid.get_tiles_x(), (float)g_light_tile_grid.get_tiles_y());
+	lighting_shader->set_uniform_1f(SHADER_UNIFORM_TILE_SIZE, (float)g_light_tile_grid.get_tile_size());
+	lighting_shader->set_uniform_1f(SHADER_UNIFORM_LIGHT_DATA_HEIGHT, (float)LIGHT_MAX_NUMBER);
+	lighting_shader->set_uniform_2f(SHADER_UNIFORM_LIGHT_INDEX_SIZE, (float)LIGHT_TILE_INDEX_TEXTURE_WIDTH, (float)g_light_tile_grid.get_index_texture_height());
+	lighting_shader->set_uniform_4fv(SHADER_UNIFORM_LIGHT_AMBIENT, g_light_tile_grid.get_ambient());
+	lighting_shader->set_uniform_matrix4fv(SHADER_UNIFORM_PROJ_MATRIX_INVERSE, proj_mat_inv->m_data);
+
+	// Select The Projection Matrix
+	glMatrixMode(GL_PROJECTION);	
+
+	// Reset The Projection Matrix
+	glLoadIdentity();							
+
+	// Calculate The Aspect Ratio Of The Window
+	glOrtho(0, g_width, 0, g_height, -1.0, 1.0);
+
+	// Select The Modelview Matrix
+	glMatrixMode(GL_MODELVIEW);			
+
+	// Reset The Modelview Matrix
+	glLoadIdentity();
+
+	glDisable(GL_BLEND);
+
+	draw_lighting_quad();
+	render_stats_count(RENDER_COUNTER_LIGHTS, g_light_tile_grid.get_light_count());
+
+	g_framebuffer_object_lighting_pass.unbind();
+
+	glPopAttrib();
+
+	ReSizeGLScene(g_width, g_height);
+}
+
+// Window depth range a light's sphere of influence can touch, false if it is all behind the near plane
+static bool get_light_depth_bounds(light const* p_light, matrix44 const *modelview_mat, matrix44 const *proj_mat, real p_radius, real *p_min, real *p_max)
+{
+	real const* m = proj_mat->m_data;
+	real near_plane = m[14] / (m[10] - 1.0f);
+
+	Vector3 view_pos = *modelview_mat * p_light->m_transform.get_world_position();
+
+	// View space looks down -z
+	real z_near = view_pos.m_data[2] + p_radius;
+	real z_far = view_pos.m_data[2] - p_radius;
+
+	if (z_far >= -near_plane) {
+		return false;
+	}
+
+	if (z_near > -near_plane) {
+		z_near = -near_plane;
+	}
+
+	*p_min = ((((m[10] * z_near) + m[14]) / -z_near) * 0.5f) + 0.5f;
+	*p_max = ((((m[10] * z_far) + m[14]) / -z_far) * 0.5f) + 0.5f;
+
+	if (*p_max > 1.0f) {
+		*p_max = 1.0f;
+	}
+
+	return true;
+}
+
+// Point and spot lights only shade the pixels inside their attenuation volume. The volume is
+// rasterized twice: a z-fail stencil pass marks pixels whose geometry lies inside it, then
+// the back faces run the lighting shader where the stencil is set.
+static void draw_lights_volumes(matrix44 const *modelview_mat, matrix44 const *proj_mat, matrix44 const *proj_mat_inv)
 {
+	glPushAttrib(GL_CURRENT_BIT | GL_POLYGON_BIT | GL_LIGHTING_BIT | GL_EVAL_BIT | GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT | GL_ENABLE_BIT);
+
+	for (uint32 i = 0; i < light_get_count(); ++i) {
+		light *light_ptr = light_get_from_dense(i);
+
+		if (light_ptr->m_type != light::LIGHT_TYPE_NONE && light_ptr->m_shadow_casting) {
+			draw_shadow_map(light_ptr);
+		}
+
+		light_release(light_ptr);
+	}
+
+	// Clears the color through the lighting pass, its depth belongs to the base pass
+	g_framebuffer_object_light_volume_pass.bind();
+	glDrawBuffer(GL_COLOR_ATTACHMENT0_EXT);
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	glClearStencil(0);
+	glClear(GL_COLOR_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+	shader *lighting_shader = g_shader_lighting_volume;
+	lighting_shader->activate();
+
+	bind_gbuffer_textures(lighting_shader);
+
+	lighting_shader->set_uniform_matrix4fv(SHADER_UNIFORM_PROJ_MATRIX_INVERSE, proj_mat_inv->m_data);
+	lighting_shader->set_uniform_2f(SHADER_UNIFORM_SCREEN_SIZE, (float)g_width, (float)g_height);
+
+	glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+	glDepthMask(GL_FALSE);
+	glEnableClientState(GL_VERTEX_ARRAY);
+
+	bool depth_bounds = (GLEW_EXT_depth_bounds_test != 0);
+
+	real const zero[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	real ambient[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	uint32 volume_count = 0;
+	uint32 fullscreen_count = 0;
+	uint32 culled_count = 0;
+
+	for (uint32 i = 0; i < light_get_count(); ++i) {
+		light *light_ptr = light_get_from_dense(i);
+
+		if (light_ptr->m_type == light::LIGHT_TYPE_NONE) {
+			light_release(light_ptr);
+			continue;
+		}
+
+		matrix44 volume_transform;
+		light_volume_type volume_type = light_volume_get_transform(light_ptr, g_light_attenuation_cutoff, &volume_transform);
+
+		if (volume_type == LIGHT_VOLUME_TYPE_FULLSCREEN) {
+			lighting_shader->activate();
+			set_light_uniforms(lighting_shader, light_ptr, modelview_mat, light_ptr->m_ambient);
+
+			glMatrixMode(GL_PROJECTION);
+			glLoadIdentity();
+			glOrtho(0, g_width, 0, g_height, -1.0, 1.0);
+			glMatrixMode(GL_MODELVIEW);
+			glLoadIdentity();
+
+			glDisable(GL_DEPTH_TEST);
+			glDisable(GL_STENCIL_TEST);
+			glDisable(GL_CULL_FACE);
+			glEnable(GL_BLEND);
+			draw_lighting_quad();
+
+			++fullscreen_count;
+			light_release(light_ptr);
+			continue;
+		}
+
+		// Ambient is not bounded by attenuation, it goes on in one full screen pass at the end
+		for (uint32 c = 0; c < 4; ++c) {
+			ambient[c] += light_ptr->m_ambient[c];
+		}
+
+		real radius = light_get_attenuation_radius(light_ptr, g_light_attenuation_cutoff);
+		real depth_min = 0.0f;
+		real depth_max = 1.0f;
+		if (volume_type == LIGHT_VOLUME_TYPE_NONE || get_light_depth_bounds(light_ptr, modelview_mat, proj_mat, radius, &depth_min, &depth_max) == false) {
+			++culled_count;
+			light_release(light_ptr);
+			continue;
+		}
+
+		light_volume const& volume = (volume_type == LIGHT_VOLUME_TYPE_CONE) ? g_light_volume_cone : g_light_volume_sphere;
+
+		glMatrixMode(GL_PROJECTION);
+		glLoadMatrixf(proj_mat->m_data);
+		glMatrixMode(GL_MODELVIEW);
+		glLoadMatrixf(modelview_mat->m_data);
+		glMultMatrixf(volume_transform.m_data);
+
+		if (depth_bounds) {
+			glEnable(GL_DEPTH_BOUNDS_TEST_EXT);
+			glDepthBoundsEXT(depth_min, depth_max);
+		}
+
+		// Stencil pass, count volume faces behind the scene
+		shader_enable_fixed_function_pipeline();
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		glDisable(GL_BLEND);
+		glDisable(GL_CULL_FACE);
+		glEnable(GL_DEPTH_TEST);
+		glDepthFunc(GL_LESS);
+		glEnable(GL_STENCIL_TEST);
+		glStencilFunc(GL_ALWAYS, 0, 0xFF);
+		glStencilOpSeparate(GL_BACK, GL_KEEP, GL_INCR_WRAP, GL_KEEP);
+		glStencilOpSeparate(GL_FRONT, GL_KEEP, GL_DECR_WRAP, GL_KEEP);
+		volume.draw();
+
+		// Lighting pass, back faces so the camera can sit inside the volume, stencil is reset as it goes
+		lighting_shader->activate();
+		set_light_uniforms(lighting_shader, light_ptr, modelview_mat, zero);
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+		glEnable(GL_BLEND);
+		glDisable(GL_DEPTH_TEST);
+		glEnable(GL_CULL_FACE);
+		glCullFace(GL_FRONT);
+		glStencilFunc(GL_NOTEQUAL, 0, 0xFF);
+		glStencilOp(GL_KEEP, GL_KEEP, GL_ZERO);
+		volume.draw();
+
+		if (depth_bounds) {
+			glDisable(GL_DEPTH_BOUNDS_TEST_EXT);
+		}
+
+		++volume_count;
+		light_release(light_ptr);
+	}
+
+	glDisable(GL_STENCIL_TEST);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_CULL_FACE);
+
+	if (ambient[0] > 0.0f || ambient[1] > 0.0f || ambient[2] > 0.0f || ambient[3] > 0.0f) {
+		lighting_shader->activate();
+		lighting_shader->set_uniform_4f(SHADER_UNIFORM_LIGHT_POSITION, 0.0f, 0.0f, 0.0f, 0.0f);
+		lighting_shader->set_uniform_4fv(SHADER_UNIFORM_LIGHT_AMBIENT, ambient);
+		lighting_shader->set_uniform_4fv(SHADER_UNIFORM_LIGHT_DIFFUSE, zero);
+		lighting_shader->set_uniform_4fv(SHADER_UNIFORM_LIGHT_SPECULAR, zero);
+
+		glMatrixMode(GL_PROJECTION);
+		glLoadIdentity();
+		glOrtho(0, g_width, 0, g_height, -1.0, 1.0);
+		glMatrixMode(GL_MODELVIEW);
+		glLoadIdentity();
+
+		glEnable(GL_BLEND);
+		draw_lighting_quad();
+	}
+
+	glDisableClientState(GL_VERTEX_ARRAY);
+
+	g_framebuffer_object_light_volume_pass.unbind();
+
+	render_stats_count(RENDER_COUNTER_LIGHTS, volume_count + fullscreen_count);
+	render_stats_count(RENDER_COUNTER_LIGHTS_CULLED, culled_count);
+
+	glPopAttrib();
+
+	ReSizeGLScene(g_width, g_height);
+}
+
+static void draw_lights(matrix44 const *modelview_mat, matrix44 const *proj_mat, matrix44 const* view_proj_inv, matrix44 const *proj_mat_inv)
+{
+	PROFILE_SCOPE("draw_lights");
+
 #define RENDER_LIGHTS
 #if defined (RENDER_LIGHTS)
+	if (g_lighting_mode == RENDER_LIB_LIGHTING_MODE_TILED) {
+		draw_lights_tiled(modelview_mat, proj_mat, proj_mat_inv);
+		return;
+	}
+
+	if (g_lighting_mode == RENDER_LIB_LIGHTING_MODE_VOLUMES) {
+		draw_lights_volumes(modelview_mat, proj_mat, proj_mat_inv);
+		return;
+	}
 
 	glPushAttrib(GL_CURRENT_BIT | GL_POLYGON_BIT | GL_LIGHTING_BIT | GL_EVAL_BIT);
 
@@ -682,64 +1401,19 @@ static void draw_lights(matrix44 const *modelview_mat, matrix44 const* view_proj
 	// Set shader
 	g_shader_lighting->activate();
 
-	uint32 uniform_location0 = g_shader_lighting->get_location("color_texture");
-	uint32 uniform_location1 = g_shader_lighting->get_location("normal_texture");
-	uint32 uniform_location4 = g_shader_lighting->get_location("depth_texture");
-
-	uint32 uniform_location3 = g_shader_lighting->get_location("light_position");
-	uint32 uniform_location5 = g_shader_lighting->get_location("light_ambient");
-	uint32 uniform_location6 = g_shader_lighting->get_location("light_diffuse");
-	uint32 uniform_location7 = g_shader_lighting->get_location("light_specular");
-	uint32 uniform_location8 = g_shader_lighting->get_location("camera_position");
-	uint32 uniform_location9 = g_shader_lighting->get_location("camera_direction");
-
-	//uint32 uniform_location12 = g_shader_lighting->get_location("shadow_texture");
-	//uint32 uniform_location13 = g_shader_lighting->get_location("shadow_map_texture");
-	uint32 uniform_location14 = g_shader_lighting->get_location("light_attenuation");
-	//uint32 uniform_location15 = g_shader_lighting->get_location("view_matrix");
-	//uint32 uniform_location16 = g_shader_lighting->get_location("view_matrix_inverse");
-	uint32 uniform_location17 = g_shader_lighting->get_location("spot_direction");
-	uint32 uniform_location18 = g_shader_lighting->get_location("spot_exponent");
-	uint32 uniform_location19 = g_shader_lighting->get_location("spot_cos_cutoff");
-	uint32 uniform_location20 = g_shader_lighting->get_location("posxy_texture");
-	//uint32 uniform_location21 = g_shader_lighting->get_location("view_vectors");
-	//uint32 uniform_location22 = g_shader_lighting->get_location("planes");
-	uint32 uniform_location23 = g_shader_lighting->get_location("proj_matrix_inverse");
-	uint32 uniform_location24 = g_shader_lighting->get_location("light_specular_power");
-
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, g_base_pass_color_texture);
-	glUniform1iARB(uniform_location0, 0);
-
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, g_base_pass_normal_texture);
-	glUniform1iARB(uniform_location1, 1);
-
-	glActiveTexture(GL_TEXTURE2);
-	glBindTexture(GL_TEXTURE_2D, g_base_pass_depth_texture);
-	glUniform1iARB(uniform_location4, 2);
+	bind_gbuffer_textures(g_shader_lighting);
 
 	//glActiveTexture(GL_TEXTURE3);
 	//g_texture_shadow->activate();
 	//glUniform1iARB(uniform_location12, 3);
 
-	glActiveTexture(GL_TEXTURE4);
-	glBindTexture(GL_TEXTURE_2D, g_base_pass_posxy_texture);
-	glUniform1iARB(uniform_location20, 4);
-
-	//glActiveTexture(GL_TEXTURE5);
-	//glBindTexture(GL_TEXTURE_2D, g_framebuffer_object_shadowmap_pass.get_depth_buffer_id());
-	//glUniform1iARB(uniform_location13, 5);
-
-	glUniform3fvARB(uniform_location8, 1, g_camera_pos.m_data);
+	g_shader_lighting->set_uniform_3fv(SHADER_UNIFORM_CAMERA_POSITION, g_camera_pos.m_data);
 	matrix44 orient;
 	g_camera_orient.CreateMatrix(orient.m_data);
 
-	glUniform3fvARB(uniform_location9, 1, orient.get_fvec().m_data);
-
-	//glUniformMatrix4fvARB(uniform_location15, 1, 0, modelview_mat->m_data);
+	g_shader_lighting->set_uniform_3fv(SHADER_UNIFORM_CAMERA_DIRECTION, orient.get_fvec().m_data);
 
-	glUniformMatrix4fvARB(uniform_location23, 1, 0, proj_mat_inv->m_data);
+	g_shader_lighting->set_uniform_matrix4fv(SHADER_UNIFORM_PROJ_MATRIX_INVERSE, proj_mat_inv->m_data);
 	
 	//glUniform3fARB(uniform_location3, 0.0f, -25.0f, -500.0f);
 	
@@ -781,42 +1455,17 @@ static void draw_lights(matrix44 const *modelview_mat, matrix44 const* view_proj
 
 	// Loop over lights
 	for (uint32 i = 0; i < light_get_count(); ++i) {
-		light *light_ptr = light_get_from_index((uint8)i);
+		light *light_ptr = light_get_from_dense(i);
 
 		if (light_ptr->m_type == light::LIGHT_TYPE_NONE) {
+			light_release(light_ptr);
 			continue;
 		}
 
 		if (light_ptr->m_shadow_casting) {
 			g_framebuffer_object_lighting_pass.unbind();
 
-			// Render from light's perspective and get depth map
-			// Enable Shadow FBO
-			// Transform to light
-			g_framebuffer_object_shadowmap_pass.bind();
-
-			ReSizeGLScene(g_width, g_height);
-
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-			g_shader_prepass->activate();
-			glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
-			glEnable(GL_DEPTH_TEST);
-			glCullFace(GL_FRONT);
-			glDepthMask(GL_TRUE);
-			glDrawBuffer(GL_FALSE);
-			glReadBuffer (GL_FALSE);
-
-			// Transform to lights position
-			camera light_camera;
-			light_camera.set_transform(&light_ptr->m_transform.m_transform_matrix);
-			light_camera.set_perspective();
-
-			draw_geometry(true, NULL);
-
-			glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
-			g_framebuffer_object_shadowmap_pass.unbind();
-
-			glCullFace(GL_BACK);
+			draw_shadow_map(light_ptr);
 
 			g_framebuffer_object_lighting_pass.bind();
 			g_shader_lighting->activate();
@@ -827,37 +1476,16 @@ static void draw_lights(matrix44 const *modelview_mat, matrix44 const* view_proj
 		// Disable Shadow FBO
 		// Render front face culled shape of light and pass in shadow depth buffer
 		
-		// Set light values
-		Vector3 const& pos = light_ptr->m_transform.get_position();
-		if (light_ptr->m_type == light::LIGHT_TYPE_POINT) {
-			Vector3 light_pos = *modelview_mat * pos;
-			glUniform4fARB(uniform_location3, light_pos.m_data[0], light_pos.m_data[1], light_pos.m_data[2], 1.0f);
-		} else {	// DIRECTION LIGHT
-			Vector3 light_pos = *modelview_mat * pos;
-			glUniform4fARB(uniform_location3, light_pos.m_data[0], light_pos.m_data[1], light_pos.m_data[2], 0.0f);
-		}
-		glUniform4fvARB(uniform_location5, 1, light_ptr->m_ambient);
-		glUniform4fvARB(uniform_location6, 1, light_ptr->m_diffuse);
-		glUniform4fvARB(uniform_location7, 1, light_ptr->m_specular);
-		float attenuation[3];
-		attenuation[0] = light_ptr->m_constant_attenuation;
-		attenuation[1] = light_ptr->m_linear_attenuation;
-		attenuation[2] = light_ptr->m_quadratic_attenuation;
-		glUniform3fvARB(uniform_location14, 1, attenuation);
-
-		Vector3 spot_direction = (*modelview_mat * light_ptr->m_spot_direction) - (*modelview_mat * Vector3(0.0f, 0.0f, 0.0f));
-
-		glUniform3fvARB(uniform_location17, 1, spot_direction.m_data);
-		glUniform1fARB(uniform_location18, light_ptr->m_spot_exponent);
-		glUniform1fARB(uniform_location19, light_ptr->m_spot_cos_cutoff);
-		glUniform1fARB(uniform_location24, light_ptr->m_specular_power);
+		// Set light values, unchanged ones are skipped
+		set_light_uniforms(g_shader_lighting, light_ptr, modelview_mat, light_ptr->m_ambient);
 
 #if defined(DEBUG_RENDER)
 		static int count = 0;
 		if (count >= 100) {
 			char buffer[256];
+			Vector3 pos = light_ptr->m_transform.get_world_position();
 			sprintf(buffer, "light pos: %f %f %f att: %f %f %f  diff: %f %f %f %f\n", pos.m_data[0], pos.m_data[1], pos.m_data[2],
-				attenuation[0], attenuation[1], attenuation[2], 
+				light_ptr->m_constant_attenuation, light_ptr->m_linear_attenuation, light_ptr->m_quadratic_attenuation, 
 				light_ptr->m_diffuse[0], light_ptr->m_diffuse[1], light_ptr->m_diffuse[2], light_ptr->m_diffuse[3]);
 			OutputDebugStringA(buffer);
 			count = 0;
@@ -892,23 +1520,8 @@ static void draw_lights(matrix44 const *modelview_mat, matrix44 const* view_proj
 		//g_framebuffer_object_lighting_pass.bind();
 		glDrawBuffer(GL_COLOR_ATTACHMENT0_EXT);
 
-		// Draw quad
-		glBegin(GL_QUADS);
-		glTexCoord2f( 0.0f, 1.0f); 
-		glVertex2i(0, g_height);	// Bottom Left Of The Texture and Quad
-
-		//glTexCoord2i(g_width, 0);
-		glTexCoord2f(1.0f, 1.0f);
-		glVertex2i(g_width, g_height);	// Bottom Right Of The Texture and Quad
-
-		//glTexCoord2i(g_width, g_height);
-		glTexCoord2f(1.0f, 0.0f);
-		glVertex2i(g_width, 0);	// Top Right Of The Texture and Quad
-
-		//glTexCoord2i(0, g_height);
-		glTexCoord2f(0.0f, 0.0f);
-		glVertex2i(0, 0);	// Top Left Of The Texture and Quad
-		glEnd();
+		draw_lighting_quad();
+		render_stats_count(RENDER_COUNTER_LIGHTS, 1);
 
 		//g_framebuffer_object_lighting_pass.unbind();
 
@@ -931,13 +1544,11 @@ void render_lib_render_block(render_block *p_render_block, mesh_instance_dynamic
 {
 	render_block &rb = *p_render_block;
 
-	if (rb.m_uv != NULL) {
-		glTexCoordPointer(2, GL_FLOAT, 0, rb.m_uv);
-	}
-	
-	if (rb.m_normal) {
-		glNormalPointer(GL_FLOAT, 0, rb.m_normal);
+	if (rb.m_prepared == false) {
+		rb.prepare(p_dynamic_mesh != 0);
 	}
+
+	rb.bind();
 	
 	if (rb.m_material) {
 #if MATERIAL_SUPPORT
@@ -961,22 +1572,15 @@ void render_lib_render_block(render_block *p_render_block, mesh_instance_dynamic
 		glColor3f(0.0f, 0.0f, 0.0f);
 	}
 
-	if (p_dynamic_mesh == 0) { 
-		glVertexPointer(3, GL_FLOAT, 0, rb.m_pos);
-	} else {
-		glVertexPointer(3, GL_FLOAT, 0, p_dynamic_mesh->m_dynamic_pos);
+	if (p_dynamic_mesh != 0) { 
+		uint32 offset = g_dynamic_vertex_buffer.write(p_dynamic_mesh->m_dynamic_pos, sizeof(Vector3) * rb.m_vertex_count);
+		glVertexPointer(3, GL_FLOAT, 0, BUFFER_OFFSET(offset));
 	}
 	
-	switch (rb.m_format) {
-		case RENDER_LIB_MESH_FORMAT_VA_TRIANGLES:
-			glDrawElements(GL_TRIANGLES, rb.m_index_count, GL_UNSIGNED_INT, rb.m_index_buffer);
-			break;
-		case RENDER_LIB_MESH_FORMAT_VA_TRIANGLE_STRIP:
-			glDrawElements(GL_TRIANGLE_STRIP, rb.m_index_count, GL_UNSIGNED_INT, rb.m_index_buffer);
-			break;
-		default:
-			break;
-		};
+	rb.draw(1);
+
+	glBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+	glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, 0);
 }
 
 
@@ -984,6 +1588,22 @@ void render_lib_render_block(render_block *p_render_block, mesh_instance_dynamic
 void render_lib_set_default_shader(char *p_shader_name)
 {
 	strncpy(g_shader_name, p_shader_name, MAX_SHADER_NAME_LENGTH);
+
+	g_shader_default = shader_create(g_shader_name);
+
+	// Look for the instanced variant of the default shader, e.g. deferred_base_instanced
+	if (g_instancing_supported) {
+		char instanced_name[MAX_SHADER_NAME_LENGTH + 16];
+		sprintf(instanced_name, "%s_instanced", g_shader_name);
+		g_shader_default_instanced = shader_create(instanced_name);
+		if (g_shader_default_instanced->is_valid() == false) {
+			printf("%s failed to build, instancing disabled\n", instanced_name);
+			shader_release(g_shader_default_instanced);
+			g_shader_default_instanced = NULL;
+		}
+
+		g_instancing_enabled = (g_shader_default_instanced != NULL);
+	}
 }
 
 shader * render_lib_get_default_shader()
@@ -991,10 +1611,55 @@ shader * render_lib_get_default_shader()
 	return shader_create(g_shader_name);
 }
 
-bool render_lib_init(unsigned long p_width, unsigned long p_height)
+void render_lib_set_instancing(bool p_enable)
+{
+	g_instancing_enabled = p_enable && g_instancing_supported && (g_shader_default_instanced != NULL);
+}
+
+bool render_lib_get_instancing()
+{
+	return g_instancing_enabled;
+}
+
+void render_lib_set_lighting_mode(lighting_mode p_mode)
+{
+	if (p_mode == RENDER_LIB_LIGHTING_MODE_TILED && g_light_tiles_supported == false) {
+		p_mode = RENDER_LIB_LIGHTING_MODE_QUADS;
+	}
+
+	if (p_mode == RENDER_LIB_LIGHTING_MODE_VOLUMES && g_light_volumes_supported == false) {
+		p_mode = RENDER_LIB_LIGHTING_MODE_QUADS;
+	}
+
+	g_lighting_mode = p_mode;
+}
+
+gbuffer_layout render_lib_get_gbuffer_layout()
+{
+	return g_gbuffer_layout;
+}
+
+lighting_mode render_lib_get_lighting_mode()
+{
+	return g_lighting_mode;
+}
+
+void render_lib_set_light_attenuation_cutoff(real p_cutoff)
+{
+	assert(p_cutoff > 0.0f && p_cutoff < 1.0f);
+	g_light_attenuation_cutoff = p_cutoff;
+}
+
+real render_lib_get_light_attenuation_cutoff()
+{
+	return g_light_attenuation_cutoff;
+}
+
+bool render_lib_init(unsigned long p_width, unsigned long p_height, gbuffer_layout p_gbuffer_layout)
 {
 	g_width = p_width;
 	g_height = p_height;
+	g_gbuffer_layout = p_gbuffer_layout;
 
 
 	/* Information about the current video settings. */
@@ -1083,11 +1748,6 @@ bool render_lib_init(unsigned long p_width, unsigned long p_height)
 		return false;
 	}
 
-	val = IsExtensionSupported("GL_EXT_draw_instanced");
-	if (val == false) {
-//		assert(0 == 1);
-	}
-	
 	GLenum err = glewInit();
 	
 	render_lib_map_2_0_functions();
@@ -1127,75 +1787,113 @@ bool render_lib_init(unsigned long p_width, unsigned long p_height)
 	material_system_init();
 	texture_system_init();
 	shader_system_init();
+	if (g_gbuffer_layout == RENDER_LIB_GBUFFER_LAYOUT_SLIM) {
+		shader_system_set_defines("#define GBUFFER_LAYOUT_SLIM 1\n");
+	}
 	framebuffer_object_system_init();
 	light_system_init();
 
+	g_dynamic_vertex_buffer.init(DEFAULT_DYNAMIC_VERTEX_BUFFER_SIZE);
+
+	setup_light_volumes();
+
 	setup_base_pass_framebuffer();
 	setup_lighting_pass_framebuffer();
+	setup_light_volume_pass_framebuffer();
 	setup_shadowmap_pass_framebuffer();
 
 	g_shader_lighting = shader_create("deferred_lighting");
 	g_shader_prepass = shader_create("prepass");
 
+	setup_instancing();
+
+	// Tile light lists live in float textures
+	g_light_tiles_supported = IsExtensionSupported("GL_ARB_texture_float");
+	if (g_light_tiles_supported) {
+		g_light_tile_grid.init(g_width, g_height, LIGHT_TILE_SIZE_DEFAULT);
+		g_shader_lighting_tiled = shader_create("deferred_lighting_tiled");
+		g_lighting_mode = RENDER_LIB_LIGHTING_MODE_TILED;
+	}
+
 	g_texture_shadow = texture_create("shadow_blend_texture");
 	g_texture_shadow->load("shadow.png");
 
 	g_texture_invalid = texture_create("invalid_texture");
 	g_texture_invalid->load("invalid.png");
+	texture_set_placeholder(g_texture_invalid);
+
+	// Setup bound textures directly
+	render_state_invalidate();
+
+	render_stats_init();
 
 	return true;								
 }
 
-mesh_id render_lib_mesh_instance_add(mesh_instance *p_mesh_instance)
+static void add_pending_instance(mesh_instance *p_mesh_instance)
 {
-	for (uint32 i = 0; i < p_mesh_instance->m_mesh->m_render_block_count; ++i) {
-		add_render_block_to_shader(p_mesh_instance, &p_mesh_instance->m_mesh->m_render_blocks[i]);
+	if (g_pending_instance_count == g_pending_instances_max) {
+		g_pending_instances_max = (g_pending_instances_max == 0) ? 64 : g_pending_instances_max * 2;
+		g_pending_instances = (mesh_instance **)MEMORY_REALLOC(g_pending_instances, sizeof(mesh_instance *) * g_pending_instances_max, MEMORY_TAG_SCENE);
+		assert(g_pending_instances != NULL);
 	}
 
+	g_pending_instances[g_pending_instance_count++] = p_mesh_instance;
+}
 
-	g_mesh_instances.push_back(p_mesh_instance);
-	return (mesh_id)0;
+// Main thread, after the frame's uploads have gone through
+static void add_ready_pending_instances()
+{
+	uint32 i = 0;
+	while (i < g_pending_instance_count) {
+		mesh_instance *instance = g_pending_instances[i];
+		if (instance->m_mesh->m_load_failed) {
+			// Nothing will ever arrive, the instance just isn't drawn
+			g_pending_instances[i] = g_pending_instances[--g_pending_instance_count];
+		} else if (instance->m_mesh->m_render_block_count > 0) {
+			g_pending_instances[i] = g_pending_instances[--g_pending_instance_count];
+			render_lib_mesh_instance_add(instance);
+		} else {
+			++i;
+		}
+	}
 }
 
-void render_lib_mesh_instance_remove(mesh_instance *p_mesh_instance)
+mesh_id render_lib_mesh_instance_add(mesh_instance *p_mesh_instance)
 {
-#if 0
-	// Remove mesh instance for render block list
-	std::list<mesh_instance *>::iterator iter;
+	// Meshes requested with resource_manager_get_mesh_async have no render blocks until their upload finishes
+	if (p_mesh_instance->m_mesh->m_render_block_count == 0 && p_mesh_instance->m_mesh->m_load_failed == false) {
+		add_pending_instance(p_mesh_instance);
+		return (mesh_id)0;
+	}
 
 	for (uint32 i = 0; i < p_mesh_instance->m_mesh->m_render_block_count; ++i) {
-		render_block *render_block_ptr = &p_mesh_instance->m_mesh->m_render_blocks[i];
-
-		for (iter = g_render_block_to_mesh_instance_list_map[render_block_ptr].begin(); iter != g_render_block_to_mesh_instance_list_map[render_block_ptr].end(); ++iter) {
-			if ((*iter) == p_mesh_instance) {
-				g_render_block_to_mesh_instance_list_map[render_block_ptr].erase(iter);
-				break;
-			}
-		}
-
-		if (g_render_block_to_mesh_instance_list_map[render_block_ptr].empty() == true) {
-			// If render block has no entries, remove it from shader list
-			assert (render_block_ptr->m_material != NULL);
-			assert (render_block_ptr->m_material->m_shader != NULL);
-			shader *shader_ptr = render_block_ptr->m_material->m_shader;
+		add_renderable(p_mesh_instance, &p_mesh_instance->m_mesh->m_render_blocks[i]);
+	}
 
-			std::list<render_block *>::iterator iter2;
+	return (mesh_id)0;
+}
 
-			for (iter2 = g_shader_to_render_blocks_map[shader_ptr].begin(); iter2 != g_shader_to_render_blocks_map[shader_ptr].end(); ++iter2) {
-				if ((*iter2) == render_block_ptr) {
-					g_shader_to_render_blocks_map[shader_ptr].erase(iter2);
-					break;
-				}
-			}
+void render_lib_mesh_instance_remove(mesh_instance *p_mesh_instance)
+{
+	// Swap remove every render block entry belonging to this instance
+	uint32 i = 0;
+	while (i < g_renderable_count) {
+		if (g_renderables[i].m_mesh_instance == p_mesh_instance) {
+			// The bounds stay behind in slot i, so the moved entry rebuilds its own
+			g_renderables[i] = g_renderables[--g_renderable_count];
+			g_renderables[i].m_transform_version = 0;
+		} else {
+			++i;
 		}
 	}
-#endif
 
-	std::list<mesh_instance *>::iterator mesh_iter;
-	for (mesh_iter = g_mesh_instances.begin(); mesh_iter != g_mesh_instances.end(); ++mesh_iter) {
-		if (*mesh_iter == p_mesh_instance) {
-			g_mesh_instances.erase(mesh_iter);
-			return;
+	i = 0;
+	while (i < g_pending_instance_count) {
+		if (g_pending_instances[i] == p_mesh_instance) {
+			g_pending_instances[i] = g_pending_instances[--g_pending_instance_count];
+		} else {
+			++i;
 		}
 	}
 }
@@ -1208,24 +1906,37 @@ void render_lib_set_camera(Vector3 const& p_pos, quaternion const& p_orient)
 
 void render_lib_render()
 {
+	// Finish streamed textures and meshes before anything reads them this frame
+	asset_stream_process(ASSET_STREAM_UPLOAD_BUDGET_DEFAULT);
+	add_ready_pending_instances();
+
+	// Anything outside the frame may have touched GL state directly
+	render_state_invalidate();
+	render_state_reset_stats();
+	render_stats_frame_begin();
+
 	// Step One: Render non-lit scene to texture
+	render_stats_pass_begin(RENDER_PASS_BASE);
 	g_framebuffer_object_base_pass.bind();
 	GLenum buffers[] = { GL_COLOR_ATTACHMENT0_EXT, GL_COLOR_ATTACHMENT1_EXT, GL_COLOR_ATTACHMENT2_EXT, GL_COLOR_ATTACHMENT3_EXT };
 
-	glDrawBuffers(4, buffers);
+	glDrawBuffers(g_gbuffer_target_count, buffers);
 	
 	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);		// Clear The Screen And The Depth Buffer
+	glClearStencil(0);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);		// Clear The Screen, Depth And Stencil Buffer
 
 	glDrawBuffer(GL_COLOR_ATTACHMENT1_EXT);
 	//glClearColor(0.5f, 0.0f, 0.5f, 0.0f);
 	glClear(GL_COLOR_BUFFER_BIT);		
 
-	glDrawBuffer(GL_COLOR_ATTACHMENT2_EXT);
-	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-	glClear(GL_COLOR_BUFFER_BIT);		// Clear The Screen And The Depth Buffer
+	if (g_gbuffer_layout == RENDER_LIB_GBUFFER_LAYOUT_PACKED) {
+		glDrawBuffer(GL_COLOR_ATTACHMENT2_EXT);
+		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT);		// Clear The Screen And The Depth Buffer
+	}
 
-	glDrawBuffers(4, buffers);
+	glDrawBuffers(g_gbuffer_target_count, buffers);
 	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 
 
@@ -1263,7 +1974,7 @@ void render_lib_render()
 	glDisable(GL_ALPHA_TEST);
 	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
 	glDepthMask(GL_TRUE);
-	draw_geometry(true);
+	draw_geometry(true, NULL, &g_render_queue);
 	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
 	glDepthMask(GL_FALSE);
 #endif
@@ -1271,8 +1982,18 @@ void render_lib_render()
 
 	glEnable(GL_DEPTH_TEST);
 	glCullFace(GL_BACK);
+
+	frustum camera_frustum;
+	camera_frustum.set_from_matrix(&viewproj);
+
+	matrix44 const* camera_transform = g_camera.get_transform();
+
+	update_cull_bounds();
+	render_stats_count(RENDER_COUNTER_CULLED, build_render_queue(&g_render_queue, &camera_frustum, camera_transform->get_trans(), camera_transform->get_fvec()));
+	render_stats_count(RENDER_COUNTER_VISIBLE, g_render_queue.get_count());
+	build_instance_buffer(&g_render_queue);
 	
-	draw_geometry(false, &modelview_mat);
+	draw_geometry(false, &modelview_mat, &g_render_queue);
 	glDepthMask(GL_TRUE);
 
 	glDisable(GL_LIGHTING);
@@ -1283,19 +2004,29 @@ void render_lib_render()
 	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
 	glDisableClientState(GL_NORMAL_ARRAY);
 
+	if (g_base_pass_depth_copy_texture) {
+		render_state_bind_texture(0, GL_TEXTURE_2D, g_base_pass_depth_copy_texture);
+		glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, g_width, g_height);
+	}
+
 	g_framebuffer_object_base_pass.unbind();
+	render_stats_pass_end();
 
-	// Step Two: Apply Lighting
+	// Step Two: Apply Lighting, shadow maps are timed as a pass of their own
 
 	//draw_lights(&modelview_mat, &proj_mat_inv);
-	draw_lights(&modelview_mat, &viewproj_inv, &proj_mat_inv);
+	render_stats_pass_begin(RENDER_PASS_LIGHTING);
+	draw_lights(&modelview_mat, &proj_mat, &viewproj_inv, &proj_mat_inv);
+	render_stats_pass_end();
 
 	// Step Three: Framebuffer effects
 
 
+	render_stats_pass_begin(RENDER_PASS_FINAL);
 	draw_final_scene();
+	render_stats_pass_end();
 
-
+	render_stats_frame_end();
 	
 	//glBindTexture(GL_TEXTURE_RECTANGLE_ARB, 0);
 	//glDisable(GL_TEXTURE_RECTANGLE_ARB);
@@ -14,7 +14,9 @@ class shader;
 
 extern camera g_camera;
 
-bool render_lib_init(unsigned long p_width, unsigned long p_height);
+// The g-buffer layout is fixed for the lifetime of the renderer, shaders are compiled against it
+bool render_lib_init(unsigned long p_width, unsigned long p_height, gbuffer_layout p_gbuffer_layout);
+gbuffer_layout render_lib_get_gbuffer_layout();
 
 mesh_id render_lib_mesh_instance_add(mesh_instance *p_mesh_instance);
 void render_lib_mesh_instance_remove(mesh_instance *p_mesh_instance);
@@ -32,4 +34,16 @@ void render_texture_unbind(unsigned long p_texture_id);
 void render_lib_set_default_shader(char *p_shader_name);
 shader * render_lib_get_default_shader();
 
+// Draw render blocks shared by several mesh instances with one instanced call
+void render_lib_set_instancing(bool p_enable);
+bool render_lib_get_instancing();
+
+// Full screen quad per light, one pass over lights binned into screen tiles, or stencil culled light volumes
+void render_lib_set_lighting_mode(lighting_mode p_mode);
+lighting_mode render_lib_get_lighting_mode();
+
+// Attenuation below which a light is considered to have no effect, sizes the tiled and volume light bounds
+void render_lib_set_light_attenuation_cutoff(real p_cutoff);
+real render_lib_get_light_attenuation_cutoff();
+
 #endif // __RENDER_LIB_H_
\ No newline at end of file
@@ -13,5 +13,16 @@ typedef unsigned char mesh_format;
 const mesh_format RENDER_LIB_MESH_FORMAT_VA_TRIANGLES = 0;
 const mesh_format RENDER_LIB_MESH_FORMAT_VA_TRIANGLE_STRIP = 1;
 
+// Packed: color, normal xy, depth as RGB8 and normal z in four RGBA8 targets.
+// Slim: color and a two channel normal, position is rebuilt from the depth buffer.
+typedef unsigned char gbuffer_layout;
+const gbuffer_layout RENDER_LIB_GBUFFER_LAYOUT_PACKED = 0;
+const gbuffer_layout RENDER_LIB_GBUFFER_LAYOUT_SLIM = 1;
+
+typedef unsigned char lighting_mode;
+const lighting_mode RENDER_LIB_LIGHTING_MODE_QUADS = 0;
+const lighting_mode RENDER_LIB_LIGHTING_MODE_TILED = 1;
+const lighting_mode RENDER_LIB_LIGHTING_MODE_VOLUMES = 2;
+
 
 #endif // __RENDER_LIB_TYPES_H_
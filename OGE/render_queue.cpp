@@ -0,0 +1,124 @@
+#include "render_queue.h"
+
+#include "assert.h"
+#include "memory_lib.h"
+
+#include <string.h>
+
+#define RENDER_QUEUE_RADIX_BITS (8)
+#define RENDER_QUEUE_RADIX_SIZE (1 << RENDER_QUEUE_RADIX_BITS)
+#define RENDER_QUEUE_RADIX_PASSES (sizeof(render_queue_key))
+
+render_queue::render_queue()
+{
+	m_items = NULL;
+	m_scratch = NULL;
+	m_count = 0;
+	m_items_max = 0;
+}
+
+void render_queue::reset(uint32 p_items_max)
+{
+	m_items = (render_queue_item *)memory_frame_alloc(sizeof(render_queue_item) * p_items_max);
+	m_scratch = (render_queue_item *)memory_frame_alloc(sizeof(render_queue_item) * p_items_max);
+	m_count = 0;
+	m_items_max = p_items_max;
+}
+
+void render_queue::push(render_queue_key p_key, render_block *p_render_block, mesh_instance *p_mesh_instance)
+{
+	assert(m_count < m_items_max);
+
+	render_queue_item &item = m_items[m_count++];
+	item.m_key = p_key;
+	item.m_render_block = p_render_block;
+	item.m_mesh_instance = p_mesh_instance;
+}
+
+void render_queue::sort()
+{
+	if (m_count < 2) {
+		return;
+	}
+
+	// Build the histogram for every key byte in one pass over the items
+	static uint32 histogram[RENDER_QUEUE_RADIX_PASSES][RENDER_QUEUE_RADIX_SIZE];
+	memset(histogram, 0, sizeof(histogram));
+
+	for (uint32 i = 0; i < m_count; ++i) {
+		render_queue_key key = m_items[i].m_key;
+		for (uint32 pass = 0; pass < RENDER_QUEUE_RADIX_PASSES; ++pass) {
+			histogram[pass][(key >> (pass * RENDER_QUEUE_RADIX_BITS)) & (RENDER_QUEUE_RADIX_SIZE - 1)]++;
+		}
+	}
+
+	render_queue_item *src = m_items;
+	render_queue_item *dst = m_scratch;
+
+	for (uint32 pass = 0; pass < RENDER_QUEUE_RADIX_PASSES; ++pass) {
+		uint32 shift = pass * RENDER_QUEUE_RADIX_BITS;
+		uint32 *counts = histogram[pass];
+
+		// Every key shares this byte, nothing to reorder
+		if (counts[(src[0].m_key >> shift) & (RENDER_QUEUE_RADIX_SIZE - 1)] == m_count) {
+			continue;
+		}
+
+		uint32 offset = 0;
+		for (uint32 i = 0; i < RENDER_QUEUE_RADIX_SIZE; ++i) {
+			uint32 count = counts[i];
+			counts[i] = offset;
+			offset += count;
+		}
+
+		for (uint32 i = 0; i < m_count; ++i) {
+			uint32 digit = (uint32)((src[i].m_key >> shift) & (RENDER_QUEUE_RADIX_SIZE - 1));
+			dst[counts[digit]++] = src[i];
+		}
+
+		render_queue_item *tmp = src;
+		src = dst;
+		dst = tmp;
+	}
+
+	// Sorted data may have ended up in the scratch buffer
+	if (src != m_items) {
+		m_scratch = m_items;
+		m_items = src;
+	}
+}
+
+uint32 render_queue::get_count() const
+{
+	return m_count;
+}
+
+render_queue_item const* render_queue::get_items() const
+{
+	return m_items;
+}
+
+render_queue_key render_queue::make_key(uint32 p_pass, uint32 p_shader_id, uint32 p_material_id, uint32 p_depth, uint32 p_block_id)
+{
+	render_queue_key key = 0;
+	key |= ((render_queue_key)(p_pass & ((1 << RENDER_QUEUE_PASS_BITS) - 1))) << RENDER_QUEUE_PASS_SHIFT;
+	key |= ((render_queue_key)(p_shader_id & ((1 << RENDER_QUEUE_SHADER_BITS) - 1))) << RENDER_QUEUE_SHADER_SHIFT;
+	key |= ((render_queue_key)(p_material_id & ((1 << RENDER_QUEUE_MATERIAL_BITS) - 1))) << RENDER_QUEUE_MATERIAL_SHIFT;
+	key |= ((render_queue_key)(p_depth & RENDER_QUEUE_DEPTH_MAX)) << RENDER_QUEUE_DEPTH_SHIFT;
+	key |= ((render_queue_key)(p_block_id & ((1 << RENDER_QUEUE_BLOCK_BITS) - 1))) << RENDER_QUEUE_BLOCK_SHIFT;
+
+	return key;
+}
+
+uint32 render_queue::quantize_depth(real p_depth, real p_near, real p_far)
+{
+	if (p_depth <= p_near) {
+		return 0;
+	}
+
+	if (p_depth >= p_far) {
+		return RENDER_QUEUE_DEPTH_MAX;
+	}
+
+	return (uint32)(((p_depth - p_near) / (p_far - p_near)) * RENDER_QUEUE_DEPTH_MAX);
+}
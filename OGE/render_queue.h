@@ -0,0 +1,63 @@
+#ifndef __RENDER_QUEUE_H_
+#define __RENDER_QUEUE_H_
+
+#include "core_types.h"
+
+class render_block;
+class mesh_instance;
+
+// Sort key layout, most significant bits first:
+// pass (4) | shader (10) | material (14) | depth (16) | render block (20)
+typedef uint64 render_queue_key;
+
+#define RENDER_QUEUE_PASS_BITS (4)
+#define RENDER_QUEUE_SHADER_BITS (10)
+#define RENDER_QUEUE_MATERIAL_BITS (14)
+#define RENDER_QUEUE_DEPTH_BITS (16)
+#define RENDER_QUEUE_BLOCK_BITS (20)
+
+#define RENDER_QUEUE_BLOCK_SHIFT (0)
+#define RENDER_QUEUE_DEPTH_SHIFT (RENDER_QUEUE_BLOCK_SHIFT + RENDER_QUEUE_BLOCK_BITS)
+#define RENDER_QUEUE_MATERIAL_SHIFT (RENDER_QUEUE_DEPTH_SHIFT + RENDER_QUEUE_DEPTH_BITS)
+#define RENDER_QUEUE_SHADER_SHIFT (RENDER_QUEUE_MATERIAL_SHIFT + RENDER_QUEUE_MATERIAL_BITS)
+#define RENDER_QUEUE_PASS_SHIFT (RENDER_QUEUE_SHADER_SHIFT + RENDER_QUEUE_SHADER_BITS)
+
+#define RENDER_QUEUE_DEPTH_MAX ((1 << RENDER_QUEUE_DEPTH_BITS) - 1)
+
+const uint32 RENDER_QUEUE_PASS_OPAQUE = 0;
+
+class render_queue_item
+{
+public:
+	render_queue_key m_key;
+	render_block *m_render_block;
+	mesh_instance *m_mesh_instance;
+};
+
+class render_queue
+{
+public:
+	render_queue();
+
+	// Start an empty queue with room for p_items_max items, storage comes from the frame arena
+	// so the queue must be rebuilt every frame before use
+	void reset(uint32 p_items_max);
+	void push(render_queue_key p_key, render_block *p_render_block, mesh_instance *p_mesh_instance);
+
+	// Radix sort items by key so they can be drawn linearly
+	void sort();
+
+	uint32 get_count() const;
+	render_queue_item const* get_items() const;
+
+	static render_queue_key make_key(uint32 p_pass, uint32 p_shader_id, uint32 p_material_id, uint32 p_depth, uint32 p_block_id);
+	static uint32 quantize_depth(real p_depth, real p_near, real p_far);
+
+private:
+	render_queue_item *m_items;
+	render_queue_item *m_scratch;
+	uint32 m_count;
+	uint32 m_items_max;
+};
+
+#endif /* __RENDER_QUEUE_H_ */
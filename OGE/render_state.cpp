@@ -0,0 +1,89 @@
+#include "render_state.h"
+
+#include "assert.h"
+#include "glew/glew.h"
+
+#include <string.h>
+
+#define RENDER_STATE_UNKNOWN (0xFFFFFFFF)
+
+class render_state_texture
+{
+public:
+	uint32 m_target;
+	uint32 m_texture;
+};
+
+static uint32 g_program = RENDER_STATE_UNKNOWN;
+static uint32 g_active_texture_unit = RENDER_STATE_UNKNOWN;
+static render_state_texture g_textures[RENDER_STATE_TEXTURE_UNITS_MAX];
+
+static render_state_stats g_stats;
+
+void render_state_invalidate()
+{
+	g_program = RENDER_STATE_UNKNOWN;
+	g_active_texture_unit = RENDER_STATE_UNKNOWN;
+
+	for (uint32 i = 0; i < RENDER_STATE_TEXTURE_UNITS_MAX; ++i) {
+		g_textures[i].m_target = RENDER_STATE_UNKNOWN;
+		g_textures[i].m_texture = RENDER_STATE_UNKNOWN;
+	}
+}
+
+void render_state_use_program(uint32 p_program)
+{
+	if (p_program == g_program) {
+		g_stats.m_program_changes_elided++;
+		return;
+	}
+
+	glUseProgram(p_program);
+	g_program = p_program;
+	g_stats.m_program_changes++;
+}
+
+uint32 render_state_get_program()
+{
+	return g_program;
+}
+
+void render_state_bind_texture(uint32 p_unit, uint32 p_target, uint32 p_texture)
+{
+	assert(p_unit < RENDER_STATE_TEXTURE_UNITS_MAX);
+
+	if (p_unit != g_active_texture_unit) {
+		glActiveTexture(GL_TEXTURE0 + p_unit);
+		g_active_texture_unit = p_unit;
+	}
+
+	render_state_texture &bound = g_textures[p_unit];
+	if (bound.m_target == p_target && bound.m_texture == p_texture) {
+		g_stats.m_texture_changes_elided++;
+		return;
+	}
+
+	glBindTexture(p_target, p_texture);
+	bound.m_target = p_target;
+	bound.m_texture = p_texture;
+	g_stats.m_texture_changes++;
+}
+
+void render_state_count_uniform(bool p_elided)
+{
+	if (p_elided) {
+		g_stats.m_uniform_changes_elided++;
+	} else {
+		g_stats.m_uniform_changes++;
+	}
+}
+
+render_state_stats const* render_state_get_stats()
+{
+	return &g_stats;
+}
+
+void render_state_reset_stats()
+{
+	memset(&g_stats, 0, sizeof(g_stats));
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+#ifndef __RENDER_STATE_H_
+#define __RENDER_STATE_H_
+
+#include "core_types.h"
+
+#define RENDER_STATE_TEXTURE_UNITS_MAX (8)
+
+// State changes requested this frame and how many of them matched the shadowed state
+class render_state_stats
+{
+public:
+	uint32 m_program_changes;
+	uint32 m_program_changes_elided;
+	uint32 m_uniform_changes;
+	uint32 m_uniform_changes_elided;
+	uint32 m_texture_changes;
+	uint32 m_texture_changes_elided;
+};
+
+// Forget the shadowed state, needed after anything binds programs or textures behind our back
+void render_state_invalidate();
+
+void render_state_use_program(uint32 p_program);
+uint32 render_state_get_program();
+
+// Leaves p_unit as the active texture unit
+void render_state_bind_texture(uint32 p_unit, uint32 p_target, uint32 p_texture);
+
+void render_state_count_uniform(bool p_elided);
+
+render_state_stats const* render_state_get_stats();
+void render_state_reset_stats();
+
+#endif /* __RENDER_STATE_H_ */
\ No newline at end of file
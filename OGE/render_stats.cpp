@@ -0,0 +1,328 @@
+#include "render_stats.h"
+
+#include "render_state.h"
+#include "assert.h"
+#include "glew/glew.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+// Queries of one frame, each times a span of the pass it's tagged with
+class render_stats_query_frame
+{
+public:
+	GLuint m_queries[RENDER_STATS_QUERIES_MAX];
+	render_pass m_passes[RENDER_STATS_QUERIES_MAX];
+	uint32 m_count;
+	bool m_pending;
+};
+
+static render_stats_query_frame g_query_frames[RENDER_STATS_QUERY_FRAMES];
+static uint32 g_query_frame = 0;
+static bool g_query_open = false;
+
+static render_pass g_pass_stack[RENDER_STATS_PASS_DEPTH_MAX];
+static uint32 g_pass_depth = 0;
+
+static uint32 g_counters[RENDER_COUNTER_COUNT];
+
+// Rings of the last RENDER_STATS_FRAMES frames, GPU times are pushed as their queries come back
+static uint32 g_counter_history[RENDER_STATS_FRAMES][RENDER_COUNTER_COUNT];
+static uint32 g_counter_history_count = 0;
+static real g_gpu_history[RENDER_STATS_FRAMES][RENDER_PASS_COUNT];
+static uint32 g_gpu_history_count = 0;
+
+static render_stats g_render_stats;
+
+static char const* g_pass_names[RENDER_PASS_COUNT] = {
+	"base",
+	"shadow",
+	"lighting",
+	"final",
+};
+
+static char const* g_counter_names[RENDER_COUNTER_COUNT] = {
+	"draws",
+	"triangles",
+	"state changes",
+	"shaders",
+	"textures",
+	"framebuffers",
+	"lights",
+	"lights culled",
+	"state changes elided",
+	"visible",
+	"culled",
+	"shadow visible",
+	"shadow culled",
+};
+
+static void print(char const* p_text)
+{
+#ifdef _WIN32
+	OutputDebugStringA(p_text);
+#else
+	fputs(p_text, stdout);
+#endif
+}
+
+static void query_begin(render_pass p_pass)
+{
+	render_stats_query_frame *frame = &g_query_frames[g_query_frame];
+	if (g_render_stats.m_gpu_timing == false || frame->m_count == RENDER_STATS_QUERIES_MAX) {
+		return;
+	}
+
+	glBeginQuery(GL_TIME_ELAPSED_EXT, frame->m_queries[frame->m_count]);
+	frame->m_passes[frame->m_count] = p_pass;
+	frame->m_count++;
+	g_query_open = true;
+}
+
+static void query_end()
+{
+	if (g_query_open) {
+		glEndQuery(GL_TIME_ELAPSED_EXT);
+		g_query_open = false;
+	}
+}
+
+static void update_gpu_stats()
+{
+	uint32 count = (g_gpu_history_count < RENDER_STATS_FRAMES) ? g_gpu_history_count : RENDER_STATS_FRAMES;
+
+	real gpu_total = 0.0f;
+	for (uint32 p = 0; p < RENDER_PASS_COUNT; ++p) {
+		real total = 0.0f;
+		for (uint32 i = 0; i < count; ++i) {
+			total += g_gpu_history[i][p];
+		}
+
+		g_render_stats.m_pass_gpu_ms_avg[p] = total / count;
+		gpu_total += g_render_stats.m_pass_gpu_ms_avg[p];
+	}
+
+	g_render_stats.m_gpu_ms_avg = gpu_total;
+}
+
+static void update_counter_stats()
+{
+	uint32 count = (g_counter_history_count < RENDER_STATS_FRAMES) ? g_counter_history_count : RENDER_STATS_FRAMES;
+
+	for (uint32 c = 0; c < RENDER_COUNTER_COUNT; ++c) {
+		real total = 0.0f;
+		for (uint32 i = 0; i < count; ++i) {
+			total += (real)g_counter_history[i][c];
+		}
+
+		g_render_stats.m_counters_avg[c] = total / count;
+	}
+}
+
+// Never waits, a frame that isn't finished by the time its queries are needed again is dropped
+static void resolve_query_frame(render_stats_query_frame *p_frame)
+{
+	if (p_frame->m_pending == false) {
+		return;
+	}
+
+	p_frame->m_pending = false;
+
+	for (uint32 i = 0; i < p_frame->m_count; ++i) {
+		GLint available = 0;
+		glGetQueryObjectiv(p_frame->m_queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available == 0) {
+			g_render_stats.m_gpu_frames_dropped++;
+			return;
+		}
+	}
+
+	real *pass_ms = g_gpu_history[g_gpu_history_count % RENDER_STATS_FRAMES];
+	for (uint32 p = 0; p < RENDER_PASS_COUNT; ++p) {
+		pass_ms[p] = 0.0f;
+	}
+
+	for (uint32 i = 0; i < p_frame->m_count; ++i) {
+		GLuint64EXT elapsed = 0;
+		glGetQueryObjectui64vEXT(p_frame->m_queries[i], GL_QUERY_RESULT, &elapsed);
+		pass_ms[p_frame->m_passes[i]] += (real)((double)elapsed / 1000000.0);
+	}
+
+	g_render_stats.m_gpu_ms = 0.0f;
+	for (uint32 p = 0; p < RENDER_PASS_COUNT; ++p) {
+		g_render_stats.m_pass_gpu_ms[p] = pass_ms[p];
+		g_render_stats.m_gpu_ms += pass_ms[p];
+	}
+
+	g_gpu_history_count++;
+	update_gpu_stats();
+}
+
+void render_stats_init()
+{
+	memset(&g_render_stats, 0, sizeof(g_render_stats));
+	memset(g_counters, 0, sizeof(g_counters));
+	g_counter_history_count = 0;
+	g_gpu_history_count = 0;
+	g_query_frame = 0;
+	g_query_open = false;
+	g_pass_depth = 0;
+
+	// Software GL like llvmpipe has the extension too, anything without it still gets the counters
+	g_render_stats.m_gpu_timing = GLEW_EXT_timer_query && glGenQueries && glDeleteQueries && glBeginQuery && glEndQuery &&
+		glGetQueryObjectiv && glGetQueryObjectui64vEXT;
+
+	for (uint32 i = 0; i < RENDER_STATS_QUERY_FRAMES; ++i) {
+		g_query_frames[i].m_count = 0;
+		g_query_frames[i].m_pending = false;
+		if (g_render_stats.m_gpu_timing) {
+			glGenQueries(RENDER_STATS_QUERIES_MAX, g_query_frames[i].m_queries);
+		}
+	}
+}
+
+void render_stats_shutdown()
+{
+	if (g_render_stats.m_gpu_timing) {
+		for (uint32 i = 0; i < RENDER_STATS_QUERY_FRAMES; ++i) {
+			glDeleteQueries(RENDER_STATS_QUERIES_MAX, g_query_frames[i].m_queries);
+			g_query_frames[i].m_count = 0;
+			g_query_frames[i].m_pending = false;
+		}
+	}
+
+	g_render_stats.m_gpu_timing = false;
+}
+
+void render_stats_frame_begin()
+{
+	assert(g_pass_depth == 0);
+
+	memset(g_counters, 0, sizeof(g_counters));
+
+	// The queries about to be reused were issued RENDER_STATS_QUERY_FRAMES frames ago
+	render_stats_query_frame *frame = &g_query_frames[g_query_frame];
+	resolve_query_frame(frame);
+	frame->m_count = 0;
+}
+
+void render_stats_frame_end()
+{
+	assert(g_pass_depth == 0);
+	assert(g_query_open == false);
+
+	render_stats_query_frame *frame = &g_query_frames[g_query_frame];
+	frame->m_pending = (frame->m_count > 0);
+	g_query_frame = (g_query_frame + 1) % RENDER_STATS_QUERY_FRAMES;
+
+	// Queries don't finish until they reach the GPU and an offscreen swap might not flush, this doesn't wait
+	if (frame->m_pending) {
+		glFlush();
+	}
+
+	// Shaders and textures are counted where their binds are shadowed
+	render_state_stats const* state = render_state_get_stats();
+	g_counters[RENDER_COUNTER_SHADER_BINDS] = state->m_program_changes;
+	g_counters[RENDER_COUNTER_TEXTURE_BINDS] = state->m_texture_changes;
+	g_counters[RENDER_COUNTER_STATE_CHANGES] = state->m_program_changes + state->m_texture_changes + state->m_uniform_changes +
+		g_counters[RENDER_COUNTER_FRAMEBUFFER_BINDS];
+	g_counters[RENDER_COUNTER_STATE_CHANGES_ELIDED] = state->m_program_changes_elided + state->m_texture_changes_elided +
+		state->m_uniform_changes_elided;
+
+	uint32 *history = g_counter_history[g_counter_history_count % RENDER_STATS_FRAMES];
+	for (uint32 c = 0; c < RENDER_COUNTER_COUNT; ++c) {
+		g_render_stats.m_counters[c] = g_counters[c];
+		history[c] = g_counters[c];
+	}
+
+	g_counter_history_count++;
+	update_counter_stats();
+}
+
+void render_stats_pass_begin(render_pass p_pass)
+{
+	assert(p_pass < RENDER_PASS_COUNT);
+	assert(g_pass_depth < RENDER_STATS_PASS_DEPTH_MAX);
+
+	// Timer queries don't nest, the enclosing pass stops timing until this one ends
+	query_end();
+	g_pass_stack[g_pass_depth++] = p_pass;
+	query_begin(p_pass);
+}
+
+void render_stats_pass_end()
+{
+	assert(g_pass_depth > 0);
+
+	query_end();
+	g_pass_depth--;
+	if (g_pass_depth > 0) {
+		query_begin(g_pass_stack[g_pass_depth - 1]);
+	}
+}
+
+void render_stats_count(render_counter p_counter, uint32 p_count)
+{
+	assert(p_counter < RENDER_COUNTER_COUNT);
+
+	g_counters[p_counter] += p_count;
+}
+
+void render_stats_count_draw(uint32 p_triangles)
+{
+	g_counters[RENDER_COUNTER_DRAW_CALLS]++;
+	g_counters[RENDER_COUNTER_TRIANGLES] += p_triangles;
+}
+
+render_stats const* render_stats_get()
+{
+	return &g_render_stats;
+}
+
+void render_stats_print()
+{
+	render_stats const* stats = &g_render_stats;
+
+	char buffer[256];
+	sprintf(buffer, "render: %.1f draws  %.0f tris  %.1f state changes (%.1f elided)  %.1f shaders  %.1f textures  %.1f framebuffers  %.1f lights  %.1f lights culled avg\n",
+		stats->m_counters_avg[RENDER_COUNTER_DRAW_CALLS], stats->m_counters_avg[RENDER_COUNTER_TRIANGLES],
+		stats->m_counters_avg[RENDER_COUNTER_STATE_CHANGES], stats->m_counters_avg[RENDER_COUNTER_STATE_CHANGES_ELIDED],
+		stats->m_counters_avg[RENDER_COUNTER_SHADER_BINDS],
+		stats->m_counters_avg[RENDER_COUNTER_TEXTURE_BINDS], stats->m_counters_avg[RENDER_COUNTER_FRAMEBUFFER_BINDS],
+		stats->m_counters_avg[RENDER_COUNTER_LIGHTS], stats->m_counters_avg[RENDER_COUNTER_LIGHTS_CULLED]);
+	print(buffer);
+
+	sprintf(buffer, "render: %.1f visible  %.1f culled  %.1f shadow visible  %.1f shadow culled avg\n",
+		stats->m_counters_avg[RENDER_COUNTER_VISIBLE], stats->m_counters_avg[RENDER_COUNTER_CULLED],
+		stats->m_counters_avg[RENDER_COUNTER_SHADOW_VISIBLE], stats->m_counters_avg[RENDER_COUNTER_SHADOW_CULLED]);
+	print(buffer);
+
+	if (stats->m_gpu_timing == false) {
+		print("render gpu: no timer queries\n");
+		return;
+	}
+
+	sprintf(buffer, "render gpu: base %.2f ms  shadow %.2f ms  lighting %.2f ms  final %.2f ms  total %.2f ms avg  %lu dropped\n",
+		stats->m_pass_gpu_ms_avg[RENDER_PASS_BASE], stats->m_pass_gpu_ms_avg[RENDER_PASS_SHADOW],
+		stats->m_pass_gpu_ms_avg[RENDER_PASS_LIGHTING], stats->m_pass_gpu_ms_avg[RENDER_PASS_FINAL],
+		stats->m_gpu_ms_avg, stats->m_gpu_frames_dropped);
+	print(buffer);
+}
+
+char const* render_stats_get_pass_name(render_pass p_pass)
+{
+	assert(p_pass < RENDER_PASS_COUNT);
+
+	return g_pass_names[p_pass];
+}
+
+char const* render_stats_get_counter_name(render_counter p_counter)
+{
+	assert(p_counter < RENDER_COUNTER_COUNT);
+
+	return g_counter_names[p_counter];
+}
\ No newline at end of file
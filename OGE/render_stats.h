@@ -0,0 +1,85 @@
+#ifndef __RENDER_STATS_H_
+#define __RENDER_STATS_H_
+
+#include "core_types.h"
+
+// Frames the averages are taken over
+#define RENDER_STATS_FRAMES (120)
+
+// Frames of GPU timer queries in flight. A frame's results are read when its queries come round again and
+// are dropped if the GPU hasn't finished them, so the CPU never waits on a query.
+#define RENDER_STATS_QUERY_FRAMES (2)
+
+// Timed spans a frame can have, a pass starting or ending inside another splits it
+#define RENDER_STATS_QUERIES_MAX (256)
+
+#define RENDER_STATS_PASS_DEPTH_MAX (4)
+
+// Passes nest, a pass's time leaves out the passes run inside it
+typedef unsigned char render_pass;
+const render_pass RENDER_PASS_BASE = 0;
+const render_pass RENDER_PASS_SHADOW = 1;
+const render_pass RENDER_PASS_LIGHTING = 2;
+const render_pass RENDER_PASS_FINAL = 3;
+#define RENDER_PASS_COUNT (4)
+
+// State changes are every shader, texture, uniform and framebuffer change that reached GL
+typedef unsigned char render_counter;
+const render_counter RENDER_COUNTER_DRAW_CALLS = 0;
+const render_counter RENDER_COUNTER_TRIANGLES = 1;
+const render_counter RENDER_COUNTER_STATE_CHANGES = 2;
+const render_counter RENDER_COUNTER_SHADER_BINDS = 3;
+const render_counter RENDER_COUNTER_TEXTURE_BINDS = 4;
+const render_counter RENDER_COUNTER_FRAMEBUFFER_BINDS = 5;
+const render_counter RENDER_COUNTER_LIGHTS = 6;
+// Lights whose volume was off screen or behind the near plane
+const render_counter RENDER_COUNTER_LIGHTS_CULLED = 7;
+// Shader, texture and uniform changes skipped because GL already had them
+const render_counter RENDER_COUNTER_STATE_CHANGES_ELIDED = 8;
+// Renderables that passed and failed the camera frustum test, and summed over every shadow map
+const render_counter RENDER_COUNTER_VISIBLE = 9;
+const render_counter RENDER_COUNTER_CULLED = 10;
+const render_counter RENDER_COUNTER_SHADOW_VISIBLE = 11;
+const render_counter RENDER_COUNTER_SHADOW_CULLED = 12;
+#define RENDER_COUNTER_COUNT (13)
+
+class render_stats
+{
+public:
+	// Counters of the last frame and GPU times of the last frame whose queries came back
+	uint32 m_counters[RENDER_COUNTER_COUNT];
+	real m_pass_gpu_ms[RENDER_PASS_COUNT];
+	real m_gpu_ms;
+
+	// Over the last RENDER_STATS_FRAMES frames, GPU times only over the frames that came back
+	real m_counters_avg[RENDER_COUNTER_COUNT];
+	real m_pass_gpu_ms_avg[RENDER_PASS_COUNT];
+	real m_gpu_ms_avg;
+
+	// False without GL_EXT_timer_query, the GPU times then stay zero
+	bool m_gpu_timing;
+	// Frames whose queries were still pending when they came round again
+	uint32 m_gpu_frames_dropped;
+};
+
+// Needs a current GL context
+void render_stats_init();
+void render_stats_shutdown();
+
+// Main thread, around everything the renderer draws in a frame
+void render_stats_frame_begin();
+void render_stats_frame_end();
+
+void render_stats_pass_begin(render_pass p_pass);
+void render_stats_pass_end();
+
+void render_stats_count(render_counter p_counter, uint32 p_count);
+void render_stats_count_draw(uint32 p_triangles);
+
+render_stats const* render_stats_get();
+void render_stats_print();
+
+char const* render_stats_get_pass_name(render_pass p_pass);
+char const* render_stats_get_counter_name(render_counter p_counter);
+
+#endif /* __RENDER_STATS_H_ */
\ No newline at end of file
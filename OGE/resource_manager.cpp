@@ -8,6 +8,14 @@
 #include <string.h>
 
 #include "importer-collada.h"
+#include "importer-obj.h"
+#include "mesh_cache.h"
+#include "asset_stream.h"
+#include "memory_lib.h"
+#include "profiler.h"
+
+#include "SDL.h"
+#include "SDL_thread.h"
 
 #ifdef MAC_OS_X
 static const char *g_data_path = "OGE-osx.app/Contents/Resources/Data";
@@ -15,142 +23,160 @@ static const char *g_data_path = "OGE-osx.app/Contents/Resources/Data";
 static const char *g_data_path = "Data";
 #endif
 
-mesh const* resource_manager_get_mesh(char *p_mesh_name)
+#define RESOURCE_MANAGER_PATH_LENGTH (256)
+
+// Lives from the async request until the mesh is handed over
+class mesh_stream_request
 {
-	char buffer[256];
-	sprintf(buffer, "%s/%s", g_data_path, p_mesh_name);
-	
-	FILE *fp;
-	fp = fopen(buffer, "r");
-	if (fp == NULL) {
+public:
+	mesh *m_mesh;
+	mesh *m_loaded;
+	char m_path[RESOURCE_MANAGER_PATH_LENGTH];
+	bool m_collada;
+	uint32 m_block;
+};
+
+// One mesh loads at a time. FCollada keeps global state, and loaders fill shared materials in after creating them.
+static SDL_mutex *g_mesh_load_lock = NULL;
+
+static mesh *load_mesh(char const* p_path, bool p_collada)
+{
+	mesh *mesh_ptr = mesh_cache_load(p_path);
+	if (mesh_ptr != NULL) {
+		return mesh_ptr;
+	}
+
+	mesh_ptr = p_collada ? importer_collada_load(p_path) : importer_obj_load(p_path);
+	if (mesh_ptr == NULL) {
 		return NULL;
 	}
+
+	// Next launch maps this instead of parsing
+	mesh_cache_save(p_path, mesh_ptr);
 	
-	uint32 face_count = 0;
-	uint32 vert_count = 0;
-
-	while(!feof(fp)) {
-		memset(buffer, 0, 256);
-		fgets(buffer, 256, fp);
-
-		if (!strncmp("v ", buffer, 2)) {
-			vert_count++;
-		} else if (!strncmp("f ", buffer, 2)) {
-			face_count++;
-		} else {
-			continue;
+	return mesh_ptr;
+}
+
+static void mesh_stream_load(void *p_data)
+{
+	mesh_stream_request *request = (mesh_stream_request *)p_data;
+
+	SDL_mutexP(g_mesh_load_lock);
+	request->m_loaded = load_mesh(request->m_path, request->m_collada);
+	SDL_mutexV(g_mesh_load_lock);
+}
+
+static bool mesh_stream_upload(void *p_data, uint32 *p_budget)
+{
+	PROFILE_SCOPE("mesh_stream_upload");
+
+	mesh_stream_request *request = (mesh_stream_request *)p_data;
+	mesh *loaded = request->m_loaded;
+
+	if (loaded != NULL) {
+		// A block at a time, the mesh only shows up once every block has its buffers
+		while (request->m_block < loaded->m_render_block_count) {
+			render_block &rb = loaded->m_render_blocks[request->m_block++];
+			uint32 size = sizeof(render_vertex) * rb.m_vertex_count + sizeof(uint32) * rb.m_index_count;
+			rb.prepare(false);
+
+			*p_budget = (size < *p_budget) ? *p_budget - size : 0;
+			if (*p_budget == 0) {
+				break;
+			}
 		}
-	}
 
-	fclose(fp);
-
-	mesh *mesh_ptr = new mesh;
-	mesh_ptr->m_render_block_count = 1;
-	mesh_ptr->m_render_blocks = (render_block *)malloc(sizeof(render_block));
-	render_block *render_block_ptr = &mesh_ptr->m_render_blocks[0];
-
-	render_block_ptr->m_format = RENDER_LIB_MESH_FORMAT_VA_TRIANGLES;
-	render_block_ptr->m_prepared = false;
-
-	render_block_ptr->m_vertex_count = vert_count;
-	render_block_ptr->m_pos = (Vector3 *)malloc(sizeof(Vector3) * vert_count);
-	//m_mesh->m_uv = (uv_coord *)malloc(sizeof(uv_coord) * vert_count);
-	render_block_ptr->m_uv = NULL;
-	render_block_ptr->m_normal = (Vector3 *)malloc(sizeof(Vector3) * vert_count);
-	render_block_ptr->m_transform.set_identity();
-
-	render_block_ptr->m_uv = (uv_coord *)malloc(sizeof(uv_coord) * render_block_ptr->m_vertex_count);
-	memset(render_block_ptr->m_uv, 0, sizeof(uv_coord) * render_block_ptr->m_vertex_count);
-
-	material *render_mat = material_create("fake_material");
-	render_block_ptr->m_material = render_mat;
-
-	if (render_block_ptr->m_material->m_texture == NULL) {
-		render_mat->m_color_ambient[0] = 0.5f;
-		render_mat->m_color_ambient[1] = 0.5f;
-		render_mat->m_color_ambient[2] = 0.5f;
-		render_mat->m_color_ambient[3] = 0.5f;
-		
-		render_mat->m_color_diffuse[0] = 0.5f;
-		render_mat->m_color_diffuse[1] = 0.5f;
-		render_mat->m_color_diffuse[2] = 0.5f;
-		render_mat->m_color_diffuse[3] = 0.5f;
-
-		render_mat->m_color_spec[0] = 0.5f;
-		render_mat->m_color_spec[1] = 0.5f;
-		render_mat->m_color_spec[2] = 0.5f;
-		render_mat->m_color_spec[3] = 0.5f;
-
-		material_load(render_mat, "invalid.png");
-		render_mat->m_shader = render_lib_get_default_shader();
+		if (request->m_block < loaded->m_render_block_count) {
+			return false;
+		}
+
+		request->m_mesh->m_meta_data = loaded->m_meta_data;
+		request->m_mesh->m_render_blocks = loaded->m_render_blocks;
+		request->m_mesh->m_render_block_count = loaded->m_render_block_count;
+		MEMORY_DELETE(loaded);
+	} else {
+		// Instances waiting on it are dropped rather than left pending
+		request->m_mesh->m_load_failed = true;
 	}
 
-	// Lot's of triangles...
-	render_block_ptr->m_index_count = face_count * 3;
-	render_block_ptr->m_index_buffer = (unsigned long *)malloc(sizeof(unsigned long) * render_block_ptr->m_index_count);
+	MEMORY_DELETE(request);
+	return true;
+}
 
-	sprintf(buffer, "%s/%s", g_data_path, p_mesh_name);
-	fp = fopen(buffer, "r");
-	if (fp == NULL) {
-		return NULL;
-	}
+static void mesh_stream_cancel(void *p_data)
+{
+	mesh_stream_request *request = (mesh_stream_request *)p_data;
 
-	uint32 vert_index = 0;
-	uint32 face_index = 0;
-	Vector3 diff;
-	while(!feof(fp)) {
-		memset(buffer, 0, 256);
-		fgets(buffer, 256, fp);
-
-		if (!strncmp("v ", buffer, 2)) {
-			sscanf((buffer + 1),"%f%f%f",
-					&render_block_ptr->m_pos[vert_index].m_data[0],
-					&render_block_ptr->m_pos[vert_index].m_data[1],
-					&render_block_ptr->m_pos[vert_index].m_data[2]);
-
-			//render_block_ptr->m_pos[vert_index].data[0] *= .1f;
-			//render_block_ptr->m_pos[vert_index].data[1] *= .1f;
-			//render_block_ptr->m_pos[vert_index].data[2] *= .1f;
-
-			vert_index++;
-
-		} else if (!strncmp("f ", buffer, 2)) {
-			sscanf((buffer + 1),"%u%u%u",
-				&render_block_ptr->m_index_buffer[face_index],
-				&render_block_ptr->m_index_buffer[face_index + 1],
-				&render_block_ptr->m_index_buffer[face_index + 2]);
-			face_index += 3;
-			render_block_ptr->m_index_buffer[face_index - 3] -= 1,
-			render_block_ptr->m_index_buffer[face_index - 2] -= 1;
-			render_block_ptr->m_index_buffer[face_index - 1] -= 1;
-
-			Vector3 normal;
-			Vector3& a = render_block_ptr->m_pos[render_block_ptr->m_index_buffer[face_index - 3]];
-			Vector3& b = render_block_ptr->m_pos[render_block_ptr->m_index_buffer[face_index - 2]];
-			Vector3& c = render_block_ptr->m_pos[render_block_ptr->m_index_buffer[face_index - 1]];
-			Vector3 x, y;
-			x.set(b.m_data[0] - a.m_data[0], b.m_data[1] - a.m_data[1], b.m_data[2] - a.m_data[2]);
-			y.set(c.m_data[0] - a.m_data[0], c.m_data[1] - a.m_data[1], c.m_data[2] - a.m_data[2]);
-			normal = x.cross(y);
-
-			render_block_ptr->m_normal[face_index - 3] = normal;
-			render_block_ptr->m_normal[face_index - 2] = normal;
-			render_block_ptr->m_normal[face_index - 1] = normal;
-
-		} else {
-			continue;
-		}
+	// Meshes are never freed once loaded, a finished load is simply left behind
+	request->m_mesh->m_load_failed = true;
+	MEMORY_DELETE(request);
+}
+
+static mesh const* request_mesh(char *p_mesh_name, bool p_collada)
+{
+	mesh *mesh_ptr = MEMORY_NEW(mesh, MEMORY_TAG_GEOMETRY);
+	mesh_ptr->m_render_blocks = NULL;
+	mesh_ptr->m_render_block_count = 0;
+
+	mesh_stream_request *request = MEMORY_NEW(mesh_stream_request, MEMORY_TAG_GEOMETRY);
+	request->m_mesh = mesh_ptr;
+	request->m_loaded = NULL;
+	request->m_collada = p_collada;
+	request->m_block = 0;
+	sprintf(request->m_path, "%s/%s", g_data_path, p_mesh_name);
+
+	asset_stream_request(mesh_stream_load, mesh_stream_upload, mesh_stream_cancel, request);
+
+	return mesh_ptr;
+}
+
+void resource_manager_init()
+{
+	g_mesh_load_lock = SDL_CreateMutex();
+}
+
+void resource_manager_shutdown()
+{
+	if (g_mesh_load_lock) {
+		SDL_DestroyMutex(g_mesh_load_lock);
+		g_mesh_load_lock = NULL;
 	}
-	
-	fclose(fp);
-	
+}
+
+mesh const* resource_manager_get_mesh(char *p_mesh_name)
+{
+	char buffer[RESOURCE_MANAGER_PATH_LENGTH];
+	sprintf(buffer, "%s/%s", g_data_path, p_mesh_name);
+
+#if defined(IMPORTER_OBJ_BENCHMARK)
+	importer_obj_benchmark(buffer, 10);
+#endif
+
+	SDL_mutexP(g_mesh_load_lock);
+	mesh *mesh_ptr = load_mesh(buffer, false);
+	SDL_mutexV(g_mesh_load_lock);
+
 	return mesh_ptr;
 }
 
 mesh const*resource_manager_get_collada_mesh(char *p_mesh_name)
 {
-	char buffer[256];
+	char buffer[RESOURCE_MANAGER_PATH_LENGTH];
 	sprintf(buffer, "%s/%s", g_data_path, p_mesh_name);
 
-	return importer_collada_load(buffer);
+	SDL_mutexP(g_mesh_load_lock);
+	mesh *mesh_ptr = load_mesh(buffer, true);
+	SDL_mutexV(g_mesh_load_lock);
+
+	return mesh_ptr;
+}
+
+mesh const* resource_manager_get_mesh_async(char *p_mesh_name)
+{
+	return request_mesh(p_mesh_name, false);
+}
+
+mesh const* resource_manager_get_collada_mesh_async(char *p_mesh_name)
+{
+	return request_mesh(p_mesh_name, true);
 }
\ No newline at end of file
@@ -7,5 +7,12 @@ mesh const* resource_manager_get_mesh(char *p_mesh_name);
 
 mesh const* resource_manager_get_collada_mesh(char *p_mesh_name);
 
-#endif // __RESOURE_MANAGER_H_
+// Return straight away with a mesh that has no render blocks. Loading and parsing happen on a streaming
+// thread, the blocks fill in on the main thread once their buffers are uploaded.
+mesh const* resource_manager_get_mesh_async(char *p_mesh_name);
+mesh const* resource_manager_get_collada_mesh_async(char *p_mesh_name);
 
+void resource_manager_init();
+void resource_manager_shutdown();
+
+#endif // __RESOURE_MANAGER_H_
\ No newline at end of file
@@ -10,6 +10,9 @@
 #include "resource_manager.h"	
 #include "objects_guff.h"
 #include "light.h"
+#include "core_lib.h"
+#include "physics_lib.h"
+#include "profiler.h"
 
 #include <stdlib.h>
 
@@ -28,7 +31,14 @@ static mesh_instance *g_ship_mesh_instance2;
 static light *g_light;
 static light *g_light2;
 
-static light *g_light_array[512];
+static light *g_light_array[LIGHT_MAX_NUMBER];
+
+// Fill the light pool with small point lights to measure light culling
+//#define LIGHT_BENCHMARK
+
+#define LIGHT_BENCHMARK_COLUMNS (32)
+#define LIGHT_BENCHMARK_SPACING (500.0f)
+#define LIGHT_BENCHMARK_RADIUS (600.0f)
 
 static bool UPDATE = true;
 
@@ -118,6 +128,43 @@ static void create_tod_light()
 #endif
 }
 
+static void create_light_benchmark()
+{
+	char str[64];
+	uint32 rows = LIGHT_MAX_NUMBER / LIGHT_BENCHMARK_COLUMNS;
+
+	for (uint32 i = 0; i < LIGHT_MAX_NUMBER; ++i) {
+		sprintf(str, "benchmark_light%d", i);
+		light *light_ptr = light_create(str);
+		g_light_array[i] = light_ptr;
+
+		light_ptr->m_type = light::LIGHT_TYPE_POINT;
+		light_ptr->m_shadow_casting = false;
+
+		// Cycle through a few colours so overlapping lights are visible
+		light_ptr->m_ambient[0] = light_ptr->m_ambient[1] = light_ptr->m_ambient[2] = light_ptr->m_ambient[3] = 0.0f;
+		light_ptr->m_diffuse[0] = (i % 3 == 0) ? 1.0f : 0.2f;
+		light_ptr->m_diffuse[1] = (i % 3 == 1) ? 1.0f : 0.2f;
+		light_ptr->m_diffuse[2] = (i % 3 == 2) ? 1.0f : 0.2f;
+		light_ptr->m_diffuse[3] = 1.0f;
+		light_ptr->m_specular[0] = light_ptr->m_specular[1] = light_ptr->m_specular[2] = light_ptr->m_specular[3] = 0.2f;
+
+		// Falls to the default cutoff at LIGHT_BENCHMARK_RADIUS
+		light_ptr->m_constant_attenuation = 1.0f;
+		light_ptr->m_linear_attenuation = 0.0f;
+		light_ptr->m_quadratic_attenuation = ((1.0f / LIGHT_ATTENUATION_CUTOFF_DEFAULT) - 1.0f) / (LIGHT_BENCHMARK_RADIUS * LIGHT_BENCHMARK_RADIUS);
+
+		uint32 column = i % LIGHT_BENCHMARK_COLUMNS;
+		uint32 row = i / LIGHT_BENCHMARK_COLUMNS;
+		Vector3 pos((column - (LIGHT_BENCHMARK_COLUMNS / 2.0f)) * LIGHT_BENCHMARK_SPACING,
+					800.0f,
+					(row - (rows / 2.0f)) * LIGHT_BENCHMARK_SPACING + BASE_OFFSET);
+		light_ptr->m_transform.set_values(&pos, NULL, NULL);
+	}
+
+	render_lib_set_lighting_mode(RENDER_LIB_LIGHTING_MODE_TILED);
+}
+
 void sg_main_scene::init()
 {
 	scene_base::init();
@@ -140,11 +187,11 @@ void sg_main_scene::init()
 	matrix44 transform_matrix;
 	q1.CreateMatrix(transform_matrix.m_data);
 
+	// The importer sized the cull bounds for the unrotated positions
 	for (uint32 i = 0; i < g_ship_mesh->m_render_block_count; i++) {
-		for (uint32 j = 0; j < g_ship_mesh->m_render_blocks[i].m_vertex_count; j++) {
-			Vector3 out = transform_matrix * g_ship_mesh->m_render_blocks[i].m_pos[j];
-			g_ship_mesh->m_render_blocks[i].m_pos[j].set(out.m_data[0], out.m_data[1], out.m_data[2]);
-		}
+		render_block &rb = g_ship_mesh->m_render_blocks[i];
+		matrix44_transform_points(&transform_matrix, rb.m_pos, rb.m_pos, rb.m_vertex_count);
+		rb.compute_bounds();
 	}
 #endif
 
@@ -169,7 +216,11 @@ void sg_main_scene::init()
 		//g_ship_mesh_instance->set_values(NULL, &quat, &scale);
 	}	
 	
+#if defined(LIGHT_BENCHMARK)
+	create_light_benchmark();
+#else
 	create_tod_light();
+#endif
 }
 
 void sg_main_scene::process(real p_frametime)
@@ -189,12 +240,12 @@ void sg_main_scene::process(real p_frametime)
 				//g_light->m_transform.set_values(&pos, NULL, NULL);
 
 
-					g_light->m_spot_direction = g_ship_mesh_instance->m_transform.m_transform_matrix.get_fvec(); //g_ship_mesh_instance->m_transform.get_position() - pos - ;
+					g_light->m_spot_direction = g_ship_mesh_instance->m_transform.get_world_matrix().get_fvec(); //g_ship_mesh_instance->m_transform.get_position() - pos - ;
 			}
 		}
 
 		//g_light2->m_transform.set_values(&g_camera_pos, &g_camera_orient, NULL);
-		//g_light2->m_spot_direction = g_light2->m_transform.m_transform_matrix.get_fvec();
+		//g_light2->m_spot_direction = g_light2->m_transform.get_world_matrix().get_fvec();
 
 		if (UPDATE) {
 			//g_ship_mesh_instance2->m_transform.set_values(&g_camera_pos, &g_camera_orient, NULL);
@@ -207,14 +258,29 @@ void sg_main_scene::process(real p_frametime)
 	}
 }
 
+static void quit()
+{
+	// The physics thread uses the job system, so it has to stop first
+	physics_lib_shutdown();
+	core_lib_shutdown();
+	exit(0);
+}
+
 void sg_main_scene::process_input(real p_frametime)
 {
 	static float cur_vel = 0.0f;
 
 	// Test for input and act on it
 	if (m_input_state.key_is_pressed(KEY_ESCAPE)) {
-		exit(0);
+		quit();
+	}
+
+	// Chrome trace of the next few frames, next to the executable
+	static bool capture_key_down = false;
+	if (m_input_state.key_is_pressed(KEY_P) && capture_key_down == false) {
+		profiler_capture("profile.json", PROFILER_CAPTURE_FRAMES_DEFAULT);
 	}
+	capture_key_down = m_input_state.key_is_pressed(KEY_P);
 
 	extern shader *g_shader_lighting;
 
@@ -284,7 +350,7 @@ void sg_main_scene::process_input(real p_frametime)
 	}
 	
 	if (m_input_state.joystick_button_pressed(0, 7)) {
-		exit(0);
+		quit();
 	}
 	
 
@@ -1,13 +1,19 @@
 #include "shader.h"
 
-#include "allocator_array.h"
+#include "allocator_pool.h"
 #include "ref_counted.h"
 #include "assert.h"
+#include "render_state.h"
+#include "job_system.h"
 
 #include "glew/glew.h"
 
+#include "SDL.h"
+#include "SDL_thread.h"
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #ifdef MAC_OS_X
 #define SHADER_PATH "OGE-osx.app/Contents/Resources/"
@@ -19,8 +25,53 @@
 #define SHADER_EXTENSION_FRAGMENT ".shf"
 
 #define SHADER_MAX_NUMBER (32)
+#define SHADER_SOURCE_MAX_LENGTH (8192)
+#define SHADER_DEFINES_MAX_LENGTH (256)
+
+static ref_counted<shader, SHADER_MAX_NUMBER, allocator_pool<ref_count_store<shader, SHADER_MAX_NUMBER>>> g_allocator_shader;
+
+// Streaming materials look up the default shader from their own threads
+static SDL_mutex *g_shader_lock = NULL;
 
-static ref_counted<shader, SHADER_MAX_NUMBER, allocator_array<ref_count_store<shader, SHADER_MAX_NUMBER>>> g_allocator_shader;
+// Prepended to the source of every shader
+static char g_shader_defines[SHADER_DEFINES_MAX_LENGTH] = "";
+
+#define SHADER_UNIFORM_NONE (0xFF)
+
+// Must match the order of shader_uniform_builtin
+static char const* g_shader_uniform_builtin_names[SHADER_UNIFORM_BUILTIN_COUNT] =
+{
+	"base_texture",
+	"color_texture",
+	"normal_texture",
+	"depth_texture",
+	"posxy_texture",
+	"light_position",
+	"light_ambient",
+	"light_diffuse",
+	"light_specular",
+	"light_attenuation",
+	"light_specular_power",
+	"spot_direction",
+	"spot_exponent",
+	"spot_cos_cutoff",
+	"camera_position",
+	"camera_direction",
+	"proj_matrix_inverse",
+	"screen_size",
+	"instance_data",
+	"instance_offset",
+	"light_data_texture",
+	"tile_texture",
+	"light_index_texture",
+	"tile_count",
+	"tile_size",
+	"light_data_height",
+	"light_index_size"
+};
+
+static char g_shader_uniform_names[SHADER_UNIFORM_NAMES_MAX][SHADER_UNIFORM_NAME_LENGTH];
+static uint32 g_shader_uniform_name_count = 0;
 
 
 static void printShaderInfoLog(GLuint p_shader)
@@ -55,6 +106,8 @@ shader::shader()
 	m_fragment_id = 0;
 	m_vertex_id = 0;
 	m_loaded = false;
+	m_uniform_count = 0;
+	memset(m_uniform_lookup, SHADER_UNIFORM_NONE, sizeof(m_uniform_lookup));
 }
 
 shader::~shader()
@@ -81,11 +134,11 @@ void shader::load(char const* p_filename)
 {
 	GLuint vert_shader_id = glCreateShaderObjectARB(GL_VERTEX_SHADER);
 	GLuint frag_shader_id = glCreateShader(GL_FRAGMENT_SHADER);
-	char vert_buffer[4096];
-	char frag_buffer[4096];
+	char vert_buffer[SHADER_SOURCE_MAX_LENGTH];
+	char frag_buffer[SHADER_SOURCE_MAX_LENGTH];
 	char buffer[256];
 	size_t unit_size = 1;
-	size_t unit_count = 4096;
+	size_t unit_count = SHADER_SOURCE_MAX_LENGTH;
 
 	// Read in vertex shader
 	sprintf(buffer, "%s/%s%s", SHADER_PATH, p_filename, SHADER_EXTENSION_VERTEX);
@@ -96,14 +149,19 @@ void shader::load(char const* p_filename)
 	// Read in fragment shader
 	sprintf(buffer, "%s/%s%s", SHADER_PATH, p_filename, SHADER_EXTENSION_FRAGMENT);
 	fopen_s(&fp, buffer, "r");
-	int lenf = fread(frag_buffer, 1, 4096, fp);
+	int lenf = fread(frag_buffer, 1, SHADER_SOURCE_MAX_LENGTH, fp);
 	fclose(fp);
 
-	// Set source
-	char *vb = vert_buffer;
-	char *vf = frag_buffer;
-	glShaderSource(vert_shader_id, 1, const_cast<const GLchar**>(&vb), (GLint const *)&lenv);
-	glShaderSource(frag_shader_id, 1, const_cast<const GLchar**>(&vf), (GLint const *)&lenf);
+	assert(lenv < SHADER_SOURCE_MAX_LENGTH && lenf < SHADER_SOURCE_MAX_LENGTH);
+
+	// Set source, defines first
+	GLint lend = (GLint)strlen(g_shader_defines);
+	char const* vb[2] = { g_shader_defines, vert_buffer };
+	char const* vf[2] = { g_shader_defines, frag_buffer };
+	GLint vl[2] = { lend, lenv };
+	GLint fl[2] = { lend, lenf };
+	glShaderSource(vert_shader_id, 2, const_cast<const GLchar**>(vb), vl);
+	glShaderSource(frag_shader_id, 2, const_cast<const GLchar**>(vf), fl);
 
 	glCompileShader(vert_shader_id);
 	glCompileShader(frag_shader_id);
@@ -116,8 +174,8 @@ void shader::load(char const* p_filename)
 	printShaderInfoLog(frag_shader_id);
 
 	if (!v_compiled || !f_compiled) {
-		glDeleteShader(m_fragment_id);
-		glDeleteShader(m_vertex_id);
+		glDeleteShader(frag_shader_id);
+		glDeleteShader(vert_shader_id);
 		return;
 	}
 
@@ -129,8 +187,8 @@ void shader::load(char const* p_filename)
 	glGetProgramiv(shader_prog, GL_LINK_STATUS, &s_linked);
 
 	if (!s_linked) {
-		glDeleteShader(m_fragment_id);
-		glDeleteShader(m_vertex_id);
+		glDeleteShader(frag_shader_id);
+		glDeleteShader(vert_shader_id);
 		glDeleteProgram(shader_prog);
 		return;
 	}
@@ -147,11 +205,150 @@ void shader::load(char const* p_filename)
 	m_shader_id = shader_prog;
 	m_vertex_id = vert_shader_id;
 	m_fragment_id = frag_shader_id;
+
+	reflect_uniforms();
+}
+
+bool shader::is_valid() const
+{
+	return m_shader_id != 0;
+}
+
+void shader::reflect_uniforms()
+{
+	GLint count = 0;
+	glGetProgramiv(m_shader_id, GL_ACTIVE_UNIFORMS, &count);
+
+	for (GLint i = 0; i < count; ++i) {
+		char name[SHADER_UNIFORM_NAME_LENGTH];
+		GLsizei length = 0;
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveUniform(m_shader_id, i, SHADER_UNIFORM_NAME_LENGTH, &length, &size, &type, name);
+
+		// Built in state isn't ours to set
+		if (strncmp(name, "gl_", 3) == 0) {
+			continue;
+		}
+
+		// Arrays are reported as their first element
+		char *bracket = strchr(name, '[');
+		if (bracket != NULL) {
+			*bracket = '\0';
+		}
+
+		assert(m_uniform_count < SHADER_UNIFORMS_MAX);
+		if (m_uniform_count == SHADER_UNIFORMS_MAX) {
+			break;
+		}
+
+		shader_uniform_id id = shader_uniform_id_get(name);
+		if (id == SHADER_UNIFORM_ID_INVALID) {
+			continue;
+		}
+
+		shader_uniform &uniform = m_uniforms[m_uniform_count];
+		uniform.m_id = id;
+		uniform.m_location = glGetUniformLocation(m_shader_id, name);
+		uniform.m_type = type;
+		uniform.m_size = size;
+		uniform.m_set = false;
+
+		m_uniform_lookup[id] = (uint8)m_uniform_count;
+		m_uniform_count++;
+	}
 }
 
 void shader::activate()
 {
-	glUseProgram(m_shader_id);
+	render_state_use_program(m_shader_id);
+}
+
+bool shader::has_uniform(shader_uniform_id p_id) const
+{
+	return (p_id < SHADER_UNIFORM_NAMES_MAX) && (m_uniform_lookup[p_id] != SHADER_UNIFORM_NONE);
+}
+
+shader_uniform * shader::update_uniform(shader_uniform_id p_id, void const* p_value, uint32 p_size)
+{
+	assert(render_state_get_program() == m_shader_id);
+
+	if (has_uniform(p_id) == false) {
+		return NULL;
+	}
+
+	shader_uniform &uniform = m_uniforms[m_uniform_lookup[p_id]];
+	if (uniform.m_set && memcmp(uniform.m_value, p_value, p_size) == 0) {
+		render_state_count_uniform(true);
+		return NULL;
+	}
+
+	memcpy(uniform.m_value, p_value, p_size);
+	uniform.m_set = true;
+	render_state_count_uniform(false);
+
+	return &uniform;
+}
+
+void shader::set_uniform_1i(shader_uniform_id p_id, int32 p_value)
+{
+	shader_uniform *uniform = update_uniform(p_id, &p_value, sizeof(p_value));
+	if (uniform) {
+		glUniform1iARB(uniform->m_location, p_value);
+	}
+}
+
+void shader::set_uniform_1f(shader_uniform_id p_id, real p_x)
+{
+	shader_uniform *uniform = update_uniform(p_id, &p_x, sizeof(p_x));
+	if (uniform) {
+		glUniform1fARB(uniform->m_location, p_x);
+	}
+}
+
+void shader::set_uniform_2f(shader_uniform_id p_id, real p_x, real p_y)
+{
+	real value[2] = { p_x, p_y };
+	shader_uniform *uniform = update_uniform(p_id, value, sizeof(value));
+	if (uniform) {
+		glUniform2fvARB(uniform->m_location, 1, value);
+	}
+}
+
+void shader::set_uniform_3f(shader_uniform_id p_id, real p_x, real p_y, real p_z)
+{
+	real value[3] = { p_x, p_y, p_z };
+	set_uniform_3fv(p_id, value);
+}
+
+void shader::set_uniform_3fv(shader_uniform_id p_id, real const* p_value)
+{
+	shader_uniform *uniform = update_uniform(p_id, p_value, sizeof(real) * 3);
+	if (uniform) {
+		glUniform3fvARB(uniform->m_location, 1, p_value);
+	}
+}
+
+void shader::set_uniform_4f(shader_uniform_id p_id, real p_x, real p_y, real p_z, real p_w)
+{
+	real value[4] = { p_x, p_y, p_z, p_w };
+	set_uniform_4fv(p_id, value);
+}
+
+void shader::set_uniform_4fv(shader_uniform_id p_id, real const* p_value)
+{
+	shader_uniform *uniform = update_uniform(p_id, p_value, sizeof(real) * 4);
+	if (uniform) {
+		glUniform4fvARB(uniform->m_location, 1, p_value);
+	}
+}
+
+void shader::set_uniform_matrix4fv(shader_uniform_id p_id, real const* p_value)
+{
+	shader_uniform *uniform = update_uniform(p_id, p_value, sizeof(real) * 16);
+	if (uniform) {
+		glUniformMatrix4fvARB(uniform->m_location, 1, GL_FALSE, p_value);
+	}
 }
 
 uint32 shader::get_location(char const* p_location_name)
@@ -162,31 +359,73 @@ uint32 shader::get_location(char const* p_location_name)
 void shader_system_init()
 {
 	g_allocator_shader.init(SHADER_MAX_NUMBER);
+	g_shader_lock = SDL_CreateMutex();
+
+	g_shader_uniform_name_count = 0;
+	for (uint32 i = 0; i < SHADER_UNIFORM_BUILTIN_COUNT; ++i) {
+		shader_uniform_id id = shader_uniform_id_get(g_shader_uniform_builtin_names[i]);
+		assert(id == i);
+	}
 }
 
 void shader_system_shutdown()
 {
 	g_allocator_shader.shutdown();
+
+	if (g_shader_lock) {
+		SDL_DestroyMutex(g_shader_lock);
+		g_shader_lock = NULL;
+	}
 }
 
 shader *shader_create(char *p_shader_name)
 {
+	SDL_mutexP(g_shader_lock);
 	shader *shader_ptr = g_allocator_shader.create(p_shader_name);
 
 	if (shader_ptr && (shader_ptr->m_loaded == false)) {
+		// Compiling needs the GL context, other threads can only share shaders that already exist
+		assert(job_system_is_main_thread());
 		shader_ptr->load(p_shader_name);
 		shader_ptr->m_loaded = true;
 	}
+	SDL_mutexV(g_shader_lock);
 
 	return shader_ptr;
 }
 
 void shader_release(shader *p_shader)
 {
+	SDL_mutexP(g_shader_lock);
 	g_allocator_shader.release(p_shader);
+	SDL_mutexV(g_shader_lock);
+}
+
+void shader_system_set_defines(char const* p_defines)
+{
+	assert(strlen(p_defines) < SHADER_DEFINES_MAX_LENGTH);
+	strcpy(g_shader_defines, p_defines);
+}
+
+shader_uniform_id shader_uniform_id_get(char const* p_name)
+{
+	// Only hit while loading shaders, a linear search is fine
+	for (uint32 i = 0; i < g_shader_uniform_name_count; ++i) {
+		if (strcmp(g_shader_uniform_names[i], p_name) == 0) {
+			return (shader_uniform_id)i;
+		}
+	}
+
+	assert(g_shader_uniform_name_count < SHADER_UNIFORM_NAMES_MAX);
+	if (g_shader_uniform_name_count == SHADER_UNIFORM_NAMES_MAX || strlen(p_name) >= SHADER_UNIFORM_NAME_LENGTH) {
+		return SHADER_UNIFORM_ID_INVALID;
+	}
+
+	strcpy(g_shader_uniform_names[g_shader_uniform_name_count], p_name);
+	return (shader_uniform_id)g_shader_uniform_name_count++;
 }
 
 void shader_enable_fixed_function_pipeline()
 {
-	glUseProgram(0);
+	render_state_use_program(0);
 }
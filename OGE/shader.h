@@ -5,6 +5,59 @@
 
 #define MAX_SHADER_NAME_LENGTH (64)
 
+#define SHADER_UNIFORM_NAME_LENGTH (64)
+#define SHADER_UNIFORM_NAMES_MAX (256)
+#define SHADER_UNIFORMS_MAX (32)
+
+// Interned uniform name, the same name maps to the same id in every shader
+typedef uint16 shader_uniform_id;
+#define SHADER_UNIFORM_ID_INVALID ((shader_uniform_id)0xFFFF)
+
+// Uniforms the renderer sets, interned first so their ids are constant
+typedef enum shader_uniform_builtin
+{
+	SHADER_UNIFORM_BASE_TEXTURE,
+	SHADER_UNIFORM_COLOR_TEXTURE,
+	SHADER_UNIFORM_NORMAL_TEXTURE,
+	SHADER_UNIFORM_DEPTH_TEXTURE,
+	SHADER_UNIFORM_POSXY_TEXTURE,
+	SHADER_UNIFORM_LIGHT_POSITION,
+	SHADER_UNIFORM_LIGHT_AMBIENT,
+	SHADER_UNIFORM_LIGHT_DIFFUSE,
+	SHADER_UNIFORM_LIGHT_SPECULAR,
+	SHADER_UNIFORM_LIGHT_ATTENUATION,
+	SHADER_UNIFORM_LIGHT_SPECULAR_POWER,
+	SHADER_UNIFORM_SPOT_DIRECTION,
+	SHADER_UNIFORM_SPOT_EXPONENT,
+	SHADER_UNIFORM_SPOT_COS_CUTOFF,
+	SHADER_UNIFORM_CAMERA_POSITION,
+	SHADER_UNIFORM_CAMERA_DIRECTION,
+	SHADER_UNIFORM_PROJ_MATRIX_INVERSE,
+	SHADER_UNIFORM_SCREEN_SIZE,
+	SHADER_UNIFORM_INSTANCE_DATA,
+	SHADER_UNIFORM_INSTANCE_OFFSET,
+	SHADER_UNIFORM_LIGHT_DATA_TEXTURE,
+	SHADER_UNIFORM_TILE_TEXTURE,
+	SHADER_UNIFORM_LIGHT_INDEX_TEXTURE,
+	SHADER_UNIFORM_TILE_COUNT,
+	SHADER_UNIFORM_TILE_SIZE,
+	SHADER_UNIFORM_LIGHT_DATA_HEIGHT,
+	SHADER_UNIFORM_LIGHT_INDEX_SIZE,
+	SHADER_UNIFORM_BUILTIN_COUNT
+};
+
+// Active uniform found when the program linked, with the last value sent to it
+class shader_uniform
+{
+public:
+	shader_uniform_id m_id;
+	int32 m_location;
+	uint32 m_type;
+	uint32 m_size;
+	bool m_set;
+	uint32 m_value[16];
+};
+
 class shader
 {
 public:
@@ -15,19 +68,50 @@ public:
 
 	void load(char const* p_filename);
 
+	// False when the program failed to compile or link, activating it falls back to fixed function
+	bool is_valid() const;
+
+	// Raw lookup, values set through the location bypass the shadow copy
 	uint32 get_location(char const* p_location_name);
 
+	// The shader must be active. Values matching the last one sent are skipped,
+	// uniforms the program doesn't use are ignored.
+	bool has_uniform(shader_uniform_id p_id) const;
+	void set_uniform_1i(shader_uniform_id p_id, int32 p_value);
+	void set_uniform_1f(shader_uniform_id p_id, real p_x);
+	void set_uniform_2f(shader_uniform_id p_id, real p_x, real p_y);
+	void set_uniform_3f(shader_uniform_id p_id, real p_x, real p_y, real p_z);
+	void set_uniform_3fv(shader_uniform_id p_id, real const* p_value);
+	void set_uniform_4f(shader_uniform_id p_id, real p_x, real p_y, real p_z, real p_w);
+	void set_uniform_4fv(shader_uniform_id p_id, real const* p_value);
+	void set_uniform_matrix4fv(shader_uniform_id p_id, real const* p_value);
+
 	bool m_loaded;
 
 private:
+	void reflect_uniforms();
+	shader_uniform * update_uniform(shader_uniform_id p_id, void const* p_value, uint32 p_size);
+
 	uint32 m_shader_id;
 	uint32 m_fragment_id;
 	uint32 m_vertex_id;
+
+	shader_uniform m_uniforms[SHADER_UNIFORMS_MAX];
+	uint32 m_uniform_count;
+
+	// Index into m_uniforms by uniform id
+	uint8 m_uniform_lookup[SHADER_UNIFORM_NAMES_MAX];
 };
 
 void shader_system_init();
 void shader_system_shutdown();
 
+// Preprocessor lines compiled into every shader created afterwards
+void shader_system_set_defines(char const* p_defines);
+
+// Id for a uniform name, interned on first use
+shader_uniform_id shader_uniform_id_get(char const* p_name);
+
 shader *shader_create(char *p_name);
 void shader_release(shader *p_shader);
 
@@ -1,13 +1,22 @@
 #include "texture.h"
 
 #include "assert.h"
-#include "allocator_array.h"
+#include "allocator_pool.h"
 #include "ref_counted.h"
+#include "render_state.h"
+#include "memory_lib.h"
+#include "job_system.h"
+#include "asset_stream.h"
+#include "texture_cache.h"
+#include "texture_compress.h"
+#include "mapped_file.h"
+#include "profiler.h"
 
 #include "glew/glew.h"
 
 #include "SDL.h"
 #include "SDL_image.h"
+#include "SDL_thread.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -18,32 +27,286 @@
 #define TEXTURE_PATH "Data"
 #endif
 
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define TEXTURE_SSE2
+#include <emmintrin.h>
+#endif
+
 
 #define TEXTURE_MAX_NUMBER (256)
 
-static ref_counted<texture, TEXTURE_MAX_NUMBER, allocator_array<ref_count_store<texture, TEXTURE_MAX_NUMBER>>> g_allocator_texture;
+static ref_counted<texture, TEXTURE_MAX_NUMBER, allocator_pool<ref_count_store<texture, TEXTURE_MAX_NUMBER>>> g_allocator_texture;
 
 
-texture::texture()
+// Guards the registry and the load claims, textures are created from streaming threads too
+static SDL_mutex *g_texture_lock = NULL;
+static texture *g_texture_placeholder = NULL;
+
+// Compression is also read by the streaming threads when they cook
+static bool g_texture_compression_supported = false;
+static bool g_texture_compression = false;
+static bool g_texture_srgb_supported = false;
+static bool g_texture_srgb = false;
+
+// Lives from load_async until the last mip level is up
+class texture_stream_request
 {
-	m_texture_data = NULL;
-	m_texture_id = 0;
+public:
+	texture *m_texture;
+	char m_texture_name[MAX_TEXTURE_NAME_LENGTH];
+	texture_image m_image;
+	bool m_decoded;
+	uint32 m_texture_id;
+	uint32 m_level;
+	uint32 m_level_offset;
+};
+
+static bool is_format_compressed(texture_format p_format)
+{
+	return p_format == TEXTURE_FORMAT_DXT1 || p_format == TEXTURE_FORMAT_DXT5;
 }
 
-texture::~texture()
+static uint32 get_bytes_per_pixel(texture_format p_format)
+{
+	switch (p_format) {
+	case TEXTURE_FORMAT_L8:
+		return 1;
+	case TEXTURE_FORMAT_RGBA8:
+		return 4;
+	default:
+		return 3;
+	}
+}
+
+uint32 texture_image_get_level_size(texture_image const* p_image, uint32 p_level)
+{
+	uint32 width = p_image->m_width >> p_level;
+	uint32 height = p_image->m_height >> p_level;
+	width = (width > 0) ? width : 1;
+	height = (height > 0) ? height : 1;
+
+	switch (p_image->m_format) {
+	case TEXTURE_FORMAT_DXT1:
+		return texture_compress_get_size(width, height, TEXTURE_COMPRESS_DXT1_BLOCK_SIZE);
+	case TEXTURE_FORMAT_DXT5:
+		return texture_compress_get_size(width, height, TEXTURE_COMPRESS_DXT5_BLOCK_SIZE);
+	default:
+		return width * height * get_bytes_per_pixel(p_image->m_format);
+	}
+}
+
+// Each texel of the next level averages the 2x2 block above it, odd edges repeat their last texel.
+// Runs of whole texel pairs go through SSE2 for 1 and 4 byte texels, both paths round the same way.
+static void build_mip(uint8 const* p_src, uint32 p_src_width, uint32 p_src_height, uint8 *p_dst, uint32 p_bytes_per_pixel)
+{
+	uint32 width = (p_src_width > 1) ? p_src_width / 2 : 1;
+	uint32 height = (p_src_height > 1) ? p_src_height / 2 : 1;
+
+	for (uint32 y = 0; y < height; ++y) {
+		uint32 y0 = y * 2;
+		uint32 y1 = (y0 + 1 < p_src_height) ? y0 + 1 : y0;
+		uint8 const* row0 = &p_src[y0 * p_src_width * p_bytes_per_pixel];
+		uint8 const* row1 = &p_src[y1 * p_src_width * p_bytes_per_pixel];
+		uint8 *out_row = &p_dst[y * width * p_bytes_per_pixel];
+		uint32 x = 0;
+
+#if defined(TEXTURE_SSE2)
+		__m128i round = _mm_set1_epi16(2);
+		__m128i zero = _mm_setzero_si128();
+
+		if (p_bytes_per_pixel == 4 && p_src_width > 1) {
+			// Four source texels a row make two output texels
+			for (; x + 2 <= width; x += 2) {
+				__m128i a = _mm_loadu_si128((__m128i const*)&row0[x * 8]);
+				__m128i b = _mm_loadu_si128((__m128i const*)&row1[x * 8]);
+				__m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+				__m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+				__m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(lo, hi), _mm_unpackhi_epi64(lo, hi));
+				sum = _mm_srli_epi16(_mm_add_epi16(sum, round), 2);
+				_mm_storel_epi64((__m128i *)&out_row[x * 4], _mm_packus_epi16(sum, zero));
+			}
+		} else if (p_bytes_per_pixel == 1 && p_src_width > 1) {
+			// Sixteen source texels a row make eight, even and odd texels split into 16 bit lanes
+			__m128i even_mask = _mm_set1_epi16(0x00ff);
+			for (; x + 8 <= width; x += 8) {
+				__m128i a = _mm_loadu_si128((__m128i const*)&row0[x * 2]);
+				__m128i b = _mm_loadu_si128((__m128i const*)&row1[x * 2]);
+				__m128i sum = _mm_add_epi16(_mm_and_si128(a, even_mask), _mm_srli_epi16(a, 8));
+				sum = _mm_add_epi16(sum, _mm_add_epi16(_mm_and_si128(b, even_mask), _mm_srli_epi16(b, 8)));
+				sum = _mm_srli_epi16(_mm_add_epi16(sum, round), 2);
+				_mm_storel_epi64((__m128i *)&out_row[x], _mm_packus_epi16(sum, zero));
+			}
+		}
+#endif
+
+		for (; x < width; ++x) {
+			uint32 x0 = x * 2;
+			uint32 x1 = (x0 + 1 < p_src_width) ? x0 + 1 : x0;
+
+			uint8 const* a = &row0[x0 * p_bytes_per_pixel];
+			uint8 const* b = &row0[x1 * p_bytes_per_pixel];
+			uint8 const* c = &row1[x0 * p_bytes_per_pixel];
+			uint8 const* d = &row1[x1 * p_bytes_per_pixel];
+			uint8 *out = &out_row[x * p_bytes_per_pixel];
+
+			for (uint32 i = 0; i < p_bytes_per_pixel; ++i) {
+				out[i] = (uint8)((a[i] + b[i] + c[i] + d[i] + 2) >> 2);
+			}
+		}
+	}
+}
+
+// Byte a channel sits at within a texel
+static uint32 get_channel_byte(uint32 p_shift, uint32 p_bytes_per_pixel)
+{
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+	return p_bytes_per_pixel - 1 - p_shift / 8;
+#else
+	return p_shift / 8;
+#endif
+}
+
+// Palettised images expand to RGB, 32 bit images without alpha drop the padding byte
+static bool get_surface_format(SDL_PixelFormat const* p_format, texture_format *p_texture_format)
+{
+	switch (p_format->BytesPerPixel) {
+	case 1:
+		*p_texture_format = (p_format->palette != NULL) ? TEXTURE_FORMAT_RGB8 : TEXTURE_FORMAT_L8;
+		return true;
+	case 3:
+		*p_texture_format = TEXTURE_FORMAT_RGB8;
+		return true;
+	case 4:
+		*p_texture_format = (p_format->Amask != 0) ? TEXTURE_FORMAT_RGBA8 : TEXTURE_FORMAT_RGB8;
+		return true;
+	default:
+		return false;
+	}
+}
+
+// Repacks the surface as level 0 in tight L, RGB or RGBA rows whatever channel order the decoder produced
+static void copy_surface(SDL_Surface *p_surf, texture_image *p_image)
+{
+	SDL_PixelFormat const* fmt = p_surf->format;
+	uint32 src_bpp = fmt->BytesPerPixel;
+	uint32 dst_bpp = get_bytes_per_pixel(p_image->m_format);
+	uint32 r = get_channel_byte(fmt->Rshift, src_bpp);
+	uint32 g = get_channel_byte(fmt->Gshift, src_bpp);
+	uint32 b = get_channel_byte(fmt->Bshift, src_bpp);
+	uint32 a = get_channel_byte(fmt->Ashift, src_bpp);
+
+	SDL_LockSurface(p_surf);
+	for (int32 y = 0; y < p_surf->h; ++y) {
+		uint8 const* src = (uint8 const*)p_surf->pixels + y * p_surf->pitch;
+		uint8 *dst = p_image->m_data + y * p_surf->w * dst_bpp;
+
+		if (p_image->m_format == TEXTURE_FORMAT_L8) {
+			memcpy(dst, src, p_surf->w);
+		} else if (src_bpp == 1) {
+			for (int32 x = 0; x < p_surf->w; ++x, dst += 3) {
+				SDL_Color const& color = fmt->palette->colors[src[x]];
+				dst[0] = color.r;
+				dst[1] = color.g;
+				dst[2] = color.b;
+			}
+		} else {
+			for (int32 x = 0; x < p_surf->w; ++x, src += src_bpp, dst += dst_bpp) {
+				dst[0] = src[r];
+				dst[1] = src[g];
+				dst[2] = src[b];
+				if (dst_bpp == 4) {
+					dst[3] = src[a];
+				}
+			}
+		}
+	}
+	SDL_UnlockSurface(p_surf);
+}
+
+static void allocate_image(texture_image *p_image)
+{
+	// Full chain down to 1x1
+	p_image->m_level_count = 1;
+	while ((p_image->m_width >> (p_image->m_level_count - 1)) > 1 || (p_image->m_height >> (p_image->m_level_count - 1)) > 1) {
+		p_image->m_level_count++;
+	}
+
+	p_image->m_size = 0;
+	for (uint32 i = 0; i < p_image->m_level_count; ++i) {
+		p_image->m_size += texture_image_get_level_size(p_image, i);
+	}
+
+	p_image->m_data = (uint8 *)MEMORY_ALLOC(p_image->m_size, MEMORY_TAG_TEXTURE);
+	assert(p_image->m_data != NULL);
+}
+
+// Swaps an RGB or RGBA chain for its DXT1 or DXT5 version
+static void compress_image(texture_image *p_image)
 {
-	if (m_texture_data != NULL) {
-		free(m_texture_data);
-		m_texture_data = NULL;
+	texture_image compressed = *p_image;
+	compressed.m_format = (p_image->m_format == TEXTURE_FORMAT_RGBA8) ? TEXTURE_FORMAT_DXT5 : TEXTURE_FORMAT_DXT1;
+	allocate_image(&compressed);
+
+	uint32 bytes_per_pixel = get_bytes_per_pixel(p_image->m_format);
+	uint32 src_offset = 0;
+	uint32 dst_offset = 0;
+	for (uint32 i = 0; i < p_image->m_level_count; ++i) {
+		uint32 width = p_image->m_width >> i;
+		uint32 height = p_image->m_height >> i;
+		width = (width > 0) ? width : 1;
+		height = (height > 0) ? height : 1;
+
+		if (compressed.m_format == TEXTURE_FORMAT_DXT5) {
+			texture_compress_dxt5(p_image->m_data + src_offset, width, height, compressed.m_data + dst_offset);
+		} else {
+			texture_compress_dxt1(p_image->m_data + src_offset, width, height, bytes_per_pixel, compressed.m_data + dst_offset);
+		}
+
+		src_offset += texture_image_get_level_size(p_image, i);
+		dst_offset += texture_image_get_level_size(&compressed, i);
 	}
+
+	MEMORY_FREE(p_image->m_data);
+	*p_image = compressed;
 }
 
-void texture::bind(uint32 p_width, uint32 p_height)
+static uint32 get_gl_format(texture_format p_format)
+{
+	switch (p_format) {
+	case TEXTURE_FORMAT_L8:
+		return GL_LUMINANCE;
+	case TEXTURE_FORMAT_RGBA8:
+		return GL_RGBA;
+	default:
+		return GL_RGB;
+	}
+}
+
+// Luminance is taken to be data rather than colour and always stays linear
+static uint32 get_gl_internal_format(texture_format p_format)
+{
+	bool srgb = g_texture_srgb && g_texture_srgb_supported;
+
+	switch (p_format) {
+	case TEXTURE_FORMAT_L8:
+		return GL_LUMINANCE8;
+	case TEXTURE_FORMAT_RGBA8:
+		return srgb ? GL_SRGB8_ALPHA8_EXT : GL_RGBA8;
+	case TEXTURE_FORMAT_DXT1:
+		return srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	case TEXTURE_FORMAT_DXT5:
+		return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	default:
+		return srgb ? GL_SRGB8_EXT : GL_RGB8;
+	}
+}
+
+static uint32 create_texture_id()
 {
 	GLuint id;
 
 	glGenTextures(1, &id);
-	glBindTexture(GL_TEXTURE_2D, id);
+	render_state_bind_texture(0, GL_TEXTURE_2D, id);
 		
 	glTexEnvf( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE );
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
@@ -51,64 +314,310 @@ void texture::bind(uint32 p_width, uint32 p_height)
 	
 	glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT );
     glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT );
-		
-	//glTexImage2D(GL_TEXTURE_2D, 0, 3, p_w, p_h, 0, GL_BGR, GL_UNSIGNED_BYTE, p_pixel_data);
-	
-	// build our texture mipmaps
-	gluBuild2DMipmaps( GL_TEXTURE_2D, 3, p_width, p_height, GL_RGB, GL_UNSIGNED_BYTE, m_texture_data);
 
-	m_texture_id = id;
+	return id;
+}
+
+static void upload_level(uint32 p_texture_id, texture_image const* p_image, uint32 p_level, uint32 p_offset)
+{
+	uint32 width = p_image->m_width >> p_level;
+	uint32 height = p_image->m_height >> p_level;
+	width = (width > 0) ? width : 1;
+	height = (height > 0) ? height : 1;
+
+	render_state_bind_texture(0, GL_TEXTURE_2D, p_texture_id);
+
+	if (is_format_compressed(p_image->m_format)) {
+		glCompressedTexImage2D(GL_TEXTURE_2D, p_level, get_gl_internal_format(p_image->m_format), width, height, 0,
+			texture_image_get_level_size(p_image, p_level), p_image->m_data + p_offset);
+		return;
+	}
+
+	// Rows are tightly packed
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, p_level, get_gl_internal_format(p_image->m_format), width, height, 0,
+		get_gl_format(p_image->m_format), GL_UNSIGNED_BYTE, p_image->m_data + p_offset);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+bool texture_image_load(char const* p_texture_name, texture_image *p_image)
+{
+	PROFILE_SCOPE("texture_image_load");
+
+	memset(p_image, 0, sizeof(texture_image));
+
+	// Append data path
+	char filename[4096];
+	sprintf(filename, "%s/%s", TEXTURE_PATH, p_texture_name);
+
+	// Read once, the flag can be flipped from the main thread while this runs
+	bool compression = g_texture_compression;
+	if (texture_cache_load(filename, compression, p_image)) {
+		return true;
+	}
+
+	SDL_Surface *surf = IMG_Load(filename);
+	assert(surf != NULL);
+	if (surf == NULL) {
+		return false;
+	}
+
+	if (get_surface_format(surf->format, &p_image->m_format) == false) {
+		SDL_FreeSurface(surf);
+		return false;
+	}
+
+	p_image->m_width = surf->w;
+	p_image->m_height = surf->h;
+	allocate_image(p_image);
+
+	copy_surface(surf, p_image);
+	SDL_FreeSurface(surf);
+
+	uint32 bytes_per_pixel = get_bytes_per_pixel(p_image->m_format);
+	uint32 offset = 0;
+	for (uint32 i = 1; i < p_image->m_level_count; ++i) {
+		uint32 src_width = p_image->m_width >> (i - 1);
+		uint32 src_height = p_image->m_height >> (i - 1);
+		uint32 src_size = texture_image_get_level_size(p_image, i - 1);
+
+		build_mip(p_image->m_data + offset, (src_width > 0) ? src_width : 1, (src_height > 0) ? src_height : 1,
+			p_image->m_data + offset + src_size, bytes_per_pixel);
+		offset += src_size;
+	}
+
+	if (compression && p_image->m_format != TEXTURE_FORMAT_L8) {
+		compress_image(p_image);
+	}
+
+	// Not being able to write the cache only costs the next load
+	texture_cache_save(filename, p_image);
+
+	return true;
+}
+
+void texture_image_release(texture_image *p_image)
+{
+	if (p_image->m_mapped_data != NULL) {
+		mapped_file_close(p_image->m_mapped_data, p_image->m_mapped_size);
+	} else {
+		MEMORY_FREE(p_image->m_data);
+	}
+
+	p_image->m_data = NULL;
+	p_image->m_mapped_data = NULL;
+	p_image->m_mapped_size = 0;
+}
+
+texture::texture()
+{
+	m_texture_id = 0;
+	m_loading = false;
+}
+
+texture::~texture()
+{
+	if (m_texture_id != 0) {
+		unbind();
+	}
 }
 
 void texture::unbind()
 {
 	glDeleteTextures( 1, (GLuint *)&m_texture_id );
 	m_texture_id = 0;
+
+	// The id can be handed out again while still shadowed as bound
+	render_state_invalidate();
 }
 
 void texture::activate()
 {
-	glBindTexture(GL_TEXTURE_2D, m_texture_id);
+	if (m_texture_id == 0 && g_texture_placeholder != NULL) {
+		render_state_bind_texture(0, GL_TEXTURE_2D, g_texture_placeholder->m_texture_id);
+		return;
+	}
+
+	render_state_bind_texture(0, GL_TEXTURE_2D, m_texture_id);
+}
+
+bool texture::is_loaded() const
+{
+	return m_texture_id != 0;
+}
+
+bool texture::begin_load()
+{
+	SDL_mutexP(g_texture_lock);
+	bool claimed = (m_texture_id == 0 && m_loading == false);
+	m_loading = true;
+	SDL_mutexV(g_texture_lock);
+
+	return claimed;
+}
+
+void texture::end_load(uint32 p_texture_id)
+{
+	SDL_mutexP(g_texture_lock);
+	m_texture_id = p_texture_id;
+	m_loading = false;
+	SDL_mutexV(g_texture_lock);
 }
 
 void texture::load(char *p_texture_name)
 {
-	// Append data path
-	char filename[4096];
-	sprintf(filename, "%s/%s", TEXTURE_PATH, p_texture_name);
+	assert(job_system_is_main_thread());
 
-	// Load in a texture to opengl
-	SDL_Surface *surf = IMG_Load(filename);
-	assert(surf != NULL);
-	if (surf == NULL) {
+	// Shared through texture_create, only the first user loads it
+	if (begin_load() == false) {
 		return;
 	}
 
-	unsigned long pixel_size = surf->format->BytesPerPixel * surf->w * surf->h;
-	m_texture_data = (uint8 *)malloc(pixel_size);
-	memcpy(m_texture_data, surf->pixels, pixel_size);
+	uint32 id = 0;
+	texture_image image;
+	if (texture_image_load(p_texture_name, &image)) {
+		id = create_texture_id();
+		uint32 offset = 0;
+		for (uint32 i = 0; i < image.m_level_count; ++i) {
+			upload_level(id, &image, i, offset);
+			offset += texture_image_get_level_size(&image, i);
+		}
 
-	bind(surf->w, surf->h);
+		// GL has its own copy now
+		texture_image_release(&image);
+	}
 
-	SDL_FreeSurface(surf);
+	end_load(id);
+}
+
+void texture::load_async(char *p_texture_name)
+{
+	if (begin_load() == false) {
+		return;
+	}
+
+	texture_stream_request *request = MEMORY_NEW(texture_stream_request, MEMORY_TAG_TEXTURE);
+
+	// Keeps the texture alive until the upload is done with it
+	SDL_mutexP(g_texture_lock);
+	g_allocator_texture.add_ref(this);
+	SDL_mutexV(g_texture_lock);
+	request->m_texture = this;
+
+	strncpy(request->m_texture_name, p_texture_name, MAX_TEXTURE_NAME_LENGTH - 1);
+	request->m_texture_name[MAX_TEXTURE_NAME_LENGTH - 1] = '\0';
+	request->m_decoded = false;
+	request->m_texture_id = 0;
+	request->m_level = 0;
+	request->m_level_offset = 0;
+
+	asset_stream_request(stream_load, stream_upload, stream_cancel, request);
+}
+
+void texture::stream_load(void *p_data)
+{
+	texture_stream_request *request = (texture_stream_request *)p_data;
+	request->m_decoded = texture_image_load(request->m_texture_name, &request->m_image);
+}
+
+bool texture::stream_upload(void *p_data, uint32 *p_budget)
+{
+	PROFILE_SCOPE("texture::stream_upload");
+
+	texture_stream_request *request = (texture_stream_request *)p_data;
+
+	if (request->m_decoded) {
+		if (request->m_texture_id == 0) {
+			request->m_texture_id = create_texture_id();
+		}
+
+		// Largest level first, the texture only switches over once the whole chain is up
+		do {
+			uint32 size = texture_image_get_level_size(&request->m_image, request->m_level);
+			upload_level(request->m_texture_id, &request->m_image, request->m_level, request->m_level_offset);
+			request->m_level_offset += size;
+			request->m_level++;
+			*p_budget = (size < *p_budget) ? *p_budget - size : 0;
+		} while (request->m_level < request->m_image.m_level_count && *p_budget > 0);
+
+		if (request->m_level < request->m_image.m_level_count) {
+			return false;
+		}
+
+		texture_image_release(&request->m_image);
+	}
+
+	// A failed decode leaves the placeholder in place for good
+	request->m_texture->end_load(request->m_texture_id);
+	texture_release(request->m_texture);
+	MEMORY_DELETE(request);
+
+	return true;
+}
+
+void texture::stream_cancel(void *p_data)
+{
+	texture_stream_request *request = (texture_stream_request *)p_data;
+
+	// Levels already uploaded go with the context
+	if (request->m_decoded) {
+		texture_image_release(&request->m_image);
+	}
+
+	request->m_texture->end_load(0);
+	texture_release(request->m_texture);
+	MEMORY_DELETE(request);
 }
 
 void texture_system_init()
 {
 	g_allocator_texture.init(TEXTURE_MAX_NUMBER);
+	g_texture_lock = SDL_CreateMutex();
+	g_texture_placeholder = NULL;
+
+	g_texture_compression_supported = (GLEW_EXT_texture_compression_s3tc != 0);
+	g_texture_compression = g_texture_compression_supported;
+	g_texture_srgb_supported = (GLEW_EXT_texture_sRGB != 0);
+	g_texture_srgb = false;
 }
 
 void texture_system_shutdown()
 {
 	g_allocator_texture.shutdown();
+
+	if (g_texture_lock) {
+		SDL_DestroyMutex(g_texture_lock);
+		g_texture_lock = NULL;
+	}
 }
 
 texture * texture_create(char *p_name)
 {
-	return g_allocator_texture.create(p_name);
+	SDL_mutexP(g_texture_lock);
+	texture *texture_ptr = g_allocator_texture.create(p_name);
+	SDL_mutexV(g_texture_lock);
+
+	return texture_ptr;
 }
 
 void texture_release(texture *p_texture)
 {
+	SDL_mutexP(g_texture_lock);
 	g_allocator_texture.release(p_texture);
+	SDL_mutexV(g_texture_lock);
+}
+
+void texture_set_placeholder(texture *p_texture)
+{
+	g_texture_placeholder = p_texture;
 }
+
+void texture_set_srgb(bool p_srgb)
+{
+	g_texture_srgb = p_srgb;
+}
+
+void texture_set_compression(bool p_compression)
+{
+	g_texture_compression = p_compression && g_texture_compression_supported;
+}
\ No newline at end of file
@@ -5,27 +5,83 @@
 
 #define MAX_TEXTURE_NAME_LENGTH (256)
 
+typedef uint32 texture_format;
+const texture_format TEXTURE_FORMAT_L8 = 0;
+const texture_format TEXTURE_FORMAT_RGB8 = 1;
+const texture_format TEXTURE_FORMAT_RGBA8 = 2;
+const texture_format TEXTURE_FORMAT_DXT1 = 3;
+const texture_format TEXTURE_FORMAT_DXT5 = 4;
+
+// Pixels with the whole mip chain packed one level after another, level 0 first.
+// Either owned or pointing into a mapped cache file.
+class texture_image
+{
+public:
+	uint8 *m_data;
+	uint32 m_size;
+	uint32 m_width;
+	uint32 m_height;
+	texture_format m_format;
+	uint32 m_level_count;
+
+	uint8 *m_mapped_data;
+	uint32 m_mapped_size;
+};
+
+// Any thread, no GL. Maps the cooked file next to the source if it is current, otherwise decodes the source,
+// box filters the mips, block compresses them when enabled and cooks the result for next time.
+bool texture_image_load(char const* p_texture_name, texture_image *p_image);
+void texture_image_release(texture_image *p_image);
+uint32 texture_image_get_level_size(texture_image const* p_image, uint32 p_level);
+
 class texture
 {
 public:
 	texture();
 	~texture();
 
-	void bind(uint32 p_width, uint32 p_height);
 	void unbind();
+	// Binds to texture unit 0, the placeholder stands in until the texture is uploaded
 	void activate();
+	// Decode and upload right away, main thread only
 	void load(char *p_texture_name);
+	// Decode on a streaming thread and upload within the frame budget, callable from any thread
+	void load_async(char *p_texture_name);
+	bool is_loaded() const;
 
-	uint8 *m_texture_data;
 private:
+	// asset_stream callbacks
+	static void stream_load(void *p_data);
+	static bool stream_upload(void *p_data, uint32 *p_budget);
+	static void stream_cancel(void *p_data);
+
+	// Claims the load for the caller, false if someone else already has
+	bool begin_load();
+	// Publishes the id, 0 when the load failed, and lets the texture be loaded again
+	void end_load(uint32 p_texture_id);
+
 	uint32 m_texture_id;
+	bool m_loading;
 };
 
+// Call after GL is up, picks up whether block compression and sRGB formats are available
 void texture_system_init();
 void texture_system_shutdown();
 
+// Thread safe
 texture * texture_create(char *p_name);
 void texture_release(texture *p_texture);
 
+// Bound in place of textures that are still streaming, or failed to load
+void texture_set_placeholder(texture *p_texture);
+
+// Colour textures upload as sRGB so filtering and blending happen in linear space. Off by default since the
+// lighting shaders work on gamma space colours. Ignored without GL_EXT_texture_sRGB.
+void texture_set_srgb(bool p_srgb);
+
+// RGB and RGBA textures are cooked to DXT1 and DXT5, on by default when GL_EXT_texture_compression_s3tc is there.
+// Only affects textures loaded afterwards.
+void texture_set_compression(bool p_compression);
+
 
 #endif /* __TEXTURE_H_ */
\ No newline at end of file
@@ -0,0 +1,139 @@
+#include "texture_cache.h"
+
+#include "assert.h"
+#include "mapped_file.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#define TEXTURE_CACHE_MAGIC (0x5445474f) // "OGET"
+#define TEXTURE_CACHE_PATH_LENGTH (4096)
+
+// Mip levels follow the header back to back, largest first
+class texture_cache_header
+{
+public:
+	uint32 m_magic;
+	uint32 m_version;
+	uint32 m_format;
+	uint32 m_width;
+	uint32 m_height;
+	uint32 m_level_count;
+	uint32 m_data_size;
+	uint32 m_source_size;
+	uint64 m_source_time;
+};
+
+static void get_cooked_path(char const* p_source_path, char p_path[TEXTURE_CACHE_PATH_LENGTH])
+{
+	assert(strlen(p_source_path) + strlen(TEXTURE_CACHE_EXTENSION) < TEXTURE_CACHE_PATH_LENGTH);
+	sprintf(p_path, "%s%s", p_source_path, TEXTURE_CACHE_EXTENSION);
+}
+
+static bool is_header_current(texture_cache_header const* p_header, char const* p_source_path, bool p_compression)
+{
+	if (p_header->m_magic != TEXTURE_CACHE_MAGIC || p_header->m_version != TEXTURE_CACHE_VERSION) {
+		return false;
+	}
+
+	// Luminance is never compressed so it is current either way
+	bool compressed = (p_header->m_format == TEXTURE_FORMAT_DXT1 || p_header->m_format == TEXTURE_FORMAT_DXT5);
+	if (p_header->m_format != TEXTURE_FORMAT_L8 && compressed != p_compression) {
+		return false;
+	}
+
+	// Shipping without the sources is fine, the cooked file is all there is
+	struct stat st;
+	if (stat(p_source_path, &st) != 0) {
+		return true;
+	}
+
+	return (uint32)st.st_size == p_header->m_source_size && (uint64)st.st_mtime == p_header->m_source_time;
+}
+
+bool texture_cache_load(char const* p_source_path, bool p_compression, texture_image *p_image)
+{
+	char path[TEXTURE_CACHE_PATH_LENGTH];
+	get_cooked_path(p_source_path, path);
+
+	uint32 size = 0;
+	uint8 *data = mapped_file_open(path, false, &size);
+	if (data == NULL) {
+		return false;
+	}
+
+	texture_cache_header const* header = (texture_cache_header const*)data;
+	if (size < sizeof(texture_cache_header) || is_header_current(header, p_source_path, p_compression) == false) {
+		mapped_file_close(data, size);
+		return false;
+	}
+
+	memset(p_image, 0, sizeof(texture_image));
+	p_image->m_format = header->m_format;
+	p_image->m_width = header->m_width;
+	p_image->m_height = header->m_height;
+	p_image->m_level_count = header->m_level_count;
+	p_image->m_size = header->m_data_size;
+
+	// A header from a different layout or a truncated write shows up as a size mismatch
+	if (p_image->m_format > TEXTURE_FORMAT_DXT5 || p_image->m_level_count == 0 || p_image->m_level_count > 32) {
+		mapped_file_close(data, size);
+		return false;
+	}
+
+	uint32 expected_size = 0;
+	for (uint32 i = 0; i < p_image->m_level_count; ++i) {
+		expected_size += texture_image_get_level_size(p_image, i);
+	}
+
+	if (expected_size != header->m_data_size || size - sizeof(texture_cache_header) != expected_size) {
+		mapped_file_close(data, size);
+		return false;
+	}
+
+	p_image->m_data = data + sizeof(texture_cache_header);
+	p_image->m_mapped_data = data;
+	p_image->m_mapped_size = size;
+
+	return true;
+}
+
+bool texture_cache_save(char const* p_source_path, texture_image const* p_image)
+{
+	struct stat st;
+	if (stat(p_source_path, &st) != 0) {
+		return false;
+	}
+
+	texture_cache_header header;
+	memset(&header, 0, sizeof(header));
+	header.m_magic = TEXTURE_CACHE_MAGIC;
+	header.m_version = TEXTURE_CACHE_VERSION;
+	header.m_format = p_image->m_format;
+	header.m_width = p_image->m_width;
+	header.m_height = p_image->m_height;
+	header.m_level_count = p_image->m_level_count;
+	header.m_data_size = p_image->m_size;
+	header.m_source_size = (uint32)st.st_size;
+	header.m_source_time = (uint64)st.st_mtime;
+
+	char path[TEXTURE_CACHE_PATH_LENGTH];
+	get_cooked_path(p_source_path, path);
+
+	bool ret = false;
+	FILE *fp = fopen(path, "wb");
+	if (fp != NULL) {
+		ret = (fwrite(&header, 1, sizeof(header), fp) == sizeof(header))
+			&& (fwrite(p_image->m_data, 1, p_image->m_size, fp) == p_image->m_size);
+		fclose(fp);
+
+		// Never leave a truncated file behind
+		if (ret == false) {
+			remove(path);
+		}
+	}
+
+	return ret;
+}
\ No newline at end of file
@@ -0,0 +1,19 @@
+#ifndef __TEXTURE_CACHE_H_
+#define __TEXTURE_CACHE_H_
+
+#include "texture.h"
+
+// Bump whenever the cooked layout changes, older files are then recooked
+#define TEXTURE_CACHE_VERSION (1)
+
+#define TEXTURE_CACHE_EXTENSION ".cooked"
+
+// Map the pre-mipped file sitting next to p_source_path, the image data points straight into the mapping.
+// Fails if there is none, it no longer matches the source's size and timestamp, or its colour data
+// was cooked with block compression the other way from p_compression.
+bool texture_cache_load(char const* p_source_path, bool p_compression, texture_image *p_image);
+
+// Cook the whole mip chain of p_image for p_source_path
+bool texture_cache_save(char const* p_source_path, texture_image const* p_image);
+
+#endif /* __TEXTURE_CACHE_H_ */
\ No newline at end of file
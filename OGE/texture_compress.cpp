@@ -0,0 +1,185 @@
+#include "texture_compress.h"
+
+#include <string.h>
+
+// Gathers a 4x4 block into RGBA, texels past the right or bottom edge repeat the last row or column
+static void get_block(uint8 const* p_src, uint32 p_width, uint32 p_height, uint32 p_bytes_per_pixel, uint32 p_x, uint32 p_y, uint8 p_block[16][4])
+{
+	for (uint32 y = 0; y < 4; ++y) {
+		uint32 sy = (p_y + y < p_height) ? p_y + y : p_height - 1;
+
+		for (uint32 x = 0; x < 4; ++x) {
+			uint32 sx = (p_x + x < p_width) ? p_x + x : p_width - 1;
+			uint8 const* texel = &p_src[(sy * p_width + sx) * p_bytes_per_pixel];
+			uint8 *out = p_block[y * 4 + x];
+
+			out[0] = texel[0];
+			out[1] = texel[1];
+			out[2] = texel[2];
+			out[3] = (p_bytes_per_pixel == 4) ? texel[3] : 255;
+		}
+	}
+}
+
+static uint16 pack_565(uint32 p_r, uint32 p_g, uint32 p_b)
+{
+	return (uint16)(((p_r >> 3) << 11) | ((p_g >> 2) << 5) | (p_b >> 3));
+}
+
+static void unpack_565(uint16 p_color, int32 p_rgb[3])
+{
+	uint32 r = (p_color >> 11) & 31;
+	uint32 g = (p_color >> 5) & 63;
+	uint32 b = p_color & 31;
+
+	p_rgb[0] = (int32)((r << 3) | (r >> 2));
+	p_rgb[1] = (int32)((g << 2) | (g >> 4));
+	p_rgb[2] = (int32)((b << 3) | (b >> 2));
+}
+
+static void write_uint16(uint8 *p_dst, uint16 p_value)
+{
+	p_dst[0] = (uint8)(p_value & 0xff);
+	p_dst[1] = (uint8)(p_value >> 8);
+}
+
+// Endpoints are the corners of the colour bounding box pulled in by a sixteenth, which keeps
+// outliers from stretching the palette. Always the four colour mode, so DXT5 can share it.
+static void compress_color_block(uint8 const p_block[16][4], uint8 *p_dst)
+{
+	int32 min[3] = { 255, 255, 255 };
+	int32 max[3] = { 0, 0, 0 };
+	for (uint32 i = 0; i < 16; ++i) {
+		for (uint32 c = 0; c < 3; ++c) {
+			int32 v = p_block[i][c];
+			min[c] = (v < min[c]) ? v : min[c];
+			max[c] = (v > max[c]) ? v : max[c];
+		}
+	}
+
+	for (uint32 c = 0; c < 3; ++c) {
+		int32 inset = (max[c] - min[c]) >> 4;
+		min[c] += inset;
+		max[c] -= inset;
+	}
+
+	uint16 color0 = pack_565(max[0], max[1], max[2]);
+	uint16 color1 = pack_565(min[0], min[1], min[2]);
+
+	// color0 > color1 selects four colours, equal endpoints leave every index at zero
+	if (color0 < color1) {
+		uint16 swap = color0;
+		color0 = color1;
+		color1 = swap;
+	}
+
+	write_uint16(p_dst, color0);
+	write_uint16(p_dst + 2, color1);
+
+	uint32 indices = 0;
+	if (color0 != color1) {
+		int32 palette[4][3];
+		unpack_565(color0, palette[0]);
+		unpack_565(color1, palette[1]);
+		for (uint32 c = 0; c < 3; ++c) {
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+
+		for (uint32 i = 0; i < 16; ++i) {
+			uint32 best = 0;
+			int32 best_error = 0x7fffffff;
+			for (uint32 p = 0; p < 4; ++p) {
+				int32 dr = p_block[i][0] - palette[p][0];
+				int32 dg = p_block[i][1] - palette[p][1];
+				int32 db = p_block[i][2] - palette[p][2];
+				int32 error = dr * dr + dg * dg + db * db;
+				if (error < best_error) {
+					best_error = error;
+					best = p;
+				}
+			}
+
+			indices |= best << (i * 2);
+		}
+	}
+
+	p_dst[4] = (uint8)(indices & 0xff);
+	p_dst[5] = (uint8)((indices >> 8) & 0xff);
+	p_dst[6] = (uint8)((indices >> 16) & 0xff);
+	p_dst[7] = (uint8)(indices >> 24);
+}
+
+// Eight step ramp between the block's alpha extremes
+static void compress_alpha_block(uint8 const p_block[16][4], uint8 *p_dst)
+{
+	int32 alpha0 = 0;
+	int32 alpha1 = 255;
+	for (uint32 i = 0; i < 16; ++i) {
+		int32 a = p_block[i][3];
+		alpha0 = (a > alpha0) ? a : alpha0;
+		alpha1 = (a < alpha1) ? a : alpha1;
+	}
+
+	p_dst[0] = (uint8)alpha0;
+	p_dst[1] = (uint8)alpha1;
+
+	uint64 indices = 0;
+	if (alpha0 != alpha1) {
+		int32 palette[8];
+		palette[0] = alpha0;
+		palette[1] = alpha1;
+		for (int32 i = 1; i < 7; ++i) {
+			palette[i + 1] = ((7 - i) * alpha0 + i * alpha1) / 7;
+		}
+
+		for (uint32 i = 0; i < 16; ++i) {
+			uint64 best = 0;
+			int32 best_error = 0x7fffffff;
+			for (uint32 p = 0; p < 8; ++p) {
+				int32 d = p_block[i][3] - palette[p];
+				int32 error = (d < 0) ? -d : d;
+				if (error < best_error) {
+					best_error = error;
+					best = p;
+				}
+			}
+
+			indices |= best << (i * 3);
+		}
+	}
+
+	for (uint32 i = 0; i < 6; ++i) {
+		p_dst[2 + i] = (uint8)((indices >> (i * 8)) & 0xff);
+	}
+}
+
+uint32 texture_compress_get_size(uint32 p_width, uint32 p_height, uint32 p_block_size)
+{
+	return ((p_width + 3) / 4) * ((p_height + 3) / 4) * p_block_size;
+}
+
+void texture_compress_dxt1(uint8 const* p_src, uint32 p_width, uint32 p_height, uint32 p_bytes_per_pixel, uint8 *p_dst)
+{
+	uint8 block[16][4];
+	for (uint32 y = 0; y < p_height; y += 4) {
+		for (uint32 x = 0; x < p_width; x += 4) {
+			get_block(p_src, p_width, p_height, p_bytes_per_pixel, x, y, block);
+			compress_color_block(block, p_dst);
+			p_dst += TEXTURE_COMPRESS_DXT1_BLOCK_SIZE;
+		}
+	}
+}
+
+void texture_compress_dxt5(uint8 const* p_src, uint32 p_width, uint32 p_height, uint8 *p_dst)
+{
+	uint8 block[16][4];
+	for (uint32 y = 0; y < p_height; y += 4) {
+		for (uint32 x = 0; x < p_width; x += 4) {
+			get_block(p_src, p_width, p_height, 4, x, y, block);
+			compress_alpha_block(block, p_dst);
+			compress_color_block(block, p_dst + 8);
+			p_dst += TEXTURE_COMPRESS_DXT5_BLOCK_SIZE;
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,16 @@
+#ifndef __TEXTURE_COMPRESS_H_
+#define __TEXTURE_COMPRESS_H_
+
+#include "core_types.h"
+
+#define TEXTURE_COMPRESS_DXT1_BLOCK_SIZE (8)
+#define TEXTURE_COMPRESS_DXT5_BLOCK_SIZE (16)
+
+// Bytes needed for a level, partial 4x4 blocks at the edges still take a whole block
+uint32 texture_compress_get_size(uint32 p_width, uint32 p_height, uint32 p_block_size);
+
+// Any thread. Source texels are tightly packed 3 or 4 byte RGB(A), DXT1 drops alpha.
+void texture_compress_dxt1(uint8 const* p_src, uint32 p_width, uint32 p_height, uint32 p_bytes_per_pixel, uint8 *p_dst);
+void texture_compress_dxt5(uint8 const* p_src, uint32 p_width, uint32 p_height, uint8 *p_dst);
+
+#endif /* __TEXTURE_COMPRESS_H_ */
\ No newline at end of file
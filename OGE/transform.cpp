@@ -1,59 +1,486 @@
-#include "transform.h"	
+#include "transform.h"
+
+#include "assert.h"
+#include "memory_lib.h"
+#include "job_system.h"
+
+#include <string.h>
+
+#define TRANSFORM_SLOT_NONE (0xffffffff)
+
+// Roots handed to each job, a root's whole subtree goes with it
+#define TRANSFORM_ROOT_BATCH_SIZE (16)
+
+// Local values changed since the last update
+const uint8 TRANSFORM_FLAG_DIRTY = 1;
+
+// Per slot, kept in depth first order so every subtree is one contiguous run starting at its root
+static Vector3 *g_position = NULL;
+static quaternion *g_orient = NULL;
+static Vector3 *g_scale = NULL;
+static matrix44 *g_world = NULL;
+static transform_id *g_parent_id = NULL;
+static transform_id *g_slot_id = NULL;
+static uint32 *g_version = NULL;
+// Number of the update that last rebuilt the world matrix, tells children their parent moved
+static uint32 *g_rebuilt = NULL;
+static uint8 *g_flags = NULL;
+
+// Per slot, derived from the parent ids whenever the order is rebuilt
+static uint32 *g_parent_slot = NULL;
+static uint32 *g_subtree_end = NULL;
+static uint32 *g_roots = NULL;
+static uint32 g_root_count = 0;
+
+// Per id
+static uint32 *g_id_slot = NULL;
+static transform_id *g_free_ids = NULL;
+static uint32 g_free_id_count = 0;
+static uint32 g_id_count = 0;
+
+// Scratch for sorting and for the per batch counts of a parallel update
+static uint32 *g_scratch_a = NULL;
+static uint32 *g_scratch_b = NULL;
+static uint32 *g_scratch_c = NULL;
+static uint8 *g_scratch_permute = NULL;
+
+static uint32 g_count = 0;
+static uint32 g_capacity = 0;
+static bool g_order_dirty = false;
+static uint32 g_dirty_min = TRANSFORM_SLOT_NONE;
+static uint32 g_update_index = 0;
+static uint32 g_updated_count = 0;
+
+template <class T>
+static void resize_array(T **p_array, uint32 p_capacity)
+{
+	*p_array = (T *)MEMORY_REALLOC(*p_array, sizeof(T) * p_capacity, MEMORY_TAG_SCENE);
+	assert(*p_array != NULL);
+}
+
+static void resize(uint32 p_capacity)
+{
+	resize_array(&g_position, p_capacity);
+	resize_array(&g_orient, p_capacity);
+	resize_array(&g_scale, p_capacity);
+	resize_array(&g_world, p_capacity);
+	resize_array(&g_parent_id, p_capacity);
+	resize_array(&g_slot_id, p_capacity);
+	resize_array(&g_version, p_capacity);
+	resize_array(&g_rebuilt, p_capacity);
+	resize_array(&g_flags, p_capacity);
+	resize_array(&g_parent_slot, p_capacity);
+	resize_array(&g_subtree_end, p_capacity);
+	resize_array(&g_roots, p_capacity);
+	resize_array(&g_id_slot, p_capacity);
+	resize_array(&g_free_ids, p_capacity);
+	resize_array(&g_scratch_a, p_capacity);
+	resize_array(&g_scratch_b, p_capacity);
+	resize_array(&g_scratch_c, p_capacity);
+	resize_array(&g_scratch_permute, p_capacity * sizeof(matrix44));
+
+	g_capacity = p_capacity;
+}
+
+template <class T>
+static void free_array(T **p_array)
+{
+	MEMORY_FREE(*p_array);
+	*p_array = NULL;
+}
+
+static void mark_dirty(uint32 p_slot)
+{
+	g_flags[p_slot] |= TRANSFORM_FLAG_DIRTY;
+	if (p_slot < g_dirty_min) {
+		g_dirty_min = p_slot;
+	}
+}
+
+static void move_slot(uint32 p_from, uint32 p_to)
+{
+	g_position[p_to] = g_position[p_from];
+	g_orient[p_to] = g_orient[p_from];
+	g_scale[p_to] = g_scale[p_from];
+	memcpy(&g_world[p_to], &g_world[p_from], sizeof(matrix44));
+	g_parent_id[p_to] = g_parent_id[p_from];
+	g_slot_id[p_to] = g_slot_id[p_from];
+	g_version[p_to] = g_version[p_from];
+	g_rebuilt[p_to] = g_rebuilt[p_from];
+	g_flags[p_to] = g_flags[p_from];
+
+	g_id_slot[g_slot_id[p_to]] = p_to;
+}
+
+template <class T>
+static void permute_array(T *p_array, uint32 const* p_order)
+{
+	T *sorted = (T *)g_scratch_permute;
+	for (uint32 i = 0; i < g_count; ++i) {
+		memcpy(&sorted[i], &p_array[p_order[i]], sizeof(T));
+	}
+	memcpy(p_array, sorted, sizeof(T) * g_count);
+}
+
+// Depth first order from the parent ids. Children keep their relative order, so does every root.
+static void sort()
+{
+	uint32 *first_child = g_scratch_a;
+	uint32 *next_sibling = g_scratch_b;
+	uint32 *order = g_scratch_c;
+
+	for (uint32 i = 0; i < g_count; ++i) {
+		first_child[i] = TRANSFORM_SLOT_NONE;
+	}
+
+	// Pushed on the front, so each child list comes out back to front which is what the stack wants
+	g_root_count = 0;
+	for (uint32 i = 0; i < g_count; ++i) {
+		if (g_parent_id[i] == TRANSFORM_ID_NONE) {
+			g_roots[g_root_count++] = i;
+		} else {
+			uint32 parent = g_id_slot[g_parent_id[i]];
+			next_sibling[i] = first_child[parent];
+			first_child[parent] = i;
+		}
+	}
+
+	// The parent slots double as the stack, nothing reads them here and they are rebuilt once the order is known
+	uint32 *stack = g_parent_slot;
+	uint32 order_count = 0;
+	for (uint32 r = 0; r < g_root_count; ++r) {
+		uint32 stack_count = 0;
+		stack[stack_count++] = g_roots[r];
+
+		while (stack_count > 0) {
+			uint32 slot = stack[--stack_count];
+			order[order_count++] = slot;
+
+			for (uint32 child = first_child[slot]; child != TRANSFORM_SLOT_NONE; child = next_sibling[child]) {
+				stack[stack_count++] = child;
+			}
+		}
+	}
+
+	assert(order_count == g_count);
+
+	permute_array(g_position, order);
+	permute_array(g_orient, order);
+	permute_array(g_scale, order);
+	permute_array(g_world, order);
+	permute_array(g_parent_id, order);
+	permute_array(g_slot_id, order);
+	permute_array(g_version, order);
+	permute_array(g_rebuilt, order);
+	permute_array(g_flags, order);
+
+	g_root_count = 0;
+	g_dirty_min = TRANSFORM_SLOT_NONE;
+	for (uint32 i = 0; i < g_count; ++i) {
+		g_id_slot[g_slot_id[i]] = i;
+		g_subtree_end[i] = i + 1;
+
+		if (g_parent_id[i] == TRANSFORM_ID_NONE) {
+			g_roots[g_root_count++] = i;
+		}
+
+		if ((g_flags[i] & TRANSFORM_FLAG_DIRTY) && g_dirty_min == TRANSFORM_SLOT_NONE) {
+			g_dirty_min = i;
+		}
+	}
+
+	for (uint32 i = 0; i < g_count; ++i) {
+		g_parent_slot[i] = (g_parent_id[i] == TRANSFORM_ID_NONE) ? TRANSFORM_SLOT_NONE : g_id_slot[g_parent_id[i]];
+	}
+
+	// Children sit after their parents, so walking backwards has every subtree finished before its root
+	for (uint32 i = g_count; i-- > 0;) {
+		uint32 parent = g_parent_slot[i];
+		if (parent != TRANSFORM_SLOT_NONE && g_subtree_end[i] > g_subtree_end[parent]) {
+			g_subtree_end[parent] = g_subtree_end[i];
+		}
+	}
+
+	g_order_dirty = false;
+}
+
+// Same composition transform used to build eagerly, scale then rotate then translate, then the parent
+static void build_world(uint32 p_slot)
+{
+	matrix44 local;
+	g_orient[p_slot].CreateMatrix(local.m_data);
+
+	Vector3 const& scale = g_scale[p_slot];
+	for (uint32 i = 0; i < 4; ++i) {
+		local.m_data[i] *= scale.m_data[0];
+		local.m_data[4 + i] *= scale.m_data[1];
+		local.m_data[8 + i] *= scale.m_data[2];
+	}
+
+	local.set_translation(g_position[p_slot]);
+
+	uint32 parent = g_parent_slot[p_slot];
+	if (parent != TRANSFORM_SLOT_NONE) {
+		g_world[p_slot] = local * g_world[parent];
+	} else {
+		g_world[p_slot] = local;
+	}
+
+	if (++g_version[p_slot] == 0) {
+		g_version[p_slot] = 1;
+	}
+	g_rebuilt[p_slot] = g_update_index;
+}
+
+static uint32 update_range(uint32 p_begin, uint32 p_end)
+{
+	uint32 updated = 0;
+	for (uint32 i = p_begin; i < p_end; ++i) {
+		uint32 parent = g_parent_slot[i];
+		if ((g_flags[i] & TRANSFORM_FLAG_DIRTY) || (parent != TRANSFORM_SLOT_NONE && g_rebuilt[parent] == g_update_index)) {
+			build_world(i);
+			g_flags[i] &= ~TRANSFORM_FLAG_DIRTY;
+			updated++;
+		}
+	}
+
+	return updated;
+}
+
+// Subtrees are disjoint, so each batch of roots can go on its own thread
+static void update_roots_job(void *p_data, uint32 p_begin, uint32 p_end)
+{
+	uint32 *updated = (uint32 *)p_data;
+	for (uint32 r = p_begin; r < p_end; ++r) {
+		uint32 root = g_roots[r];
+		uint32 begin = (root > g_dirty_min) ? root : g_dirty_min;
+		updated[r] = (begin < g_subtree_end[root]) ? update_range(begin, g_subtree_end[root]) : 0;
+	}
+}
+
+static transform_id transform_system_create()
+{
+	assert(g_capacity > 0);
+	assert(job_system_is_main_thread());
+
+	if (g_count == g_capacity) {
+		resize(g_capacity * 2);
+	}
+
+	transform_id id = (g_free_id_count > 0) ? g_free_ids[--g_free_id_count] : g_id_count++;
+	uint32 slot = g_count++;
+
+	g_position[slot].set(0.0f, 0.0f, 0.0f);
+	g_orient[slot].CreateFromAxisAngle(1.0f, 0.0f, 0.0f, 0.0f);
+	g_scale[slot].set(1.0f, 1.0f, 1.0f);
+	g_world[slot].set_identity();
+	g_parent_id[slot] = TRANSFORM_ID_NONE;
+	g_slot_id[slot] = id;
+	g_version[slot] = 1;
+	g_rebuilt[slot] = 0;
+	g_flags[slot] = 0;
+	g_id_slot[id] = slot;
+
+	// A new root at the end is already in order
+	if (g_order_dirty == false) {
+		g_parent_slot[slot] = TRANSFORM_SLOT_NONE;
+		g_subtree_end[slot] = slot + 1;
+		g_roots[g_root_count++] = slot;
+	}
+
+	return id;
+}
+
+static void transform_system_destroy(transform_id p_id)
+{
+	// Owners can outlive the system on the way out
+	if (g_capacity == 0) {
+		return;
+	}
+
+	assert(job_system_is_main_thread());
+
+	uint32 slot = g_id_slot[p_id];
+	assert(slot != TRANSFORM_SLOT_NONE);
+
+	for (uint32 i = 0; i < g_count; ++i) {
+		if (g_parent_id[i] == p_id) {
+			g_parent_id[i] = TRANSFORM_ID_NONE;
+			mark_dirty(i);
+		}
+	}
+
+	uint32 last = g_count - 1;
+	if (slot != last) {
+		move_slot(last, slot);
+	}
+
+	g_id_slot[p_id] = TRANSFORM_SLOT_NONE;
+	g_free_ids[g_free_id_count++] = p_id;
+	g_count--;
+
+	g_order_dirty = true;
+}
 
 transform::transform()
 {
-	m_transform_matrix.set_identity();
-	m_position.set(0.0f, 0.0f, 0.0f);
-	m_orientation.CreateFromAxisAngle(1.0f, 0.0f, 0.0f, 0.0f);
+	m_id = transform_system_create();
 }
 
+transform::~transform()
+{
+	transform_system_destroy(m_id);
+}
 
 Vector3 const& transform::get_position()
 {
-	return m_position;
+	return g_position[g_id_slot[m_id]];
 }
 
 Vector3 const& transform::get_scale()
 {
-	return m_scale;
+	return g_scale[g_id_slot[m_id]];
 }
 
 quaternion const& transform::get_orient()
 {
-	return m_orientation;
+	return g_orient[g_id_slot[m_id]];
 }
 
-	
 void transform::set_values(Vector3 const* p_position, quaternion const* p_orient, Vector3 const* p_scale)
 {
+	uint32 slot = g_id_slot[m_id];
+
 	if (p_position) {
-		m_position = *p_position;
+		g_position[slot] = *p_position;
 	}
 
 	if (p_orient) {
-		m_orientation = *p_orient;
+		g_orient[slot] = *p_orient;
 	}
 
 	if (p_scale) {
-		m_scale = *p_scale;
+		g_scale[slot] = *p_scale;
 	}
 
-	m_orientation.CreateMatrix(m_transform_matrix.m_data);
+	mark_dirty(slot);
+}
 
-	
+void transform::set_parent(transform const* p_parent)
+{
+	transform_id parent_id = p_parent ? p_parent->m_id : TRANSFORM_ID_NONE;
 
-	matrix44 tmp_scale;
-	tmp_scale.set_identity();
-	tmp_scale._00 *= m_scale.m_data[0];
-	tmp_scale._11 *= m_scale.m_data[1];
-	tmp_scale._22 *= m_scale.m_data[2];
-	tmp_scale._33 = 1.0f;
+	// No cycles
+	for (transform_id id = parent_id; id != TRANSFORM_ID_NONE; id = g_parent_id[g_id_slot[id]]) {
+		assert(id != m_id);
+	}
 
-	
-	m_transform_matrix = tmp_scale * m_transform_matrix;
+	uint32 slot = g_id_slot[m_id];
+	if (g_parent_id[slot] == parent_id) {
+		return;
+	}
 
-	m_transform_matrix._03 = m_position.m_data[0];
-	m_transform_matrix._13 = m_position.m_data[1];
-	m_transform_matrix._23 = m_position.m_data[2];
+	g_parent_id[slot] = parent_id;
+	mark_dirty(slot);
+	g_order_dirty = true;
 }
 
+matrix44 const& transform::get_world_matrix() const
+{
+	return g_world[g_id_slot[m_id]];
+}
+
+Vector3 transform::get_world_position() const
+{
+	return g_world[g_id_slot[m_id]].get_trans();
+}
+
+transform_id transform::get_id() const
+{
+	return m_id;
+}
+
+bool transform_system_init(uint32 p_capacity)
+{
+	assert(p_capacity > 0);
+
+	g_count = 0;
+	g_id_count = 0;
+	g_free_id_count = 0;
+	g_root_count = 0;
+	g_order_dirty = false;
+	g_dirty_min = TRANSFORM_SLOT_NONE;
+	g_update_index = 0;
+	g_updated_count = 0;
+
+	resize(p_capacity);
+
+	return true;
+}
+
+void transform_system_shutdown()
+{
+	free_array(&g_position);
+	free_array(&g_orient);
+	free_array(&g_scale);
+	free_array(&g_world);
+	free_array(&g_parent_id);
+	free_array(&g_slot_id);
+	free_array(&g_version);
+	free_array(&g_rebuilt);
+	free_array(&g_flags);
+	free_array(&g_parent_slot);
+	free_array(&g_subtree_end);
+	free_array(&g_roots);
+	free_array(&g_id_slot);
+	free_array(&g_free_ids);
+	free_array(&g_scratch_a);
+	free_array(&g_scratch_b);
+	free_array(&g_scratch_c);
+	free_array(&g_scratch_permute);
+
+	g_count = 0;
+	g_capacity = 0;
+}
+
+void transform_system_update()
+{
+	assert(job_system_is_main_thread());
+
+	if (g_order_dirty) {
+		sort();
+	}
+
+	g_updated_count = 0;
+	if (g_dirty_min == TRANSFORM_SLOT_NONE) {
+		return;
+	}
+
+	// Zero is what a never rebuilt slot holds
+	if (++g_update_index == 0) {
+		g_update_index = 1;
+	}
+
+	if (g_count - g_dirty_min >= TRANSFORM_PARALLEL_MIN && g_root_count > 1) {
+		uint32 *updated = g_scratch_a;
+		job_parallel_for(g_root_count, TRANSFORM_ROOT_BATCH_SIZE, update_roots_job, updated);
+
+		for (uint32 r = 0; r < g_root_count; ++r) {
+			g_updated_count += updated[r];
+		}
+	} else {
+		g_updated_count = update_range(g_dirty_min, g_count);
+	}
+
+	g_dirty_min = TRANSFORM_SLOT_NONE;
+}
+
+uint32 transform_system_get_version(transform_id p_id)
+{
+	return g_version[g_id_slot[p_id]];
+}
+
+uint32 transform_system_get_updated_count()
+{
+	return g_updated_count;
+}
\ No newline at end of file
@@ -5,24 +5,58 @@
 #include "quaternion.h"
 #include "matrix.h"
 
+typedef uint32 transform_id;
+#define TRANSFORM_ID_NONE (0xffffffff)
+
+#define TRANSFORM_CAPACITY_DEFAULT (1024)
+
+// Below this many transforms the update runs on the main thread only
+#define TRANSFORM_PARALLEL_MIN (4096)
+
+// A node in the transform hierarchy. The local values live in the transform system's arrays and the
+// world matrix is only rebuilt by transform_system_update, so setting values several times a frame is cheap.
 class transform
 {
 public:
 	transform();
+	~transform();
 
 	Vector3 const& get_position();
 	Vector3 const& get_scale();
 	quaternion const& get_orient();
 
+	// Local to the parent, NULL leaves that part alone
 	void set_values(Vector3 const* p_position, quaternion const* p_orient, Vector3 const* p_scale);
 
-	matrix44 m_transform_matrix;
+	// NULL detaches, the local values are kept so the node jumps to them in world space
+	void set_parent(transform const* p_parent);
+
+	// As of the last transform_system_update, don't hold on to it across frames
+	matrix44 const& get_world_matrix() const;
+	Vector3 get_world_position() const;
+
+	transform_id get_id() const;
 
 private:
-	Vector3 m_position;
-	quaternion m_orientation;
-	Vector3 m_scale;
+	// Each transform owns its node
+	transform(transform const&);
+	transform& operator=(transform const&);
 
+	transform_id m_id;
 };
 
+// Main thread only, like everything that creates or edits transforms
+bool transform_system_init(uint32 p_capacity);
+void transform_system_shutdown();
+
+// Rebuild the world matrix of every transform that was changed, or whose parent's was, parents first.
+// Returns straight away when nothing was touched, so a static scene costs nothing.
+void transform_system_update();
+
+// Bumped every time the world matrix is rebuilt, never zero, for caching anything derived from it
+uint32 transform_system_get_version(transform_id p_id);
+
+// World matrices rebuilt by the last update
+uint32 transform_system_get_updated_count();
+
 #endif /* __TRANSFORM_H_ */
\ No newline at end of file
@@ -52,7 +52,7 @@ public:
 
 	void set(real x, real y, real z);
 
-	Vector3 cross(Vector3 const& val);
+	Vector3 cross(Vector3 const& val) const;
 
 	float len() const;
 
@@ -62,4 +62,7 @@ Vector3 vmax(Vector3 const& val_a, Vector3 const& val_b);
 
 Vector3 vmin(Vector3 const& val_a, Vector3 const& val_b);
 
+// Inline so the per vertex loops don't pay a call for every operator
+#include "vector3.inl"
+
 #endif // __VECTOR3_H_
\ No newline at end of file
@@ -0,0 +1,50 @@
+#ifndef __VECTOR4_H_
+#define __VECTOR4_H_
+
+#include "vector3.h"
+
+#if defined(MATH_SSE)
+#include <xmmintrin.h>
+#endif
+
+// Four wide vector for the SIMD paths. Aligned so stack and static copies load in one go, heap copies
+// only get malloc's alignment so the kernels never rely on it.
+class MATH_ALIGN(16) vector4
+{
+public:
+	union {
+		real m_data[4];
+		struct {
+			real x;
+			real y;
+			real z;
+			real w;
+		};
+	};
+
+	vector4();
+	vector4(real p_x, real p_y, real p_z, real p_w);
+	vector4(Vector3 const& p_vec, real p_w);
+
+	Vector3 get_vector3() const;
+	void set(real p_x, real p_y, real p_z, real p_w);
+
+	vector4 operator+(vector4 const& p_val) const;
+	vector4 operator-(vector4 const& p_val) const;
+	vector4 operator*(real p_val) const;
+	vector4& operator+=(vector4 const& p_val);
+	vector4& operator-=(vector4 const& p_val);
+	vector4& operator*=(real p_val);
+
+	real dot3(vector4 const& p_val) const;
+	real dot4(vector4 const& p_val) const;
+	// w of the result is zero
+	vector4 cross3(vector4 const& p_val) const;
+	real len3() const;
+	// Leaves w alone, zero length vectors are left as they are
+	void normalize3();
+};
+
+#include "vector4.inl"
+
+#endif /* __VECTOR4_H_ */
\ No newline at end of file
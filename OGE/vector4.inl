@@ -0,0 +1,171 @@
+#if defined(MATH_SSE)
+inline __m128 vector4_load(vector4 const& p_vec)
+{
+	return _mm_loadu_ps(p_vec.m_data);
+}
+
+inline vector4 vector4_store(__m128 p_simd)
+{
+	vector4 ret;
+	_mm_storeu_ps(ret.m_data, p_simd);
+	return ret;
+}
+
+// x*x + y*y + z*z in every lane
+inline __m128 vector4_dot3_splat(__m128 p_a, __m128 p_b)
+{
+	__m128 mul = _mm_mul_ps(p_a, p_b);
+	__m128 x = _mm_shuffle_ps(mul, mul, _MM_SHUFFLE(0, 0, 0, 0));
+	__m128 y = _mm_shuffle_ps(mul, mul, _MM_SHUFFLE(1, 1, 1, 1));
+	__m128 z = _mm_shuffle_ps(mul, mul, _MM_SHUFFLE(2, 2, 2, 2));
+	return _mm_add_ps(_mm_add_ps(x, y), z);
+}
+#endif
+
+inline vector4::vector4()
+{
+	m_data[0] = 0.0f;
+	m_data[1] = 0.0f;
+	m_data[2] = 0.0f;
+	m_data[3] = 0.0f;
+}
+
+inline vector4::vector4(real p_x, real p_y, real p_z, real p_w)
+{
+	m_data[0] = p_x;
+	m_data[1] = p_y;
+	m_data[2] = p_z;
+	m_data[3] = p_w;
+}
+
+inline vector4::vector4(Vector3 const& p_vec, real p_w)
+{
+	m_data[0] = p_vec.m_data[0];
+	m_data[1] = p_vec.m_data[1];
+	m_data[2] = p_vec.m_data[2];
+	m_data[3] = p_w;
+}
+
+inline Vector3 vector4::get_vector3() const
+{
+	return Vector3(m_data[0], m_data[1], m_data[2]);
+}
+
+inline void vector4::set(real p_x, real p_y, real p_z, real p_w)
+{
+	m_data[0] = p_x;
+	m_data[1] = p_y;
+	m_data[2] = p_z;
+	m_data[3] = p_w;
+}
+
+inline vector4 vector4::operator+(vector4 const& p_val) const
+{
+#if defined(MATH_SSE)
+	return vector4_store(_mm_add_ps(vector4_load(*this), vector4_load(p_val)));
+#else
+	return vector4(m_data[0] + p_val.m_data[0], m_data[1] + p_val.m_data[1], m_data[2] + p_val.m_data[2], m_data[3] + p_val.m_data[3]);
+#endif
+}
+
+inline vector4 vector4::operator-(vector4 const& p_val) const
+{
+#if defined(MATH_SSE)
+	return vector4_store(_mm_sub_ps(vector4_load(*this), vector4_load(p_val)));
+#else
+	return vector4(m_data[0] - p_val.m_data[0], m_data[1] - p_val.m_data[1], m_data[2] - p_val.m_data[2], m_data[3] - p_val.m_data[3]);
+#endif
+}
+
+inline vector4 vector4::operator*(real p_val) const
+{
+#if defined(MATH_SSE)
+	return vector4_store(_mm_mul_ps(vector4_load(*this), _mm_set1_ps(p_val)));
+#else
+	return vector4(m_data[0] * p_val, m_data[1] * p_val, m_data[2] * p_val, m_data[3] * p_val);
+#endif
+}
+
+inline vector4& vector4::operator+=(vector4 const& p_val)
+{
+	*this = *this + p_val;
+	return *this;
+}
+
+inline vector4& vector4::operator-=(vector4 const& p_val)
+{
+	*this = *this - p_val;
+	return *this;
+}
+
+inline vector4& vector4::operator*=(real p_val)
+{
+	*this = *this * p_val;
+	return *this;
+}
+
+inline real vector4::dot3(vector4 const& p_val) const
+{
+#if defined(MATH_SSE)
+	return _mm_cvtss_f32(vector4_dot3_splat(vector4_load(*this), vector4_load(p_val)));
+#else
+	return (m_data[0] * p_val.m_data[0]) + (m_data[1] * p_val.m_data[1]) + (m_data[2] * p_val.m_data[2]);
+#endif
+}
+
+inline real vector4::dot4(vector4 const& p_val) const
+{
+#if defined(MATH_SSE)
+	__m128 mul = _mm_mul_ps(vector4_load(*this), vector4_load(p_val));
+	__m128 sum = _mm_add_ps(mul, _mm_movehl_ps(mul, mul));
+	sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 1, 1, 1)));
+	return _mm_cvtss_f32(sum);
+#else
+	return (m_data[0] * p_val.m_data[0]) + (m_data[1] * p_val.m_data[1]) + (m_data[2] * p_val.m_data[2]) + (m_data[3] * p_val.m_data[3]);
+#endif
+}
+
+inline vector4 vector4::cross3(vector4 const& p_val) const
+{
+#if defined(MATH_SSE)
+	// (y, z, x) * (z, x, y) - (z, x, y) * (y, z, x), the w lanes cancel to zero
+	__m128 a = vector4_load(*this);
+	__m128 b = vector4_load(p_val);
+	__m128 a_yzx = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+	__m128 b_yzx = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+	__m128 c = _mm_sub_ps(_mm_mul_ps(a, b_yzx), _mm_mul_ps(a_yzx, b));
+	return vector4_store(_mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1)));
+#else
+	return vector4((m_data[1] * p_val.m_data[2]) - (m_data[2] * p_val.m_data[1]),
+		(m_data[2] * p_val.m_data[0]) - (m_data[0] * p_val.m_data[2]),
+		(m_data[0] * p_val.m_data[1]) - (m_data[1] * p_val.m_data[0]),
+		0.0f);
+#endif
+}
+
+inline real vector4::len3() const
+{
+	return sqrt(dot3(*this));
+}
+
+inline void vector4::normalize3()
+{
+#if defined(MATH_SSE)
+	__m128 v = vector4_load(*this);
+	__m128 len = _mm_sqrt_ps(vector4_dot3_splat(v, v));
+	if (_mm_cvtss_f32(len) > 0.0f) {
+		// Divide rather than the rsqrt estimate so results match the scalar path
+		__m128 w = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3));
+		__m128 n = _mm_div_ps(v, len);
+		_mm_storeu_ps(m_data, n);
+		_mm_store_ss(&m_data[3], w);
+	}
+#else
+	real len = len3();
+	if (len > 0.0f) {
+		m_data[0] /= len;
+		m_data[1] /= len;
+		m_data[2] /= len;
+	}
+#endif
+}
\ No newline at end of file
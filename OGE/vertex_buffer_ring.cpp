@@ -0,0 +1,81 @@
+#include "vertex_buffer_ring.h"
+
+#include "glew/glew.h"
+#include "assert.h"
+
+// Keep every write aligned for the vertex fetch
+#define VERTEX_BUFFER_RING_ALIGNMENT (16)
+
+vertex_buffer_ring::vertex_buffer_ring()
+{
+	m_buffer_id = 0;
+	m_size = 0;
+	m_offset = 0;
+}
+
+vertex_buffer_ring::~vertex_buffer_ring()
+{
+	shutdown();
+}
+
+void vertex_buffer_ring::init(uint32 p_size)
+{
+	assert(m_buffer_id == 0);
+
+	m_size = p_size;
+	m_offset = 0;
+
+	glGenBuffersARB(1, (GLuint *)&m_buffer_id);
+	bind();
+	orphan();
+	unbind();
+}
+
+void vertex_buffer_ring::shutdown()
+{
+	if (m_buffer_id) {
+		glDeleteBuffersARB(1, (GLuint const*)&m_buffer_id);
+		m_buffer_id = 0;
+	}
+
+	m_size = 0;
+	m_offset = 0;
+}
+
+void vertex_buffer_ring::orphan()
+{
+	glBufferDataARB(GL_ARRAY_BUFFER_ARB, m_size, NULL, GL_STREAM_DRAW_ARB);
+	m_offset = 0;
+}
+
+uint32 vertex_buffer_ring::write(void const* p_data, uint32 p_size)
+{
+	assert(m_buffer_id != 0);
+
+	bind();
+
+	if (p_size > m_size) {
+		m_size = p_size * 2;
+		orphan();
+	} else if (m_offset + p_size > m_size) {
+		// Wrapped, hand the old storage back to the driver and start over
+		orphan();
+	}
+
+	uint32 offset = m_offset;
+	glBufferSubDataARB(GL_ARRAY_BUFFER_ARB, offset, p_size, p_data);
+
+	m_offset = (offset + p_size + (VERTEX_BUFFER_RING_ALIGNMENT - 1)) & ~(VERTEX_BUFFER_RING_ALIGNMENT - 1);
+
+	return offset;
+}
+
+void vertex_buffer_ring::bind() const
+{
+	glBindBufferARB(GL_ARRAY_BUFFER_ARB, m_buffer_id);
+}
+
+void vertex_buffer_ring::unbind() const
+{
+	glBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+}
\ No newline at end of file
@@ -0,0 +1,31 @@
+#ifndef __VERTEX_BUFFER_RING_H_
+#define __VERTEX_BUFFER_RING_H_
+
+#include "core_types.h"
+
+// Streaming vertex buffer for data that changes every frame. Writes are appended
+// and the storage is orphaned when it wraps so the GPU never waits on it.
+class vertex_buffer_ring
+{
+public:
+	vertex_buffer_ring();
+	~vertex_buffer_ring();
+
+	void init(uint32 p_size);
+	void shutdown();
+
+	// Copy data into the ring, returns its byte offset. Leaves the buffer bound.
+	uint32 write(void const* p_data, uint32 p_size);
+
+	void bind() const;
+	void unbind() const;
+
+private:
+	void orphan();
+
+	uint32 m_buffer_id;
+	uint32 m_size;
+	uint32 m_offset;
+};
+
+#endif /* __VERTEX_BUFFER_RING_H_ */
\ No newline at end of file